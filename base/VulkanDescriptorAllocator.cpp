@@ -0,0 +1,260 @@
+/*
+* Vulkan descriptor allocator
+*
+* Deduplicates descriptor set layouts and allocates descriptor sets from chains of pools that grow on demand
+* Transient sets come from per-frame pool chains that are reset in bulk, immutable sets can be shared by all users with the same descriptors
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanDescriptorAllocator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace vks
+{
+	namespace
+	{
+		// Serializes individual members and hashes them with 64 bit FNV-1a
+		// Variable length data is preceded by its count or presence, so different inputs can't serialize to the same bytes
+		class Hasher
+		{
+		public:
+			std::vector<uint8_t> data;
+			uint64_t value = 14695981039346656037ULL;
+
+			template <typename T>
+			void add(const T &member)
+			{
+				const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&member);
+				data.insert(data.end(), bytes, bytes + sizeof(T));
+				for (size_t i = 0; i < sizeof(T); i++) {
+					value ^= bytes[i];
+					value *= 1099511628211ULL;
+				}
+			}
+
+			template <typename T>
+			bool present(const T *pointer)
+			{
+				add<uint32_t>(pointer ? 1 : 0);
+				return pointer != nullptr;
+			}
+		};
+	}
+
+	void DescriptorAllocator::create(VkDevice device, uint32_t frameCount, uint32_t setsPerPool)
+	{
+		this->device = device;
+		this->setsPerPool = std::max(setsPerPool, 1u);
+		frames.resize(frameCount);
+	}
+
+	void DescriptorAllocator::destroy()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto pool : persistent.pools) {
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		}
+		persistent = PoolChain();
+		for (auto &frame : frames) {
+			for (auto pool : frame.pools) {
+				vkDestroyDescriptorPool(device, pool, nullptr);
+			}
+		}
+		frames.clear();
+		for (auto &layout : layouts) {
+			vkDestroyDescriptorSetLayout(device, layout.second, nullptr);
+		}
+		layouts.clear();
+		largestLayout.clear();
+		cachedSets.clear();
+	}
+
+	VkDescriptorSetLayout DescriptorAllocator::getLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings, VkDescriptorSetLayoutCreateFlags flags)
+	{
+		Hasher hasher;
+		hasher.add(flags);
+		hasher.add<uint64_t>(bindings.size());
+		for (auto &binding : bindings) {
+			hasher.add(binding.binding);
+			hasher.add(binding.descriptorType);
+			hasher.add(binding.descriptorCount);
+			hasher.add(binding.stageFlags);
+			if (hasher.present(binding.pImmutableSamplers)) {
+				for (uint32_t i = 0; i < binding.descriptorCount; i++) {
+					hasher.add(binding.pImmutableSamplers[i]);
+				}
+			}
+		}
+
+		Key key;
+		key.data = std::move(hasher.data);
+		key.hash = hasher.value;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto cached = layouts.find(key);
+		if (cached != layouts.end()) {
+			stats.layoutHits++;
+			return cached->second;
+		}
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
+		descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		descriptorLayoutCI.flags = flags;
+		descriptorLayoutCI.bindingCount = static_cast<uint32_t>(bindings.size());
+		descriptorLayoutCI.pBindings = bindings.data();
+		VkDescriptorSetLayout layout;
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &layout));
+		layouts.emplace(std::move(key), layout);
+		stats.layoutsCreated++;
+
+		std::unordered_map<uint32_t, uint32_t> descriptorCounts;
+		for (auto &binding : bindings) {
+			descriptorCounts[binding.descriptorType] += binding.descriptorCount;
+		}
+		for (auto &count : descriptorCounts) {
+			largestLayout[count.first] = std::max(largestLayout[count.first], count.second);
+		}
+		return layout;
+	}
+
+	VkDescriptorPool DescriptorAllocator::createPool(uint32_t setCount)
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (auto &poolSizeRatio : poolSizeRatios) {
+			const uint32_t count = static_cast<uint32_t>(std::ceil(poolSizeRatio.ratio * (float)setCount));
+			const auto largest = largestLayout.find(poolSizeRatio.type);
+			poolSizes.push_back({ poolSizeRatio.type, std::max(count, (largest != largestLayout.end()) ? largest->second : 0u) });
+		}
+		for (auto &largest : largestLayout) {
+			const VkDescriptorType type = static_cast<VkDescriptorType>(largest.first);
+			if (std::find_if(poolSizes.begin(), poolSizes.end(), [type](const VkDescriptorPoolSize &poolSize) { return poolSize.type == type; }) == poolSizes.end()) {
+				poolSizes.push_back({ type, largest.second });
+			}
+		}
+		VkDescriptorPoolCreateInfo descriptorPoolCI{};
+		descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		descriptorPoolCI.pPoolSizes = poolSizes.data();
+		descriptorPoolCI.maxSets = setCount;
+		VkDescriptorPool pool;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &pool));
+		stats.poolsCreated++;
+		return pool;
+	}
+
+	VkDescriptorSet DescriptorAllocator::allocate(PoolChain &chain, VkDescriptorSetLayout layout)
+	{
+		while (true) {
+			bool newPool = false;
+			if (chain.current == chain.pools.size()) {
+				const uint32_t setCount = chain.pools.empty() ? setsPerPool : std::min(chain.poolSetCounts.back() * 2, std::max(maxSetsPerPool, setsPerPool));
+				chain.pools.push_back(createPool(setCount));
+				chain.poolSetCounts.push_back(setCount);
+				newPool = true;
+			}
+			VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
+			descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			descriptorSetAllocInfo.descriptorPool = chain.pools[chain.current];
+			descriptorSetAllocInfo.pSetLayouts = &layout;
+			descriptorSetAllocInfo.descriptorSetCount = 1;
+			VkDescriptorSet descriptorSet;
+			const VkResult result = vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSet);
+			if (result == VK_SUCCESS) {
+				stats.setsAllocated++;
+				return descriptorSet;
+			}
+			// An exhausted pool is skipped until the chain is reset, a set that doesn't fit into an empty pool is an error
+			if (newPool || ((result != VK_ERROR_OUT_OF_POOL_MEMORY) && (result != VK_ERROR_FRAGMENTED_POOL))) {
+				VK_CHECK_RESULT(result);
+			}
+			chain.current++;
+		}
+	}
+
+	VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return allocate(persistent, layout);
+	}
+
+	VkDescriptorSet DescriptorAllocator::allocateTransient(VkDescriptorSetLayout layout, uint32_t frameIndex)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		assert(frameIndex < frames.size());
+		return allocate(frames[frameIndex], layout);
+	}
+
+	void DescriptorAllocator::resetFrame(uint32_t frameIndex)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		assert(frameIndex < frames.size());
+		PoolChain &frame = frames[frameIndex];
+		// Only pools up to the current one have been used since the last reset
+		for (size_t i = 0; i < std::min(frame.current + 1, frame.pools.size()); i++) {
+			VK_CHECK_RESULT(vkResetDescriptorPool(device, frame.pools[i], 0));
+		}
+		frame.current = 0;
+		stats.frameResets++;
+	}
+
+	VkDescriptorSet DescriptorAllocator::getCached(VkDescriptorSetLayout layout, const std::vector<VkWriteDescriptorSet> &writes)
+	{
+		Hasher hasher;
+		hasher.add(layout);
+		hasher.add<uint64_t>(writes.size());
+		for (auto &write : writes) {
+			hasher.add(write.dstBinding);
+			hasher.add(write.dstArrayElement);
+			hasher.add(write.descriptorType);
+			hasher.add(write.descriptorCount);
+			if (hasher.present(write.pImageInfo)) {
+				for (uint32_t i = 0; i < write.descriptorCount; i++) {
+					hasher.add(write.pImageInfo[i].sampler);
+					hasher.add(write.pImageInfo[i].imageView);
+					hasher.add(write.pImageInfo[i].imageLayout);
+				}
+			}
+			if (hasher.present(write.pBufferInfo)) {
+				for (uint32_t i = 0; i < write.descriptorCount; i++) {
+					hasher.add(write.pBufferInfo[i].buffer);
+					hasher.add(write.pBufferInfo[i].offset);
+					hasher.add(write.pBufferInfo[i].range);
+				}
+			}
+			if (hasher.present(write.pTexelBufferView)) {
+				for (uint32_t i = 0; i < write.descriptorCount; i++) {
+					hasher.add(write.pTexelBufferView[i]);
+				}
+			}
+		}
+		Key key;
+		key.data = std::move(hasher.data);
+		key.hash = hasher.value;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto cached = cachedSets.find(key);
+		if (cached != cachedSets.end()) {
+			stats.cachedSetHits++;
+			return cached->second;
+		}
+		VkDescriptorSet descriptorSet = allocate(persistent, layout);
+		std::vector<VkWriteDescriptorSet> setWrites = writes;
+		for (auto &write : setWrites) {
+			write.dstSet = descriptorSet;
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
+		cachedSets.emplace(std::move(key), descriptorSet);
+		return descriptorSet;
+	}
+
+	DescriptorAllocator::Statistics DescriptorAllocator::statistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return stats;
+	}
+}
@@ -0,0 +1,130 @@
+/*
+* Vulkan descriptor allocator
+*
+* Deduplicates descriptor set layouts and allocates descriptor sets from chains of pools that grow on demand
+* Transient sets come from per-frame pool chains that are reset in bulk, immutable sets can be shared by all users with the same descriptors
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Allocates descriptor sets without the need to size descriptor pools up front
+	* @note Pools are sized by poolSizeRatios, a pool that is exhausted (VK_ERROR_OUT_OF_POOL_MEMORY) is followed by a new one that holds twice as many sets
+	* @note All functions are thread safe
+	*/
+	class DescriptorAllocator
+	{
+	public:
+		/** @brief Number of descriptors of a type that a pool provides per set */
+		struct PoolSizeRatio
+		{
+			VkDescriptorType type;
+			float ratio;
+		};
+
+		struct Statistics
+		{
+			uint32_t layoutsCreated = 0;
+			/** @brief Layout requests that returned an existing layout with the same bindings */
+			uint32_t layoutHits = 0;
+			uint32_t poolsCreated = 0;
+			uint32_t setsAllocated = 0;
+			/** @brief Cached set requests that returned an existing set with the same descriptors */
+			uint32_t cachedSetHits = 0;
+			uint32_t frameResets = 0;
+		};
+
+		/** @brief Pool sizes used for all pools created after changing them, pools are also large enough for the largest layout created by the allocator */
+		std::vector<PoolSizeRatio> poolSizeRatios = {
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1.0f },
+		};
+
+		/**
+		* Prepares the allocator, pools are only created with the first allocation from a chain
+		*
+		* @param device Logical device the layouts, pools and sets are created for
+		* @param frameCount Number of frames with transient pool chains of their own
+		* @param setsPerPool Number of sets in the first pool of each chain, following pools double this up to maxSetsPerPool
+		*/
+		void create(VkDevice device, uint32_t frameCount = 0, uint32_t setsPerPool = 64);
+		/** @brief Destroys all pools and all layouts created by the allocator */
+		void destroy();
+
+		/** @brief Returns a layout for the bindings, layouts with the same bindings and flags are only created once and must not be destroyed by the caller */
+		VkDescriptorSetLayout getLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings, VkDescriptorSetLayoutCreateFlags flags = 0);
+
+		/** @brief Allocates a set that stays valid until the allocator is destroyed */
+		VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+		/** @brief Allocates a set that stays valid until the frame is reset */
+		VkDescriptorSet allocateTransient(VkDescriptorSetLayout layout, uint32_t frameIndex);
+		/**
+		* Frees all transient sets of a frame at once by resetting its pools
+		* @note The GPU must have finished all work that uses sets of that frame
+		*/
+		void resetFrame(uint32_t frameIndex);
+
+		/**
+		* Returns a set with the given descriptors, sets with the same layout and descriptors are only allocated and written once
+		* @note The returned set is shared and must not be updated afterwards, the dstSet members of the writes are ignored
+		*/
+		VkDescriptorSet getCached(VkDescriptorSetLayout layout, const std::vector<VkWriteDescriptorSet> &writes);
+
+		Statistics statistics();
+
+	private:
+		const uint32_t maxSetsPerPool = 4096;
+
+		// Pools that sets are allocated from in order, the current pool is the first one that wasn't exhausted
+		struct PoolChain
+		{
+			std::vector<VkDescriptorPool> pools;
+			std::vector<uint32_t> poolSetCounts;
+			size_t current = 0;
+		};
+
+		/** @brief Serialized bindings or writes, compared in full on lookup so colliding hashes can't return the wrong layout or set */
+		struct Key
+		{
+			std::vector<uint8_t> data;
+			uint64_t hash = 0;
+			bool operator==(const Key &other) const { return hash == other.hash && data == other.data; }
+		};
+		struct KeyHash
+		{
+			size_t operator()(const Key &key) const { return static_cast<size_t>(key.hash); }
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		uint32_t setsPerPool = 64;
+		std::mutex mutex;
+		PoolChain persistent;
+		std::vector<PoolChain> frames;
+		std::unordered_map<Key, VkDescriptorSetLayout, KeyHash> layouts;
+		// Highest descriptor count per type of all layouts, so a single set always fits into a new pool
+		std::unordered_map<uint32_t, uint32_t> largestLayout;
+		std::unordered_map<Key, VkDescriptorSet, KeyHash> cachedSets;
+		Statistics stats;
+
+		VkDescriptorPool createPool(uint32_t setCount);
+		VkDescriptorSet allocate(PoolChain &chain, VkDescriptorSetLayout layout);
+	};
+}
@@ -0,0 +1,114 @@
+/*
+* Vulkan per-frame linear allocator
+*
+* Sub-allocates uniform data from one persistently mapped buffer per frame slot, allocations are aligned for use as dynamic offsets
+* All allocations of a slot are released at once when the slot is used again
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanFrameAllocator.h"
+
+#include <algorithm>
+
+namespace vks
+{
+	VkDeviceSize FrameAllocator::requiredAlignment(vks::VulkanDevice *device, VkBufferUsageFlags usageFlags)
+	{
+		const VkPhysicalDeviceLimits &limits = device->properties.limits;
+		VkDeviceSize alignment = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 1);
+		if (usageFlags & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+			alignment = std::max(alignment, limits.minStorageBufferOffsetAlignment);
+		}
+		return alignment;
+	}
+
+	VkDeviceSize FrameAllocator::alignedSize(vks::VulkanDevice *device, VkDeviceSize size, VkBufferUsageFlags usageFlags)
+	{
+		const VkDeviceSize alignment = requiredAlignment(device, usageFlags);
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
+	void FrameAllocator::create(vks::VulkanDevice *device, uint32_t frameCount, VkDeviceSize frameSize, VkBufferUsageFlags usageFlags)
+	{
+		offsetAlignment = requiredAlignment(device, usageFlags);
+		this->frameSize = frameSize;
+
+		PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR = nullptr;
+		if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
+			vkGetBufferDeviceAddressKHR = reinterpret_cast<PFN_vkGetBufferDeviceAddressKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetBufferDeviceAddressKHR"));
+		}
+
+		frames.resize(frameCount);
+		for (auto &frame : frames) {
+			// Host coherent, so writes are visible to the GPU without flushing each allocation
+			VK_CHECK_RESULT(device->createBuffer(usageFlags, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame.buffer, frameSize));
+			VK_CHECK_RESULT(frame.buffer.map());
+			if (vkGetBufferDeviceAddressKHR) {
+				VkBufferDeviceAddressInfoKHR bufferDeviceAddressInfo{};
+				bufferDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+				bufferDeviceAddressInfo.buffer = frame.buffer.buffer;
+				frame.deviceAddress = vkGetBufferDeviceAddressKHR(device->logicalDevice, &bufferDeviceAddressInfo);
+			}
+		}
+		currentFrame = 0;
+		stats = Statistics();
+	}
+
+	void FrameAllocator::destroy()
+	{
+		for (auto &frame : frames) {
+			frame.buffer.destroy();
+		}
+		frames.clear();
+	}
+
+	void FrameAllocator::beginFrame(uint32_t frameIndex)
+	{
+		assert(frameIndex < frames.size());
+		currentFrame = frameIndex;
+		stats.allocations = 0;
+		stats.used = 0;
+	}
+
+	FrameAllocator::Allocation FrameAllocator::allocate(VkDeviceSize size)
+	{
+		const VkDeviceSize offset = (stats.used + offsetAlignment - 1) & ~(offsetAlignment - 1);
+		if (offset + size > frameSize) {
+			vks::tools::exitFatal("Frame allocator ran out of memory, " + std::to_string(offset + size) + " of " + std::to_string(frameSize) + " bytes requested", -1);
+		}
+		Frame &frame = frames[currentFrame];
+		Allocation allocation;
+		allocation.buffer = frame.buffer.buffer;
+		allocation.offset = static_cast<uint32_t>(offset);
+		allocation.size = size;
+		allocation.data = static_cast<uint8_t*>(frame.buffer.mapped) + offset;
+		allocation.deviceAddress = frame.deviceAddress ? frame.deviceAddress + offset : 0;
+		stats.allocations++;
+		stats.used = offset + size;
+		stats.peak = std::max(stats.peak, stats.used);
+		return allocation;
+	}
+
+	VkDescriptorBufferInfo FrameAllocator::descriptor(uint32_t frameIndex, VkDeviceSize range) const
+	{
+		assert(frameIndex < frames.size());
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = frames[frameIndex].buffer.buffer;
+		bufferInfo.offset = 0;
+		bufferInfo.range = range;
+		return bufferInfo;
+	}
+
+	VkDeviceSize FrameAllocator::alignment() const
+	{
+		return offsetAlignment;
+	}
+
+	FrameAllocator::Statistics FrameAllocator::statistics() const
+	{
+		return stats;
+	}
+}
@@ -0,0 +1,109 @@
+/*
+* Vulkan per-frame linear allocator
+*
+* Sub-allocates uniform data from one persistently mapped buffer per frame slot, allocations are aligned for use as dynamic offsets
+* All allocations of a slot are released at once when the slot is used again
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Bump pointer allocator for data that's written by the host once per frame
+	* @note A slot must not be reused with beginFrame() before the GPU has finished the frame that used it, so there should be one slot per frame in flight
+	* @note Allocations of a frame are deterministic, so command buffers recorded once per slot can keep using the same dynamic offsets
+	*/
+	class FrameAllocator
+	{
+	public:
+		struct Allocation
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			/** @brief Offset into the buffer, aligned for use as a dynamic offset */
+			uint32_t offset = 0;
+			VkDeviceSize size = 0;
+			/** @brief Host pointer to the allocation's memory */
+			void *data = nullptr;
+			/** @brief Device address of the allocation, only available if the buffers were created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT */
+			VkDeviceAddress deviceAddress = 0;
+		};
+
+		struct Statistics
+		{
+			/** @brief Allocations made in the current frame */
+			uint32_t allocations = 0;
+			/** @brief Bytes used by the current frame including alignment padding */
+			VkDeviceSize used = 0;
+			/** @brief Highest number of bytes used by any frame */
+			VkDeviceSize peak = 0;
+		};
+
+		/**
+		* Creates and maps the buffers for all frame slots
+		*
+		* @param device Device the buffers are created on
+		* @param frameCount Number of frame slots
+		* @param frameSize Capacity of each slot in bytes
+		* @param usageFlags Usage flags of the buffers, storage buffer and device address usages are taken into account for alignment and addresses
+		*/
+		void create(vks::VulkanDevice *device, uint32_t frameCount, VkDeviceSize frameSize, VkBufferUsageFlags usageFlags = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+		void destroy();
+
+		/**
+		* Returns the space an allocation takes up including the padding to the next aligned offset, e.g. to size a frame for a number of allocations
+		*
+		* @param device Device the allocator is created on
+		* @param size Size of the allocation in bytes
+		* @param usageFlags Usage flags the allocator is created with
+		*/
+		static VkDeviceSize alignedSize(vks::VulkanDevice *device, VkDeviceSize size, VkBufferUsageFlags usageFlags = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+		/** @brief Selects the slot that following allocations are made from and releases all of its previous allocations */
+		void beginFrame(uint32_t frameIndex);
+		/** @brief Returns aligned memory of the current slot, running out of space is a fatal error as the capacity is fixed for the lifetime of the allocator */
+		Allocation allocate(VkDeviceSize size);
+		/** @brief Allocates memory for a value and copies it */
+		template <typename T>
+		Allocation push(const T &value)
+		{
+			Allocation allocation = allocate(sizeof(T));
+			memcpy(allocation.data, &value, sizeof(T));
+			return allocation;
+		}
+
+		/** @brief Descriptor for a dynamic buffer binding of a slot, with the range each draw reads starting at its dynamic offset */
+		VkDescriptorBufferInfo descriptor(uint32_t frameIndex, VkDeviceSize range) const;
+		/** @brief Alignment applied to the start of every allocation */
+		VkDeviceSize alignment() const;
+		Statistics statistics() const;
+
+	private:
+		struct Frame
+		{
+			vks::Buffer buffer;
+			VkDeviceAddress deviceAddress = 0;
+		};
+
+		std::vector<Frame> frames;
+		uint32_t currentFrame = 0;
+		VkDeviceSize frameSize = 0;
+		VkDeviceSize offsetAlignment = 1;
+		Statistics stats;
+
+		static VkDeviceSize requiredAlignment(vks::VulkanDevice *device, VkBufferUsageFlags usageFlags);
+	};
+}
@@ -0,0 +1,457 @@
+/*
+* Vulkan frame capture
+*
+* Copies rendered images into a ring of host visible buffers without stalling the frame, finished copies are detected by polling their fences
+* Encoding and writing the images to disk (PPM, PNG or QOI) is done on a worker thread
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanFrameCapture.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include "cpuprofiler.hpp"
+
+namespace vks
+{
+	namespace
+	{
+		void putBigEndian(std::vector<uint8_t> &out, uint32_t value)
+		{
+			out.push_back((value >> 24) & 0xff);
+			out.push_back((value >> 16) & 0xff);
+			out.push_back((value >> 8) & 0xff);
+			out.push_back(value & 0xff);
+		}
+
+		void encodePPM(const std::vector<uint8_t> &rgb, uint32_t width, uint32_t height, std::vector<uint8_t> &out)
+		{
+			const std::string header = "P6\n" + std::to_string(width) + "\n" + std::to_string(height) + "\n255\n";
+			out.insert(out.end(), header.begin(), header.end());
+			out.insert(out.end(), rgb.begin(), rgb.end());
+		}
+
+		// PNG with stored (uncompressed) deflate blocks, so no compression library is required
+		void encodePNG(const std::vector<uint8_t> &rgb, uint32_t width, uint32_t height, std::vector<uint8_t> &out)
+		{
+			static const std::vector<uint32_t> crcTable = [] {
+				std::vector<uint32_t> table(256);
+				for (uint32_t n = 0; n < 256; n++) {
+					uint32_t c = n;
+					for (uint32_t k = 0; k < 8; k++) {
+						c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+					}
+					table[n] = c;
+				}
+				return table;
+			}();
+			auto writeChunk = [&out](const char *type, const std::vector<uint8_t> &data) {
+				putBigEndian(out, static_cast<uint32_t>(data.size()));
+				const size_t start = out.size();
+				out.insert(out.end(), type, type + 4);
+				out.insert(out.end(), data.begin(), data.end());
+				uint32_t crc = 0xffffffffu;
+				for (size_t i = start; i < out.size(); i++) {
+					crc = crcTable[(crc ^ out[i]) & 0xff] ^ (crc >> 8);
+				}
+				putBigEndian(out, crc ^ 0xffffffffu);
+			};
+
+			const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+			out.insert(out.end(), signature, signature + sizeof(signature));
+
+			std::vector<uint8_t> header;
+			putBigEndian(header, width);
+			putBigEndian(header, height);
+			// 8 bit RGB, default compression, filter and no interlacing
+			const uint8_t headerFlags[] = { 8, 2, 0, 0, 0 };
+			header.insert(header.end(), headerFlags, headerFlags + sizeof(headerFlags));
+			writeChunk("IHDR", header);
+
+			// Every scanline starts with its filter type (none)
+			const size_t rowSize = width * 3;
+			std::vector<uint8_t> scanlines;
+			scanlines.reserve((rowSize + 1) * height);
+			for (uint32_t y = 0; y < height; y++) {
+				scanlines.push_back(0);
+				scanlines.insert(scanlines.end(), rgb.begin() + y * rowSize, rgb.begin() + (y + 1) * rowSize);
+			}
+
+			std::vector<uint8_t> zlib = { 0x78, 0x01 };
+			zlib.reserve(scanlines.size() + scanlines.size() / 65535 * 5 + 16);
+			size_t offset = 0;
+			do {
+				const uint16_t blockSize = static_cast<uint16_t>(std::min<size_t>(scanlines.size() - offset, 65535));
+				const bool last = (offset + blockSize == scanlines.size());
+				zlib.push_back(last ? 1 : 0);
+				zlib.push_back(blockSize & 0xff);
+				zlib.push_back(blockSize >> 8);
+				zlib.push_back(~blockSize & 0xff);
+				zlib.push_back((~blockSize >> 8) & 0xff);
+				zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+				offset += blockSize;
+			} while (offset < scanlines.size());
+			uint32_t a = 1, b = 0;
+			for (auto value : scanlines) {
+				a = (a + value) % 65521;
+				b = (b + a) % 65521;
+			}
+			putBigEndian(zlib, (b << 16) | a);
+			writeChunk("IDAT", zlib);
+			writeChunk("IEND", {});
+		}
+
+		// Quite OK Image format (https://qoiformat.org), lossless and a lot faster to encode than PNG
+		void encodeQOI(const std::vector<uint8_t> &rgb, uint32_t width, uint32_t height, std::vector<uint8_t> &out)
+		{
+			const uint8_t magic[] = { 'q', 'o', 'i', 'f' };
+			out.insert(out.end(), magic, magic + sizeof(magic));
+			putBigEndian(out, width);
+			putBigEndian(out, height);
+			// 3 channels, sRGB with linear alpha
+			out.push_back(3);
+			out.push_back(0);
+
+			// Pixels are packed as RGBA with alpha always being 255, the index starts zeroed (including alpha) as required by the format
+			uint32_t index[64] = {};
+			uint32_t previous = 0xff000000u;
+			uint8_t run = 0;
+			const size_t pixelCount = static_cast<size_t>(width) * height;
+			for (size_t i = 0; i < pixelCount; i++) {
+				const uint8_t r = rgb[i * 3];
+				const uint8_t g = rgb[i * 3 + 1];
+				const uint8_t b = rgb[i * 3 + 2];
+				const uint32_t pixel = r | (g << 8) | (b << 16) | 0xff000000u;
+				if (pixel == previous) {
+					run++;
+					if ((run == 62) || (i == pixelCount - 1)) {
+						out.push_back(0xc0 | (run - 1));
+						run = 0;
+					}
+					continue;
+				}
+				if (run > 0) {
+					out.push_back(0xc0 | (run - 1));
+					run = 0;
+				}
+				const uint32_t hash = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+				if (index[hash] == pixel) {
+					out.push_back(static_cast<uint8_t>(hash));
+				}
+				else {
+					index[hash] = pixel;
+					const int8_t dr = static_cast<int8_t>(r - (previous & 0xff));
+					const int8_t dg = static_cast<int8_t>(g - ((previous >> 8) & 0xff));
+					const int8_t db = static_cast<int8_t>(b - ((previous >> 16) & 0xff));
+					const int8_t drg = static_cast<int8_t>(dr - dg);
+					const int8_t dbg = static_cast<int8_t>(db - dg);
+					if ((dr >= -2) && (dr <= 1) && (dg >= -2) && (dg <= 1) && (db >= -2) && (db <= 1)) {
+						out.push_back(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+					}
+					else if ((dg >= -32) && (dg <= 31) && (drg >= -8) && (drg <= 7) && (dbg >= -8) && (dbg <= 7)) {
+						out.push_back(0x80 | (dg + 32));
+						out.push_back(((drg + 8) << 4) | (dbg + 8));
+					}
+					else {
+						out.push_back(0xfe);
+						out.push_back(r);
+						out.push_back(g);
+						out.push_back(b);
+					}
+				}
+				previous = pixel;
+			}
+			const uint8_t padding[] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+			out.insert(out.end(), padding, padding + sizeof(padding));
+		}
+	}
+
+	FrameCapture::Format FrameCapture::formatFromFilename(const std::string &filename)
+	{
+		std::string extension = filename.substr(filename.find_last_of('.') + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension == "png") {
+			return Format::PNG;
+		}
+		if (extension == "qoi") {
+			return Format::QOI;
+		}
+		return Format::PPM;
+	}
+
+	std::string FrameCapture::sequenceFilename(const std::string &filename, uint32_t frame)
+	{
+		char number[16];
+		snprintf(number, sizeof(number), "_%05u", frame);
+		const size_t extension = filename.find_last_of('.');
+		const size_t directory = filename.find_last_of("/\\");
+		if ((extension == std::string::npos) || ((directory != std::string::npos) && (extension < directory))) {
+			return filename + number;
+		}
+		return filename.substr(0, extension) + number + filename.substr(extension);
+	}
+
+	void FrameCapture::create(vks::VulkanDevice *device, uint32_t width, uint32_t height, VkFormat colorFormat, VkImageUsageFlags imageUsage, uint32_t slotCount)
+	{
+		if ((imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) == 0) {
+			vks::tools::exitFatal("Frame capture requires images with VK_IMAGE_USAGE_TRANSFER_SRC_BIT, the surface doesn't support transfer source usage for swap chain images", -1);
+		}
+		this->device = device;
+		this->width = width;
+		this->height = height;
+		const std::vector<VkFormat> formatsBGR = { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SNORM };
+		swizzle = std::find(formatsBGR.begin(), formatsBGR.end(), colorFormat) != formatsBGR.end();
+
+		// Cached memory makes reading back on the host a lot faster, it's usually not coherent so the buffers need to be invalidated
+		VkMemoryPropertyFlags memoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		VkBool32 cachedMemoryFound = VK_FALSE;
+		device->getMemoryType(~0u, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &cachedMemoryFound);
+		if (cachedMemoryFound) {
+			memoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		}
+
+		commandPool = device->createCommandPool(device->queueFamilyIndices.graphics);
+		slots.resize(std::max(slotCount, 1u));
+		for (auto &slot : slots) {
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryPropertyFlags, &slot.buffer, static_cast<VkDeviceSize>(width) * height * 4));
+			VK_CHECK_RESULT(slot.buffer.map());
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device->logicalDevice, &cmdBufAllocateInfo, &slot.commandBuffer));
+			VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceCreateInfo, nullptr, &slot.fence));
+			VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCreateInfo, nullptr, &slot.semaphore));
+			slot.state = SlotState::Free;
+		}
+		nextSlot = 0;
+
+		stopWorker = false;
+		worker = std::thread(&FrameCapture::workerLoop, this);
+	}
+
+	void FrameCapture::destroy()
+	{
+		if (slots.empty()) {
+			return;
+		}
+		flush();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopWorker = true;
+		}
+		workAvailable.notify_all();
+		worker.join();
+		for (auto &slot : slots) {
+			slot.buffer.destroy();
+			vkDestroyFence(device->logicalDevice, slot.fence, nullptr);
+			vkDestroySemaphore(device->logicalDevice, slot.semaphore, nullptr);
+		}
+		slots.clear();
+		vkDestroyCommandPool(device->logicalDevice, commandPool, nullptr);
+		commandPool = VK_NULL_HANDLE;
+	}
+
+	VkSemaphore FrameCapture::capture(VkQueue queue, VkImage image, VkImageLayout layout, VkSemaphore waitSemaphore, const std::string &filename)
+	{
+		VKS_PROFILE_SCOPE("Frame capture");
+		const auto tStart = std::chrono::high_resolution_clock::now();
+		poll();
+
+		// The ring is full if the next slot is still in use, wait for its copy and then for its file to be written
+		Slot &slot = slots[nextSlot];
+		const SlotState state = stateOf(slot);
+		const bool stalled = (state != SlotState::Free);
+		if (state == SlotState::Copying) {
+			VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+			poll();
+		}
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			slotWritten.wait(lock, [&slot] { return slot.state == SlotState::Free; });
+		}
+		nextSlot = (nextSlot + 1) % static_cast<uint32_t>(slots.size());
+		VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &slot.fence));
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(slot.commandBuffer, &cmdBufInfo));
+		const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vks::tools::insertImageMemoryBarrier(
+			slot.commandBuffer,
+			image,
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT,
+			layout,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			subresourceRange);
+		VkBufferImageCopy copyRegion = {};
+		copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copyRegion.imageSubresource.layerCount = 1;
+		copyRegion.imageExtent = { width, height, 1 };
+		vkCmdCopyImageToBuffer(slot.commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer.buffer, 1, &copyRegion);
+		vks::tools::insertImageMemoryBarrier(
+			slot.commandBuffer,
+			image,
+			VK_ACCESS_TRANSFER_READ_BIT,
+			0,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			layout,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			subresourceRange);
+		// Make the copied data available to the host once the fence has been signaled
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.buffer = slot.buffer.buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(slot.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		VK_CHECK_RESULT(vkEndCommandBuffer(slot.commandBuffer));
+
+		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		if (waitSemaphore != VK_NULL_HANDLE) {
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &waitSemaphore;
+			submitInfo.pWaitDstStageMask = &waitStageMask;
+		}
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &slot.semaphore;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &slot.commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, slot.fence));
+
+		std::lock_guard<std::mutex> lock(mutex);
+		slot.state = SlotState::Copying;
+		slot.filename = filename;
+		stats.captured++;
+		stats.stalls += stalled ? 1 : 0;
+		stats.captureTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		return slot.semaphore;
+	}
+
+	void FrameCapture::poll()
+	{
+		// Slots are handed over in submission order, so files are written in the order they were captured
+		bool queued = false;
+		for (uint32_t i = 0; i < slots.size(); i++) {
+			const uint32_t index = (nextSlot + i) % static_cast<uint32_t>(slots.size());
+			Slot &slot = slots[index];
+			if (stateOf(slot) != SlotState::Copying) {
+				continue;
+			}
+			if (vkGetFenceStatus(device->logicalDevice, slot.fence) != VK_SUCCESS) {
+				break;
+			}
+			if ((slot.buffer.memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0) {
+				VK_CHECK_RESULT(slot.buffer.invalidate());
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			slot.state = SlotState::Writing;
+			writeQueue.push_back(index);
+			queued = true;
+		}
+		if (queued) {
+			workAvailable.notify_one();
+		}
+	}
+
+	void FrameCapture::flush()
+	{
+		std::vector<VkFence> fences;
+		for (auto &slot : slots) {
+			if (stateOf(slot) == SlotState::Copying) {
+				fences.push_back(slot.fence);
+			}
+		}
+		if (!fences.empty()) {
+			VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX));
+		}
+		poll();
+		std::unique_lock<std::mutex> lock(mutex);
+		slotWritten.wait(lock, [this] {
+			return std::all_of(slots.begin(), slots.end(), [](const Slot &slot) { return slot.state == SlotState::Free; });
+		});
+	}
+
+	FrameCapture::Statistics FrameCapture::statistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return stats;
+	}
+
+	FrameCapture::SlotState FrameCapture::stateOf(const Slot &slot)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return slot.state;
+	}
+
+	void FrameCapture::workerLoop()
+	{
+		VKS_PROFILE_THREAD_NAME("Frame capture");
+		while (true) {
+			uint32_t index;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				workAvailable.wait(lock, [this] { return stopWorker || !writeQueue.empty(); });
+				if (writeQueue.empty()) {
+					return;
+				}
+				index = writeQueue.front();
+				writeQueue.pop_front();
+			}
+			const auto tStart = std::chrono::high_resolution_clock::now();
+			write(slots[index]);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				slots[index].state = SlotState::Free;
+				stats.written++;
+				stats.writeTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			}
+			slotWritten.notify_all();
+		}
+	}
+
+	void FrameCapture::write(const Slot &slot)
+	{
+		VKS_PROFILE_SCOPE("Write capture");
+		// Drop alpha and swizzle to RGB, which all formats are written as
+		const size_t pixelCount = static_cast<size_t>(width) * height;
+		const uint8_t *pixels = static_cast<const uint8_t*>(slot.buffer.mapped);
+		const uint32_t r = swizzle ? 2 : 0;
+		const uint32_t b = swizzle ? 0 : 2;
+		std::vector<uint8_t> rgb(pixelCount * 3);
+		for (size_t i = 0; i < pixelCount; i++) {
+			rgb[i * 3] = pixels[i * 4 + r];
+			rgb[i * 3 + 1] = pixels[i * 4 + 1];
+			rgb[i * 3 + 2] = pixels[i * 4 + b];
+		}
+
+		std::vector<uint8_t> encoded;
+		switch (formatFromFilename(slot.filename)) {
+		case Format::PNG:
+			encodePNG(rgb, width, height, encoded);
+			break;
+		case Format::QOI:
+			encodeQOI(rgb, width, height, encoded);
+			break;
+		default:
+			encodePPM(rgb, width, height, encoded);
+		}
+
+		std::ofstream file(slot.filename, std::ios::out | std::ios::binary);
+		file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+		if (!file.good()) {
+			std::cerr << "Could not write captured frame to " << slot.filename << "\n";
+		}
+	}
+}
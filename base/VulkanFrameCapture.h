@@ -0,0 +1,124 @@
+/*
+* Vulkan frame capture
+*
+* Copies rendered images into a ring of host visible buffers without stalling the frame, finished copies are detected by polling their fences
+* Encoding and writing the images to disk (PPM, PNG or QOI) is done on a worker thread
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Captures rendered images to files without waiting for the GPU or the file system
+	* @note Slots are used round robin, capture() only blocks if the oldest slot's copy or write hasn't finished yet
+	* @note All functions must be called from the thread that submits to the queue
+	*/
+	class FrameCapture
+	{
+	public:
+		enum class Format { PPM, PNG, QOI };
+
+		struct Statistics
+		{
+			uint32_t captured = 0;
+			uint32_t written = 0;
+			/** @brief Captures that had to wait for a slot to become free */
+			uint32_t stalls = 0;
+			/** @brief Time spent in capture() on the calling thread in ms, including stalls */
+			double captureTime = 0.0;
+			/** @brief Time spent encoding and writing files on the worker thread in ms */
+			double writeTime = 0.0;
+		};
+
+		/** @brief Selects the format by the file extension (.png, .qoi), anything else is written as PPM */
+		static Format formatFromFilename(const std::string &filename);
+		/** @brief Appends a zero padded frame number to the file name, e.g. "capture.qoi" becomes "capture_00042.qoi" */
+		static std::string sequenceFilename(const std::string &filename, uint32_t frame);
+
+		/**
+		* Creates the readback buffers and starts the worker thread
+		*
+		* @param device Device the images to capture are rendered on, copies are submitted on its graphics queue family
+		* @param width Width of the captured images
+		* @param height Height of the captured images
+		* @param colorFormat Format of the captured images, must be a 32 bit RGBA or BGRA format
+		* @param imageUsage Usage the captured images were created with, must include VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+		* @param slotCount Number of frames that can be in flight between capture and the file being written
+		*/
+		void create(vks::VulkanDevice *device, uint32_t width, uint32_t height, VkFormat colorFormat, VkImageUsageFlags imageUsage, uint32_t slotCount = 3);
+		/** @brief Writes all pending captures and destroys all resources, statistics are kept */
+		void destroy();
+
+		/**
+		* Submits a copy of the image into the next free slot, the file is written once the copy has finished
+		*
+		* @param queue Queue the image was rendered on
+		* @param image Image created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT, it's returned to its layout after the copy
+		* @param layout Layout of the image when rendering has finished
+		* @param waitSemaphore Semaphore signaled once rendering to the image has finished
+		* @param filename File the image is written to, the extension selects the format
+		*
+		* @return Semaphore signaled once the copy has finished, e.g. to be waited on by presentation
+		*/
+		VkSemaphore capture(VkQueue queue, VkImage image, VkImageLayout layout, VkSemaphore waitSemaphore, const std::string &filename);
+		/** @brief Hands finished copies to the worker thread, done by every capture() so only needed to get files written earlier */
+		void poll();
+		/** @brief Waits until all captured images have been written */
+		void flush();
+
+		Statistics statistics();
+
+	private:
+		enum class SlotState { Free, Copying, Writing };
+
+		struct Slot
+		{
+			vks::Buffer buffer;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+			SlotState state = SlotState::Free;
+			std::string filename;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// Set for BGR formats, pixels are swizzled to RGB when encoding
+		bool swizzle = false;
+		std::vector<Slot> slots;
+		uint32_t nextSlot = 0;
+
+		std::thread worker;
+		std::mutex mutex;
+		std::condition_variable workAvailable;
+		std::condition_variable slotWritten;
+		std::deque<uint32_t> writeQueue;
+		bool stopWorker = false;
+		Statistics stats;
+
+		/** @brief Reads the state of a slot under the lock, as the worker thread frees slots concurrently */
+		SlotState stateOf(const Slot &slot);
+		void workerLoop();
+		void write(const Slot &slot);
+	};
+}
@@ -0,0 +1,307 @@
+/*
+* Vulkan pipeline compiler
+*
+* Creates graphics and compute pipelines on background threads and returns futures for them
+* Create infos are copied on submission, so they can be built on the stack like for vkCreateGraphicsPipelines
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanPipelineCompiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include "cpuprofiler.hpp"
+
+namespace vks
+{
+	// A pending pipeline with a copy of its create info and all the state the create info points to
+	struct PipelineCompiler::Request
+	{
+		std::string name;
+		bool compute = false;
+		VkGraphicsPipelineCreateInfo graphicsCreateInfo{};
+		VkComputePipelineCreateInfo computeCreateInfo{};
+
+		std::vector<VkPipelineShaderStageCreateInfo> stages;
+		std::vector<std::string> entryPoints;
+		std::vector<VkSpecializationInfo> specializationInfos;
+		std::vector<std::vector<VkSpecializationMapEntry>> specializationMapEntries;
+		std::vector<std::vector<uint8_t>> specializationData;
+
+		VkPipelineVertexInputStateCreateInfo vertexInputState;
+		std::vector<VkVertexInputBindingDescription> vertexBindings;
+		std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState;
+		VkPipelineTessellationStateCreateInfo tessellationState;
+		VkPipelineViewportStateCreateInfo viewportState;
+		std::vector<VkViewport> viewports;
+		std::vector<VkRect2D> scissors;
+		VkPipelineRasterizationStateCreateInfo rasterizationState;
+		VkPipelineMultisampleStateCreateInfo multisampleState;
+		std::vector<VkSampleMask> sampleMask;
+		VkPipelineDepthStencilStateCreateInfo depthStencilState;
+		VkPipelineColorBlendStateCreateInfo colorBlendState;
+		std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+		VkPipelineDynamicStateCreateInfo dynamicState;
+		std::vector<VkDynamicState> dynamicStates;
+
+		std::promise<VkPipeline> promise;
+
+		void copyStages(const VkPipelineShaderStageCreateInfo *source, uint32_t count)
+		{
+			// All storage is sized up front so the pointers into it stay valid
+			stages.assign(source, source + count);
+			entryPoints.resize(count);
+			specializationInfos.resize(count);
+			specializationMapEntries.resize(count);
+			specializationData.resize(count);
+			for (uint32_t i = 0; i < count; i++) {
+				entryPoints[i] = source[i].pName;
+				stages[i].pName = entryPoints[i].c_str();
+				if (source[i].pSpecializationInfo) {
+					const VkSpecializationInfo &specializationInfo = *source[i].pSpecializationInfo;
+					specializationMapEntries[i].assign(specializationInfo.pMapEntries, specializationInfo.pMapEntries + specializationInfo.mapEntryCount);
+					const uint8_t *data = static_cast<const uint8_t*>(specializationInfo.pData);
+					specializationData[i].assign(data, data + specializationInfo.dataSize);
+					specializationInfos[i] = specializationInfo;
+					specializationInfos[i].pMapEntries = specializationMapEntries[i].data();
+					specializationInfos[i].pData = specializationData[i].data();
+					stages[i].pSpecializationInfo = &specializationInfos[i];
+				}
+			}
+		}
+
+		template <typename T>
+		const T *copyState(const T *source, T &target)
+		{
+			if (!source) {
+				return nullptr;
+			}
+			target = *source;
+			return &target;
+		}
+
+		template <typename T>
+		const T *copyArray(const T *source, uint32_t count, std::vector<T> &target)
+		{
+			if (!source) {
+				return nullptr;
+			}
+			target.assign(source, source + count);
+			return target.data();
+		}
+
+		void copy(const VkGraphicsPipelineCreateInfo &createInfo)
+		{
+			graphicsCreateInfo = createInfo;
+			copyStages(createInfo.pStages, createInfo.stageCount);
+			graphicsCreateInfo.pStages = stages.data();
+			if (copyState(createInfo.pVertexInputState, vertexInputState)) {
+				vertexInputState.pVertexBindingDescriptions = copyArray(vertexInputState.pVertexBindingDescriptions, vertexInputState.vertexBindingDescriptionCount, vertexBindings);
+				vertexInputState.pVertexAttributeDescriptions = copyArray(vertexInputState.pVertexAttributeDescriptions, vertexInputState.vertexAttributeDescriptionCount, vertexAttributes);
+				graphicsCreateInfo.pVertexInputState = &vertexInputState;
+			}
+			graphicsCreateInfo.pInputAssemblyState = copyState(createInfo.pInputAssemblyState, inputAssemblyState);
+			graphicsCreateInfo.pTessellationState = copyState(createInfo.pTessellationState, tessellationState);
+			if (copyState(createInfo.pViewportState, viewportState)) {
+				viewportState.pViewports = copyArray(viewportState.pViewports, viewportState.viewportCount, viewports);
+				viewportState.pScissors = copyArray(viewportState.pScissors, viewportState.scissorCount, scissors);
+				graphicsCreateInfo.pViewportState = &viewportState;
+			}
+			graphicsCreateInfo.pRasterizationState = copyState(createInfo.pRasterizationState, rasterizationState);
+			if (copyState(createInfo.pMultisampleState, multisampleState)) {
+				multisampleState.pSampleMask = copyArray(multisampleState.pSampleMask, (multisampleState.rasterizationSamples + 31) / 32, sampleMask);
+				graphicsCreateInfo.pMultisampleState = &multisampleState;
+			}
+			graphicsCreateInfo.pDepthStencilState = copyState(createInfo.pDepthStencilState, depthStencilState);
+			if (copyState(createInfo.pColorBlendState, colorBlendState)) {
+				colorBlendState.pAttachments = copyArray(colorBlendState.pAttachments, colorBlendState.attachmentCount, blendAttachments);
+				graphicsCreateInfo.pColorBlendState = &colorBlendState;
+			}
+			if (copyState(createInfo.pDynamicState, dynamicState)) {
+				dynamicState.pDynamicStates = copyArray(dynamicState.pDynamicStates, dynamicState.dynamicStateCount, dynamicStates);
+				graphicsCreateInfo.pDynamicState = &dynamicState;
+			}
+		}
+
+		void copy(const VkComputePipelineCreateInfo &createInfo)
+		{
+			compute = true;
+			computeCreateInfo = createInfo;
+			copyStages(&createInfo.stage, 1);
+			computeCreateInfo.stage = stages[0];
+		}
+	};
+
+	PipelineCompiler::~PipelineCompiler()
+	{
+		if (!threads.empty()) {
+			destroy();
+		}
+	}
+
+	void PipelineCompiler::create(VkDevice device, VkPipelineCache pipelineCache, uint32_t threadCount, CacheMode cacheMode)
+	{
+		this->device = device;
+		this->pipelineCache = pipelineCache;
+		this->cacheMode = cacheMode;
+		this->threadCount = (threadCount > 0) ? threadCount : std::max(2u, std::thread::hardware_concurrency()) - 1;
+	}
+
+	void PipelineCompiler::destroy()
+	{
+		wait();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		requestCondition.notify_all();
+		for (auto &thread : threads) {
+			thread.join();
+		}
+		threads.clear();
+		for (auto &cache : threadCaches) {
+			vkDestroyPipelineCache(device, cache, nullptr);
+		}
+		threadCaches.clear();
+		stopping = false;
+	}
+
+	std::shared_future<VkPipeline> PipelineCompiler::compile(const std::string &name, const VkGraphicsPipelineCreateInfo &createInfo)
+	{
+		std::shared_ptr<Request> request = std::make_shared<Request>();
+		request->name = name;
+		request->copy(createInfo);
+		return submit(request);
+	}
+
+	std::shared_future<VkPipeline> PipelineCompiler::compile(const std::string &name, const VkComputePipelineCreateInfo &createInfo)
+	{
+		std::shared_ptr<Request> request = std::make_shared<Request>();
+		request->name = name;
+		request->copy(createInfo);
+		return submit(request);
+	}
+
+	std::vector<std::shared_future<VkPipeline>> PipelineCompiler::compile(const std::vector<std::string> &names, const std::vector<VkGraphicsPipelineCreateInfo> &createInfos)
+	{
+		assert(names.size() == createInfos.size());
+		std::vector<std::shared_future<VkPipeline>> pipelines;
+		pipelines.reserve(createInfos.size());
+		for (size_t i = 0; i < createInfos.size(); i++) {
+			pipelines.push_back(compile(names[i], createInfos[i]));
+		}
+		return pipelines;
+	}
+
+	std::shared_future<VkPipeline> PipelineCompiler::submit(std::shared_ptr<Request> request)
+	{
+		assert(device != VK_NULL_HANDLE);
+		std::shared_future<VkPipeline> pipeline = request->promise.get_future().share();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (threads.empty()) {
+				if (cacheMode == CacheMode::PerThread) {
+					threadCaches.resize(threadCount);
+					for (auto &cache : threadCaches) {
+						VkPipelineCacheCreateInfo pipelineCacheCreateInfo{};
+						pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+						VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &cache));
+					}
+				}
+				for (uint32_t i = 0; i < threadCount; i++) {
+					threads.push_back(std::thread(&PipelineCompiler::threadLoop, this, i));
+				}
+			}
+			if (!started) {
+				firstSubmission = std::chrono::high_resolution_clock::now();
+				started = true;
+			}
+			pending++;
+			requests.push_back(request);
+		}
+		requestCondition.notify_one();
+		return pipeline;
+	}
+
+	void PipelineCompiler::threadLoop(uint32_t index)
+	{
+		VKS_PROFILE_THREAD_NAME("Pipeline compiler " + std::to_string(index));
+		const VkPipelineCache cache = (cacheMode == CacheMode::PerThread) ? threadCaches[index] : pipelineCache;
+		while (true) {
+			std::shared_ptr<Request> request;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				requestCondition.wait(lock, [this] { return stopping || !requests.empty(); });
+				if (requests.empty()) {
+					return;
+				}
+				request = requests.front();
+				requests.pop_front();
+			}
+
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			const auto tStart = std::chrono::high_resolution_clock::now();
+			{
+				VKS_PROFILE_SCOPE("Compile pipeline");
+				if (request->compute) {
+					VK_CHECK_RESULT(vkCreateComputePipelines(device, cache, 1, &request->computeCreateInfo, nullptr, &pipeline));
+				}
+				else {
+					VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, cache, 1, &request->graphicsCreateInfo, nullptr, &pipeline));
+				}
+			}
+			const auto tEnd = std::chrono::high_resolution_clock::now();
+			// The future is ready before the pipeline stops counting as pending, so wait() guarantees get() won't block
+			request->promise.set_value(pipeline);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			Timing timing;
+			timing.name = request->name;
+			timing.compileTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+			stats.timings.push_back(timing);
+			stats.compileTime += timing.compileTime;
+			stats.pipelines++;
+			lastCompletion = tEnd;
+			pending--;
+			if (pending == 0) {
+				idleCondition.notify_all();
+			}
+		}
+	}
+
+	void PipelineCompiler::wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		idleCondition.wait(lock, [this] { return pending == 0; });
+		if (!threadCaches.empty()) {
+			VK_CHECK_RESULT(vkMergePipelineCaches(device, pipelineCache, static_cast<uint32_t>(threadCaches.size()), threadCaches.data()));
+		}
+	}
+
+	bool PipelineCompiler::ready(const std::shared_future<VkPipeline> &pipeline)
+	{
+		return pipeline.valid() && (pipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+	}
+
+	PipelineCompiler::Statistics PipelineCompiler::statistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Statistics result = stats;
+		result.wallTime = (stats.pipelines > 0) ? std::chrono::duration<double, std::milli>(lastCompletion - firstSubmission).count() : 0.0;
+		return result;
+	}
+
+	void PipelineCompiler::printReport()
+	{
+		const Statistics result = statistics();
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "Pipeline compiler: " << result.pipelines << " pipelines on " << threadCount << " threads, wall clock " << result.wallTime << " ms, compile time " << result.compileTime << " ms" << "\n";
+		for (auto &timing : result.timings) {
+			std::cout << "  " << timing.name << ": " << timing.compileTime << " ms" << "\n";
+		}
+	}
+}
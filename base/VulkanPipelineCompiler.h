@@ -0,0 +1,115 @@
+/*
+* Vulkan pipeline compiler
+*
+* Creates graphics and compute pipelines on background threads and returns futures for them
+* Create infos are copied on submission, so they can be built on the stack like for vkCreateGraphicsPipelines
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Compiles pipelines on a pool of threads of its own
+	* @note Compiling takes milliseconds per pipeline, so the compiler doesn't use the job system to not hold up its frame tasks
+	* @note pNext chains of the create infos and the handles they reference (layouts, render passes, shader modules, base pipelines) are not copied and must stay valid until the pipeline is ready
+	*/
+	class PipelineCompiler
+	{
+	public:
+		enum class CacheMode {
+			/** @brief All threads use the pipeline cache passed to create() (pipeline caches are internally synchronized) */
+			Shared,
+			/** @brief Each thread uses a cache of its own, they're merged into the pipeline cache passed to create() by wait() */
+			PerThread
+		};
+
+		struct Timing
+		{
+			std::string name;
+			/** @brief Time spent in vkCreate*Pipelines in ms */
+			double compileTime;
+		};
+
+		struct Statistics
+		{
+			uint32_t pipelines = 0;
+			/** @brief Time from the first submission to the last finished pipeline in ms */
+			double wallTime = 0.0;
+			/** @brief Sum of all compile times in ms, larger than the wall time if pipelines were compiled in parallel */
+			double compileTime = 0.0;
+			std::vector<Timing> timings;
+		};
+
+		~PipelineCompiler();
+
+		/**
+		* Prepares the compiler, threads are only started with the first submission
+		*
+		* @param device Logical device the pipelines are created for
+		* @param pipelineCache Pipeline cache used for (or merged into by) all compilations
+		* @param threadCount Number of compile threads, 0 uses all but one hardware thread
+		* @param cacheMode Selects if the threads share the pipeline cache or merge their own caches into it
+		*/
+		void create(VkDevice device, VkPipelineCache pipelineCache, uint32_t threadCount = 0, CacheMode cacheMode = CacheMode::Shared);
+		/** @brief Waits for all submitted pipelines and stops the threads, pipelines that have been created are owned by the caller */
+		void destroy();
+
+		std::shared_future<VkPipeline> compile(const std::string &name, const VkGraphicsPipelineCreateInfo &createInfo);
+		std::shared_future<VkPipeline> compile(const std::string &name, const VkComputePipelineCreateInfo &createInfo);
+		/** @brief Submits a batch of graphics pipelines, with one name per create info */
+		std::vector<std::shared_future<VkPipeline>> compile(const std::vector<std::string> &names, const std::vector<VkGraphicsPipelineCreateInfo> &createInfos);
+
+		/** @brief Waits until all submitted pipelines have been compiled */
+		void wait();
+		/** @brief Returns true if the pipeline has been compiled and get() won't block */
+		static bool ready(const std::shared_future<VkPipeline> &pipeline);
+
+		Statistics statistics();
+		/** @brief Writes the wall clock time and the compile time of each pipeline to stdout */
+		void printReport();
+
+	private:
+		struct Request;
+
+		VkDevice device = VK_NULL_HANDLE;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		CacheMode cacheMode = CacheMode::Shared;
+		uint32_t threadCount = 0;
+		std::vector<std::thread> threads;
+		std::vector<VkPipelineCache> threadCaches;
+
+		std::mutex mutex;
+		std::condition_variable requestCondition;
+		std::condition_variable idleCondition;
+		std::deque<std::shared_ptr<Request>> requests;
+		uint32_t pending = 0;
+		bool stopping = false;
+
+		bool started = false;
+		std::chrono::high_resolution_clock::time_point firstSubmission;
+		std::chrono::high_resolution_clock::time_point lastCompletion;
+		Statistics stats;
+
+		std::shared_future<VkPipeline> submit(std::shared_ptr<Request> request);
+		void threadLoop(uint32_t index);
+	};
+}
@@ -0,0 +1,233 @@
+/*
+* Vulkan pipeline variant cache
+*
+* Creates one pipeline per distinct permutation of shader modules, specialization constants, vertex layout and render state
+* Create infos are reduced to a key of their state, so e.g. materials with identical properties share a single pipeline
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanPipelineVariantCache.h"
+
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+namespace vks
+{
+	namespace
+	{
+		// Serializes the individual members and hashes them with 64 bit FNV-1a, structs aren't added as a whole as their padding and pointers would end up in the key
+		// Variable length data is preceded by its size, so different states can't serialize to the same bytes
+		class Hasher
+		{
+		public:
+			std::vector<uint8_t> data;
+			uint64_t value = 14695981039346656037ULL;
+
+			void add(const void *data, size_t size)
+			{
+				const uint8_t *bytes = static_cast<const uint8_t*>(data);
+				this->data.insert(this->data.end(), bytes, bytes + size);
+				for (size_t i = 0; i < size; i++) {
+					value ^= bytes[i];
+					value *= 1099511628211ULL;
+				}
+			}
+
+			template <typename T>
+			void add(const T &member)
+			{
+				add(&member, sizeof(T));
+			}
+
+			// Marks whether an optional state is present, so a missing state doesn't hash like one with default values
+			template <typename T>
+			bool present(const T *state)
+			{
+				add<uint32_t>(state ? 1 : 0);
+				return state != nullptr;
+			}
+		};
+
+		void hashStages(Hasher &hasher, const VkPipelineShaderStageCreateInfo *stages, uint32_t count)
+		{
+			hasher.add(count);
+			for (uint32_t i = 0; i < count; i++) {
+				const VkPipelineShaderStageCreateInfo &stage = stages[i];
+				hasher.add(stage.flags);
+				hasher.add(stage.stage);
+				// Modules from the shader cache are unique per SPIR-V, so the handle identifies the code
+				hasher.add(stage.module);
+				const size_t nameLength = strlen(stage.pName);
+				hasher.add<uint64_t>(nameLength);
+				hasher.add(stage.pName, nameLength);
+				if (hasher.present(stage.pSpecializationInfo)) {
+					const VkSpecializationInfo &specializationInfo = *stage.pSpecializationInfo;
+					hasher.add(specializationInfo.mapEntryCount);
+					for (uint32_t j = 0; j < specializationInfo.mapEntryCount; j++) {
+						const VkSpecializationMapEntry &entry = specializationInfo.pMapEntries[j];
+						hasher.add(entry.constantID);
+						hasher.add(entry.offset);
+						hasher.add<uint64_t>(entry.size);
+					}
+					hasher.add<uint64_t>(specializationInfo.dataSize);
+					hasher.add(specializationInfo.pData, specializationInfo.dataSize);
+				}
+			}
+		}
+	}
+
+	void PipelineVariantCache::create(VkDevice device, VkPipelineCache pipelineCache)
+	{
+		this->device = device;
+		this->pipelineCache = pipelineCache;
+	}
+
+	void PipelineVariantCache::destroy()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &pipeline : pipelines) {
+			vkDestroyPipeline(device, pipeline.second, nullptr);
+		}
+		pipelines.clear();
+	}
+
+	uint64_t PipelineVariantCache::hash(const VkGraphicsPipelineCreateInfo &createInfo, uint64_t salt)
+	{
+		return key(createInfo, salt).hash;
+	}
+
+	PipelineVariantCache::Key PipelineVariantCache::key(const VkGraphicsPipelineCreateInfo &createInfo, uint64_t salt)
+	{
+		Hasher hasher;
+		hasher.add(salt);
+		hasher.add(createInfo.flags);
+		hasher.add(createInfo.layout);
+		hasher.add(createInfo.renderPass);
+		hasher.add(createInfo.subpass);
+		hashStages(hasher, createInfo.pStages, createInfo.stageCount);
+
+		if (hasher.present(createInfo.pVertexInputState)) {
+			const VkPipelineVertexInputStateCreateInfo &state = *createInfo.pVertexInputState;
+			hasher.add(state.vertexBindingDescriptionCount);
+			for (uint32_t i = 0; i < state.vertexBindingDescriptionCount; i++) {
+				hasher.add(state.pVertexBindingDescriptions[i].binding);
+				hasher.add(state.pVertexBindingDescriptions[i].stride);
+				hasher.add(state.pVertexBindingDescriptions[i].inputRate);
+			}
+			hasher.add(state.vertexAttributeDescriptionCount);
+			for (uint32_t i = 0; i < state.vertexAttributeDescriptionCount; i++) {
+				hasher.add(state.pVertexAttributeDescriptions[i].location);
+				hasher.add(state.pVertexAttributeDescriptions[i].binding);
+				hasher.add(state.pVertexAttributeDescriptions[i].format);
+				hasher.add(state.pVertexAttributeDescriptions[i].offset);
+			}
+		}
+		if (hasher.present(createInfo.pInputAssemblyState)) {
+			hasher.add(createInfo.pInputAssemblyState->topology);
+			hasher.add(createInfo.pInputAssemblyState->primitiveRestartEnable);
+		}
+		if (hasher.present(createInfo.pTessellationState)) {
+			hasher.add(createInfo.pTessellationState->patchControlPoints);
+		}
+		if (hasher.present(createInfo.pViewportState)) {
+			const VkPipelineViewportStateCreateInfo &state = *createInfo.pViewportState;
+			hasher.add(state.viewportCount);
+			hasher.add(state.scissorCount);
+			// Viewports and scissors are usually dynamic, in which case the arrays are ignored
+			if (hasher.present(state.pViewports)) {
+				hasher.add(state.pViewports, sizeof(VkViewport) * state.viewportCount);
+			}
+			if (hasher.present(state.pScissors)) {
+				hasher.add(state.pScissors, sizeof(VkRect2D) * state.scissorCount);
+			}
+		}
+		if (hasher.present(createInfo.pRasterizationState)) {
+			const VkPipelineRasterizationStateCreateInfo &state = *createInfo.pRasterizationState;
+			hasher.add(state.depthClampEnable);
+			hasher.add(state.rasterizerDiscardEnable);
+			hasher.add(state.polygonMode);
+			hasher.add(state.cullMode);
+			hasher.add(state.frontFace);
+			hasher.add(state.depthBiasEnable);
+			hasher.add(state.depthBiasConstantFactor);
+			hasher.add(state.depthBiasClamp);
+			hasher.add(state.depthBiasSlopeFactor);
+			hasher.add(state.lineWidth);
+		}
+		if (hasher.present(createInfo.pMultisampleState)) {
+			const VkPipelineMultisampleStateCreateInfo &state = *createInfo.pMultisampleState;
+			hasher.add(state.rasterizationSamples);
+			hasher.add(state.sampleShadingEnable);
+			hasher.add(state.minSampleShading);
+			if (hasher.present(state.pSampleMask)) {
+				hasher.add(state.pSampleMask, sizeof(VkSampleMask) * ((state.rasterizationSamples + 31) / 32));
+			}
+			hasher.add(state.alphaToCoverageEnable);
+			hasher.add(state.alphaToOneEnable);
+		}
+		if (hasher.present(createInfo.pDepthStencilState)) {
+			const VkPipelineDepthStencilStateCreateInfo &state = *createInfo.pDepthStencilState;
+			hasher.add(state.depthTestEnable);
+			hasher.add(state.depthWriteEnable);
+			hasher.add(state.depthCompareOp);
+			hasher.add(state.depthBoundsTestEnable);
+			hasher.add(state.stencilTestEnable);
+			hasher.add(state.front);
+			hasher.add(state.back);
+			hasher.add(state.minDepthBounds);
+			hasher.add(state.maxDepthBounds);
+		}
+		if (hasher.present(createInfo.pColorBlendState)) {
+			const VkPipelineColorBlendStateCreateInfo &state = *createInfo.pColorBlendState;
+			hasher.add(state.logicOpEnable);
+			hasher.add(state.logicOp);
+			hasher.add(state.attachmentCount);
+			hasher.add(state.pAttachments, sizeof(VkPipelineColorBlendAttachmentState) * state.attachmentCount);
+			hasher.add(state.blendConstants);
+		}
+		if (hasher.present(createInfo.pDynamicState)) {
+			const VkPipelineDynamicStateCreateInfo &state = *createInfo.pDynamicState;
+			hasher.add(state.dynamicStateCount);
+			hasher.add(state.pDynamicStates, sizeof(VkDynamicState) * state.dynamicStateCount);
+		}
+		Key key;
+		key.data = std::move(hasher.data);
+		key.hash = hasher.value;
+		return key;
+	}
+
+	VkPipeline PipelineVariantCache::get(const VkGraphicsPipelineCreateInfo &createInfo, uint64_t salt)
+	{
+		Key variantKey = key(createInfo, salt);
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.requests++;
+		auto cached = pipelines.find(variantKey);
+		if (cached != pipelines.end()) {
+			stats.hits++;
+			return cached->second;
+		}
+		const auto tStart = std::chrono::high_resolution_clock::now();
+		VkPipeline pipeline;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &createInfo, nullptr, &pipeline));
+		stats.creationTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		stats.misses++;
+		pipelines.emplace(std::move(variantKey), pipeline);
+		return pipeline;
+	}
+
+	size_t PipelineVariantCache::size()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return pipelines.size();
+	}
+
+	PipelineVariantCache::Statistics PipelineVariantCache::statistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return stats;
+	}
+}
@@ -0,0 +1,85 @@
+/*
+* Vulkan pipeline variant cache
+*
+* Creates one pipeline per distinct permutation of shader modules, specialization constants, vertex layout and render state
+* Create infos are reduced to a key of their state, so e.g. materials with identical properties share a single pipeline
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Returns a shared pipeline for each distinct graphics pipeline create info, variants are only created when they're first requested
+	* @note pNext chains and base pipeline handles are not part of the key, use the salt of get() to tell variants apart that only differ by those
+	* @note Requesting pipelines is thread safe
+	*/
+	class PipelineVariantCache
+	{
+	public:
+		struct Statistics
+		{
+			/** @brief Number of get calls */
+			uint32_t requests = 0;
+			/** @brief Requests for a variant that already existed */
+			uint32_t hits = 0;
+			/** @brief Requests that created a new variant */
+			uint32_t misses = 0;
+			/** @brief Time spent in vkCreateGraphicsPipelines in ms */
+			double creationTime = 0.0;
+		};
+
+		void create(VkDevice device, VkPipelineCache pipelineCache);
+		/** @brief Destroys all variants created by the cache */
+		void destroy();
+
+		/**
+		* Returns the pipeline for a create info, creating it if no variant with the same state exists yet
+		*
+		* @param createInfo Graphics pipeline create info, only needs to stay valid for the duration of the call
+		* @param salt Additional value mixed into the key for state the cache can't see
+		*
+		* @return Pipeline owned by the cache, must not be destroyed by the caller
+		*/
+		VkPipeline get(const VkGraphicsPipelineCreateInfo &createInfo, uint64_t salt = 0);
+		/** @brief Hash of the key that identifies the variant for a create info */
+		static uint64_t hash(const VkGraphicsPipelineCreateInfo &createInfo, uint64_t salt = 0);
+
+		/** @brief Number of distinct variants */
+		size_t size();
+		Statistics statistics();
+
+	private:
+		/** @brief Serialized state of a create info, compared in full on lookup so colliding hashes can't return the wrong variant */
+		struct Key
+		{
+			std::vector<uint8_t> data;
+			uint64_t hash = 0;
+			bool operator==(const Key &other) const { return hash == other.hash && data == other.data; }
+		};
+		struct KeyHash
+		{
+			size_t operator()(const Key &key) const { return static_cast<size_t>(key.hash); }
+		};
+
+		static Key key(const VkGraphicsPipelineCreateInfo &createInfo, uint64_t salt);
+
+		VkDevice device = VK_NULL_HANDLE;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		std::mutex mutex;
+		std::unordered_map<Key, VkPipeline, KeyHash> pipelines;
+		Statistics stats;
+	};
+}
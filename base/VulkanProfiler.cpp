@@ -0,0 +1,189 @@
+/*
+* Vulkan GPU profiler
+*
+* Measures GPU execution times of named scopes with timestamp queries
+* Each recorded command buffer uses its own query pool (slot), results are read back without waiting a few frames later
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanProfiler.h"
+
+#include <algorithm>
+
+namespace vks
+{
+	/**
+	* Prepares the profiler for a device
+	*
+	* @param device Device the profiled command buffers are recorded for
+	* @param queueFamilyIndex Queue family the command buffers are submitted to, needs to support timestamps
+	*
+	* @note If the device or the queue family doesn't support timestamps all functions of the profiler do nothing
+	*/
+	void GPUProfiler::create(vks::VulkanDevice *device, uint32_t queueFamilyIndex)
+	{
+		this->device = device;
+		const uint32_t validBits = device->queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+		timestampsSupported = (validBits > 0) && (device->properties.limits.timestampPeriod > 0.0f);
+		timestampPeriod = device->properties.limits.timestampPeriod;
+		timestampMask = (validBits >= 64) ? ~0ULL : ((1ULL << validBits) - 1);
+	}
+
+	void GPUProfiler::destroy()
+	{
+		for (auto &slot : slots) {
+			if (slot.queryPool != VK_NULL_HANDLE) {
+				vkDestroyQueryPool(device->logicalDevice, slot.queryPool, nullptr);
+			}
+		}
+		slots.clear();
+		scopeList.clear();
+	}
+
+	bool GPUProfiler::supported() const
+	{
+		return timestampsSupported;
+	}
+
+	uint32_t GPUProfiler::scopeIndex(const std::string &name)
+	{
+		for (uint32_t i = 0; i < scopeList.size(); i++) {
+			if (scopeList[i].name == name) {
+				return i;
+			}
+		}
+		Scope scope;
+		scope.name = name;
+		scopeList.push_back(scope);
+		return static_cast<uint32_t>(scopeList.size() - 1);
+	}
+
+	GPUProfiler::Slot &GPUProfiler::getSlot(uint32_t slot)
+	{
+		if (slot >= slots.size()) {
+			slots.resize(slot + 1);
+		}
+		if (slots[slot].queryPool == VK_NULL_HANDLE) {
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = maxScopes * 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolInfo, nullptr, &slots[slot].queryPool));
+		}
+		return slots[slot];
+	}
+
+	void GPUProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t slot)
+	{
+		if (!timestampsSupported) {
+			return;
+		}
+		Slot &s = getSlot(slot);
+		// Results of the previous recording are laid out differently, so make sure they're never collected for the new one
+		uint64_t result[2] = { 0, 0 };
+		if (vkGetQueryPoolResults(device->logicalDevice, s.queryPool, 0, 1, sizeof(result), result, sizeof(result), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) == VK_SUCCESS) {
+			s.lastCollected = result[0];
+		}
+		vkCmdResetQueryPool(commandBuffer, s.queryPool, 0, maxScopes * 2);
+		s.queryCount = 0;
+		s.scopeQueries.clear();
+		s.openScopes.clear();
+	}
+
+	void GPUProfiler::beginScope(VkCommandBuffer commandBuffer, uint32_t slot, const std::string &name)
+	{
+		if (!timestampsSupported) {
+			return;
+		}
+		Slot &s = getSlot(slot);
+		if (s.queryCount + 2 > maxScopes * 2) {
+			// Scopes beyond the limit are ignored, but still have to be balanced by endScope
+			s.openScopes.push_back(UINT32_MAX);
+			return;
+		}
+		ScopeQueries queries;
+		queries.scope = scopeIndex(name);
+		queries.begin = s.queryCount++;
+		queries.end = s.queryCount++;
+		scopeList[queries.scope].depth = static_cast<uint32_t>(s.openScopes.size());
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, s.queryPool, queries.begin);
+		s.openScopes.push_back(static_cast<uint32_t>(s.scopeQueries.size()));
+		s.scopeQueries.push_back(queries);
+	}
+
+	void GPUProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t slot)
+	{
+		if (!timestampsSupported) {
+			return;
+		}
+		Slot &s = getSlot(slot);
+		assert(!s.openScopes.empty());
+		const uint32_t index = s.openScopes.back();
+		s.openScopes.pop_back();
+		if (index != UINT32_MAX) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, s.queryPool, s.scopeQueries[index].end);
+		}
+	}
+
+	void GPUProfiler::collect()
+	{
+		if (!timestampsSupported) {
+			return;
+		}
+		// Value and availability for each query
+		std::vector<uint64_t> results;
+		std::vector<double> durations(scopeList.size());
+		std::vector<bool> measured(scopeList.size());
+		for (auto &s : slots) {
+			if (s.queryCount == 0) {
+				continue;
+			}
+			results.resize(s.queryCount * 2);
+			// Without the wait bit this returns VK_NOT_READY while the command buffer is still pending
+			VkResult result = vkGetQueryPoolResults(device->logicalDevice, s.queryPool, 0, s.queryCount, results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+			if ((result != VK_SUCCESS) || (results[0] == s.lastCollected)) {
+				continue;
+			}
+			s.lastCollected = results[0];
+			std::fill(durations.begin(), durations.end(), 0.0);
+			std::fill(measured.begin(), measured.end(), false);
+			for (auto &queries : s.scopeQueries) {
+				const uint64_t begin = results[queries.begin * 2] & timestampMask;
+				const uint64_t end = results[queries.end * 2] & timestampMask;
+				// Timestamps wrap around at timestampValidBits
+				const uint64_t ticks = (end - begin) & timestampMask;
+				durations[queries.scope] += (double)ticks * timestampPeriod / 1000000.0;
+				measured[queries.scope] = true;
+			}
+			for (size_t i = 0; i < scopeList.size(); i++) {
+				if (!measured[i]) {
+					continue;
+				}
+				Scope &scope = scopeList[i];
+				const double duration = durations[i];
+				scope.last = duration;
+				scope.average = (scope.samples == 0) ? duration : scope.average + (duration - scope.average) * smoothing;
+				scope.min = (scope.samples == 0) ? duration : std::min(scope.min, duration);
+				scope.max = (scope.samples == 0) ? duration : std::max(scope.max, duration);
+				scope.total += duration;
+				scope.samples++;
+			}
+		}
+	}
+
+	void GPUProfiler::resetStatistics()
+	{
+		for (auto &scope : scopeList) {
+			scope.min = scope.max = scope.total = 0.0;
+			scope.samples = 0;
+		}
+	}
+
+	const std::vector<GPUProfiler::Scope> &GPUProfiler::scopes() const
+	{
+		return scopeList;
+	}
+}
@@ -0,0 +1,95 @@
+/*
+* Vulkan GPU profiler
+*
+* Measures GPU execution times of named scopes with timestamp queries
+* Each recorded command buffer uses its own query pool (slot), results are read back without waiting a few frames later
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief GPU timings of named scopes recorded with vkCmdWriteTimestamp
+	* @note A slot is a query pool owned by one command buffer, e.g. one per swap chain image for pre-recorded command buffers
+	* @note Results are collected without waiting, so they are only picked up once the command buffer has finished executing
+	*/
+	class GPUProfiler
+	{
+	public:
+		struct Scope
+		{
+			std::string name;
+			/** @brief Nesting depth of the scope when it was last recorded */
+			uint32_t depth = 0;
+			/** @brief GPU time of the last collected execution in ms */
+			double last = 0.0;
+			/** @brief Exponential moving average of the GPU time in ms, for display */
+			double average = 0.0;
+			/** @brief Statistics since the last call to resetStatistics() */
+			double min = 0.0;
+			double max = 0.0;
+			double total = 0.0;
+			uint32_t samples = 0;
+		};
+
+		/** @brief Maximum number of scopes per slot */
+		uint32_t maxScopes = 32;
+		/** @brief Weight of a new sample in the moving average */
+		double smoothing = 0.05;
+
+		void create(vks::VulkanDevice *device, uint32_t queueFamilyIndex);
+		void destroy();
+		bool supported() const;
+
+		/** @brief Starts recording timestamps into a slot, must be called outside of a render pass before any scope of the command buffer */
+		void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot);
+		void beginScope(VkCommandBuffer commandBuffer, uint32_t slot, const std::string &name);
+		void endScope(VkCommandBuffer commandBuffer, uint32_t slot);
+
+		/** @brief Reads the results of all slots that finished executing since the last call, doesn't wait for pending results */
+		void collect();
+		/** @brief Clears the min, max and total values of all scopes, e.g. after a benchmark's warm up */
+		void resetStatistics();
+		const std::vector<Scope> &scopes() const;
+
+	private:
+		struct ScopeQueries
+		{
+			uint32_t scope;
+			uint32_t begin;
+			uint32_t end;
+		};
+		struct Slot
+		{
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			uint32_t queryCount = 0;
+			std::vector<ScopeQueries> scopeQueries;
+			std::vector<uint32_t> openScopes;
+			// First timestamp of the last collected execution, used to tell new results from ones already read
+			uint64_t lastCollected = 0;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		bool timestampsSupported = false;
+		float timestampPeriod = 1.0f;
+		uint64_t timestampMask = ~0ULL;
+		std::vector<Slot> slots;
+		std::vector<Scope> scopeList;
+
+		uint32_t scopeIndex(const std::string &name);
+		Slot &getSlot(uint32_t slot);
+	};
+}
@@ -0,0 +1,218 @@
+/*
+* Vulkan shader module cache
+*
+* Reuses shader modules for SPIR-V files that are loaded more than once, keyed by file name and content hash
+* SPIR-V files are memory mapped instead of being copied into a temporary buffer
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanShaderCache.h"
+
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+#if defined(__ANDROID__)
+#include <android/asset_manager.h>
+#elif !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace vks
+{
+	namespace
+	{
+		// Read only view of a file's contents, memory mapped where the platform allows it
+		class MappedFile
+		{
+		public:
+			const uint8_t *data = nullptr;
+			size_t size = 0;
+
+			explicit MappedFile(const std::string &fileName)
+			{
+#if defined(__ANDROID__)
+				// Uncompressed assets are mapped directly from the apk
+				asset = AAssetManager_open(androidApp->activity->assetManager, fileName.c_str(), AASSET_MODE_BUFFER);
+				if (asset) {
+					data = (const uint8_t*)AAsset_getBuffer(asset);
+					size = AAsset_getLength(asset);
+				}
+#elif defined(_WIN32)
+				file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+				if (file == INVALID_HANDLE_VALUE) {
+					return;
+				}
+				LARGE_INTEGER fileSize;
+				if (!GetFileSizeEx(file, &fileSize) || (fileSize.QuadPart == 0)) {
+					return;
+				}
+				mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+				if (mapping) {
+					data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+					size = data ? (size_t)fileSize.QuadPart : 0;
+				}
+#else
+				fd = open(fileName.c_str(), O_RDONLY);
+				if (fd < 0) {
+					return;
+				}
+				struct stat info;
+				if ((fstat(fd, &info) != 0) || (info.st_size == 0)) {
+					return;
+				}
+				void *mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (mapped != MAP_FAILED) {
+					data = (const uint8_t*)mapped;
+					size = (size_t)info.st_size;
+				}
+#endif
+			}
+
+			~MappedFile()
+			{
+#if defined(__ANDROID__)
+				if (asset) {
+					AAsset_close(asset);
+				}
+#elif defined(_WIN32)
+				if (data) {
+					UnmapViewOfFile(data);
+				}
+				if (mapping) {
+					CloseHandle(mapping);
+				}
+				if (file != INVALID_HANDLE_VALUE) {
+					CloseHandle(file);
+				}
+#else
+				if (data) {
+					munmap((void*)data, size);
+				}
+				if (fd >= 0) {
+					close(fd);
+				}
+#endif
+			}
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile &operator=(const MappedFile&) = delete;
+
+		private:
+#if defined(__ANDROID__)
+			AAsset *asset = nullptr;
+#elif defined(_WIN32)
+			HANDLE file = INVALID_HANDLE_VALUE;
+			HANDLE mapping = NULL;
+#else
+			int fd = -1;
+#endif
+		};
+
+		// 64 bit FNV-1a, mixes in the size so files that only differ by trailing zeros don't collide
+		uint64_t hashData(const uint8_t *data, size_t size)
+		{
+			uint64_t hash = 14695981039346656037ULL ^ (uint64_t)size;
+			for (size_t i = 0; i < size; i++) {
+				hash ^= data[i];
+				hash *= 1099511628211ULL;
+			}
+			return hash;
+		}
+	}
+
+	void ShaderCache::create(VkDevice device, bool moduleIdentifiers)
+	{
+		this->device = device;
+		if (moduleIdentifiers) {
+			vkGetShaderModuleIdentifierEXT = reinterpret_cast<PFN_vkGetShaderModuleIdentifierEXT>(vkGetDeviceProcAddr(device, "vkGetShaderModuleIdentifierEXT"));
+		}
+	}
+
+	void ShaderCache::destroy()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &entry : modules) {
+			vkDestroyShaderModule(device, entry.second.module, nullptr);
+		}
+		modules.clear();
+		paths.clear();
+	}
+
+	VkShaderModule ShaderCache::load(const std::string &fileName)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.requests++;
+		auto path = paths.find(fileName);
+		if (path != paths.end()) {
+			stats.pathHits++;
+			return path->second;
+		}
+
+		auto tStart = std::chrono::high_resolution_clock::now();
+		MappedFile file(fileName);
+		if (!file.data) {
+			std::cerr << "Error: Could not open shader file \"" << fileName << "\"" << "\n";
+			return VK_NULL_HANDLE;
+		}
+		const uint64_t hash = hashData(file.data, file.size);
+		stats.bytesRead += file.size;
+		stats.readTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+		auto candidates = modules.equal_range(hash);
+		for (auto cached = candidates.first; cached != candidates.second; cached++) {
+			const std::vector<uint8_t> &code = cached->second.code;
+			if ((code.size() == file.size) && (memcmp(code.data(), file.data, file.size) == 0)) {
+				stats.contentHits++;
+				paths[fileName] = cached->second.module;
+				return cached->second.module;
+			}
+		}
+
+		tStart = std::chrono::high_resolution_clock::now();
+		Module module;
+		VkShaderModuleCreateInfo moduleCreateInfo{};
+		moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleCreateInfo.codeSize = file.size;
+		moduleCreateInfo.pCode = (const uint32_t*)file.data;
+		VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, nullptr, &module.module));
+		stats.creationTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		stats.modulesCreated++;
+
+		if (vkGetShaderModuleIdentifierEXT) {
+			VkShaderModuleIdentifierEXT moduleIdentifier{};
+			moduleIdentifier.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_IDENTIFIER_EXT;
+			vkGetShaderModuleIdentifierEXT(device, module.module, &moduleIdentifier);
+			module.identifier.assign(moduleIdentifier.identifier, moduleIdentifier.identifier + moduleIdentifier.identifierSize);
+		}
+
+		module.code.assign(file.data, file.data + file.size);
+		const VkShaderModule shaderModule = module.module;
+		modules.emplace(hash, std::move(module));
+		paths[fileName] = shaderModule;
+		return shaderModule;
+	}
+
+	std::vector<uint8_t> ShaderCache::identifier(VkShaderModule module)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &entry : modules) {
+			if (entry.second.module == module) {
+				return entry.second.identifier;
+			}
+		}
+		return std::vector<uint8_t>();
+	}
+
+	ShaderCache::Statistics ShaderCache::statistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return stats;
+	}
+}
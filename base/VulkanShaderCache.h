@@ -0,0 +1,86 @@
+/*
+* Vulkan shader module cache
+*
+* Reuses shader modules for SPIR-V files that are loaded more than once, keyed by file name and content hash
+* SPIR-V files are memory mapped instead of being copied into a temporary buffer
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Creates each distinct shader module only once
+	* @note Modules with the same SPIR-V are shared even if they're loaded from different files, so they must not be destroyed by the caller
+	* @note Loading is thread safe
+	*/
+	class ShaderCache
+	{
+	public:
+		struct Statistics
+		{
+			/** @brief Number of load calls */
+			uint32_t requests = 0;
+			/** @brief Loads of a file name that has been loaded before */
+			uint32_t pathHits = 0;
+			/** @brief Loads of a new file name whose SPIR-V matched an existing module */
+			uint32_t contentHits = 0;
+			uint32_t modulesCreated = 0;
+			uint64_t bytesRead = 0;
+			/** @brief Time spent mapping and hashing files in ms */
+			double readTime = 0.0;
+			/** @brief Time spent in vkCreateShaderModule in ms */
+			double creationTime = 0.0;
+		};
+
+		/**
+		* Prepares the cache for a device
+		*
+		* @param device Logical device the modules are created for
+		* @param moduleIdentifiers Query a module identifier for each created module, requires VK_EXT_shader_module_identifier and its shaderModuleIdentifier feature to be enabled
+		*/
+		void create(VkDevice device, bool moduleIdentifiers = false);
+		/** @brief Destroys all modules created by the cache */
+		void destroy();
+
+		/** @brief Returns the module for a SPIR-V file, VK_NULL_HANDLE if the file can't be read */
+		VkShaderModule load(const std::string &fileName);
+		/**
+		* Returns the identifier of a module created by the cache
+		* @note Identifiers can be passed with VkPipelineShaderStageModuleIdentifierCreateInfoEXT to create pipelines found in a pipeline cache without the SPIR-V
+		* @return Identifier of the module, empty if identifiers aren't enabled
+		*/
+		std::vector<uint8_t> identifier(VkShaderModule module);
+		Statistics statistics();
+
+	private:
+		struct Module
+		{
+			VkShaderModule module;
+			std::vector<uint8_t> identifier;
+			// SPIR-V the module was created from, compared on a hash match so colliding hashes can't return the wrong module
+			std::vector<uint8_t> code;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		PFN_vkGetShaderModuleIdentifierEXT vkGetShaderModuleIdentifierEXT = nullptr;
+		std::mutex mutex;
+		// Modules by the hash of their SPIR-V, and the module of each loaded file name
+		std::unordered_multimap<uint64_t, Module> modules;
+		std::unordered_map<std::string, VkShaderModule> paths;
+		Statistics stats;
+	};
+}
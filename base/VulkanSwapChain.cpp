@@ -197,6 +197,39 @@ void VulkanSwapChain::initSurface(uint32_t width, uint32_t height)
 
 }
 
+/**
+* Render into a ring of images owned by the swapchain class instead of presenting to a surface
+* No window system is required, e.g. for running benchmarks on CI machines with a software implementation
+*
+* @param queue Queue used to signal the acquire semaphores and to wait on the present semaphores
+* @param queueFamilyIndex Family of the queue, used for the command pool instead of a present capable family
+*/
+void VulkanSwapChain::initOffscreen(VkQueue queue, uint32_t queueFamilyIndex)
+{
+	offscreen = true;
+	offscreenQueue = queue;
+	queueNodeIndex = queueFamilyIndex;
+
+	// Prefer the format most surfaces report, so render passes and pipelines are the same as with a window
+	std::vector<VkFormat> formats = { VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM };
+	colorFormat = VK_FORMAT_UNDEFINED;
+	for (auto& format : formats)
+	{
+		VkFormatProperties formatProps;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProps);
+		if (formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT)
+		{
+			colorFormat = format;
+			break;
+		}
+	}
+	if (colorFormat == VK_FORMAT_UNDEFINED)
+	{
+		vks::tools::exitFatal("Could not find a color format for offscreen rendering!", -1);
+	}
+	colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+}
+
 /**
 * Set instance, physical and logical device to use for the swapchain and get all required function pointers
 * 
@@ -231,6 +264,12 @@ void VulkanSwapChain::connect(VkInstance instance, VkPhysicalDevice physicalDevi
 */
 void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool fullscreen)
 {
+	if (offscreen)
+	{
+		createOffscreen(*width, *height);
+		return;
+	}
+
 	// Store the current swap chain handle so we can use it later on to ease up recreation
 	VkSwapchainKHR oldSwapchain = swapChain;
 
@@ -364,6 +403,7 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 	}
 
 	VK_CHECK_RESULT(fpCreateSwapchainKHR(device, &swapchainCI, nullptr, &swapChain));
+	imageUsage = swapchainCI.imageUsage;
 
 	// If an existing swap chain is re-created, destroy the old swap chain
 	// This also cleans up all the presentable images
@@ -423,6 +463,23 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 */
 VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t *imageIndex)
 {
+	if (offscreen)
+	{
+		// Images are used round robin, the fence signals once the last frame that rendered to the next image has been "presented"
+		*imageIndex = offscreenIndex;
+		offscreenIndex = (offscreenIndex + 1) % imageCount;
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &offscreenFences[*imageIndex], VK_TRUE, UINT64_MAX));
+		VK_CHECK_RESULT(vkResetFences(device, 1, &offscreenFences[*imageIndex]));
+		// Signal the semaphore like the presentation engine would, so the submit of the frame can wait on it as usual
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		if (presentCompleteSemaphore != VK_NULL_HANDLE)
+		{
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &presentCompleteSemaphore;
+		}
+		return vkQueueSubmit(offscreenQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
 	// By setting timeout to UINT64_MAX we will always wait until the next image has been acquired or an actual error is thrown
 	// With that we don't have to handle VK_NOT_READY
 	return fpAcquireNextImageKHR(device, swapChain, UINT64_MAX, presentCompleteSemaphore, (VkFence)nullptr, imageIndex);
@@ -439,6 +496,20 @@ VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore,
 */
 VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore)
 {
+	if (offscreen)
+	{
+		// Nothing is presented, the image can be reused once the rendering the semaphore belongs to has finished
+		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		if (waitSemaphore != VK_NULL_HANDLE)
+		{
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &waitSemaphore;
+			submitInfo.pWaitDstStageMask = &waitStageMask;
+		}
+		return vkQueueSubmit(queue, 1, &submitInfo, offscreenFences[imageIndex]);
+	}
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.pNext = NULL;
@@ -460,6 +531,11 @@ VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSem
 */
 void VulkanSwapChain::cleanup()
 {
+	if (offscreen)
+	{
+		destroyOffscreen();
+		return;
+	}
 	if (swapChain != VK_NULL_HANDLE)
 	{
 		for (uint32_t i = 0; i < imageCount; i++)
@@ -476,6 +552,111 @@ void VulkanSwapChain::cleanup()
 	swapChain = VK_NULL_HANDLE;
 }
 
+/**
+* Create the images, views and fences of the offscreen image ring, images are also usable as transfer sources for screenshots
+*/
+void VulkanSwapChain::createOffscreen(uint32_t width, uint32_t height)
+{
+	destroyOffscreen();
+
+	// Same number of images as a triple buffered swapchain, so examples record the same number of command buffers
+	imageCount = 3;
+	images.resize(imageCount);
+	buffers.resize(imageCount);
+	offscreenMemory.resize(imageCount);
+	offscreenFences.resize(imageCount);
+	offscreenIndex = 0;
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		VkImageCreateInfo imageCreateInfo = {};
+		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = colorFormat;
+		imageCreateInfo.extent = { width, height, 1 };
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.usage = imageUsage;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &images[i]));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, images[i], &memReqs);
+		// Prefer device local memory, but take any supported type as software implementations may not distinguish
+		uint32_t memoryTypeIndex = UINT32_MAX;
+		for (uint32_t j = 0; j < memoryProperties.memoryTypeCount; j++)
+		{
+			if (memReqs.memoryTypeBits & (1 << j))
+			{
+				if (memoryProperties.memoryTypes[j].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+				{
+					memoryTypeIndex = j;
+					break;
+				}
+				if (memoryTypeIndex == UINT32_MAX)
+				{
+					memoryTypeIndex = j;
+				}
+			}
+		}
+		VkMemoryAllocateInfo memAlloc = {};
+		memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = memoryTypeIndex;
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreenMemory[i]));
+		VK_CHECK_RESULT(vkBindImageMemory(device, images[i], offscreenMemory[i], 0));
+
+		VkImageViewCreateInfo colorAttachmentView = {};
+		colorAttachmentView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		colorAttachmentView.format = colorFormat;
+		colorAttachmentView.components = {
+			VK_COMPONENT_SWIZZLE_R,
+			VK_COMPONENT_SWIZZLE_G,
+			VK_COMPONENT_SWIZZLE_B,
+			VK_COMPONENT_SWIZZLE_A
+		};
+		colorAttachmentView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		colorAttachmentView.subresourceRange.levelCount = 1;
+		colorAttachmentView.subresourceRange.layerCount = 1;
+		colorAttachmentView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		colorAttachmentView.image = images[i];
+		buffers[i].image = images[i];
+		VK_CHECK_RESULT(vkCreateImageView(device, &colorAttachmentView, nullptr, &buffers[i].view));
+
+		// Created signaled as the images are available right away
+		VkFenceCreateInfo fenceCreateInfo = {};
+		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &offscreenFences[i]));
+	}
+}
+
+void VulkanSwapChain::destroyOffscreen()
+{
+	if (!offscreenFences.empty())
+	{
+		vkWaitForFences(device, static_cast<uint32_t>(offscreenFences.size()), offscreenFences.data(), VK_TRUE, UINT64_MAX);
+	}
+	for (size_t i = 0; i < offscreenFences.size(); i++)
+	{
+		vkDestroyImageView(device, buffers[i].view, nullptr);
+		vkDestroyImage(device, images[i], nullptr);
+		vkFreeMemory(device, offscreenMemory[i], nullptr);
+		vkDestroyFence(device, offscreenFences[i], nullptr);
+	}
+	images.clear();
+	buffers.clear();
+	offscreenMemory.clear();
+	offscreenFences.clear();
+}
+
 #if defined(_DIRECT2DISPLAY)
 /**
 * Create direct to display surface
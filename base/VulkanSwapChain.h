@@ -49,14 +49,25 @@ private:
 	PFN_vkGetSwapchainImagesKHR fpGetSwapchainImagesKHR;
 	PFN_vkAcquireNextImageKHR fpAcquireNextImageKHR;
 	PFN_vkQueuePresentKHR fpQueuePresentKHR;
+	// Offscreen image ring
+	VkQueue offscreenQueue = VK_NULL_HANDLE;
+	std::vector<VkDeviceMemory> offscreenMemory;
+	std::vector<VkFence> offscreenFences;
+	uint32_t offscreenIndex = 0;
+	void createOffscreen(uint32_t width, uint32_t height);
+	void destroyOffscreen();
 public:
 	VkFormat colorFormat;
 	VkColorSpaceKHR colorSpace;
 	VkSwapchainKHR swapChain = VK_NULL_HANDLE;	
 	uint32_t imageCount;
 	std::vector<VkImage> images;
+	/** @brief Usage the images were created with, transfer usage is only added if the surface supports it */
+	VkImageUsageFlags imageUsage = 0;
 	std::vector<SwapChainBuffer> buffers;
 	uint32_t queueNodeIndex = UINT32_MAX;
+	/** @brief Set if the images are owned by this class and rendered to without a surface (see initOffscreen) */
+	bool offscreen = false;
 
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
 	void initSurface(void* platformHandle, void* platformWindow);
@@ -76,6 +87,7 @@ public:
 	void createDirect2DisplaySurface(uint32_t width, uint32_t height);
 #endif
 #endif
+	void initOffscreen(VkQueue queue, uint32_t queueFamilyIndex);
 	void connect(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device);
 	void create(uint32_t* width, uint32_t* height, bool vsync = false, bool fullscreen = false);
 	VkResult acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t* imageIndex);
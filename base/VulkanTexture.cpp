@@ -7,6 +7,7 @@
 */
 
 #include <VulkanTexture.h>
+#include "cpuprofiler.hpp"
 
 namespace vks
 {
@@ -66,6 +67,7 @@ namespace vks
 	*/
 	void Texture2D::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout, bool forceLinear)
 	{
+		VKS_PROFILE_SCOPE("Texture2D::loadFromFile");
 		ktxTexture* ktxTexture;
 		ktxResult result = loadKTXFile(filename, &ktxTexture);
 		assert(result == KTX_SUCCESS);
@@ -508,6 +510,7 @@ namespace vks
 	*/
 	void Texture2DArray::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
 	{
+		VKS_PROFILE_SCOPE("Texture2DArray::loadFromFile");
 		ktxTexture* ktxTexture;
 		ktxResult result = loadKTXFile(filename, &ktxTexture);
 		assert(result == KTX_SUCCESS);
@@ -692,6 +695,7 @@ namespace vks
 	*/
 	void TextureCubeMap::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
 	{
+		VKS_PROFILE_SCOPE("TextureCubeMap::loadFromFile");
 		ktxTexture* ktxTexture;
 		ktxResult result = loadKTXFile(filename, &ktxTexture);
 		assert(result == KTX_SUCCESS);
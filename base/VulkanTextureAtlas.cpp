@@ -0,0 +1,376 @@
+/*
+* Vulkan texture atlas
+*
+* Packs many small images into the layers of a single texture, so a scene with lots of material textures can be drawn with a few descriptor binds
+*
+* Copyright(C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTextureAtlas.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace vks
+{
+	void SkylinePacker::init(uint32_t width, uint32_t height)
+	{
+		this->width = width;
+		this->height = height;
+		skyline.clear();
+		skyline.push_back({ 0, 0, width });
+	}
+
+	// Checks if a rectangle placed at the start of the given segment fits into the packer area and returns the lowest possible y position for it
+	bool SkylinePacker::fits(size_t index, uint32_t width, uint32_t height, uint32_t &y)
+	{
+		const uint32_t x = skyline[index].x;
+		if (x + width > this->width) {
+			return false;
+		}
+		uint32_t widthLeft = width;
+		y = skyline[index].y;
+		for (size_t i = index; i < skyline.size(); i++) {
+			y = std::max(y, skyline[i].y);
+			if (y + height > this->height) {
+				return false;
+			}
+			if (skyline[i].width >= widthLeft) {
+				return true;
+			}
+			widthLeft -= skyline[i].width;
+		}
+		return false;
+	}
+
+	/**
+	* Place a rectangle inside the packer area
+	*
+	* @param width Width of the rectangle
+	* @param height Height of the rectangle
+	* @param x Left edge of the rectangle, if it could be placed
+	* @param y Top edge of the rectangle, if it could be placed
+	*
+	* @return True if the rectangle could be placed
+	*/
+	bool SkylinePacker::insert(uint32_t width, uint32_t height, uint32_t &x, uint32_t &y)
+	{
+		// Choose the position that results in the lowest bottom edge, prefer narrow segments to reduce wasted space
+		size_t bestIndex = skyline.size();
+		uint32_t bestBottom = UINT32_MAX;
+		uint32_t bestWidth = UINT32_MAX;
+		for (size_t i = 0; i < skyline.size(); i++) {
+			uint32_t top;
+			if (fits(i, width, height, top)) {
+				const uint32_t bottom = top + height;
+				if ((bottom < bestBottom) || ((bottom == bestBottom) && (skyline[i].width < bestWidth))) {
+					bestIndex = i;
+					bestBottom = bottom;
+					bestWidth = skyline[i].width;
+					x = skyline[i].x;
+					y = top;
+				}
+			}
+		}
+		if (bestIndex == skyline.size()) {
+			return false;
+		}
+
+		// The new rectangle becomes part of the skyline, segments covered by it are shrunk or removed
+		skyline.insert(skyline.begin() + bestIndex, { x, y + height, width });
+		for (size_t i = bestIndex + 1; i < skyline.size();) {
+			const Segment &previous = skyline[i - 1];
+			const uint32_t previousEnd = previous.x + previous.width;
+			if (skyline[i].x >= previousEnd) {
+				break;
+			}
+			const uint32_t shrink = previousEnd - skyline[i].x;
+			if (skyline[i].width <= shrink) {
+				skyline.erase(skyline.begin() + i);
+				continue;
+			}
+			skyline[i].x += shrink;
+			skyline[i].width -= shrink;
+			break;
+		}
+
+		// Merge neighbouring segments at the same height
+		for (size_t i = 0; i + 1 < skyline.size();) {
+			if (skyline[i].y == skyline[i + 1].y) {
+				skyline[i].width += skyline[i + 1].width;
+				skyline.erase(skyline.begin() + i + 1);
+			} else {
+				i++;
+			}
+		}
+		return true;
+	}
+
+	/**
+	* Add an image to the layout
+	*
+	* @param width Width of the image
+	* @param height Height of the image
+	*
+	* @return Index of the image's region
+	*/
+	uint32_t TextureAtlasLayout::add(uint32_t width, uint32_t height)
+	{
+		Region region{};
+		region.width = width;
+		region.height = height;
+		regions.push_back(region);
+		return static_cast<uint32_t>(regions.size() - 1);
+	}
+
+	/**
+	* Place all regions inside the atlas layers
+	*
+	* @return Number of regions that could be placed
+	*/
+	uint32_t TextureAtlasLayout::pack()
+	{
+		assert((layerSize & (layerSize - 1)) == 0);
+		assert((padding > 0) && ((padding & (padding - 1)) == 0));
+
+		// A box filtered mip level k combines blocks of 2^k texels, so a border of 2^k texels around images that start at multiples of 2^k keeps level k free of bleeding
+		mipLevels = std::min(static_cast<uint32_t>(log2(padding)) + 1, static_cast<uint32_t>(log2(layerSize)) + 1);
+		const uint32_t alignment = padding;
+
+		// Larger images first, small ones fill the gaps
+		std::vector<uint32_t> order(regions.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+			if (regions[a].height != regions[b].height) {
+				return regions[a].height > regions[b].height;
+			}
+			return regions[a].width > regions[b].width;
+		});
+
+		std::vector<SkylinePacker> layers;
+		uint32_t packedCount = 0;
+		for (auto index : order) {
+			Region &region = regions[index];
+			region.packed = false;
+			const uint32_t cellWidth = (region.width + 2 * padding + alignment - 1) & ~(alignment - 1);
+			const uint32_t cellHeight = (region.height + 2 * padding + alignment - 1) & ~(alignment - 1);
+			if ((cellWidth > layerSize) || (cellHeight > layerSize)) {
+				continue;
+			}
+			for (uint32_t layer = 0; layer < maxLayers; layer++) {
+				if (layer == layers.size()) {
+					layers.push_back(SkylinePacker());
+					layers.back().init(layerSize, layerSize);
+				}
+				if (layers[layer].insert(cellWidth, cellHeight, region.x, region.y)) {
+					region.layer = layer;
+					region.packed = true;
+					break;
+				}
+			}
+			if (!region.packed) {
+				continue;
+			}
+			region.uvOffset = glm::vec2((float)(region.x + padding) / (float)layerSize, (float)(region.y + padding) / (float)layerSize);
+			region.uvScale = glm::vec2((float)region.width / (float)layerSize, (float)region.height / (float)layerSize);
+			packedCount++;
+		}
+		layerCount = static_cast<uint32_t>(layers.size());
+		return packedCount;
+	}
+
+	glm::vec2 TextureAtlasLayout::remap(uint32_t region, glm::vec2 uv) const
+	{
+		return regions[region].uvOffset + uv * regions[region].uvScale;
+	}
+
+	/**
+	* Create the atlas texture from a packed layout
+	*
+	* @param layout Packed layout of the atlas
+	* @param images RGBA8 image data for every region of the layout (nullptr leaves the region black)
+	* @param device Vulkan device to create the texture on
+	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
+	* @param (Optional) viewType Type of the image view, VK_IMAGE_VIEW_TYPE_2D can be used with single layer atlases for shaders sampling a sampler2D
+	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
+	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	*
+	*/
+	void TextureAtlas::fromLayout(const TextureAtlasLayout &layout, const std::vector<const uint8_t *> &images, vks::VulkanDevice *device, VkQueue copyQueue, VkImageViewType viewType, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	{
+		assert(images.size() == layout.regions.size());
+		assert((viewType == VK_IMAGE_VIEW_TYPE_2D_ARRAY) || (layout.layerCount <= 1));
+
+		this->device = device;
+		width = layout.layerSize;
+		height = layout.layerSize;
+		layerCount = std::max(layout.layerCount, 1u);
+		mipLevels = layout.mipLevels;
+		const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+
+		// Staging data contains all mip levels of the first layer, followed by all levels of the next layer, etc.
+		std::vector<VkDeviceSize> levelOffsets(mipLevels);
+		VkDeviceSize layerDataSize = 0;
+		for (uint32_t level = 0; level < mipLevels; level++) {
+			const uint32_t levelSize = std::max(layout.layerSize >> level, 1u);
+			levelOffsets[level] = layerDataSize;
+			layerDataSize += levelSize * levelSize * 4;
+		}
+		std::vector<uint8_t> data(layerDataSize * layerCount, 0);
+
+		// Copy the images into the first mip level of their layer and extend their edges into the padding
+		const int32_t padding = static_cast<int32_t>(layout.padding);
+		for (size_t i = 0; i < layout.regions.size(); i++) {
+			const TextureAtlasLayout::Region &region = layout.regions[i];
+			if (!region.packed || (images[i] == nullptr)) {
+				continue;
+			}
+			uint8_t *layerData = data.data() + region.layer * layerDataSize;
+			for (int32_t y = -padding; y < (int32_t)region.height + padding; y++) {
+				const int32_t srcY = std::min(std::max(y, 0), (int32_t)region.height - 1);
+				for (int32_t x = -padding; x < (int32_t)region.width + padding; x++) {
+					const int32_t srcX = std::min(std::max(x, 0), (int32_t)region.width - 1);
+					const uint8_t *src = images[i] + (srcY * region.width + srcX) * 4;
+					uint8_t *dst = layerData + ((region.y + padding + y) * layout.layerSize + (region.x + padding + x)) * 4;
+					memcpy(dst, src, 4);
+				}
+			}
+		}
+
+		// Generate the mip chain with a box filter, the padding keeps the filter inside each image's cell
+		for (uint32_t layer = 0; layer < layerCount; layer++) {
+			uint8_t *layerData = data.data() + layer * layerDataSize;
+			for (uint32_t level = 1; level < mipLevels; level++) {
+				const uint32_t srcSize = layout.layerSize >> (level - 1);
+				const uint32_t dstSize = layout.layerSize >> level;
+				const uint8_t *src = layerData + levelOffsets[level - 1];
+				uint8_t *dst = layerData + levelOffsets[level];
+				for (uint32_t y = 0; y < dstSize; y++) {
+					for (uint32_t x = 0; x < dstSize; x++) {
+						for (uint32_t c = 0; c < 4; c++) {
+							const uint32_t sum =
+							    src[((2 * y) * srcSize + 2 * x) * 4 + c] +
+							    src[((2 * y) * srcSize + 2 * x + 1) * 4 + c] +
+							    src[((2 * y + 1) * srcSize + 2 * x) * 4 + c] +
+							    src[((2 * y + 1) * srcSize + 2 * x + 1) * 4 + c];
+							dst[(y * dstSize + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+						}
+					}
+				}
+			}
+		}
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(device->createBuffer(
+		    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		    &stagingBuffer,
+		    data.size(),
+		    data.data()));
+
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		for (uint32_t layer = 0; layer < layerCount; layer++) {
+			for (uint32_t level = 0; level < mipLevels; level++) {
+				VkBufferImageCopy bufferCopyRegion = {};
+				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				bufferCopyRegion.imageSubresource.mipLevel = level;
+				bufferCopyRegion.imageSubresource.baseArrayLayer = layer;
+				bufferCopyRegion.imageSubresource.layerCount = 1;
+				bufferCopyRegion.imageExtent.width = std::max(width >> level, 1u);
+				bufferCopyRegion.imageExtent.height = std::max(height >> level, 1u);
+				bufferCopyRegion.imageExtent.depth = 1;
+				bufferCopyRegion.bufferOffset = layer * layerDataSize + levelOffsets[level];
+				bufferCopyRegions.push_back(bufferCopyRegion);
+			}
+		}
+
+		// Create optimal tiled target image
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { width, height, 1 };
+		imageCreateInfo.usage = imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCreateInfo.arrayLayers = layerCount;
+		imageCreateInfo.mipLevels = mipLevels;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = mipLevels;
+		subresourceRange.layerCount = layerCount;
+
+		vks::tools::setImageLayout(
+		    copyCmd,
+		    image,
+		    VK_IMAGE_LAYOUT_UNDEFINED,
+		    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		    subresourceRange);
+
+		vkCmdCopyBufferToImage(
+		    copyCmd,
+		    stagingBuffer.buffer,
+		    image,
+		    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		    static_cast<uint32_t>(bufferCopyRegions.size()),
+		    bufferCopyRegions.data());
+
+		this->imageLayout = imageLayout;
+		vks::tools::setImageLayout(
+		    copyCmd,
+		    image,
+		    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		    imageLayout,
+		    subresourceRange);
+
+		device->flushCommandBuffer(copyCmd, copyQueue);
+		stagingBuffer.destroy();
+
+		// Create sampler
+		// Anisotropic filtering isn't enabled as its footprint can reach past the padding of an image
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeV = samplerCreateInfo.addressModeU;
+		samplerCreateInfo.addressModeW = samplerCreateInfo.addressModeU;
+		samplerCreateInfo.mipLodBias = 0.0f;
+		samplerCreateInfo.maxAnisotropy = 1.0f;
+		samplerCreateInfo.anisotropyEnable = VK_FALSE;
+		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
+		samplerCreateInfo.minLod = 0.0f;
+		samplerCreateInfo.maxLod = (float)mipLevels;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+
+		// Create image view
+		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+		viewCreateInfo.viewType = viewType;
+		viewCreateInfo.format = format;
+		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		viewCreateInfo.subresourceRange.layerCount = layerCount;
+		viewCreateInfo.subresourceRange.levelCount = mipLevels;
+		viewCreateInfo.image = image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
+
+		// Update descriptor image info member that can be used for setting up descriptor sets
+		updateDescriptor();
+	}
+}        // namespace vks
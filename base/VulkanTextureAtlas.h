@@ -0,0 +1,96 @@
+/*
+* Vulkan texture atlas
+*
+* Packs many small images into the layers of a single texture, so a scene with lots of material textures can be drawn with a few descriptor binds
+*
+* Copyright(C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include <glm/glm.hpp>
+
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanTexture.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+/**
+* @brief Skyline bottom-left rectangle packer
+* @note Keeps the top edge of all placed rectangles as a list of horizontal segments and places new rectangles as low as possible
+*/
+class SkylinePacker
+{
+  public:
+	void init(uint32_t width, uint32_t height);
+	bool insert(uint32_t width, uint32_t height, uint32_t &x, uint32_t &y);
+
+  private:
+	struct Segment
+	{
+		uint32_t x, y, width;
+	};
+	uint32_t             width, height;
+	std::vector<Segment> skyline;
+	bool                 fits(size_t index, uint32_t width, uint32_t height, uint32_t &y);
+};
+
+/**
+* @brief Placement of a list of images inside the layers of a texture atlas
+* @note Every image is surrounded by a border of repeated edge texels that is wide enough to keep all mip levels of the atlas from bleeding into neighbouring images
+*/
+class TextureAtlasLayout
+{
+  public:
+	struct Region
+	{
+		uint32_t  width, height;
+		uint32_t  x = 0, y = 0;
+		uint32_t  layer = 0;
+		bool      packed = false;
+		/** @brief Transforms texture coordinates of the source image into atlas texture coordinates */
+		glm::vec2 uvOffset = glm::vec2(0.0f);
+		glm::vec2 uvScale = glm::vec2(1.0f);
+	};
+
+	/** @brief Width and height of each atlas layer */
+	uint32_t layerSize = 2048;
+	/** @brief Border around each image in texels, must be a power of two and limits the number of mip levels to log2(padding) + 1 */
+	uint32_t padding = 8;
+	/** @brief Maximum number of layers, regions that don't fit stay unpacked */
+	uint32_t maxLayers = 1;
+	uint32_t layerCount = 0;
+	uint32_t mipLevels = 1;
+	std::vector<Region> regions;
+
+	uint32_t  add(uint32_t width, uint32_t height);
+	uint32_t  pack();
+	glm::vec2 remap(uint32_t region, glm::vec2 uv) const;
+};
+
+/**
+* @brief RGBA8 texture array containing the images of a texture atlas layout
+*/
+class TextureAtlas : public Texture
+{
+  public:
+	void fromLayout(
+	    const TextureAtlasLayout &            layout,
+	    const std::vector<const uint8_t *> &images,
+	    vks::VulkanDevice *                   device,
+	    VkQueue                               copyQueue,
+	    VkImageViewType                       viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+	    VkImageUsageFlags                     imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+	    VkImageLayout                         imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+};
+}        // namespace vks
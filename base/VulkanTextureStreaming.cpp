@@ -0,0 +1,452 @@
+/*
+* Vulkan texture streaming
+*
+* Textures become usable as soon as their smallest mip levels (the mip tail) are resident,
+* finer levels are read by a background thread and uploaded under a per-frame byte budget
+*
+* Copyright(C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTextureStreaming.h"
+
+namespace vks
+{
+	// Reads a range of bytes from a file (or an asset on Android) into dst
+	static bool readFileRange(const std::string &filename, VkDeviceSize offset, VkDeviceSize size, void *dst)
+	{
+#if defined(__ANDROID__)
+		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_RANDOM);
+		if (!asset) {
+			return false;
+		}
+		bool success = (AAsset_seek(asset, (off_t)offset, SEEK_SET) == (off_t)offset) && (AAsset_read(asset, dst, (size_t)size) == (int)size);
+		AAsset_close(asset);
+		return success;
+#else
+		std::ifstream is(filename, std::ios::binary | std::ios::in);
+		if (!is.is_open()) {
+			return false;
+		}
+		is.seekg((std::streamoff)offset, std::ios::beg);
+		is.read((char*)dst, (std::streamsize)size);
+		return !is.fail();
+#endif
+	}
+
+	static uint32_t swapEndianness(uint32_t value)
+	{
+		return ((value & 0xFF) << 24) | ((value & 0xFF00) << 8) | ((value >> 8) & 0xFF00) | (value >> 24);
+	}
+
+	/*
+		Reads the mip level layout of a KTX (version 1) file without loading any image data
+		Levels are stored from the largest to the smallest, each one prefixed with its image size
+	*/
+	static void readKTXLevelLayout(const std::string &filename, uint32_t &width, uint32_t &height, std::vector<VkDeviceSize> &offsets, std::vector<VkDeviceSize> &sizes)
+	{
+		const uint8_t ktxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+		struct {
+			uint8_t identifier[12];
+			uint32_t endianness;
+			uint32_t glType;
+			uint32_t glTypeSize;
+			uint32_t glFormat;
+			uint32_t glInternalFormat;
+			uint32_t glBaseInternalFormat;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t numberOfArrayElements;
+			uint32_t numberOfFaces;
+			uint32_t numberOfMipmapLevels;
+			uint32_t bytesOfKeyValueData;
+		} header;
+		static_assert(sizeof(header) == 64, "Unexpected ktx header size");
+
+		if (!readFileRange(filename, 0, sizeof(header), &header) || (memcmp(header.identifier, ktxIdentifier, sizeof(ktxIdentifier)) != 0)) {
+			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nMake sure the assets submodule has been checked out and is up-to-date.", -1);
+		}
+		// Files written on a machine with different endianness have all header values swapped
+		const bool swap = (header.endianness != 0x04030201);
+		if (swap) {
+			uint32_t* values = &header.endianness;
+			for (uint32_t i = 0; i < 13; i++) {
+				values[i] = swapEndianness(values[i]);
+			}
+		}
+		// Only plain 2D textures can be streamed
+		assert(header.pixelDepth <= 1 && header.numberOfArrayElements == 0 && header.numberOfFaces == 1);
+
+		width = header.pixelWidth;
+		height = header.pixelHeight;
+		const uint32_t levelCount = std::max(1u, header.numberOfMipmapLevels);
+		offsets.resize(levelCount);
+		sizes.resize(levelCount);
+		VkDeviceSize offset = sizeof(header) + header.bytesOfKeyValueData;
+		for (uint32_t level = 0; level < levelCount; level++) {
+			uint32_t imageSize;
+			if (!readFileRange(filename, offset, sizeof(imageSize), &imageSize)) {
+				vks::tools::exitFatal("Could not read mip level layout from " + filename, -1);
+			}
+			if (swap) {
+				imageSize = swapEndianness(imageSize);
+			}
+			offsets[level] = offset + sizeof(imageSize);
+			sizes[level] = imageSize;
+			// Level data is padded to a multiple of four bytes
+			offset += sizeof(imageSize) + ((imageSize + 3) & ~3);
+		}
+	}
+
+	static VkDeviceSize alignedOffset(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	/**
+	* Load a 2D texture with only its mip tail resident, and register the remaining levels for streaming
+	*
+	* @param filename File to load (supports uncompressed and block compressed .ktx)
+	* @param format Vulkan format of the image data stored in the file
+	* @param device Vulkan device to create the texture on
+	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
+	* @param streamer Streamer that loads the remaining levels in the background, if nullptr all levels are loaded right away
+	* @param (Optional) mipTailSize Levels with a width and height up to this size are uploaded right away (defaults to 128)
+	*
+	*/
+	void StreamingTexture2D::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, vks::TextureStreamer *streamer, uint32_t mipTailSize)
+	{
+		this->device = device;
+		this->filename = filename;
+		this->format = format;
+		sampler = VK_NULL_HANDLE;
+		layerCount = 1;
+
+#if !defined(__ANDROID__)
+		if (!vks::tools::fileExists(filename)) {
+			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nMake sure the assets submodule has been checked out and is up-to-date.", -1);
+		}
+#endif
+		readKTXLevelLayout(filename, width, height, levelOffsets, levelSizes);
+		mipLevels = static_cast<uint32_t>(levelSizes.size());
+
+		// The mip tail starts at the first level that fits into the requested size
+		uint32_t tailLevel = 0;
+		if (streamer) {
+			while ((tailLevel < mipLevels - 1) && (std::max(width >> tailLevel, height >> tailLevel) > mipTailSize)) {
+				tailLevel++;
+			}
+		}
+		residentMipLevel = tailLevel;
+
+		// The image is created with the full mip chain, so streamed levels can be copied into it later on
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.mipLevels = mipLevels;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { width, height, 1 };
+		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+
+		// Read the mip tail straight into a host visible staging buffer
+		const VkDeviceSize alignment = std::max<VkDeviceSize>(16, device->properties.limits.optimalBufferCopyOffsetAlignment);
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		VkDeviceSize stagingSize = 0;
+		for (uint32_t level = tailLevel; level < mipLevels; level++) {
+			VkBufferImageCopy bufferCopyRegion = {};
+			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferCopyRegion.imageSubresource.mipLevel = level;
+			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+			bufferCopyRegion.imageSubresource.layerCount = 1;
+			bufferCopyRegion.imageExtent.width = std::max(1u, width >> level);
+			bufferCopyRegion.imageExtent.height = std::max(1u, height >> level);
+			bufferCopyRegion.imageExtent.depth = 1;
+			bufferCopyRegion.bufferOffset = stagingSize;
+			bufferCopyRegions.push_back(bufferCopyRegion);
+			stagingSize = alignedOffset(stagingSize + levelSizes[level], alignment);
+		}
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, stagingSize));
+		VK_CHECK_RESULT(stagingBuffer.map());
+		for (auto& region : bufferCopyRegions) {
+			const uint32_t level = region.imageSubresource.mipLevel;
+			if (!readFileRange(filename, levelOffsets[level], levelSizes[level], (uint8_t*)stagingBuffer.mapped + region.bufferOffset)) {
+				vks::tools::exitFatal("Could not read mip level " + std::to_string(level) + " from " + filename, -1);
+			}
+		}
+		stagingBuffer.unmap();
+
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+		// All levels are transitioned, so the whole image is in the same layout as the view covering it
+		// Levels that are not yet resident are never sampled as the sampler's minLod excludes them
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout, subresourceRange);
+
+		device->flushCommandBuffer(copyCmd, copyQueue);
+		stagingBuffer.destroy();
+
+		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = format;
+		viewCreateInfo.subresourceRange = subresourceRange;
+		viewCreateInfo.image = image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
+
+		updateSampler();
+
+		if (residentMipLevel > 0) {
+			streamer->add(this);
+		}
+	}
+
+	bool StreamingTexture2D::fullyResident() const
+	{
+		return residentMipLevel == 0;
+	}
+
+	// (Re)creates the sampler with the lod clamped to the finest resident mip level
+	void StreamingTexture2D::updateSampler()
+	{
+		if (sampler != VK_NULL_HANDLE) {
+			vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		}
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
+		samplerCreateInfo.minLod = (float)residentMipLevel;
+		samplerCreateInfo.maxLod = (float)mipLevels;
+		samplerCreateInfo.maxAnisotropy = device->enabledFeatures.samplerAnisotropy ? device->properties.limits.maxSamplerAnisotropy : 1.0f;
+		samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		updateDescriptor();
+	}
+
+	/**
+	* Create the upload resources and start the background I/O thread
+	*
+	* @param device Vulkan device the streamed textures are created on
+	* @param transferQueue Queue of the graphics queue family used for the level uploads
+	*/
+	void TextureStreamer::create(vks::VulkanDevice *device, VkQueue transferQueue)
+	{
+		this->device = device;
+		this->transferQueue = transferQueue;
+		commandPool = device->createCommandPool(device->queueFamilyIndices.graphics);
+		commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool);
+		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
+		VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceCreateInfo, nullptr, &fence));
+		createStagingBuffer(uploadBudget);
+		destroying = false;
+		ioThread = std::thread(&TextureStreamer::ioLoop, this);
+	}
+
+	/**
+	* Stop the I/O thread and release all upload resources
+	*
+	* @note Must be called before destroying any of the textures registered with this streamer
+	*/
+	void TextureStreamer::destroy()
+	{
+		if (!ioThread.joinable()) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			destroying = true;
+		}
+		condition.notify_one();
+		ioThread.join();
+		if (!inFlight.empty()) {
+			VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			inFlight.clear();
+		}
+		pendingLoads.clear();
+		loadedLevels.clear();
+		vkDestroyFence(device->logicalDevice, fence, nullptr);
+		vkFreeCommandBuffers(device->logicalDevice, commandPool, 1, &commandBuffer);
+		vkDestroyCommandPool(device->logicalDevice, commandPool, nullptr);
+		staging.destroy();
+	}
+
+	// Queues all levels above the texture's mip tail for loading
+	void TextureStreamer::add(StreamingTexture2D *texture)
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		for (int32_t level = (int32_t)texture->residentMipLevel - 1; level >= 0; level--) {
+			pendingLoads.push_back({ texture, (uint32_t)level, {} });
+		}
+		condition.notify_one();
+	}
+
+	void TextureStreamer::ioLoop()
+	{
+		while (true)
+		{
+			LevelRequest request;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				condition.wait(lock, [this] { return !pendingLoads.empty() || destroying; });
+				if (destroying)
+				{
+					break;
+				}
+				// Always load the coarsest pending level over all textures next, so the whole scene refines evenly
+				auto next = std::max_element(pendingLoads.begin(), pendingLoads.end(), [](const LevelRequest &a, const LevelRequest &b) { return a.level < b.level; });
+				request = std::move(*next);
+				pendingLoads.erase(next);
+				activeLoads++;
+			}
+
+			StreamingTexture2D *texture = request.texture;
+			request.data.resize(texture->levelSizes[request.level]);
+			bool loaded = readFileRange(texture->filename, texture->levelOffsets[request.level], texture->levelSizes[request.level], request.data.data());
+
+			std::lock_guard<std::mutex> lock(queueMutex);
+			activeLoads--;
+			if (loaded) {
+				loadedLevels.push_back(std::move(request));
+			} else {
+				// Finer levels can't become resident without this one, so the texture stays at its current level
+				std::cerr << "Could not stream mip level " << request.level << " from " << texture->filename << "\n";
+				pendingLoads.erase(std::remove_if(pendingLoads.begin(), pendingLoads.end(), [texture](const LevelRequest &r) { return r.texture == texture; }), pendingLoads.end());
+			}
+		}
+	}
+
+	void TextureStreamer::createStagingBuffer(VkDeviceSize size)
+	{
+		if (staging.buffer != VK_NULL_HANDLE) {
+			staging.destroy();
+		}
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging, size));
+		VK_CHECK_RESULT(staging.map());
+	}
+
+	/**
+	* Make levels of the last upload resident and submit the next batch of loaded levels
+	*
+	* @note Call once per frame at a point where the samplers of the streamed textures aren't in use by the GPU, e.g. before submitting the frame's command buffers after the queue has been waited on
+	*
+	* @return True if the samplers (and with it the descriptors) of at least one texture have changed
+	*/
+	bool TextureStreamer::update()
+	{
+		bool residencyChanged = false;
+
+		// Levels of the previous submission become resident once the GPU has finished copying them
+		if (!inFlight.empty()) {
+			if (vkGetFenceStatus(device->logicalDevice, fence) != VK_SUCCESS) {
+				return false;
+			}
+			for (size_t i = 0; i < inFlight.size(); i++) {
+				StreamingTexture2D *texture = inFlight[i].texture;
+				texture->residentMipLevel = std::min(texture->residentMipLevel, inFlight[i].level);
+				// Only recreate the sampler once for the finest level of a texture uploaded with this batch
+				bool finestOfBatch = true;
+				for (size_t j = i + 1; j < inFlight.size(); j++) {
+					finestOfBatch &= (inFlight[j].texture != texture);
+				}
+				if (finestOfBatch) {
+					texture->updateSampler();
+				}
+			}
+			inFlight.clear();
+			residencyChanged = true;
+		}
+
+		// Take as many loaded levels as fit into the upload budget
+		const VkDeviceSize alignment = std::max<VkDeviceSize>(16, device->properties.limits.optimalBufferCopyOffsetAlignment);
+		VkDeviceSize batchSize = 0;
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			while (!loadedLevels.empty()) {
+				const VkDeviceSize levelSize = alignedOffset(loadedLevels.front().data.size(), alignment);
+				if (!inFlight.empty() && (batchSize + levelSize > uploadBudget)) {
+					break;
+				}
+				batchSize += levelSize;
+				inFlight.push_back(std::move(loadedLevels.front()));
+				loadedLevels.pop_front();
+			}
+		}
+		if (inFlight.empty()) {
+			return residencyChanged;
+		}
+
+		if (staging.size < batchSize) {
+			createStagingBuffer(batchSize);
+		}
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		VkDeviceSize offset = 0;
+		for (auto& request : inFlight) {
+			memcpy((uint8_t*)staging.mapped + offset, request.data.data(), request.data.size());
+
+			StreamingTexture2D *texture = request.texture;
+			VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, request.level, 1, 0, 1 };
+			vks::tools::setImageLayout(commandBuffer, texture->image, texture->imageLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+			VkBufferImageCopy bufferCopyRegion = {};
+			bufferCopyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, request.level, 0, 1 };
+			bufferCopyRegion.imageExtent = { std::max(1u, texture->width >> request.level), std::max(1u, texture->height >> request.level), 1 };
+			bufferCopyRegion.bufferOffset = offset;
+			vkCmdCopyBufferToImage(commandBuffer, staging.buffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+			vks::tools::setImageLayout(commandBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture->imageLayout, subresourceRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+			offset = alignedOffset(offset + request.data.size(), alignment);
+			statistics.levelsUploaded++;
+			statistics.bytesUploaded += request.data.size();
+			// The level's data is no longer needed on the host
+			std::vector<uint8_t>().swap(request.data);
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &fence));
+		VK_CHECK_RESULT(vkQueueSubmit(transferQueue, 1, &submitInfo, fence));
+
+		return residencyChanged;
+	}
+
+	// Returns true if all registered textures have been fully streamed in
+	bool TextureStreamer::idle()
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		return pendingLoads.empty() && loadedLevels.empty() && inFlight.empty() && (activeLoads == 0);
+	}
+
+	TextureStreamer::Statistics TextureStreamer::getStatistics()
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		statistics.levelsPending = static_cast<uint32_t>(pendingLoads.size() + loadedLevels.size() + inFlight.size()) + activeLoads;
+		return statistics;
+	}
+}
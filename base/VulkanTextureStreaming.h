@@ -0,0 +1,118 @@
+/*
+* Vulkan texture streaming
+*
+* Textures become usable as soon as their smallest mip levels (the mip tail) are resident,
+* finer levels are read by a background thread and uploaded under a per-frame byte budget
+*
+* Copyright(C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "vulkan/vulkan.h"
+
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanTexture.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+class TextureStreamer;
+
+/**
+* @brief 2D texture loaded from a ktx file that is made resident from its smallest mip level upwards
+* @note The sampler's minLod is clamped to the finest resident level, so shaders never sample levels that haven't been uploaded yet
+*/
+class StreamingTexture2D : public Texture
+{
+  public:
+	std::string filename;
+	VkFormat    format;
+	/** @brief Finest mip level that is currently resident (0 once the texture has been fully streamed in) */
+	uint32_t    residentMipLevel;
+	/** @brief File offset and size of the image data of each mip level */
+	std::vector<VkDeviceSize> levelOffsets;
+	std::vector<VkDeviceSize> levelSizes;
+
+	void loadFromFile(
+	    std::string           filename,
+	    VkFormat              format,
+	    vks::VulkanDevice *   device,
+	    VkQueue               copyQueue,
+	    vks::TextureStreamer *streamer,
+	    uint32_t              mipTailSize = 128);
+	bool fullyResident() const;
+
+  private:
+	friend class TextureStreamer;
+	void updateSampler();
+};
+
+/**
+* @brief Streams mip levels of StreamingTexture2D objects in from disk
+* @note Levels are read on a background thread, coarsest levels first over all registered textures
+* @note update() uploads finished levels on the render thread and must be called at a point where the texture samplers aren't used by pending command buffers
+*/
+class TextureStreamer
+{
+  public:
+	/** @brief Maximum number of bytes uploaded per call to update(), a single level larger than this is still uploaded on its own */
+	VkDeviceSize uploadBudget = 4 * 1024 * 1024;
+
+	struct Statistics
+	{
+		uint32_t     levelsPending = 0;
+		uint32_t     levelsUploaded = 0;
+		VkDeviceSize bytesUploaded = 0;
+	};
+
+	void create(vks::VulkanDevice *device, VkQueue transferQueue);
+	void destroy();
+	void add(StreamingTexture2D *texture);
+	bool update();
+	bool idle();
+	Statistics getStatistics();
+
+  private:
+	struct LevelRequest
+	{
+		StreamingTexture2D * texture;
+		uint32_t             level;
+		std::vector<uint8_t> data;
+	};
+
+	vks::VulkanDevice *device = nullptr;
+	VkQueue            transferQueue;
+	VkCommandPool      commandPool = VK_NULL_HANDLE;
+	VkCommandBuffer    commandBuffer = VK_NULL_HANDLE;
+	VkFence            fence = VK_NULL_HANDLE;
+	vks::Buffer        staging;
+
+	std::thread             ioThread;
+	std::mutex              queueMutex;
+	std::condition_variable condition;
+	bool                    destroying = false;
+	// Number of levels currently being read by the I/O thread
+	uint32_t                activeLoads = 0;
+	// Levels waiting to be read from disk
+	std::vector<LevelRequest> pendingLoads;
+	// Levels read from disk waiting to be uploaded
+	std::deque<LevelRequest> loadedLevels;
+	// Levels uploaded with the last submission, made resident once its fence has been signaled
+	std::vector<LevelRequest> inFlight;
+	Statistics                statistics;
+
+	void ioLoop();
+	void createStagingBuffer(VkDeviceSize size);
+};
+}        // namespace vks
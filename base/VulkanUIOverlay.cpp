@@ -310,47 +310,81 @@ namespace vks
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 	}
 
-	/** Update vertex and index buffer containing the imGui elements when required */
+	/**
+	* Makes sure a geometry buffer can hold the given size
+	* Buffers grow geometrically and are only shrunk after their usage stayed low for shrinkDelay updates, so changing text doesn't recreate them
+	* @return True if the buffer has been (re)created
+	*/
+	bool UIOverlay::reserve(vks::Buffer &buffer, VkBufferUsageFlags usage, VkDeviceSize size, uint32_t &lowUsage)
+	{
+		VkDeviceSize capacity;
+		if ((buffer.buffer != VK_NULL_HANDLE) && (size <= buffer.size)) {
+			if (size * 4 >= buffer.size) {
+				lowUsage = 0;
+				return false;
+			}
+			if (++lowUsage < shrinkDelay) {
+				return false;
+			}
+			capacity = buffer.size / 2;
+		}
+		else {
+			capacity = std::max(size, buffer.size * 2);
+		}
+		buffer.unmap();
+		buffer.destroy();
+		buffer = vks::Buffer();
+		// Coherent memory stays mapped for the lifetime of the buffer and doesn't need to be flushed after writes
+		VK_CHECK_RESULT(device->createBuffer(usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, capacity));
+		VK_CHECK_RESULT(buffer.map());
+		lowUsage = 0;
+		return true;
+	}
+
+	uint32_t UIOverlay::currentSlot() const
+	{
+		return slotIndex;
+	}
+
+	uint32_t UIOverlay::nextSlot() const
+	{
+		return slots.empty() ? 0 : (slotIndex + 1) % static_cast<uint32_t>(slots.size());
+	}
+
+	/**
+	* Writes the imGui elements to the next geometry slot
+	* @return True if command buffers drawing the overlay need to be rebuilt, because a buffer has been recreated or the draw commands changed
+	*/
 	bool UIOverlay::update()
 	{
 		ImDrawData* imDrawData = ImGui::GetDrawData();
-		bool updateCmdBuffers = false;
 
 		if (!imDrawData) { return false; };
 
-		// Note: Alignment is done inside buffer creation
 		VkDeviceSize vertexBufferSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
 		VkDeviceSize indexBufferSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
 
-		// Update buffers only if vertex or index count has been changed compared to current buffer size
 		if ((vertexBufferSize == 0) || (indexBufferSize == 0)) {
 			return false;
 		}
 
-		// Vertex buffer
-		if ((vertexBuffer.buffer == VK_NULL_HANDLE) || (vertexCount != imDrawData->TotalVtxCount)) {
-			vertexBuffer.unmap();
-			vertexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &vertexBuffer, vertexBufferSize));
-			vertexCount = imDrawData->TotalVtxCount;
-			vertexBuffer.unmap();
-			vertexBuffer.map();
-			updateCmdBuffers = true;
+		if (slots.empty()) {
+			slots.resize(std::max(slotCount, 1u));
+			slotIndex = static_cast<uint32_t>(slots.size()) - 1;
 		}
+		const uint32_t index = nextSlot();
+		GeometrySlot &slot = slots[index];
 
-		// Index buffer
-		if ((indexBuffer.buffer == VK_NULL_HANDLE) || (indexCount < imDrawData->TotalIdxCount)) {
-			indexBuffer.unmap();
-			indexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &indexBuffer, indexBufferSize));
-			indexCount = imDrawData->TotalIdxCount;
-			indexBuffer.map();
-			updateCmdBuffers = true;
-		}
+		bool updateCmdBuffers = reserve(slot.vertexBuffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBufferSize, slot.vertexLowUsage);
+		updateCmdBuffers |= reserve(slot.indexBuffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBufferSize, slot.indexLowUsage);
+		// Draw commands recorded for the previous geometry use its counts
+		updateCmdBuffers |= (vertexCount != imDrawData->TotalVtxCount) || (indexCount != imDrawData->TotalIdxCount);
+		vertexCount = imDrawData->TotalVtxCount;
+		indexCount = imDrawData->TotalIdxCount;
 
 		// Upload data
-		ImDrawVert* vtxDst = (ImDrawVert*)vertexBuffer.mapped;
-		ImDrawIdx* idxDst = (ImDrawIdx*)indexBuffer.mapped;
+		ImDrawVert* vtxDst = (ImDrawVert*)slot.vertexBuffer.mapped;
+		ImDrawIdx* idxDst = (ImDrawIdx*)slot.indexBuffer.mapped;
 
 		for (int n = 0; n < imDrawData->CmdListsCount; n++) {
 			const ImDrawList* cmd_list = imDrawData->CmdLists[n];
@@ -360,9 +394,7 @@ namespace vks
 			idxDst += cmd_list->IdxBuffer.Size;
 		}
 
-		// Flush to make writes visible to GPU
-		vertexBuffer.flush();
-		indexBuffer.flush();
+		slotIndex = index;
 
 		return updateCmdBuffers;
 	}
@@ -373,9 +405,10 @@ namespace vks
 		int32_t vertexOffset = 0;
 		int32_t indexOffset = 0;
 
-		if ((!imDrawData) || (imDrawData->CmdListsCount == 0)) {
+		if ((!imDrawData) || (imDrawData->CmdListsCount == 0) || slots.empty() || (slots[slotIndex].vertexBuffer.buffer == VK_NULL_HANDLE)) {
 			return;
 		}
+		const GeometrySlot &slot = slots[slotIndex];
 
 		ImGuiIO& io = ImGui::GetIO();
 
@@ -387,8 +420,8 @@ namespace vks
 		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 
 		VkDeviceSize offsets[1] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &slot.vertexBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, slot.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
 
 		for (int32_t i = 0; i < imDrawData->CmdListsCount; i++)
 		{
@@ -417,8 +450,13 @@ namespace vks
 
 	void UIOverlay::freeResources()
 	{
-		vertexBuffer.destroy();
-		indexBuffer.destroy();
+		for (auto &slot : slots) {
+			slot.vertexBuffer.unmap();
+			slot.vertexBuffer.destroy();
+			slot.indexBuffer.unmap();
+			slot.indexBuffer.destroy();
+		}
+		slots.clear();
 		vkDestroyImageView(device->logicalDevice, fontView, nullptr);
 		vkDestroyImage(device->logicalDevice, fontImage, nullptr);
 		vkFreeMemory(device->logicalDevice, fontMemory, nullptr);
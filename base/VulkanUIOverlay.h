@@ -39,8 +39,19 @@ namespace vks
 		VkSampleCountFlagBits rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 		uint32_t subpass = 0;
 
-		vks::Buffer vertexBuffer;
-		vks::Buffer indexBuffer;
+		/** @brief Persistently mapped vertex and index buffers for one update of the overlay geometry */
+		struct GeometrySlot {
+			vks::Buffer vertexBuffer;
+			vks::Buffer indexBuffer;
+			// Number of consecutive updates that used less than a quarter of the buffer, used to shrink it with hysteresis
+			uint32_t vertexLowUsage = 0;
+			uint32_t indexLowUsage = 0;
+		};
+		/** @brief Number of geometry slots updates cycle through, more than one lets frames in flight keep reading the geometry they were recorded with */
+		uint32_t slotCount = 1;
+		/** @brief Number of consecutive updates using less than a quarter of a buffer before it's shrunk to half its size */
+		uint32_t shrinkDelay = 300;
+		/** @brief Vertex and index count of the last update */
 		int32_t vertexCount = 0;
 		int32_t indexCount = 0;
 
@@ -75,6 +86,10 @@ namespace vks
 		bool update();
 		void draw(const VkCommandBuffer commandBuffer);
 		void resize(uint32_t width, uint32_t height);
+		/** @brief Slot read by draw(), i.e. the one written by the last update */
+		uint32_t currentSlot() const;
+		/** @brief Slot the next update writes to */
+		uint32_t nextSlot() const;
 
 		void freeResources();
 
@@ -89,5 +104,10 @@ namespace vks
 		bool button(const char* caption);
 		bool colorPicker(const char* caption, float* color);
 		void text(const char* formatstr, ...);
+
+	private:
+		std::vector<GeometrySlot> slots;
+		uint32_t slotIndex = 0;
+		bool reserve(vks::Buffer &buffer, VkBufferUsageFlags usage, VkDeviceSize size, uint32_t &lowUsage);
 	};
 }
@@ -12,6 +12,7 @@
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 
 #include "VulkanglTFModel.h"
+#include "cpuprofiler.hpp"
 
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
@@ -435,14 +436,8 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 /*
 	glTF material
 */
-void vkglTF::Material::createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags)
+void vkglTF::Material::createDescriptorSet(vks::DescriptorAllocator &descriptorAllocator, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags)
 {
-	VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-	descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	descriptorSetAllocInfo.descriptorPool = descriptorPool;
-	descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
-	descriptorSetAllocInfo.descriptorSetCount = 1;
-	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &descriptorSet));
 	std::vector<VkDescriptorImageInfo> imageDescriptors{};
 	std::vector<VkWriteDescriptorSet> writeDescriptorSets{};
 	if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
@@ -451,7 +446,6 @@ void vkglTF::Material::createDescriptorSet(VkDescriptorPool descriptorPool, VkDe
 		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.dstSet = descriptorSet;
 		writeDescriptorSet.dstBinding = static_cast<uint32_t>(writeDescriptorSets.size());
 		writeDescriptorSet.pImageInfo = &baseColorTexture->descriptor;
 		writeDescriptorSets.push_back(writeDescriptorSet);
@@ -462,12 +456,12 @@ void vkglTF::Material::createDescriptorSet(VkDescriptorPool descriptorPool, VkDe
 		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.dstSet = descriptorSet;
 		writeDescriptorSet.dstBinding = static_cast<uint32_t>(writeDescriptorSets.size());
 		writeDescriptorSet.pImageInfo = &normalTexture->descriptor;
 		writeDescriptorSets.push_back(writeDescriptorSet);
 	}
-	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	// Materials sampling the same images (e.g. from a texture atlas) share a descriptor set
+	descriptorSet = descriptorAllocator.getCached(descriptorSetLayout, writeDescriptorSets);
 }
 
 
@@ -738,6 +732,9 @@ vkglTF::Model::~Model()
 	for (auto texture : textures) {
 		texture.destroy();
 	}
+	for (auto texture : atlasTextures) {
+		texture.destroy();
+	}
 	for (auto node : nodes) {
 		delete node;
 	}
@@ -752,7 +749,9 @@ vkglTF::Model::~Model()
 		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutImage, nullptr);
 		descriptorSetLayoutImage = VK_NULL_HANDLE;
 	}
-	vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+	if (descriptorAllocator) {
+		descriptorAllocator->destroy();
+	}
 	emptyTexture.destroy();
 }
 
@@ -1050,6 +1049,181 @@ void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
 	materials.push_back(Material(device));
 }
 
+/*
+	Packs the base color and normal map images of all materials that can be drawn from an atlas into one atlas per image type
+	Materials sharing a combination of images share a region, so they end up with identical descriptor sets
+	Only materials that sample nothing but a base color and an optional normal map with matching dimensions and only use texture coordinates inside [0..1] can be packed,
+	images stored in ktx files are skipped as they may use compressed formats
+*/
+void vkglTF::Model::packImages(tinygltf::Model &gltfModel, std::vector<Vertex>& vertexBuffer, VkQueue transferQueue)
+{
+	// Atlas textures are clamped, so materials with wrapping texture coordinates have to keep their own textures
+	std::vector<bool> wrapsCoordinates(materials.size(), false);
+	for (Node* node : linearNodes) {
+		if (node->mesh) {
+			for (Primitive* primitive : node->mesh->primitives) {
+				const size_t materialIndex = &primitive->material - materials.data();
+				for (uint32_t i = 0; i < primitive->vertexCount; i++) {
+					const glm::vec2 &uv = vertexBuffer[primitive->firstVertex + i].uv;
+					if ((uv.x < 0.0f) || (uv.x > 1.0f) || (uv.y < 0.0f) || (uv.y > 1.0f)) {
+						wrapsCoordinates[materialIndex] = true;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	auto getImageIndex = [this](vkglTF::Texture* texture) -> int32_t {
+		if ((texture == nullptr) || (texture == &emptyTexture)) {
+			return -1;
+		}
+		return static_cast<int32_t>(texture - textures.data());
+	};
+	auto packable = [&gltfModel](int32_t imageIndex) {
+		const tinygltf::Image &image = gltfModel.images[imageIndex];
+		return !image.image.empty() && (image.bits == 8) && ((image.component == 3) || (image.component == 4));
+	};
+
+	// Assign an atlas region to each combination of base color and normal map images
+	vks::TextureAtlasLayout layout;
+	layout.layerSize = std::min(4096u, device->properties.limits.maxImageDimension2D);
+	std::map<std::pair<int32_t, int32_t>, uint32_t> regionIndices;
+	std::vector<std::pair<int32_t, int32_t>> regionImages;
+	std::vector<int32_t> materialRegions(materials.size(), -1);
+	for (size_t i = 0; i < materials.size(); i++) {
+		Material &material = materials[i];
+		if (wrapsCoordinates[i] || material.metallicRoughnessTexture || material.occlusionTexture || material.emissiveTexture) {
+			continue;
+		}
+		const int32_t baseColor = getImageIndex(material.baseColorTexture);
+		const int32_t normal = getImageIndex(material.normalTexture);
+		if ((baseColor < 0) || !packable(baseColor)) {
+			continue;
+		}
+		if (normal >= 0) {
+			if (!packable(normal) || (gltfModel.images[normal].width != gltfModel.images[baseColor].width) || (gltfModel.images[normal].height != gltfModel.images[baseColor].height)) {
+				continue;
+			}
+		}
+		const std::pair<int32_t, int32_t> key(baseColor, normal);
+		if (regionIndices.find(key) == regionIndices.end()) {
+			regionIndices[key] = layout.add(gltfModel.images[baseColor].width, gltfModel.images[baseColor].height);
+			regionImages.push_back(key);
+		}
+		materialRegions[i] = regionIndices[key];
+	}
+	if (layout.regions.empty() || (layout.pack() == 0)) {
+		return;
+	}
+
+	// Gather RGBA image data for all regions
+	std::vector<std::vector<uint8_t>> rgbaImages(gltfModel.images.size());
+	auto getImageData = [&gltfModel, &rgbaImages](int32_t imageIndex) -> const uint8_t* {
+		if (imageIndex < 0) {
+			return nullptr;
+		}
+		tinygltf::Image &image = gltfModel.images[imageIndex];
+		if (image.component == 4) {
+			return image.image.data();
+		}
+		std::vector<uint8_t> &rgba = rgbaImages[imageIndex];
+		if (rgba.empty()) {
+			const size_t pixelCount = static_cast<size_t>(image.width) * static_cast<size_t>(image.height);
+			rgba.resize(pixelCount * 4);
+			for (size_t i = 0; i < pixelCount; i++) {
+				rgba[i * 4] = image.image[i * 3];
+				rgba[i * 4 + 1] = image.image[i * 3 + 1];
+				rgba[i * 4 + 2] = image.image[i * 3 + 2];
+				rgba[i * 4 + 3] = 255;
+			}
+		}
+		return rgba.data();
+	};
+	std::vector<const uint8_t*> baseColorImages(layout.regions.size());
+	std::vector<const uint8_t*> normalImages(layout.regions.size());
+	bool hasNormalMaps = false;
+	for (size_t i = 0; i < layout.regions.size(); i++) {
+		baseColorImages[i] = getImageData(regionImages[i].first);
+		normalImages[i] = getImageData(regionImages[i].second);
+		hasNormalMaps |= (normalImages[i] != nullptr);
+	}
+
+	// Materials keep pointers to the atlas textures, so the vector must not be resized afterwards
+	// The atlases use a single layer with a 2D view, so existing shaders sampling a sampler2D can be used unmodified
+	atlasTextures.resize(hasNormalMaps ? 2 : 1);
+	auto createAtlasTexture = [this, &layout, transferQueue](const std::vector<const uint8_t*> &images, vkglTF::Texture &texture) {
+		vks::TextureAtlas atlas;
+		atlas.fromLayout(layout, images, device, transferQueue, VK_IMAGE_VIEW_TYPE_2D);
+		// Ownership of the Vulkan objects is passed to the glTF texture
+		texture.device = device;
+		texture.image = atlas.image;
+		texture.imageLayout = atlas.imageLayout;
+		texture.deviceMemory = atlas.deviceMemory;
+		texture.view = atlas.view;
+		texture.width = atlas.width;
+		texture.height = atlas.height;
+		texture.mipLevels = atlas.mipLevels;
+		texture.layerCount = atlas.layerCount;
+		texture.sampler = atlas.sampler;
+		texture.updateDescriptor();
+	};
+	createAtlasTexture(baseColorImages, atlasTextures[0]);
+	if (hasNormalMaps) {
+		createAtlasTexture(normalImages, atlasTextures[1]);
+	}
+
+	// Remap texture coordinates of all primitives using packed materials
+	for (Node* node : linearNodes) {
+		if (node->mesh) {
+			for (Primitive* primitive : node->mesh->primitives) {
+				const int32_t region = materialRegions[&primitive->material - materials.data()];
+				if ((region < 0) || !layout.regions[region].packed) {
+					continue;
+				}
+				for (uint32_t i = 0; i < primitive->vertexCount; i++) {
+					Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
+					vertex.uv = layout.remap(region, vertex.uv);
+				}
+			}
+		}
+	}
+
+	uint32_t packedMaterials = 0;
+	for (size_t i = 0; i < materials.size(); i++) {
+		const int32_t region = materialRegions[i];
+		if ((region < 0) || !layout.regions[region].packed) {
+			continue;
+		}
+		materials[i].baseColorTexture = &atlasTextures[0];
+		if (regionImages[region].second >= 0) {
+			materials[i].normalTexture = &atlasTextures[1];
+		}
+		packedMaterials++;
+	}
+
+	// Release source textures that are no longer referenced by any material
+	std::vector<bool> referenced(textures.size(), false);
+	for (auto& material : materials) {
+		for (vkglTF::Texture* texture : { material.baseColorTexture, material.metallicRoughnessTexture, material.normalTexture, material.occlusionTexture, material.emissiveTexture }) {
+			const int32_t imageIndex = getImageIndex(texture);
+			if ((imageIndex >= 0) && (imageIndex < static_cast<int32_t>(textures.size()))) {
+				referenced[imageIndex] = true;
+			}
+		}
+	}
+	for (auto& key : regionImages) {
+		for (int32_t imageIndex : { key.first, key.second }) {
+			if ((imageIndex >= 0) && !referenced[imageIndex] && textures[imageIndex].device) {
+				textures[imageIndex].destroy();
+				textures[imageIndex].device = nullptr;
+			}
+		}
+	}
+
+	std::cout << "Packed " << packedMaterials << " of " << materials.size() - 1 << " materials into a " << layout.layerSize << " x " << layout.layerSize << " texture atlas" << std::endl;
+}
+
 void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 {
 	for (tinygltf::Animation &anim : gltfModel.animations) {
@@ -1166,6 +1340,7 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 
 void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
 {
+	VKS_PROFILE_SCOPE("vkglTF::Model::loadFromFile");
 	tinygltf::Model gltfModel;
 	tinygltf::TinyGLTF gltfContext;
 	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
@@ -1265,6 +1440,10 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		}
 	}
 
+	if ((fileLoadingFlags & FileLoadingFlags::PackImagesToAtlas) && !(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+		packImages(gltfModel, vertexBuffer, transferQueue);
+	}
+
 	size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
 	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
 	indices.count = static_cast<uint32_t>(indexBuffer.size());
@@ -1332,35 +1511,24 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	getSceneDimensions();
 
 	// Setup descriptors
-	uint32_t uboCount{ 0 };
-	uint32_t imageCount{ 0 };
+	// The first pool is sized for the model's sets, so a single pool is enough unless sets are allocated later on
+	uint32_t setCount{ 0 };
 	for (auto node : linearNodes) {
 		if (node->mesh) {
-			uboCount++;
+			setCount++;
 		}
 	}
 	for (auto material : materials) {
 		if (material.baseColorTexture != nullptr) {
-			imageCount++;
+			setCount++;
 		}
 	}
-	std::vector<VkDescriptorPoolSize> poolSizes = {
-		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uboCount },
+	descriptorAllocator.reset(new vks::DescriptorAllocator());
+	descriptorAllocator->create(device->logicalDevice, 0, setCount);
+	descriptorAllocator->poolSizeRatios = {
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f },
 	};
-	if (imageCount > 0) {
-		if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
-			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
-		}
-		if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
-			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
-		}
-	}
-	VkDescriptorPoolCreateInfo descriptorPoolCI{};
-	descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-	descriptorPoolCI.pPoolSizes = poolSizes.data();
-	descriptorPoolCI.maxSets = uboCount + imageCount;
-	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
 
 	// Descriptors for per-node uniform buffers
 	{
@@ -1398,9 +1566,10 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutImage));
 		}
 		for (auto& material : materials) {
-			if (material.baseColorTexture != nullptr) {
-				material.createDescriptorSet(descriptorPool, vkglTF::descriptorSetLayoutImage, descriptorBindingFlags);
+			if (material.baseColorTexture == nullptr) {
+				continue;
 			}
+			material.createDescriptorSet(*descriptorAllocator, vkglTF::descriptorSetLayoutImage, descriptorBindingFlags);
 		}
 	}
 }
@@ -1414,6 +1583,13 @@ void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
 }
 
 void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+{
+	VkDescriptorSet boundImageSet = VK_NULL_HANDLE;
+	drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet, boundImageSet);
+}
+
+// Skips binding the material's image descriptor set if it's already bound
+void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, VkDescriptorSet &boundImageSet)
 {
 	if (node->mesh) {
 		for (Primitive* primitive : node->mesh->primitives) {
@@ -1429,15 +1605,16 @@ void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t
 				skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
 			}
 			if (!skip) {
-				if (renderFlags & RenderFlags::BindImages) {
+				if ((renderFlags & RenderFlags::BindImages) && (material.descriptorSet != boundImageSet)) {
 					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
+					boundImageSet = material.descriptorSet;
 				}
 				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
 			}
 		}
 	}
 	for (auto& child : node->children) {
-		drawNode(child, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
+		drawNode(child, commandBuffer, renderFlags, pipelineLayout, bindImageSet, boundImageSet);
 	}
 }
 
@@ -1448,8 +1625,9 @@ void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, Vk
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
 		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 	}
+	VkDescriptorSet boundImageSet = VK_NULL_HANDLE;
 	for (auto& node : nodes) {
-		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
+		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet, boundImageSet);
 	}
 }
 
@@ -1571,12 +1749,7 @@ vkglTF::Node* vkglTF::Model::nodeFromIndex(uint32_t index) {
 
 void vkglTF::Model::prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout) {
 	if (node->mesh) {
-		VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-		descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		descriptorSetAllocInfo.descriptorPool = descriptorPool;
-		descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
-		descriptorSetAllocInfo.descriptorSetCount = 1;
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &node->mesh->uniformBuffer.descriptorSet));
+		node->mesh->uniformBuffer.descriptorSet = descriptorAllocator->allocate(descriptorSetLayout);
 
 		VkWriteDescriptorSet writeDescriptorSet{};
 		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
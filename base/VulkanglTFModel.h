@@ -12,6 +12,7 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <memory>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
@@ -25,6 +26,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "VulkanTextureAtlas.h"
+#include "VulkanDescriptorAllocator.h"
+
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 #ifdef VK_USE_PLATFORM_ANDROID_KHR
 #define TINYGLTF_ANDROID_LOAD_FROM_ASSETS
@@ -91,7 +95,7 @@ namespace vkglTF
 		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 
 		Material(vks::VulkanDevice* device) : device(device) {};
-		void createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
+		void createDescriptorSet(vks::DescriptorAllocator &descriptorAllocator, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
 	};
 
 	/*
@@ -233,7 +237,9 @@ namespace vkglTF
 		PreTransformVertices = 0x00000001,
 		PreMultiplyVertexColors = 0x00000002,
 		FlipY = 0x00000004,
-		DontLoadImages = 0x00000008
+		DontLoadImages = 0x00000008,
+		// Packs the images of materials into texture atlases and remaps their texture coordinates (see Model::packImages)
+		PackImagesToAtlas = 0x00000010
 	};
 
 	enum RenderFlags {
@@ -251,9 +257,12 @@ namespace vkglTF
 		vkglTF::Texture* getTexture(uint32_t index);
 		vkglTF::Texture emptyTexture;
 		void createEmptyTexture(VkQueue transferQueue);
+		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, VkDescriptorSet& boundImageSet);
 	public:
 		vks::VulkanDevice* device;
-		VkDescriptorPool descriptorPool;
+		// Node and material sets are allocated from pools that grow with the model, materials with the same images share a set
+		// Held by pointer as the allocator's mutex would otherwise make the model immovable, e.g. for std::vector<Model>::resize
+		std::unique_ptr<vks::DescriptorAllocator> descriptorAllocator;
 
 		struct Vertices {
 			int count;
@@ -272,6 +281,8 @@ namespace vkglTF
 		std::vector<Skin*> skins;
 
 		std::vector<Texture> textures;
+		// Base color and normal map atlases created with FileLoadingFlags::PackImagesToAtlas
+		std::vector<Texture> atlasTextures;
 		std::vector<Material> materials;
 		std::vector<Animation> animations;
 
@@ -288,11 +299,13 @@ namespace vkglTF
 		std::string path;
 
 		Model() {};
+		Model(Model &&) = default;
 		~Model();
 		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale);
 		void loadSkins(tinygltf::Model& gltfModel);
 		void loadImages(tinygltf::Model& gltfModel, vks::VulkanDevice* device, VkQueue transferQueue);
 		void loadMaterials(tinygltf::Model& gltfModel);
+		void packImages(tinygltf::Model& gltfModel, std::vector<Vertex>& vertexBuffer, VkQueue transferQueue);
 		void loadAnimations(tinygltf::Model& gltfModel);
 		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
 		void bindBuffers(VkCommandBuffer commandBuffer);
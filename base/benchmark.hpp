@@ -13,6 +13,13 @@
 #include <functional>
 #include <chrono>
 #include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <numeric>
+#include <utility>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
 
 namespace vks
 {
@@ -32,9 +39,238 @@ namespace vks
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
 
+		/** @brief Time from the creation of the example (the benchmark is a member of it) to the first benchmark frame in ms */
+		double startupTime = 0.0;
+		std::chrono::high_resolution_clock::time_point creationTime = std::chrono::high_resolution_clock::now();
+
+		/** @brief Frame times in ms above which a frame is counted as a stutter */
+		std::vector<double> stutterThresholds = { 33.3, 50.0, 100.0 };
+		/** @brief Width of the frame time histogram bins in ms */
+		double histogramBinWidth = 1.0;
+
+		/** @brief Ends the warm up once frame times are stable, the warm up time then only limits its duration */
+		bool stableWarmup = true;
+		/** @brief Number of frames in the two consecutive windows whose median frame times are compared to detect stability */
+		uint32_t warmupWindow = 60;
+		/** @brief Maximum relative difference of the window medians for frame times to be considered stable */
+		double warmupTolerance = 0.02;
+		uint32_t warmupFrames = 0;
+		double warmupTime = 0.0;
+		bool warmupStabilized = false;
+
+		/** @brief Information about the run that's written to the results, set by the example base class */
+		std::string title;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<std::pair<std::string, std::string>> settings;
+
+		/** @brief GPU time of a profiled scope over the benchmark run */
+		struct GPUTiming {
+			std::string name;
+			double avg = 0.0;
+			double min = 0.0;
+			double max = 0.0;
+			uint32_t samples = 0;
+		};
+		/** @brief Filled by the example base class from the GPU profiler when the run has finished */
+		std::vector<GPUTiming> gpuTimings;
+
+		/** @brief Optional callbacks invoked after the warm up and after the last benchmark frame */
+		std::function<void()> warmupFinished;
+		std::function<void()> runFinished;
+
+		/** @brief Runs for exactly outputFrames frames regardless of the duration, e.g. to render a whole camera path */
+		bool fixedFrameCount = false;
+
+		/** @brief Named part of the run (e.g. a camera viewpoint) with its own frame time statistics */
+		struct Section {
+			std::string name;
+			std::vector<double> frameTimes;
+			double avg = 0.0;
+			double p50 = 0.0;
+			double p99 = 0.0;
+		};
+		/** @brief Optional sections of the run, each frame is counted for the section that is current once it has been rendered */
+		std::vector<Section> sections;
+		uint32_t currentSection = 0;
+
+		struct Statistics {
+			double min = 0.0;
+			double max = 0.0;
+			double avg = 0.0;
+			double stddev = 0.0;
+			double p50 = 0.0;
+			double p90 = 0.0;
+			double p99 = 0.0;
+			double p999 = 0.0;
+			/** @brief Number of frames per bin, bin i covers frame times from i * histogramBinWidth to (i + 1) * histogramBinWidth */
+			std::vector<uint32_t> histogram;
+			/** @brief Number of frames above each of the stutter thresholds */
+			std::vector<uint32_t> stutterCounts;
+		} statistics;
+
+	private:
+		// Nearest rank percentile of a sorted list
+		static double percentile(const std::vector<double> &sorted, double p) {
+			size_t rank = (size_t)std::ceil(p / 100.0 * (double)sorted.size());
+			return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+		}
+
+		static double median(std::vector<double>::const_iterator first, std::vector<double>::const_iterator last) {
+			std::vector<double> values(first, last);
+			std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+			return values[values.size() / 2];
+		}
+
+		static std::string jsonString(const std::string &value) {
+			std::stringstream ss;
+			ss << "\"";
+			for (char c : value) {
+				switch (c) {
+				case '"': ss << "\\\""; break;
+				case '\\': ss << "\\\\"; break;
+				case '\n': ss << "\\n"; break;
+				case '\t': ss << "\\t"; break;
+				default:
+					if ((unsigned char)c < 0x20) {
+						ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec << std::setfill(' ');
+					}
+					else {
+						ss << c;
+					}
+				}
+			}
+			ss << "\"";
+			return ss.str();
+		}
+
+		void computeStatistics() {
+			statistics = Statistics();
+			// Reports index the stutter counts by threshold, even if no frames were recorded
+			statistics.stutterCounts.assign(stutterThresholds.size(), 0);
+			if (frameTimes.empty()) {
+				return;
+			}
+			std::vector<double> sorted(frameTimes);
+			std::sort(sorted.begin(), sorted.end());
+			statistics.min = sorted.front();
+			statistics.max = sorted.back();
+			statistics.avg = std::accumulate(sorted.begin(), sorted.end(), 0.0) / (double)sorted.size();
+			double variance = 0.0;
+			for (double t : sorted) {
+				variance += (t - statistics.avg) * (t - statistics.avg);
+			}
+			statistics.stddev = std::sqrt(variance / (double)sorted.size());
+			statistics.p50 = percentile(sorted, 50.0);
+			statistics.p90 = percentile(sorted, 90.0);
+			statistics.p99 = percentile(sorted, 99.0);
+			statistics.p999 = percentile(sorted, 99.9);
+			statistics.histogram.resize((size_t)(statistics.max / histogramBinWidth) + 1, 0);
+			for (double t : sorted) {
+				statistics.histogram[(size_t)(t / histogramBinWidth)]++;
+			}
+			for (size_t i = 0; i < stutterThresholds.size(); i++) {
+				statistics.stutterCounts[i] = (uint32_t)(sorted.end() - std::upper_bound(sorted.begin(), sorted.end(), stutterThresholds[i]));
+			}
+			for (auto &section : sections) {
+				if (section.frameTimes.empty()) {
+					continue;
+				}
+				std::vector<double> sectionSorted(section.frameTimes);
+				std::sort(sectionSorted.begin(), sectionSorted.end());
+				section.avg = std::accumulate(sectionSorted.begin(), sectionSorted.end(), 0.0) / (double)sectionSorted.size();
+				section.p50 = percentile(sectionSorted, 50.0);
+				section.p99 = percentile(sectionSorted, 99.0);
+			}
+		}
+
+		void saveJSON(std::ofstream &result) {
+			result << "{\n";
+			result << "\t\"example\": " << jsonString(title) << ",\n";
+			result << "\t\"device\": " << jsonString(deviceProps.deviceName) << ",\n";
+			result << "\t\"driverversion\": " << deviceProps.driverVersion << ",\n";
+			result << "\t\"apiversion\": \"" << VK_VERSION_MAJOR(deviceProps.apiVersion) << "." << VK_VERSION_MINOR(deviceProps.apiVersion) << "." << VK_VERSION_PATCH(deviceProps.apiVersion) << "\",\n";
+			result << "\t\"vendorid\": " << deviceProps.vendorID << ",\n";
+			result << "\t\"resolution\": [" << width << ", " << height << "],\n";
+			result << "\t\"settings\": {";
+			for (size_t i = 0; i < settings.size(); i++) {
+				result << (i > 0 ? ", " : " ") << jsonString(settings[i].first) << ": " << jsonString(settings[i].second);
+			}
+			result << " },\n";
+			result << "\t\"startup\": " << startupTime << ",\n";
+			result << "\t\"warmup\": { \"frames\": " << warmupFrames << ", \"ms\": " << warmupTime << ", \"stable\": " << (warmupStabilized ? "true" : "false") << " },\n";
+			result << "\t\"duration\": " << runtime << ",\n";
+			result << "\t\"frames\": " << frameCount << ",\n";
+			result << "\t\"fps\": " << frameCount / (runtime / 1000.0) << ",\n";
+			result << "\t\"frametime\": {\n";
+			result << "\t\t\"min\": " << statistics.min << ",\n";
+			result << "\t\t\"max\": " << statistics.max << ",\n";
+			result << "\t\t\"avg\": " << statistics.avg << ",\n";
+			result << "\t\t\"stddev\": " << statistics.stddev << ",\n";
+			result << "\t\t\"p50\": " << statistics.p50 << ",\n";
+			result << "\t\t\"p90\": " << statistics.p90 << ",\n";
+			result << "\t\t\"p99\": " << statistics.p99 << ",\n";
+			result << "\t\t\"p99.9\": " << statistics.p999 << "\n";
+			result << "\t},\n";
+			result << "\t\"stutters\": [";
+			for (size_t i = 0; i < stutterThresholds.size(); i++) {
+				result << (i > 0 ? ", " : " ") << "{ \"threshold\": " << stutterThresholds[i] << ", \"frames\": " << statistics.stutterCounts[i] << " }";
+			}
+			result << " ],\n";
+			result << "\t\"histogram\": { \"binwidth\": " << histogramBinWidth << ", \"counts\": [";
+			for (size_t i = 0; i < statistics.histogram.size(); i++) {
+				result << (i > 0 ? ", " : "") << statistics.histogram[i];
+			}
+			result << "] }";
+			if (!sections.empty()) {
+				result << ",\n\t\"sections\": [";
+				for (size_t i = 0; i < sections.size(); i++) {
+					result << (i > 0 ? "," : "") << "\n\t\t{ \"name\": " << jsonString(sections[i].name) << ", \"frames\": " << sections[i].frameTimes.size() << ", \"avg\": " << sections[i].avg << ", \"p50\": " << sections[i].p50 << ", \"p99\": " << sections[i].p99 << " }";
+				}
+				result << "\n\t]";
+			}
+			if (!gpuTimings.empty()) {
+				result << ",\n\t\"gpu\": [";
+				for (size_t i = 0; i < gpuTimings.size(); i++) {
+					result << (i > 0 ? "," : "") << "\n\t\t{ \"scope\": " << jsonString(gpuTimings[i].name) << ", \"avg\": " << gpuTimings[i].avg << ", \"min\": " << gpuTimings[i].min << ", \"max\": " << gpuTimings[i].max << ", \"samples\": " << gpuTimings[i].samples << " }";
+				}
+				result << "\n\t]";
+			}
+			if (outputFrameTimes) {
+				result << ",\n\t\"frametimes\": [";
+				for (size_t i = 0; i < frameTimes.size(); i++) {
+					result << (i > 0 ? ", " : "") << frameTimes[i];
+				}
+				result << "]";
+			}
+			result << "\n}\n";
+		}
+
+	public:
+		/** @brief Parses a comma separated list of stutter thresholds in ms, entries that aren't numbers are skipped */
+		void setStutterThresholds(const std::string &list) {
+			stutterThresholds.clear();
+			std::stringstream ss(list);
+			std::string value;
+			while (std::getline(ss, value, ',')) {
+				if (value.empty()) {
+					continue;
+				}
+				char *end = nullptr;
+				const double threshold = std::strtod(value.c_str(), &end);
+				if ((end == value.c_str()) || (*end != '\0')) {
+					std::cerr << "Ignoring invalid stutter threshold \"" << value << "\"" << "\n";
+					continue;
+				}
+				stutterThresholds.push_back(threshold);
+			}
+			std::sort(stutterThresholds.begin(), stutterThresholds.end());
+		}
+
 		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
 			active = true;
 			this->deviceProps = deviceProps;
+			startupTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - creationTime).count();
 #if defined(_WIN32)
 			AttachConsole(ATTACH_PARENT_PROCESS);
 			freopen_s(&stream, "CONOUT$", "w+", stdout);
@@ -43,42 +279,124 @@ namespace vks
 			std::cout << std::fixed << std::setprecision(3);
 
 			// Warm up phase to get more stable frame rates
+			// With stable warm up this ends as soon as the median frame times of the last two windows match, otherwise after the warm up time
 			{
-				double tMeasured = 0.0;
-				while (tMeasured < (warmup * 1000)) {
+				std::vector<double> warmupFrameTimes;
+				while (warmupTime < (warmup * 1000)) {
 					auto tStart = std::chrono::high_resolution_clock::now();
 					renderFunc();
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
-					tMeasured += tDiff;
+					warmupTime += tDiff;
+					warmupFrames++;
+					if (stableWarmup) {
+						warmupFrameTimes.push_back(tDiff);
+						if (warmupFrameTimes.size() >= 2 * warmupWindow) {
+							auto last = warmupFrameTimes.end();
+							double previousMedian = median(last - 2 * warmupWindow, last - warmupWindow);
+							double currentMedian = median(last - warmupWindow, last);
+							if (std::abs(currentMedian - previousMedian) <= warmupTolerance * previousMedian) {
+								warmupStabilized = true;
+								break;
+							}
+						}
+					}
 				};
 			}
+			if (warmupFinished) {
+				warmupFinished();
+			}
 
 			// Benchmark phase
 			{
-				while (runtime < (duration * 1000.0)) {
+				while (fixedFrameCount ? (frameCount < (uint32_t)outputFrames) : (runtime < (duration * 1000.0))) {
 					auto tStart = std::chrono::high_resolution_clock::now();
 					renderFunc();
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 					runtime += tDiff;
 					frameTimes.push_back(tDiff);
+					if (currentSection < sections.size()) {
+						sections[currentSection].frameTimes.push_back(tDiff);
+					}
 					frameCount++;
 					if (outputFrames != -1 && outputFrames == frameCount) break;
 				};
+				if (runFinished) {
+					runFinished();
+				}
 				std::cout << "Benchmark finished" << "\n";
 				std::cout << "device : " << deviceProps.deviceName << " (driver version: " << deviceProps.driverVersion << ")" << "\n";
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
 				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				computeStatistics();
+				std::cout << "startup: " << (startupTime / 1000.0) << " s" << "\n";
+				std::cout << "warmup : " << warmupFrames << " frames, " << (warmupTime / 1000.0) << " s" << (stableWarmup ? (warmupStabilized ? " (stable)" : " (not stable)") : "") << "\n";
+				std::cout << "p50    : " << statistics.p50 << " ms" << "\n";
+				std::cout << "p90    : " << statistics.p90 << " ms" << "\n";
+				std::cout << "p99    : " << statistics.p99 << " ms" << "\n";
+				std::cout << "p99.9  : " << statistics.p999 << " ms" << "\n";
+				std::cout << "stddev : " << statistics.stddev << " ms" << "\n";
+				for (size_t i = 0; i < stutterThresholds.size(); i++) {
+					std::cout << "stutter: " << statistics.stutterCounts[i] << " frames > " << stutterThresholds[i] << " ms" << "\n";
+				}
+				for (auto &section : sections) {
+					std::cout << "section: " << section.name << " " << section.avg << " ms avg, " << section.p99 << " ms p99 (" << section.frameTimes.size() << " frames)" << "\n";
+				}
+				for (auto &timing : gpuTimings) {
+					std::cout << "gpu    : " << timing.name << " " << timing.avg << " ms (min " << timing.min << ", max " << timing.max << ")" << "\n";
+				}
 			}
 		}
 
+		/** @brief Saves the results as JSON if the file name ends with .json, and as CSV otherwise */
 		void saveResults() {
 			std::ofstream result(filename, std::ios::out);
 			if (result.is_open()) {
 				result << std::fixed << std::setprecision(4);
 
-				result << "device,driverversion,duration (ms),frames,fps" << "\n";
-				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "\n";
+				const std::string jsonExtension = ".json";
+				if ((filename.size() >= jsonExtension.size()) && (filename.compare(filename.size() - jsonExtension.size(), jsonExtension.size(), jsonExtension) == 0)) {
+					saveJSON(result);
+					result.flush();
+#if defined(_WIN32)
+					FreeConsole();
+#endif
+					return;
+				}
+
+				// The first columns are kept stable for scripts parsing the results
+				result << "device,driverversion,duration (ms),frames,fps,width,height,startup (ms),avg (ms),stddev (ms),p50 (ms),p90 (ms),p99 (ms),p99.9 (ms)";
+				for (double threshold : stutterThresholds) {
+					result << ",stutter > " << std::defaultfloat << threshold << " ms";
+				}
+				result << std::fixed << "\n";
+				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << ","
+					<< width << "," << height << "," << startupTime << "," << statistics.avg << "," << statistics.stddev << "," << statistics.p50 << "," << statistics.p90 << "," << statistics.p99 << "," << statistics.p999;
+				for (uint32_t count : statistics.stutterCounts) {
+					result << "," << count;
+				}
+				result << "\n";
+
+				if (!sections.empty()) {
+					result << "\n" << "section,frames,avg (ms),p50 (ms),p99 (ms)" << "\n";
+					for (auto &section : sections) {
+						result << section.name << "," << section.frameTimes.size() << "," << section.avg << "," << section.p50 << "," << section.p99 << "\n";
+					}
+				}
+
+				if (!gpuTimings.empty()) {
+					result << "\n" << "gpu scope,avg (ms),min (ms),max (ms),samples" << "\n";
+					for (auto &timing : gpuTimings) {
+						result << timing.name << "," << timing.avg << "," << timing.min << "," << timing.max << "," << timing.samples << "\n";
+					}
+				}
+
+				result << "\n" << "histogram (ms),frames" << "\n";
+				for (size_t i = 0; i < statistics.histogram.size(); i++) {
+					if (statistics.histogram[i] > 0) {
+						result << i * histogramBinWidth << "," << statistics.histogram[i] << "\n";
+					}
+				}
 
 				if (outputFrameTimes) {
 					result << "\n" << "frame,ms" << "\n";
@@ -0,0 +1,202 @@
+/*
+* Camera path recording and playback
+*
+* Stores camera position, rotation and animation timer keyed by frame, used to render the exact same frames in every benchmark run
+* A path consists of one or more named viewpoints that are played back one after another
+*
+* File format (text, one entry per line, lines starting with # are ignored):
+*   viewpoint <name>
+*   <frame> <position x y z> <rotation x y z> <timer>
+* Frames are relative to the start of their viewpoint, poses between keyframes are interpolated linearly
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	class CameraPath
+	{
+	public:
+		struct Keyframe
+		{
+			uint32_t frame = 0;
+			glm::vec3 position = glm::vec3(0.0f);
+			glm::vec3 rotation = glm::vec3(0.0f);
+			float timer = 0.0f;
+		};
+
+		struct Viewpoint
+		{
+			std::string name;
+			/** @brief Keyframes sorted by frame, the first one is at frame 0 */
+			std::vector<Keyframe> keyframes;
+
+			uint32_t frameCount() const
+			{
+				return keyframes.empty() ? 0 : keyframes.back().frame + 1;
+			}
+		};
+
+		/** @brief Camera pose and animation timer at a frame of the path */
+		struct Pose
+		{
+			glm::vec3 position;
+			glm::vec3 rotation;
+			float timer;
+			uint32_t viewpoint;
+		};
+
+		std::vector<Viewpoint> viewpoints;
+
+		bool empty() const
+		{
+			return frameCount() == 0;
+		}
+
+		/** @brief Number of frames of all viewpoints */
+		uint32_t frameCount() const
+		{
+			uint32_t count = 0;
+			for (auto &viewpoint : viewpoints) {
+				count += viewpoint.frameCount();
+			}
+			return count;
+		}
+
+		void clear()
+		{
+			viewpoints.clear();
+		}
+
+		/** @brief Starts a new viewpoint, keyframes added afterwards belong to it */
+		void addViewpoint(const std::string &name)
+		{
+			Viewpoint viewpoint;
+			viewpoint.name = name;
+			viewpoints.push_back(viewpoint);
+		}
+
+		/** @brief Appends a keyframe to the last viewpoint, frames have to be added in ascending order */
+		void addKeyframe(const Keyframe &keyframe)
+		{
+			if (viewpoints.empty()) {
+				addViewpoint("default");
+			}
+			viewpoints.back().keyframes.push_back(keyframe);
+		}
+
+		/**
+		* Returns the pose at a frame of the whole path, frames beyond the end wrap around to the start
+		* @note The path must not be empty
+		*/
+		Pose pose(uint32_t frame) const
+		{
+			frame %= frameCount();
+			uint32_t viewpointIndex = 0;
+			while (frame >= viewpoints[viewpointIndex].frameCount()) {
+				frame -= viewpoints[viewpointIndex].frameCount();
+				viewpointIndex++;
+			}
+			const std::vector<Keyframe> &keyframes = viewpoints[viewpointIndex].keyframes;
+			size_t next = 0;
+			while (keyframes[next].frame < frame) {
+				next++;
+			}
+			Pose result;
+			result.viewpoint = viewpointIndex;
+			if (keyframes[next].frame == frame) {
+				result.position = keyframes[next].position;
+				result.rotation = keyframes[next].rotation;
+				result.timer = keyframes[next].timer;
+				return result;
+			}
+			const Keyframe &a = keyframes[next - 1];
+			const Keyframe &b = keyframes[next];
+			const float t = (float)(frame - a.frame) / (float)(b.frame - a.frame);
+			result.position = glm::mix(a.position, b.position, t);
+			result.rotation = glm::mix(a.rotation, b.rotation, t);
+			// The timer wraps around from 1 to 0, so interpolate across the wrap if the next value is lower
+			const float timerB = (b.timer < a.timer) ? b.timer + 1.0f : b.timer;
+			result.timer = a.timer + (timerB - a.timer) * t;
+			result.timer -= std::floor(result.timer);
+			return result;
+		}
+
+		/** @brief Loads a path from a file, returns false if the file can't be read or contains invalid entries */
+		bool loadFromFile(const std::string &filename)
+		{
+			clear();
+			std::ifstream file(filename);
+			if (!file.is_open()) {
+				return false;
+			}
+			std::string line;
+			while (std::getline(file, line)) {
+				std::stringstream ss(line);
+				std::string token;
+				if (!(ss >> token) || token[0] == '#') {
+					continue;
+				}
+				if (token == "viewpoint") {
+					std::string name;
+					std::getline(ss >> std::ws, name);
+					addViewpoint(name);
+					continue;
+				}
+				Keyframe keyframe;
+				std::stringstream values(line);
+				if (!(values >> keyframe.frame >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.rotation.x >> keyframe.rotation.y >> keyframe.rotation.z >> keyframe.timer)) {
+					clear();
+					return false;
+				}
+				if (viewpoints.empty()) {
+					addViewpoint("default");
+				}
+				const std::vector<Keyframe> &keyframes = viewpoints.back().keyframes;
+				if ((keyframes.empty() && keyframe.frame != 0) || (!keyframes.empty() && keyframe.frame <= keyframes.back().frame)) {
+					clear();
+					return false;
+				}
+				addKeyframe(keyframe);
+			}
+			// Viewpoints without keyframes can't be played back
+			for (auto it = viewpoints.begin(); it != viewpoints.end();) {
+				it = it->keyframes.empty() ? viewpoints.erase(it) : it + 1;
+			}
+			return !empty();
+		}
+
+		bool saveToFile(const std::string &filename) const
+		{
+			std::ofstream file(filename, std::ios::out);
+			if (!file.is_open()) {
+				return false;
+			}
+			file << "# frame position.x position.y position.z rotation.x rotation.y rotation.z timer\n";
+			file.precision(9);
+			for (auto &viewpoint : viewpoints) {
+				file << "viewpoint " << viewpoint.name << "\n";
+				for (auto &keyframe : viewpoint.keyframes) {
+					file << keyframe.frame << " " << keyframe.position.x << " " << keyframe.position.y << " " << keyframe.position.z << " "
+						<< keyframe.rotation.x << " " << keyframe.rotation.y << " " << keyframe.rotation.z << " " << keyframe.timer << "\n";
+				}
+			}
+			return true;
+		}
+	};
+}
@@ -0,0 +1,214 @@
+/*
+* CPU scope profiler
+*
+* Scopes are recorded into a lock-free ring buffer per thread and can be written as a Chrome trace (JSON)
+* that can be opened with chrome://tracing or Perfetto (https://ui.perfetto.dev)
+* Defining VKS_CPU_PROFILER_DISABLED compiles all profiling macros to nothing
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <cstdint>
+
+namespace vks
+{
+	class CPUProfiler
+	{
+	public:
+		/** @brief Number of scopes kept per thread, older ones are overwritten */
+		static const uint32_t ringSize = 1 << 16;
+
+		/**
+		* Measures the lifetime of the object as a scope
+		* @note The name must outlive the profiler (e.g. a string literal or __FUNCTION__), only the pointer is stored
+		*/
+		class Scope
+		{
+		private:
+			const char *name;
+			uint64_t start;
+		public:
+			explicit Scope(const char *name) : name(name), start(0)
+			{
+				if (CPUProfiler::enabled()) {
+					start = CPUProfiler::now();
+				}
+			}
+			~Scope()
+			{
+				if (start != 0) {
+					CPUProfiler::record(name, start, CPUProfiler::now());
+				}
+			}
+			Scope(const Scope&) = delete;
+			Scope &operator=(const Scope&) = delete;
+		};
+
+		static bool enabled()
+		{
+			return enabledFlag().load(std::memory_order_relaxed);
+		}
+
+		/** @brief Starts or stops recording scopes on all threads */
+		static void setEnabled(bool enabled)
+		{
+			epoch();
+			enabledFlag().store(enabled, std::memory_order_relaxed);
+		}
+
+		/** @brief Names the calling thread in the trace, only has an effect if the profiler is enabled */
+		static void setThreadName(const std::string &name)
+		{
+			if (!enabled()) {
+				return;
+			}
+			ThreadBuffer *buffer = threadBuffer();
+			std::lock_guard<std::mutex> lock(registry().mutex);
+			buffer->name = name;
+		}
+
+		/** @brief Nanoseconds since the profiler was first used, never 0 */
+		static uint64_t now()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch()).count()) + 1;
+		}
+
+		static void record(const char *name, uint64_t start, uint64_t end)
+		{
+			ThreadBuffer *buffer = threadBuffer();
+			// Only the owning thread writes to its ring, the release store publishes the event to writeTrace()
+			const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+			Event &event = buffer->events[head % ringSize];
+			event.name = name;
+			event.start = start;
+			event.end = end;
+			buffer->head.store(head + 1, std::memory_order_release);
+		}
+
+		/**
+		* Writes all recorded scopes of all threads as a Chrome trace
+		* @note Scopes recorded by other threads while writing may be torn, so call this while no other thread records scopes
+		*/
+		static bool writeTrace(const std::string &filename)
+		{
+			std::ofstream file(filename, std::ios::out);
+			if (!file.is_open()) {
+				return false;
+			}
+			Registry &reg = registry();
+			std::lock_guard<std::mutex> lock(reg.mutex);
+			file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+			bool first = true;
+			for (auto &buffer : reg.buffers) {
+				if (!buffer->name.empty()) {
+					file << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->id << ", \"args\": {\"name\": \"" << escape(buffer->name) << "\"}}";
+					first = false;
+				}
+				const uint64_t head = buffer->head.load(std::memory_order_acquire);
+				const uint64_t count = (head < ringSize) ? head : ringSize;
+				for (uint64_t i = head - count; i < head; i++) {
+					const Event &event = buffer->events[i % ringSize];
+					// Chrome trace timestamps are in microseconds
+					file << (first ? "" : ",\n") << "{\"name\": \"" << escape(event.name) << "\", \"cat\": \"cpu\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->id
+						<< ", \"ts\": " << (event.start / 1000.0) << ", \"dur\": " << ((event.end - event.start) / 1000.0) << "}";
+					first = false;
+				}
+			}
+			file << "\n]}\n";
+			return true;
+		}
+
+	private:
+		struct Event
+		{
+			const char *name;
+			uint64_t start;
+			uint64_t end;
+		};
+
+		struct ThreadBuffer
+		{
+			uint32_t id = 0;
+			std::string name;
+			std::vector<Event> events;
+			std::atomic<uint64_t> head{ 0 };
+		};
+
+		// Thread buffers are owned by the registry so their scopes survive the threads that recorded them
+		struct Registry
+		{
+			std::mutex mutex;
+			std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+		};
+
+		static std::atomic<bool> &enabledFlag()
+		{
+			static std::atomic<bool> flag(false);
+			return flag;
+		}
+
+		static std::chrono::steady_clock::time_point epoch()
+		{
+			static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			return start;
+		}
+
+		static Registry &registry()
+		{
+			static Registry reg;
+			return reg;
+		}
+
+		static ThreadBuffer *threadBuffer()
+		{
+			static thread_local ThreadBuffer *buffer = nullptr;
+			if (!buffer) {
+				std::unique_ptr<ThreadBuffer> newBuffer(new ThreadBuffer());
+				newBuffer->events.resize(ringSize);
+				Registry &reg = registry();
+				std::lock_guard<std::mutex> lock(reg.mutex);
+				newBuffer->id = static_cast<uint32_t>(reg.buffers.size()) + 1;
+				buffer = newBuffer.get();
+				reg.buffers.push_back(std::move(newBuffer));
+			}
+			return buffer;
+		}
+
+		static std::string escape(const std::string &value)
+		{
+			std::string result;
+			for (char c : value) {
+				if (c == '"' || c == '\\') {
+					result += '\\';
+				}
+				result += ((unsigned char)c < 0x20) ? ' ' : c;
+			}
+			return result;
+		}
+	};
+}
+
+#if !defined(VKS_CPU_PROFILER_DISABLED)
+#define VKS_PROFILE_CONCAT_IMPL(a, b) a##b
+#define VKS_PROFILE_CONCAT(a, b) VKS_PROFILE_CONCAT_IMPL(a, b)
+/** @brief Profiles the enclosing scope under the given name (must be a string literal) */
+#define VKS_PROFILE_SCOPE(name) vks::CPUProfiler::Scope VKS_PROFILE_CONCAT(cpuProfilerScope, __LINE__)(name)
+/** @brief Profiles the enclosing function */
+#define VKS_PROFILE_FUNCTION() VKS_PROFILE_SCOPE(__FUNCTION__)
+#define VKS_PROFILE_THREAD_NAME(name) vks::CPUProfiler::setThreadName(name)
+#else
+#define VKS_PROFILE_SCOPE(name)
+#define VKS_PROFILE_FUNCTION()
+#define VKS_PROFILE_THREAD_NAME(name)
+#endif
@@ -1,23 +1,76 @@
 /*
 * View frustum culling class
 *
+* Besides single sphere checks, batches of bounding spheres and axis aligned bounding boxes stored as structure of arrays
+* can be culled 4 (SSE2, NEON) or 8 (AVX) at a time, writing either visibility bitmasks or compacted index lists
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #include <array>
+#include <algorithm>
+#include <assert.h>
 #include <math.h>
+#include <stdint.h>
 #include <glm/glm.hpp>
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FRUSTUM_SIMD_SSE
+#define FRUSTUM_SIMD_AVX
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+// The AVX path is compiled for AVX regardless of the target flags and only used if the CPU supports it
+#if defined(__GNUC__) || defined(__clang__)
+#define FRUSTUM_TARGET_AVX __attribute__((target("avx")))
+#else
+#define FRUSTUM_TARGET_AVX
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FRUSTUM_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
 namespace vks
 {
+	/** @brief Bounding spheres stored as structure of arrays */
+	struct SphereBounds
+	{
+		const float *x;
+		const float *y;
+		const float *z;
+		const float *radius;
+	};
+
+	/** @brief Axis aligned bounding boxes stored as structure of arrays of centers and half extents */
+	struct AABBBounds
+	{
+		const float *centerX;
+		const float *centerY;
+		const float *centerZ;
+		const float *extentX;
+		const float *extentY;
+		const float *extentZ;
+	};
+
 	class Frustum
 	{
 	public:
 		enum side { LEFT = 0, RIGHT = 1, TOP = 2, BOTTOM = 3, BACK = 4, FRONT = 5 };
 		std::array<glm::vec4, 6> planes;
 
+		enum class InstructionSet { Scalar, SSE, AVX, NEON };
+		/** @brief Instruction set used by the batch functions, defaults to the widest one supported by the CPU, the scalar path is the reference for the SIMD paths */
+		InstructionSet instructionSet = bestInstructionSet();
+
+		/** @brief Number of bounds that share one plane coherency hint */
+		static const uint32_t hintBlockSize = 8;
+
 		void update(glm::mat4 matrix)
 		{
 			planes[LEFT].x = matrix[0].w + matrix[0].x;
@@ -57,7 +110,7 @@ namespace vks
 			}
 		}
 		
-		bool checkSphere(glm::vec3 pos, float radius)
+		bool checkSphere(glm::vec3 pos, float radius) const
 		{
 			for (auto i = 0; i < planes.size(); i++)
 			{
@@ -68,5 +121,385 @@ namespace vks
 			}
 			return true;
 		}
+
+		/** @brief Returns true if the axis aligned bounding box given by its center and half extents is at least partially inside the frustum */
+		bool checkAABB(glm::vec3 center, glm::vec3 extent) const
+		{
+			for (auto i = 0; i < planes.size(); i++)
+			{
+				// Projected radius of the box onto the plane normal
+				const float radius = (fabsf(planes[i].x) * extent.x) + (fabsf(planes[i].y) * extent.y) + (fabsf(planes[i].z) * extent.z);
+				if ((planes[i].x * center.x) + (planes[i].y * center.y) + (planes[i].z * center.z) + planes[i].w <= -radius)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/**
+		* Tests a batch of spheres against the frustum and writes the indices of the visible ones
+		*
+		* @param x, y, z Sphere centers stored as separate arrays (structure of arrays)
+		* @param radius Sphere radii
+		* @param count Number of spheres
+		* @param visibleIndices Receives the indices (plus indexOffset) of the visible spheres, must have room for count entries
+		* @param indexOffset Added to every index written to visibleIndices
+		* @param planeHints Optional plane coherency hints, see cullSpheresMask
+		*
+		* @return Number of visible spheres
+		*/
+		uint32_t cullSpheres(const float *x, const float *y, const float *z, const float *radius, uint32_t count, uint32_t *visibleIndices, uint32_t indexOffset = 0, uint8_t *planeHints = nullptr) const
+		{
+			SphereBounds bounds = { x, y, z, radius };
+			return cull(bounds, count, nullptr, visibleIndices, indexOffset, planeHints);
+		}
+
+		/**
+		* Tests a batch of spheres against the frustum and writes a visibility bitmask
+		*
+		* @param visibleMask Receives one bit per sphere (bit i % 32 of word i / 32 is set if sphere i is visible), must have room for (count + 31) / 32 words
+		* @param planeHints Optional array of (count + hintBlockSize - 1) / hintBlockSize bytes, initialized to zero
+		* Stores the plane that rejected all bounds of a block, which is tested first in the next call to skip the other planes if the bounds didn't move much
+		*
+		* @return Number of visible spheres
+		*/
+		uint32_t cullSpheresMask(const float *x, const float *y, const float *z, const float *radius, uint32_t count, uint32_t *visibleMask, uint8_t *planeHints = nullptr) const
+		{
+			SphereBounds bounds = { x, y, z, radius };
+			return cull(bounds, count, visibleMask, nullptr, 0, planeHints);
+		}
+
+		/** @brief Tests a batch of axis aligned bounding boxes against the frustum and writes the indices of the visible ones, see cullSpheres */
+		uint32_t cullAABBs(const AABBBounds &bounds, uint32_t count, uint32_t *visibleIndices, uint32_t indexOffset = 0, uint8_t *planeHints = nullptr) const
+		{
+			return cull(bounds, count, nullptr, visibleIndices, indexOffset, planeHints);
+		}
+
+		/** @brief Tests a batch of axis aligned bounding boxes against the frustum and writes a visibility bitmask, see cullSpheresMask */
+		uint32_t cullAABBsMask(const AABBBounds &bounds, uint32_t count, uint32_t *visibleMask, uint8_t *planeHints = nullptr) const
+		{
+			return cull(bounds, count, visibleMask, nullptr, 0, planeHints);
+		}
+
+		static InstructionSet bestInstructionSet()
+		{
+#if defined(FRUSTUM_SIMD_AVX)
+			return avxSupported() ? InstructionSet::AVX : InstructionSet::SSE;
+#elif defined(FRUSTUM_SIMD_NEON)
+			return InstructionSet::NEON;
+#else
+			return InstructionSet::Scalar;
+#endif
+		}
+
+		static bool instructionSetSupported(InstructionSet set)
+		{
+			switch (set) {
+			case InstructionSet::Scalar:
+				return true;
+#if defined(FRUSTUM_SIMD_SSE)
+			case InstructionSet::SSE:
+				return true;
+#endif
+#if defined(FRUSTUM_SIMD_AVX)
+			case InstructionSet::AVX:
+				return avxSupported();
+#endif
+#if defined(FRUSTUM_SIMD_NEON)
+			case InstructionSet::NEON:
+				return true;
+#endif
+			default:
+				return false;
+			}
+		}
+
+		static const char* instructionSetName(InstructionSet set)
+		{
+			switch (set) {
+			case InstructionSet::SSE: return "SSE2";
+			case InstructionSet::AVX: return "AVX";
+			case InstructionSet::NEON: return "NEON";
+			default: return "scalar";
+			}
+		}
+
+	private:
+		static uint32_t ctz(uint32_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward(&index, value);
+			return index;
+#else
+			return __builtin_ctz(value);
+#endif
+		}
+
+		static uint32_t popcount(uint32_t value)
+		{
+			value = value - ((value >> 1) & 0x55555555);
+			value = (value & 0x33333333) + ((value >> 2) & 0x33333333);
+			return (((value + (value >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+		}
+
+#if defined(FRUSTUM_SIMD_AVX)
+		static bool avxSupported()
+		{
+			static const bool supported = []() {
+#if defined(_MSC_VER)
+				int info[4];
+				__cpuid(info, 1);
+				// The OS has to save the AVX registers on context switches
+				const bool osxsave = (info[2] & (1 << 27)) != 0;
+				const bool avx = (info[2] & (1 << 28)) != 0;
+				return osxsave && avx && ((_xgetbv(0) & 0x6) == 0x6);
+#else
+				__builtin_cpu_init();
+				return __builtin_cpu_supports("avx") != 0;
+#endif
+			}();
+			return supported;
+		}
+#endif
+
+		/*
+			Per-plane tests, the scalar versions define the results and the order of operations the SIMD versions have to match
+			Bounds are culled if the signed distance of the center is less or equal to the negated (projected) radius for any plane
+			The comparisons are written as "not less or equal" so NaN distances are treated as visible, like in checkSphere
+		*/
+
+		bool testScalar(const SphereBounds &b, uint32_t i, uint32_t plane) const
+		{
+			const glm::vec4 &p = planes[plane];
+			return !((p.x * b.x[i]) + (p.y * b.y[i]) + (p.z * b.z[i]) + p.w <= -b.radius[i]);
+		}
+
+		bool testScalar(const AABBBounds &b, uint32_t i, uint32_t plane) const
+		{
+			const glm::vec4 &p = planes[plane];
+			const float radius = (fabsf(p.x) * b.extentX[i]) + (fabsf(p.y) * b.extentY[i]) + (fabsf(p.z) * b.extentZ[i]);
+			return !((p.x * b.centerX[i]) + (p.y * b.centerY[i]) + (p.z * b.centerZ[i]) + p.w <= -radius);
+		}
+
+		// Plane tested at the given step, the hinted plane is tested first followed by the others in order
+		static uint32_t planeOrder(uint32_t step, uint32_t firstPlane)
+		{
+			return (step == 0) ? firstPlane : ((step <= firstPlane) ? step - 1 : step);
+		}
+
+		/*
+			Block tests return the visibility bits of hintBlockSize bounds starting at first
+			Planes are tested until all bounds of the block are rejected, rejectingPlane receives the plane that rejected the last ones
+		*/
+
+		template<typename Bounds>
+		uint32_t testBlockScalar(const Bounds &bounds, uint32_t first, uint32_t count, uint32_t firstPlane, uint32_t &rejectingPlane) const
+		{
+			uint32_t mask = (1u << count) - 1;
+			for (uint32_t step = 0; step < planes.size() && mask != 0; step++) {
+				const uint32_t plane = planeOrder(step, firstPlane);
+				for (uint32_t i = 0; i < count; i++) {
+					if ((mask & (1u << i)) && !testScalar(bounds, first + i, plane)) {
+						mask &= ~(1u << i);
+					}
+				}
+				rejectingPlane = plane;
+			}
+			return mask;
+		}
+
+#if defined(FRUSTUM_SIMD_SSE)
+		__m128 distanceSSE(const glm::vec4 &p, __m128 x, __m128 y, __m128 z) const
+		{
+			__m128 distance = _mm_mul_ps(_mm_set1_ps(p.x), x);
+			distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(p.y), y));
+			distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(p.z), z));
+			return _mm_add_ps(distance, _mm_set1_ps(p.w));
+		}
+
+		__m128 testSSE(const SphereBounds &b, uint32_t i, uint32_t plane) const
+		{
+			const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(b.radius + i));
+			return _mm_cmpnle_ps(distanceSSE(planes[plane], _mm_loadu_ps(b.x + i), _mm_loadu_ps(b.y + i), _mm_loadu_ps(b.z + i)), negRadius);
+		}
+
+		__m128 testSSE(const AABBBounds &b, uint32_t i, uint32_t plane) const
+		{
+			const glm::vec4 &p = planes[plane];
+			__m128 radius = _mm_mul_ps(_mm_set1_ps(fabsf(p.x)), _mm_loadu_ps(b.extentX + i));
+			radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(fabsf(p.y)), _mm_loadu_ps(b.extentY + i)));
+			radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(fabsf(p.z)), _mm_loadu_ps(b.extentZ + i)));
+			const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+			return _mm_cmpnle_ps(distanceSSE(p, _mm_loadu_ps(b.centerX + i), _mm_loadu_ps(b.centerY + i), _mm_loadu_ps(b.centerZ + i)), negRadius);
+		}
+
+		// Tests a block of eight bounds as two groups of four
+		template<typename Bounds>
+		uint32_t testBlockSSE(const Bounds &bounds, uint32_t first, uint32_t firstPlane, uint32_t &rejectingPlane) const
+		{
+			__m128 visibleLow = testSSE(bounds, first, firstPlane);
+			__m128 visibleHigh = testSSE(bounds, first + 4, firstPlane);
+			uint32_t mask = (uint32_t)_mm_movemask_ps(visibleLow) | ((uint32_t)_mm_movemask_ps(visibleHigh) << 4);
+			rejectingPlane = firstPlane;
+			for (uint32_t step = 1; step < planes.size() && mask != 0; step++) {
+				const uint32_t plane = planeOrder(step, firstPlane);
+				visibleLow = _mm_and_ps(visibleLow, testSSE(bounds, first, plane));
+				visibleHigh = _mm_and_ps(visibleHigh, testSSE(bounds, first + 4, plane));
+				mask = (uint32_t)_mm_movemask_ps(visibleLow) | ((uint32_t)_mm_movemask_ps(visibleHigh) << 4);
+				rejectingPlane = plane;
+			}
+			return mask;
+		}
+#endif
+
+#if defined(FRUSTUM_SIMD_AVX)
+		FRUSTUM_TARGET_AVX __m256 distanceAVX(const glm::vec4 &p, __m256 x, __m256 y, __m256 z) const
+		{
+			__m256 distance = _mm256_mul_ps(_mm256_set1_ps(p.x), x);
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(p.y), y));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(p.z), z));
+			return _mm256_add_ps(distance, _mm256_set1_ps(p.w));
+		}
+
+		FRUSTUM_TARGET_AVX __m256 testAVX(const SphereBounds &b, uint32_t i, uint32_t plane) const
+		{
+			const __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(b.radius + i));
+			return _mm256_cmp_ps(distanceAVX(planes[plane], _mm256_loadu_ps(b.x + i), _mm256_loadu_ps(b.y + i), _mm256_loadu_ps(b.z + i)), negRadius, _CMP_NLE_UQ);
+		}
+
+		FRUSTUM_TARGET_AVX __m256 testAVX(const AABBBounds &b, uint32_t i, uint32_t plane) const
+		{
+			const glm::vec4 &p = planes[plane];
+			__m256 radius = _mm256_mul_ps(_mm256_set1_ps(fabsf(p.x)), _mm256_loadu_ps(b.extentX + i));
+			radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_set1_ps(fabsf(p.y)), _mm256_loadu_ps(b.extentY + i)));
+			radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_set1_ps(fabsf(p.z)), _mm256_loadu_ps(b.extentZ + i)));
+			const __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), radius);
+			return _mm256_cmp_ps(distanceAVX(p, _mm256_loadu_ps(b.centerX + i), _mm256_loadu_ps(b.centerY + i), _mm256_loadu_ps(b.centerZ + i)), negRadius, _CMP_NLE_UQ);
+		}
+
+		template<typename Bounds>
+		FRUSTUM_TARGET_AVX uint32_t testBlockAVX(const Bounds &bounds, uint32_t first, uint32_t firstPlane, uint32_t &rejectingPlane) const
+		{
+			__m256 visible = testAVX(bounds, first, firstPlane);
+			uint32_t mask = (uint32_t)_mm256_movemask_ps(visible);
+			rejectingPlane = firstPlane;
+			for (uint32_t step = 1; step < planes.size() && mask != 0; step++) {
+				const uint32_t plane = planeOrder(step, firstPlane);
+				visible = _mm256_and_ps(visible, testAVX(bounds, first, plane));
+				mask = (uint32_t)_mm256_movemask_ps(visible);
+				rejectingPlane = plane;
+			}
+			return mask;
+		}
+#endif
+
+#if defined(FRUSTUM_SIMD_NEON)
+		float32x4_t distanceNEON(const glm::vec4 &p, float32x4_t x, float32x4_t y, float32x4_t z) const
+		{
+			float32x4_t distance = vmulq_n_f32(x, p.x);
+			distance = vaddq_f32(distance, vmulq_n_f32(y, p.y));
+			distance = vaddq_f32(distance, vmulq_n_f32(z, p.z));
+			return vaddq_f32(distance, vdupq_n_f32(p.w));
+		}
+
+		uint32x4_t testNEON(const SphereBounds &b, uint32_t i, uint32_t plane) const
+		{
+			const float32x4_t negRadius = vnegq_f32(vld1q_f32(b.radius + i));
+			return vmvnq_u32(vcleq_f32(distanceNEON(planes[plane], vld1q_f32(b.x + i), vld1q_f32(b.y + i), vld1q_f32(b.z + i)), negRadius));
+		}
+
+		uint32x4_t testNEON(const AABBBounds &b, uint32_t i, uint32_t plane) const
+		{
+			const glm::vec4 &p = planes[plane];
+			float32x4_t radius = vmulq_n_f32(vld1q_f32(b.extentX + i), fabsf(p.x));
+			radius = vaddq_f32(radius, vmulq_n_f32(vld1q_f32(b.extentY + i), fabsf(p.y)));
+			radius = vaddq_f32(radius, vmulq_n_f32(vld1q_f32(b.extentZ + i), fabsf(p.z)));
+			return vmvnq_u32(vcleq_f32(distanceNEON(p, vld1q_f32(b.centerX + i), vld1q_f32(b.centerY + i), vld1q_f32(b.centerZ + i)), vnegq_f32(radius)));
+		}
+
+		static uint32_t movemaskNEON(uint32x4_t value)
+		{
+			const int32_t shiftValues[4] = { 0, 1, 2, 3 };
+			const uint32x4_t bits = vshlq_u32(vshrq_n_u32(value, 31), vld1q_s32(shiftValues));
+			return vgetq_lane_u32(bits, 0) | vgetq_lane_u32(bits, 1) | vgetq_lane_u32(bits, 2) | vgetq_lane_u32(bits, 3);
+		}
+
+		template<typename Bounds>
+		uint32_t testBlockNEON(const Bounds &bounds, uint32_t first, uint32_t firstPlane, uint32_t &rejectingPlane) const
+		{
+			uint32x4_t visibleLow = testNEON(bounds, first, firstPlane);
+			uint32x4_t visibleHigh = testNEON(bounds, first + 4, firstPlane);
+			uint32_t mask = movemaskNEON(visibleLow) | (movemaskNEON(visibleHigh) << 4);
+			rejectingPlane = firstPlane;
+			for (uint32_t step = 1; step < planes.size() && mask != 0; step++) {
+				const uint32_t plane = planeOrder(step, firstPlane);
+				visibleLow = vandq_u32(visibleLow, testNEON(bounds, first, plane));
+				visibleHigh = vandq_u32(visibleHigh, testNEON(bounds, first + 4, plane));
+				mask = movemaskNEON(visibleLow) | (movemaskNEON(visibleHigh) << 4);
+				rejectingPlane = plane;
+			}
+			return mask;
+		}
+#endif
+
+		template<typename Bounds>
+		uint32_t testBlock(const Bounds &bounds, uint32_t first, uint32_t count, uint32_t firstPlane, uint32_t &rejectingPlane) const
+		{
+			// Partial blocks at the end of a batch always take the scalar path
+			if (count == hintBlockSize) {
+				switch (instructionSet) {
+#if defined(FRUSTUM_SIMD_SSE)
+				case InstructionSet::SSE:
+					return testBlockSSE(bounds, first, firstPlane, rejectingPlane);
+#endif
+#if defined(FRUSTUM_SIMD_AVX)
+				case InstructionSet::AVX:
+					return testBlockAVX(bounds, first, firstPlane, rejectingPlane);
+#endif
+#if defined(FRUSTUM_SIMD_NEON)
+				case InstructionSet::NEON:
+					return testBlockNEON(bounds, first, firstPlane, rejectingPlane);
+#endif
+				default:
+					break;
+				}
+			}
+			return testBlockScalar(bounds, first, count, firstPlane, rejectingPlane);
+		}
+
+		template<typename Bounds>
+		uint32_t cull(const Bounds &bounds, uint32_t count, uint32_t *visibleMask, uint32_t *visibleIndices, uint32_t indexOffset, uint8_t *planeHints) const
+		{
+			assert(instructionSetSupported(instructionSet));
+			uint32_t visibleCount = 0;
+			for (uint32_t first = 0, block = 0; first < count; first += hintBlockSize, block++) {
+				const uint32_t blockCount = std::min(count - first, uint32_t(hintBlockSize));
+				const uint32_t hint = (planeHints && planeHints[block] < planes.size()) ? planeHints[block] : 0;
+				uint32_t rejectingPlane = hint;
+				const uint32_t mask = testBlock(bounds, first, blockCount, hint, rejectingPlane);
+				if (planeHints && mask == 0) {
+					// Test the plane that culled the block first next time, bounds moving only a little are likely to be culled by it again
+					planeHints[block] = (uint8_t)rejectingPlane;
+				}
+				if (visibleMask) {
+					// Blocks are aligned to eight bounds, so a block never straddles two mask words
+					if ((first & 31) == 0) {
+						visibleMask[first / 32] = 0;
+					}
+					visibleMask[first / 32] |= mask << (first & 31);
+					visibleCount += popcount(mask);
+				}
+				else {
+					uint32_t bits = mask;
+					while (bits) {
+						visibleIndices[visibleCount++] = indexOffset + first + ctz(bits);
+						bits &= bits - 1;
+					}
+				}
+			}
+			return visibleCount;
+		}
 	};
 }
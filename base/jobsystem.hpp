@@ -0,0 +1,421 @@
+/*
+* Work stealing job system
+*
+* Every worker owns a Chase-Lev deque: it pushes and pops jobs at the bottom, idle workers steal from the top of other deques
+* Job callables are stored inline in the job (no heap allocation per job), idle workers spin for a while and then park on a condition variable
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "cpuprofiler.hpp"
+
+namespace vks
+{
+	// Number of unfinished jobs, used to wait for a group of jobs
+	class JobCounter
+	{
+	public:
+		std::atomic<uint32_t> value;
+
+		JobCounter() : value(0) {}
+
+		bool done() const
+		{
+			return value.load(std::memory_order_acquire) == 0;
+		}
+	};
+
+	struct Job
+	{
+		// Size of the inline storage for the job's callable, larger callables are rejected at compile time
+		static const size_t storageSize = 64;
+
+		void (*execute)(Job*);
+		JobCounter *counter;
+		// Set while the job slot is queued or executing, so the slot isn't reused too early
+		std::atomic<bool> inUse;
+		typename std::aligned_storage<storageSize, alignof(std::max_align_t)>::type storage;
+
+		Job() : execute(nullptr), counter(nullptr), inUse(false) {}
+	};
+
+	// Lock-free single owner, multi thief deque (Chase and Lev, with the C11 memory orderings from Le et al.)
+	// Fixed capacity, push fails if the deque is full
+	class JobDeque
+	{
+	private:
+		static const int64_t capacity = 4096;
+		// Keep the indices written by thieves and by the owner on separate cache lines
+		std::atomic<int64_t> top;
+		char padding[64];
+		std::atomic<int64_t> bottom;
+		std::atomic<Job*> buffer[capacity];
+
+	public:
+		JobDeque() : top(0), bottom(0)
+		{
+			for (auto &slot : buffer) {
+				slot.store(nullptr, std::memory_order_relaxed);
+			}
+		}
+
+		// Owner only
+		bool push(Job *job)
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed);
+			const int64_t t = top.load(std::memory_order_acquire);
+			if (b - t >= capacity) {
+				return false;
+			}
+			buffer[b & (capacity - 1)].store(job, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		// Owner only
+		Job* pop()
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_relaxed);
+			if (t > b) {
+				// Empty
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			Job *job = buffer[b & (capacity - 1)].load(std::memory_order_relaxed);
+			if (t == b) {
+				// Last job, race against thieves
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+					job = nullptr;
+				}
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		// Any thread
+		Job* steal()
+		{
+			int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t b = bottom.load(std::memory_order_acquire);
+			if (t >= b) {
+				return nullptr;
+			}
+			Job *job = buffer[t & (capacity - 1)].load(std::memory_order_relaxed);
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				return nullptr;
+			}
+			return job;
+		}
+	};
+
+	class JobSystem
+	{
+	private:
+		// Number of job slots each worker can have in flight
+		static const uint32_t jobPoolSize = 4096;
+		// Number of unsuccessful attempts to find a job before an idle worker parks
+		static const uint32_t spinCount = 256;
+
+		struct Worker
+		{
+			JobDeque deque;
+			std::vector<Job> jobPool;
+			uint32_t nextJob = 0;
+			uint32_t stealIndex = 0;
+			Worker() : jobPool(jobPoolSize) {}
+		};
+
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::vector<std::thread> threads;
+		std::atomic<bool> destroying;
+		// Number of jobs that have been queued but not yet picked up by any worker
+		std::atomic<uint32_t> queuedJobs;
+		std::atomic<uint32_t> sleepingWorkers;
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+
+		// Jobs submitted by threads that are not part of this job system
+		std::mutex externalMutex;
+		std::deque<Job*> externalJobs;
+		std::mutex externalPoolMutex;
+		std::vector<Job> externalJobPool;
+		uint32_t nextExternalJob = 0;
+
+		struct ThreadContext
+		{
+			JobSystem *owner;
+			uint32_t index;
+		};
+
+		static ThreadContext& threadContext()
+		{
+			static thread_local ThreadContext context = { nullptr, 0 };
+			return context;
+		}
+
+		// Index of the calling thread's worker or UINT32_MAX for external threads
+		uint32_t currentWorker()
+		{
+			ThreadContext &context = threadContext();
+			return (context.owner == this) ? context.index : UINT32_MAX;
+		}
+
+		template<typename F>
+		static void executeCallable(Job *job)
+		{
+			F *callable = reinterpret_cast<F*>(&job->storage);
+			(*callable)();
+			callable->~F();
+		}
+
+		// Returns the next slot of a job ring or nullptr if that slot is still in use
+		Job* allocateJob(std::vector<Job> &pool, uint32_t &next)
+		{
+			Job *job = &pool[next];
+			if (job->inUse.load(std::memory_order_acquire)) {
+				return nullptr;
+			}
+			next = (next + 1) % static_cast<uint32_t>(pool.size());
+			job->inUse.store(true, std::memory_order_relaxed);
+			return job;
+		}
+
+		Job* findJob(uint32_t workerIndex)
+		{
+			Job *job = nullptr;
+			if (workerIndex != UINT32_MAX) {
+				job = workers[workerIndex]->deque.pop();
+			}
+			if (!job) {
+				// Try to steal from the other workers, starting at a different one each time to spread out contention
+				const uint32_t count = static_cast<uint32_t>(workers.size());
+				uint32_t start = (workerIndex != UINT32_MAX) ? workers[workerIndex]->stealIndex++ : 0;
+				for (uint32_t i = 0; i < count && !job; i++) {
+					const uint32_t victim = (start + i) % count;
+					if (victim != workerIndex) {
+						job = workers[victim]->deque.steal();
+					}
+				}
+			}
+			if (!job) {
+				std::lock_guard<std::mutex> lock(externalMutex);
+				if (!externalJobs.empty()) {
+					job = externalJobs.front();
+					externalJobs.pop_front();
+				}
+			}
+			if (job) {
+				queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		void execute(Job *job)
+		{
+			JobCounter *counter = job->counter;
+			job->execute(job);
+			job->inUse.store(false, std::memory_order_release);
+			if (counter) {
+				counter->value.fetch_sub(1, std::memory_order_acq_rel);
+			}
+		}
+
+		void wake()
+		{
+			if (sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				sleepCondition.notify_one();
+			}
+		}
+
+		void workerLoop(uint32_t index)
+		{
+			threadContext().owner = this;
+			threadContext().index = index;
+			VKS_PROFILE_THREAD_NAME("Job worker " + std::to_string(index));
+			uint32_t idleCount = 0;
+			while (!destroying.load(std::memory_order_acquire)) {
+				if (executeNext()) {
+					idleCount = 0;
+					continue;
+				}
+				if (++idleCount < spinCount) {
+					std::this_thread::yield();
+					continue;
+				}
+				// Park until new work arrives, the timeout guards against missed wake ups
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+				if ((queuedJobs.load(std::memory_order_seq_cst) == 0) && !destroying.load(std::memory_order_acquire)) {
+					sleepCondition.wait_for(lock, std::chrono::milliseconds(1));
+				}
+				sleepingWorkers.fetch_sub(1, std::memory_order_seq_cst);
+				idleCount = 0;
+			}
+		}
+
+	public:
+		JobSystem() : destroying(false), queuedJobs(0), sleepingWorkers(0) {}
+
+		~JobSystem()
+		{
+			destroy();
+		}
+
+		// Creates the job system with the calling thread as worker 0 and threadCount - 1 additional worker threads
+		void create(uint32_t threadCount = std::thread::hardware_concurrency())
+		{
+			assert(workers.empty());
+			threadCount = std::max(threadCount, 1u);
+			destroying = false;
+			externalJobPool = std::vector<Job>(jobPoolSize);
+			for (uint32_t i = 0; i < threadCount; i++) {
+				workers.push_back(std::unique_ptr<Worker>(new Worker()));
+			}
+			threadContext().owner = this;
+			threadContext().index = 0;
+			for (uint32_t i = 1; i < threadCount; i++) {
+				threads.push_back(std::thread(&JobSystem::workerLoop, this, i));
+			}
+		}
+
+		void destroy()
+		{
+			if (workers.empty()) {
+				return;
+			}
+			destroying = true;
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				sleepCondition.notify_all();
+			}
+			for (auto &thread : threads) {
+				thread.join();
+			}
+			threads.clear();
+			workers.clear();
+			if (threadContext().owner == this) {
+				threadContext().owner = nullptr;
+			}
+		}
+
+		uint32_t threadCount() const
+		{
+			return static_cast<uint32_t>(workers.size());
+		}
+
+		// Index of the worker executing the calling code (0 is the thread that created the job system)
+		// Can be used to select per-thread resources inside of jobs
+		uint32_t workerIndex()
+		{
+			const uint32_t index = currentWorker();
+			return (index != UINT32_MAX) ? index : 0;
+		}
+
+		// Queues a job, if a counter is passed it's incremented now and decremented once the job has finished
+		template<typename F>
+		void run(F &&function, JobCounter *counter = nullptr)
+		{
+			typedef typename std::decay<F>::type Callable;
+			static_assert(sizeof(Callable) <= Job::storageSize, "Job callable exceeds the inline storage size");
+			static_assert(alignof(Callable) <= alignof(std::max_align_t), "Job callable is over-aligned");
+
+			const uint32_t index = currentWorker();
+			Job *job = nullptr;
+			if (index != UINT32_MAX) {
+				Worker &worker = *workers[index];
+				job = allocateJob(worker.jobPool, worker.nextJob);
+			} else {
+				std::lock_guard<std::mutex> lock(externalPoolMutex);
+				job = allocateJob(externalJobPool, nextExternalJob);
+			}
+			if (!job) {
+				// The job ring is full (e.g. all threads are busy and lots of jobs are queued), run the job right away instead of waiting for a free slot
+				// Waiting could deadlock if the slot belongs to a job further up the calling thread's stack
+				function();
+				return;
+			}
+			new (&job->storage) Callable(std::forward<F>(function));
+			job->execute = &executeCallable<Callable>;
+			job->counter = counter;
+			if (counter) {
+				counter->value.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+			if (index != UINT32_MAX) {
+				if (!workers[index]->deque.push(job)) {
+					// Deque is full, run the job right away
+					queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+					execute(job);
+					return;
+				}
+			} else {
+				std::lock_guard<std::mutex> lock(externalMutex);
+				externalJobs.push_back(job);
+			}
+			wake();
+		}
+
+		// Runs one queued job on the calling thread, returns false if no job was found
+		bool executeNext()
+		{
+			Job *job = findJob(currentWorker());
+			if (!job) {
+				return false;
+			}
+			execute(job);
+			return true;
+		}
+
+		// Waits until all jobs of the counter have finished, the calling thread executes other jobs in the meantime
+		void wait(JobCounter &counter)
+		{
+			while (!counter.done()) {
+				if (!executeNext()) {
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		// Calls function(begin, end) for sub ranges of [first..last) with at most grainSize elements in parallel and waits for all of them
+		template<typename F>
+		void parallel_for(uint32_t first, uint32_t last, uint32_t grainSize, const F &function)
+		{
+			JobCounter counter;
+			grainSize = std::max(grainSize, 1u);
+			const F *callable = &function;
+			for (uint32_t begin = first; begin < last; begin += grainSize) {
+				const uint32_t end = std::min(begin + grainSize, last);
+				run([callable, begin, end]() { (*callable)(begin, end); }, &counter);
+			}
+			wait(counter);
+		}
+	};
+}
@@ -0,0 +1,261 @@
+/*
+* Task graph for the CPU work of a frame
+*
+* Tasks declare the resources they read and write (or explicit edges), dependencies are derived from the declaration order
+* Tasks run on a job system as soon as all of their dependencies have finished, so independent tasks run concurrently
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include "jobsystem.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	class TaskGraph
+	{
+	public:
+		typedef uint32_t Task;
+		typedef uint32_t Resource;
+
+		struct TaskInfo
+		{
+			std::string name;
+			/** @brief CPU time of the last execution in milliseconds */
+			double duration = 0.0;
+		};
+
+	private:
+		struct TaskData
+		{
+			TaskInfo info;
+			std::function<void()> function;
+			std::vector<Resource> reads;
+			std::vector<Resource> writes;
+			std::vector<Task> dependents;
+			uint32_t dependencyCount = 0;
+		};
+		std::vector<TaskData> tasks;
+		std::vector<std::string> resources;
+		std::vector<std::pair<Task, Task>> edges;
+		// Number of unfinished dependencies per task for the running execution
+		std::unique_ptr<std::atomic<uint32_t>[]> pending;
+		JobSystem *jobSystem = nullptr;
+		JobCounter counter;
+		bool compiled = false;
+		bool launched = false;
+
+		void addDependent(Task before, Task after)
+		{
+			std::vector<Task> &dependents = tasks[before].dependents;
+			if (before != after && std::find(dependents.begin(), dependents.end(), after) == dependents.end()) {
+				dependents.push_back(after);
+				tasks[after].dependencyCount++;
+			}
+		}
+
+		void runTask(Task task)
+		{
+			jobSystem->run([this, task]() {
+				TaskData &data = tasks[task];
+				auto tStart = std::chrono::high_resolution_clock::now();
+				data.function();
+				data.info.duration = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+				// Dependents are queued before this job completes, so the counter can't reach zero while tasks are outstanding
+				for (Task dependent : data.dependents) {
+					if (pending[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+						runTask(dependent);
+					}
+				}
+			}, &counter);
+		}
+
+	public:
+		~TaskGraph()
+		{
+			wait();
+		}
+
+		/** @brief Adds a named resource that tasks can declare read or write access to */
+		Resource addResource(const std::string &name)
+		{
+			assert(!launched);
+			resources.push_back(name);
+			compiled = false;
+			return static_cast<Resource>(resources.size() - 1);
+		}
+
+		/**
+		* Adds a task to the graph
+		*
+		* @param name Name of the task (for statistics)
+		* @param function Work done by the task
+		* @param reads Resources read by the task, the task runs after the last task declared before it that writes any of them
+		* @param writes Resources written by the task, the task runs after all tasks declared before it that access any of them
+		*
+		* @return Handle of the task, can be used to add explicit dependencies
+		*/
+		Task addTask(const std::string &name, std::function<void()> function, const std::vector<Resource> &reads = {}, const std::vector<Resource> &writes = {})
+		{
+			assert(!launched);
+			TaskData task;
+			task.info.name = name;
+			task.function = std::move(function);
+			task.reads = reads;
+			task.writes = writes;
+			tasks.push_back(std::move(task));
+			compiled = false;
+			return static_cast<Task>(tasks.size() - 1);
+		}
+
+		/** @brief Adds an explicit dependency, "after" won't start before "before" has finished */
+		void addDependency(Task before, Task after)
+		{
+			assert(!launched);
+			edges.push_back(std::make_pair(before, after));
+			compiled = false;
+		}
+
+		/** @brief Removes all tasks, resources and dependencies */
+		void clear()
+		{
+			wait();
+			tasks.clear();
+			resources.clear();
+			edges.clear();
+			compiled = false;
+		}
+
+		/** @brief Derives the dependencies between tasks from their resource accesses, called on the first launch if required */
+		void compile()
+		{
+			assert(!launched);
+			for (auto &task : tasks) {
+				task.dependents.clear();
+				task.dependencyCount = 0;
+			}
+			// Last writer and readers since the last write for each resource, in declaration order
+			std::vector<uint32_t> lastWriter(resources.size(), UINT32_MAX);
+			std::vector<std::vector<Task>> readers(resources.size());
+			for (Task t = 0; t < tasks.size(); t++) {
+				for (Resource r : tasks[t].reads) {
+					assert(r < resources.size());
+					if (lastWriter[r] != UINT32_MAX) {
+						addDependent(lastWriter[r], t);
+					}
+					readers[r].push_back(t);
+				}
+				for (Resource r : tasks[t].writes) {
+					assert(r < resources.size());
+					if (lastWriter[r] != UINT32_MAX) {
+						addDependent(lastWriter[r], t);
+					}
+					for (Task reader : readers[r]) {
+						addDependent(reader, t);
+					}
+					readers[r].clear();
+					lastWriter[r] = t;
+				}
+			}
+			for (auto &edge : edges) {
+				assert(edge.first < tasks.size() && edge.second < tasks.size());
+				addDependent(edge.first, edge.second);
+			}
+			// Explicit edges may point backwards, so make sure the graph is still acyclic
+			std::vector<uint32_t> dependencyCounts(tasks.size());
+			std::vector<Task> ready;
+			for (Task t = 0; t < tasks.size(); t++) {
+				dependencyCounts[t] = tasks[t].dependencyCount;
+				if (dependencyCounts[t] == 0) {
+					ready.push_back(t);
+				}
+			}
+			size_t visited = 0;
+			while (!ready.empty()) {
+				Task t = ready.back();
+				ready.pop_back();
+				visited++;
+				for (Task dependent : tasks[t].dependents) {
+					if (--dependencyCounts[dependent] == 0) {
+						ready.push_back(dependent);
+					}
+				}
+			}
+			if (visited != tasks.size()) {
+				vks::tools::exitFatal("The task graph contains a dependency cycle", -1);
+			}
+			pending.reset(new std::atomic<uint32_t>[tasks.size()]);
+			compiled = true;
+		}
+
+		/** @brief Starts executing the graph on the given job system and returns immediately, call wait() before touching data written by the tasks */
+		void launch(JobSystem &jobSystem)
+		{
+			wait();
+			if (!compiled) {
+				compile();
+			}
+			this->jobSystem = &jobSystem;
+			launched = true;
+			for (Task t = 0; t < tasks.size(); t++) {
+				pending[t].store(tasks[t].dependencyCount, std::memory_order_relaxed);
+			}
+			for (Task t = 0; t < tasks.size(); t++) {
+				if (tasks[t].dependencyCount == 0) {
+					runTask(t);
+				}
+			}
+		}
+
+		/** @brief Waits for the tasks of the last launch to finish, the calling thread helps executing jobs while waiting */
+		void wait()
+		{
+			if (launched) {
+				jobSystem->wait(counter);
+				launched = false;
+			}
+		}
+
+		/** @brief Executes all tasks and waits for them to finish */
+		void execute(JobSystem &jobSystem)
+		{
+			launch(jobSystem);
+			wait();
+		}
+
+		bool running() const
+		{
+			return launched;
+		}
+
+		bool empty() const
+		{
+			return tasks.empty();
+		}
+
+		uint32_t taskCount() const
+		{
+			return static_cast<uint32_t>(tasks.size());
+		}
+
+		/** @brief Returns the name and last duration of a task, only valid while the graph isn't running */
+		const TaskInfo &taskInfo(Task task) const
+		{
+			return tasks[task].info;
+		}
+	};
+}
@@ -31,28 +31,31 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	appInfo.pEngineName = name.c_str();
 	appInfo.apiVersion = apiVersion;
 
+	// VK_KHR_surface is also required in headless offscreen mode, as the swapchain device extension depends on it
 	std::vector<const char*> instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
 
-	// Enable surface extensions depending on os
+	// Enable surface extensions depending on os, no window system is used in headless offscreen mode
+	if (!settings.headlessOffscreen) {
 #if defined(_WIN32)
-	instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
-	instanceExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
 #elif defined(_DIRECT2DISPLAY)
-	instanceExtensions.push_back(VK_KHR_DISPLAY_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_DISPLAY_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_DIRECTFB_EXT)
-	instanceExtensions.push_back(VK_EXT_DIRECTFB_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_EXT_DIRECTFB_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	instanceExtensions.push_back(VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	instanceExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_IOS_MVK)
-	instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_MACOS_MVK)
-	instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_HEADLESS_EXT)
-	instanceExtensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
 #endif
+	}
 	
 	// Get extensions supported by the instance and store for later use
 	uint32_t extCount = 0;
@@ -152,10 +155,19 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 
 void VulkanExampleBase::renderFrame()
 {
+	// Results of the frame graph tasks launched during the previous frame are used to build this frame
+	{
+		VKS_PROFILE_SCOPE("Wait for frame graph");
+		frameGraph.wait();
+	}
 	VulkanExampleBase::prepareFrame();
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	{
+		VKS_PROFILE_SCOPE("Submit");
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	}
+	launchFrameGraph();
 	VulkanExampleBase::submitFrame();
 }
 
@@ -203,6 +215,7 @@ void VulkanExampleBase::createPipelineCache()
 
 void VulkanExampleBase::prepare()
 {
+	VKS_PROFILE_SCOPE("VulkanExampleBase::prepare");
 	initSwapchain();
 	createCommandPool();
 	setupSwapChain();
@@ -211,7 +224,13 @@ void VulkanExampleBase::prepare()
 	setupDepthStencil();
 	setupRenderPass();
 	createPipelineCache();
+	pipelineCompiler.create(device, pipelineCache);
+	descriptorAllocator.create(device, static_cast<uint32_t>(drawCmdBuffers.size()));
 	setupFrameBuffer();
+	if (!captureFile.empty()) {
+		frameCapture.create(vulkanDevice, width, height, swapChain.colorFormat, swapChain.imageUsage, static_cast<uint32_t>(swapChain.imageCount));
+	}
+	gpuProfiler.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics);
 	settings.overlay = settings.overlay && (!benchmark.active);
 	if (settings.overlay) {
 		UIOverlay.device = vulkanDevice;
@@ -221,28 +240,38 @@ void VulkanExampleBase::prepare()
 			loadShader(getShadersPath() + "base/uioverlay.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
 		};
 		UIOverlay.prepareResources();
-		UIOverlay.preparePipeline(pipelineCache, renderPass, swapChain.colorFormat, depthFormat);
+		if (settings.overlayPass) {
+			createOverlayPass();
+			// One geometry slot more than overlay passes can be in flight, so updates never have to wait for the GPU
+			UIOverlay.slotCount = swapChain.imageCount + 1;
+			UIOverlay.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+			UIOverlay.subpass = 0;
+			UIOverlay.preparePipeline(pipelineCache, overlayPass.renderPass, swapChain.colorFormat, depthFormat);
+		}
+		else {
+			UIOverlay.preparePipeline(pipelineCache, renderPass, swapChain.colorFormat, depthFormat);
+		}
 	}
 }
 
 VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileName, VkShaderStageFlagBits stage)
 {
+	VKS_PROFILE_SCOPE("loadShader");
 	VkPipelineShaderStageCreateInfo shaderStage = {};
 	shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shaderStage.stage = stage;
-#if defined(VK_USE_PLATFORM_ANDROID_KHR)
-	shaderStage.module = vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
-#else
-	shaderStage.module = vks::tools::loadShader(fileName.c_str(), device);
-#endif
+	shaderStage.module = shaderCache.load(fileName);
 	shaderStage.pName = "main";
 	assert(shaderStage.module != VK_NULL_HANDLE);
-	shaderModules.push_back(shaderStage.module);
+	if (std::find(shaderModules.begin(), shaderModules.end(), shaderStage.module) == shaderModules.end()) {
+		shaderModules.push_back(shaderStage.module);
+	}
 	return shaderStage;
 }
 
 void VulkanExampleBase::nextFrame()
 {
+	VKS_PROFILE_SCOPE("Frame");
 	auto tStart = std::chrono::high_resolution_clock::now();
 	if (viewUpdated)
 	{
@@ -250,7 +279,10 @@ void VulkanExampleBase::nextFrame()
 		viewChanged();
 	}
 
-	render();
+	{
+		VKS_PROFILE_SCOPE("render");
+		render();
+	}
 	frameCounter++;
 	auto tEnd = std::chrono::high_resolution_clock::now();
 #if (defined(VK_USE_PLATFORM_IOS_MVK) || (defined(VK_USE_PLATFORM_MACOS_MVK) && !defined(VK_EXAMPLE_XCODE_GENERATED)))
@@ -274,6 +306,15 @@ void VulkanExampleBase::nextFrame()
 			timer -= 1.0f;
 		}
 	}
+	if (recordCameraPath)
+	{
+		vks::CameraPath::Keyframe keyframe;
+		keyframe.frame = cameraPathFrame++;
+		keyframe.position = camera.position;
+		keyframe.rotation = camera.rotation;
+		keyframe.timer = timer;
+		cameraPath.addKeyframe(keyframe);
+	}
 	float fpsTimer = (float)(std::chrono::duration<double, std::milli>(tEnd - lastTimestamp).count());
 	if (fpsTimer > 1000.0f)
 	{
@@ -288,22 +329,128 @@ void VulkanExampleBase::nextFrame()
 		lastTimestamp = tEnd;
 	}
 	tPrevEnd = tEnd;
-	
-	// TODO: Cap UI overlay update rates
+
+	// The overlay caps its update rate itself
 	updateOverlay();
 }
 
+void VulkanExampleBase::runBenchmark()
+{
+	// Describe the run for the results, so they can be compared across machines and settings
+	benchmark.title = title;
+	benchmark.width = width;
+	benchmark.height = height;
+	benchmark.settings = {
+		{ "validation", settings.validation ? "true" : "false" },
+		{ "fullscreen", settings.fullscreen ? "true" : "false" },
+		{ "vsync", settings.vsync ? "true" : "false" },
+		{ "presentation", settings.headlessOffscreen ? "offscreen" : "swapchain" },
+		{ "shaders", shaderDir }
+	};
+	std::string arguments;
+	for (size_t i = 1; i < args.size(); i++) {
+		arguments += (i > 1 ? " " : "") + std::string(args[i]);
+	}
+	benchmark.settings.push_back({ "arguments", arguments });
+	if (!captureFile.empty()) {
+		benchmark.settings.push_back({ "capture", captureFile });
+	}
+	const vks::ShaderCache::Statistics shaderStatistics = shaderCache.statistics();
+	std::stringstream shaderSummary;
+	shaderSummary << shaderStatistics.modulesCreated << " created, " << (shaderStatistics.pathHits + shaderStatistics.contentHits) << " reused, "
+		<< shaderStatistics.readTime << " ms read, " << shaderStatistics.creationTime << " ms create";
+	benchmark.settings.push_back({ "shadermodules", shaderSummary.str() });
+	// Frames are only measured once all pipelines are final, so runs don't depend on how long fallbacks were in use
+	pipelineCompiler.wait();
+	const vks::PipelineCompiler::Statistics pipelineStatistics = pipelineCompiler.statistics();
+	if (pipelineStatistics.pipelines > 0) {
+		std::stringstream pipelineSummary;
+		pipelineSummary << pipelineStatistics.pipelines << " compiled, " << pipelineStatistics.wallTime << " ms wall clock, " << pipelineStatistics.compileTime << " ms compile";
+		benchmark.settings.push_back({ "pipelines", pipelineSummary.str() });
+	}
+	if (!cameraPath.empty()) {
+		// Render every frame of the path exactly once, each viewpoint gets its own statistics
+		benchmark.settings.push_back({ "camerapath", cameraPathFile });
+		if (benchmark.outputFrames == -1) {
+			benchmark.outputFrames = cameraPath.frameCount();
+			benchmark.fixedFrameCount = true;
+		}
+		benchmark.sections.clear();
+		for (auto &viewpoint : cameraPath.viewpoints) {
+			vks::Benchmark::Section section;
+			section.name = viewpoint.name;
+			benchmark.sections.push_back(section);
+		}
+		if (benchmarkTimestep == 0.0f) {
+			benchmarkTimestep = 1000.0f / 60.0f;
+		}
+	}
+	if (benchmarkTimestep > 0.0f) {
+		benchmark.settings.push_back({ "timestep", std::to_string(benchmarkTimestep) });
+	}
+	// Animations restart with the benchmark phase, so all runs render the same frames no matter how long the warm up took
+	const float startTimer = timer;
+	// GPU timings only cover the frames after the warm up
+	benchmark.warmupFinished = [this, startTimer]() {
+		gpuProfiler.resetStatistics();
+		cameraPathFrame = 0;
+		timer = startTimer;
+	};
+	benchmark.runFinished = [this]() {
+		vkDeviceWaitIdle(device);
+		gpuProfiler.collect();
+		benchmark.gpuTimings.clear();
+		for (auto &scope : gpuProfiler.scopes()) {
+			if (scope.samples > 0) {
+				vks::Benchmark::GPUTiming timing;
+				timing.name = scope.name;
+				timing.avg = scope.total / scope.samples;
+				timing.min = scope.min;
+				timing.max = scope.max;
+				timing.samples = scope.samples;
+				benchmark.gpuTimings.push_back(timing);
+			}
+		}
+	};
+	benchmark.run([=] { benchmarkFrame(); }, vulkanDevice->properties);
+	frameGraph.wait();
+	vkDeviceWaitIdle(device);
+	if (benchmark.filename != "") {
+		benchmark.saveResults();
+	}
+}
+
+void VulkanExampleBase::benchmarkFrame()
+{
+	// Without a camera path or fixed time step, frames are rendered without advancing animations
+	if (benchmarkTimestep > 0.0f) {
+		frameTimer = benchmarkTimestep / 1000.0f;
+	}
+	if (!cameraPath.empty()) {
+		const vks::CameraPath::Pose pose = cameraPath.pose(cameraPathFrame);
+		camera.setPosition(pose.position);
+		camera.setRotation(pose.rotation);
+		timer = pose.timer;
+		benchmark.currentSection = pose.viewpoint;
+		viewChanged();
+	}
+	else if (benchmarkTimestep > 0.0f) {
+		timer += timerSpeed * frameTimer;
+		if (timer > 1.0) {
+			timer -= 1.0f;
+		}
+	}
+	render();
+	cameraPathFrame++;
+}
+
 void VulkanExampleBase::renderLoop()
 {
 // SRS - for non-apple plaforms, handle benchmarking here within VulkanExampleBase::renderLoop()
 //     - for macOS, handle benchmarking within NSApp rendering loop via displayLinkOutputCb()
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 	if (benchmark.active) {
-		benchmark.run([=] { render(); }, vulkanDevice->properties);
-		vkDeviceWaitIdle(device);
-		if (benchmark.filename != "") {
-			benchmark.saveResults();
-		}
+		runBenchmark();
 		return;
 	}
 #endif
@@ -658,20 +805,43 @@ void VulkanExampleBase::renderLoop()
 	[NSApp run];
 #endif
 	// Flush device to make sure all resources can be freed
+	frameGraph.wait();
 	if (device != VK_NULL_HANDLE) {
 		vkDeviceWaitIdle(device);
 	}
 }
 
+void VulkanExampleBase::launchFrameGraph()
+{
+	if (frameGraph.empty()) {
+		return;
+	}
+	if (jobSystem.threadCount() == 0) {
+		jobSystem.create();
+	}
+	frameGraph.launch(jobSystem);
+}
+
 void VulkanExampleBase::updateOverlay()
 {
 	if (!settings.overlay)
 		return;
 
+	// Text like frame times doesn't need to change every frame, so the overlay is only updated at a fixed rate unless it's used with the mouse
+	overlayUpdateTimer += frameTimer;
+	const bool mouseInput = mouseButtons.left || mouseButtons.right || mouseButtons.middle || (mousePos != overlayMousePos);
+	if (!mouseInput && !UIOverlay.updated && (overlayUpdateTimer < settings.overlayUpdateInterval)) {
+		return;
+	}
+
+	VKS_PROFILE_SCOPE("updateOverlay");
+
 	ImGuiIO& io = ImGui::GetIO();
 
 	io.DisplaySize = ImVec2((float)width, (float)height);
-	io.DeltaTime = frameTimer;
+	io.DeltaTime = overlayUpdateTimer;
+	overlayUpdateTimer = 0.0f;
+	overlayMousePos = mousePos;
 
 	io.MousePos = ImVec2(mousePos.x, mousePos.y);
 	io.MouseDown[0] = mouseButtons.left && UIOverlay.visible;
@@ -693,6 +863,18 @@ void VulkanExampleBase::updateOverlay()
 #endif
 	ImGui::PushItemWidth(110.0f * UIOverlay.scale);
 	OnUpdateUIOverlay(&UIOverlay);
+	if (recordCameraPath && UIOverlay.header("Camera path")) {
+		UIOverlay.text("%s: %d frames", cameraPath.viewpoints.back().name.c_str(), cameraPathFrame);
+		if (UIOverlay.button("New viewpoint")) {
+			cameraPath.addViewpoint("viewpoint " + std::to_string(cameraPath.viewpoints.size() + 1));
+			cameraPathFrame = 0;
+		}
+	}
+	if (!gpuProfiler.scopes().empty() && UIOverlay.header("GPU timings")) {
+		for (auto &scope : gpuProfiler.scopes()) {
+			UIOverlay.text("%*s%s: %.3f ms", scope.depth * 2, "", scope.name.c_str(), scope.average);
+		}
+	}
 	ImGui::PopItemWidth();
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	ImGui::PopStyleVar();
@@ -702,7 +884,24 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::PopStyleVar();
 	ImGui::Render();
 
-	if (UIOverlay.update() || UIOverlay.updated) {
+	if (overlayPass.renderPass != VK_NULL_HANDLE) {
+		// Only overlay passes still reading the geometry slot that's written next have to finish
+		const uint32_t slot = UIOverlay.nextSlot();
+		for (size_t i = 0; i < overlayPass.fences.size(); i++) {
+			if (overlayPass.drawnSlots[i] == slot) {
+				VK_CHECK_RESULT(vkWaitForFences(device, 1, &overlayPass.fences[i], VK_TRUE, UINT64_MAX));
+			}
+		}
+		UIOverlay.update();
+		// The overlay itself doesn't need the example's command buffers, but a widget that changed a setting may affect what they record
+		if (UIOverlay.updated) {
+			VKS_PROFILE_SCOPE("buildCommandBuffers");
+			buildCommandBuffers();
+			UIOverlay.updated = false;
+		}
+	}
+	else if (UIOverlay.update() || UIOverlay.updated) {
+		VKS_PROFILE_SCOPE("buildCommandBuffers");
 		buildCommandBuffers();
 		UIOverlay.updated = false;
 	}
@@ -716,7 +915,8 @@ void VulkanExampleBase::updateOverlay()
 
 void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 {
-	if (settings.overlay && UIOverlay.visible) {
+	// With the overlay pass the overlay is drawn when the frame is submitted instead
+	if (settings.overlay && UIOverlay.visible && (overlayPass.renderPass == VK_NULL_HANDLE)) {
 		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 		const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
@@ -726,10 +926,169 @@ void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 	}
 }
 
+void VulkanExampleBase::createOverlayPass()
+{
+	// Loads the example's output and draws the overlay on top, the swap chain image is ready for presentation before and after the pass
+	VkAttachmentDescription attachment = {};
+	attachment.format = swapChain.colorFormat;
+	attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachment.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+	VkSubpassDescription subpassDescription = {};
+	subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDescription.colorAttachmentCount = 1;
+	subpassDescription.pColorAttachments = &colorReference;
+
+	// The example's writes to the swap chain image have to be finished before the overlay blends on top of them
+	VkSubpassDependency dependency = {};
+	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass = 0;
+	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = 1;
+	renderPassInfo.pAttachments = &attachment;
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpassDescription;
+	renderPassInfo.dependencyCount = 1;
+	renderPassInfo.pDependencies = &dependency;
+	VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &overlayPass.renderPass));
+
+	setupOverlayFrameBuffers();
+}
+
+void VulkanExampleBase::setupOverlayFrameBuffers()
+{
+	VkFramebufferCreateInfo frameBufferCreateInfo = vks::initializers::framebufferCreateInfo();
+	frameBufferCreateInfo.renderPass = overlayPass.renderPass;
+	frameBufferCreateInfo.attachmentCount = 1;
+	frameBufferCreateInfo.width = width;
+	frameBufferCreateInfo.height = height;
+	frameBufferCreateInfo.layers = 1;
+	overlayPass.frameBuffers.resize(swapChain.imageCount);
+	for (uint32_t i = 0; i < overlayPass.frameBuffers.size(); i++) {
+		frameBufferCreateInfo.pAttachments = &swapChain.buffers[i].view;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &overlayPass.frameBuffers[i]));
+	}
+
+	overlayPass.commandBuffers.resize(swapChain.imageCount);
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(overlayPass.commandBuffers.size()));
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, overlayPass.commandBuffers.data()));
+
+	VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+	overlayPass.fences.resize(swapChain.imageCount);
+	for (auto& fence : overlayPass.fences) {
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
+	}
+	overlayPass.drawnSlots.assign(swapChain.imageCount, UINT32_MAX);
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	overlayPass.complete.resize(swapChain.imageCount);
+	for (auto& semaphore : overlayPass.complete) {
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
+	}
+}
+
+void VulkanExampleBase::destroyOverlayFrameBuffers()
+{
+	for (auto& frameBuffer : overlayPass.frameBuffers) {
+		vkDestroyFramebuffer(device, frameBuffer, nullptr);
+	}
+	if (!overlayPass.commandBuffers.empty()) {
+		vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(overlayPass.commandBuffers.size()), overlayPass.commandBuffers.data());
+	}
+	for (auto& fence : overlayPass.fences) {
+		vkDestroyFence(device, fence, nullptr);
+	}
+	for (auto& semaphore : overlayPass.complete) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	overlayPass.frameBuffers.clear();
+	overlayPass.commandBuffers.clear();
+	overlayPass.fences.clear();
+	overlayPass.drawnSlots.clear();
+	overlayPass.complete.clear();
+}
+
+void VulkanExampleBase::destroyOverlayPass()
+{
+	if (overlayPass.renderPass == VK_NULL_HANDLE) {
+		return;
+	}
+	destroyOverlayFrameBuffers();
+	vkDestroyRenderPass(device, overlayPass.renderPass, nullptr);
+	overlayPass.renderPass = VK_NULL_HANDLE;
+}
+
+/**
+* Records and submits the overlay pass for the current swap chain image
+*
+* @param waitSemaphore Semaphore signalled once the example's rendering has finished
+*
+* @return Semaphore signalled once the overlay has been drawn, to be waited on by the presentation
+*/
+VkSemaphore VulkanExampleBase::submitOverlayPass(VkSemaphore waitSemaphore)
+{
+	VKS_PROFILE_SCOPE("Overlay pass");
+	VkFence fence = overlayPass.fences[currentBuffer];
+	VkCommandBuffer commandBuffer = overlayPass.commandBuffers[currentBuffer];
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+	VK_CHECK_RESULT(vkResetFences(device, 1, &fence));
+
+	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+	cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+	VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+	renderPassBeginInfo.renderPass = overlayPass.renderPass;
+	renderPassBeginInfo.framebuffer = overlayPass.frameBuffers[currentBuffer];
+	renderPassBeginInfo.renderArea.extent.width = width;
+	renderPassBeginInfo.renderArea.extent.height = height;
+	vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+	const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	UIOverlay.draw(commandBuffer);
+	overlayPass.drawnSlots[currentBuffer] = UIOverlay.currentSlot();
+	vkCmdEndRenderPass(commandBuffer);
+	VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+	VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	VkSubmitInfo overlaySubmitInfo = vks::initializers::submitInfo();
+	overlaySubmitInfo.waitSemaphoreCount = 1;
+	overlaySubmitInfo.pWaitSemaphores = &waitSemaphore;
+	overlaySubmitInfo.pWaitDstStageMask = &waitStageMask;
+	overlaySubmitInfo.signalSemaphoreCount = 1;
+	overlaySubmitInfo.pSignalSemaphores = &overlayPass.complete[currentBuffer];
+	overlaySubmitInfo.commandBufferCount = 1;
+	overlaySubmitInfo.pCommandBuffers = &commandBuffer;
+	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &overlaySubmitInfo, fence));
+	return overlayPass.complete[currentBuffer];
+}
+
 void VulkanExampleBase::prepareFrame()
 {
+	prepareFrame(semaphores.presentComplete);
+}
+
+void VulkanExampleBase::prepareFrame(VkSemaphore presentCompleteSemaphore)
+{
+	VKS_PROFILE_SCOPE("prepareFrame");
+	// Pick up the GPU timings of command buffers that have finished executing
+	gpuProfiler.collect();
 	// Acquire the next image from the swap chain
-	VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
+	VkResult result = swapChain.acquireNextImage(presentCompleteSemaphore, &currentBuffer);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE)
 	// SRS - If no longer optimal (VK_SUBOPTIMAL_KHR), wait until submitFrame() in case number of swapchain images will change on resize
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
@@ -745,7 +1104,20 @@ void VulkanExampleBase::prepareFrame()
 
 void VulkanExampleBase::submitFrame()
 {
-	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	submitFrame(semaphores.renderComplete, true);
+}
+
+void VulkanExampleBase::submitFrame(VkSemaphore renderCompleteSemaphore, bool waitIdle)
+{
+	VKS_PROFILE_SCOPE("submitFrame");
+	if ((overlayPass.renderPass != VK_NULL_HANDLE) && UIOverlay.visible) {
+		renderCompleteSemaphore = submitOverlayPass(renderCompleteSemaphore);
+	}
+	// The copy has to be submitted before presentation, as the image may no longer be accessed afterwards
+	if (!captureFile.empty()) {
+		renderCompleteSemaphore = frameCapture.capture(queue, swapChain.images[currentBuffer], VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, renderCompleteSemaphore, vks::FrameCapture::sequenceFilename(captureFile, captureFrame++));
+	}
+	VkResult result = swapChain.queuePresent(queue, currentBuffer, renderCompleteSemaphore);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		windowResize();
@@ -756,7 +1128,10 @@ void VulkanExampleBase::submitFrame()
 	else {
 		VK_CHECK_RESULT(result);
 	}
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	if (waitIdle) {
+		VKS_PROFILE_SCOPE("vkQueueWaitIdle");
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	}
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
@@ -789,11 +1164,19 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	commandLineParser.add("gpuselection", { "-g", "--gpu" }, 1, "Select GPU to run on");
 	commandLineParser.add("gpulist", { "-gl", "--listgpus" }, 0, "Display a list of available Vulkan devices");
 	commandLineParser.add("benchmark", { "-b", "--benchmark" }, 0, "Run example in benchmark mode");
-	commandLineParser.add("benchmarkwarmup", { "-bw", "--benchwarmup" }, 1, "Set warmup time for benchmark mode in seconds");
+	commandLineParser.add("benchmarkwarmup", { "-bw", "--benchwarmup" }, 1, "Set the maximum warmup time for benchmark mode in seconds");
+	commandLineParser.add("benchmarkfixedwarmup", { "-bfw", "--benchfixedwarmup" }, 0, "Always warm up for the full warmup time instead of stopping once frame times are stable");
 	commandLineParser.add("benchmarkruntime", { "-br", "--benchruntime" }, 1, "Set duration time for benchmark mode in seconds");
-	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
+	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results (JSON if the name ends with .json, CSV otherwise)");
 	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
 	commandLineParser.add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
+	commandLineParser.add("cputrace", { "-ct", "--cputrace" }, 1, "Record CPU profiler scopes and write them to the given file as a Chrome trace (JSON, can be opened in Perfetto) on exit");
+	commandLineParser.add("benchmarktimestep", { "-bts", "--benchtimestep" }, 1, "Advance animations by a fixed time step in ms per benchmark frame instead of leaving them paused");
+	commandLineParser.add("camerapath", { "-cp", "--camerapath" }, 1, "Play back a camera path file in benchmark mode, renders every frame of the path once with a fixed time step");
+	commandLineParser.add("camerarecord", { "-cr", "--camerarecord" }, 1, "Record the camera and animation timer of every frame and write them to the given camera path file on exit");
+	commandLineParser.add("benchmarkstutter", { "-bst", "--benchstutter" }, 1, "Comma separated frame times in ms above which frames are counted as stutters (default 33.3,50,100)");
+	commandLineParser.add("capture", { "-cap", "--capture" }, 1, "Write every frame to an image file without stalling rendering, the frame number is appended to the given name and the extension selects the format (ppm, png or qoi)");
+	commandLineParser.add("headlessoffscreen", { "-ho", "--headless-offscreen" }, 0, "Run in benchmark mode without a window, frames are rendered to offscreen images instead of a swapchain");
 
 	commandLineParser.parse(args);
 	if (commandLineParser.isSet("help")) {
@@ -832,6 +1215,12 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 		benchmark.active = true;
 		vks::tools::errorModeSilent = true;
 	}
+	if (commandLineParser.isSet("headlessoffscreen")) {
+		// There is nothing to interact with without a window, so the example always runs as a benchmark
+		settings.headlessOffscreen = true;
+		benchmark.active = true;
+		vks::tools::errorModeSilent = true;
+	}
 	if (commandLineParser.isSet("benchmarkwarmup")) {
 		benchmark.warmup = commandLineParser.getValueAsInt("benchmarkwarmup", benchmark.warmup);
 	}
@@ -847,6 +1236,38 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	if (commandLineParser.isSet("benchmarkframes")) {
 		benchmark.outputFrames = commandLineParser.getValueAsInt("benchmarkframes", benchmark.outputFrames);
 	}
+	if (commandLineParser.isSet("benchmarkfixedwarmup")) {
+		benchmark.stableWarmup = false;
+	}
+	if (commandLineParser.isSet("benchmarkstutter")) {
+		benchmark.setStutterThresholds(commandLineParser.getValueAsString("benchmarkstutter", ""));
+	}
+	if (commandLineParser.isSet("benchmarktimestep")) {
+		benchmarkTimestep = std::stof(commandLineParser.getValueAsString("benchmarktimestep", "0"));
+	}
+	if (commandLineParser.isSet("camerapath")) {
+		cameraPathFile = commandLineParser.getValueAsString("camerapath", "");
+		if (!cameraPath.loadFromFile(cameraPathFile)) {
+			vks::tools::exitFatal("Could not load camera path from \"" + cameraPathFile + "\"", -1);
+		}
+	}
+	else if (commandLineParser.isSet("camerarecord")) {
+		cameraPathFile = commandLineParser.getValueAsString("camerarecord", "camerapath.txt");
+		recordCameraPath = true;
+		cameraPath.addViewpoint("viewpoint 1");
+	}
+	if (commandLineParser.isSet("capture")) {
+		captureFile = commandLineParser.getValueAsString("capture", "capture.ppm");
+	}
+	if (commandLineParser.isSet("cputrace")) {
+#if defined(VKS_CPU_PROFILER_DISABLED)
+		std::cerr << "CPU profiling has been disabled at compile time, no trace will be written\n";
+#else
+		cpuTraceFile = commandLineParser.getValueAsString("cputrace", "trace.json");
+		vks::CPUProfiler::setEnabled(true);
+		VKS_PROFILE_THREAD_NAME("Main thread");
+#endif
+	}
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// Vulkan library is loaded dynamically on Android
@@ -855,9 +1276,13 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 #elif defined(_DIRECT2DISPLAY)
 
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	initWaylandConnection();
+	if (!settings.headlessOffscreen) {
+		initWaylandConnection();
+	}
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	initxcbConnection();
+	if (!settings.headlessOffscreen) {
+		initxcbConnection();
+	}
 #endif
 
 #if defined(_WIN32)
@@ -872,13 +1297,44 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 
 VulkanExampleBase::~VulkanExampleBase()
 {
+	if (recordCameraPath) {
+		if (cameraPath.saveToFile(cameraPathFile)) {
+			std::cout << "Camera path with " << cameraPath.frameCount() << " frames written to " << cameraPathFile << "\n";
+		}
+		else {
+			std::cerr << "Could not write camera path to " << cameraPathFile << "\n";
+		}
+	}
+	if (!cpuTraceFile.empty()) {
+		// Stop the job system first, its workers may still record scopes
+		frameGraph.wait();
+		jobSystem.destroy();
+		vks::CPUProfiler::setEnabled(false);
+		if (vks::CPUProfiler::writeTrace(cpuTraceFile)) {
+			std::cout << "CPU trace written to " << cpuTraceFile << "\n";
+		}
+		else {
+			std::cerr << "Could not write CPU trace to " << cpuTraceFile << "\n";
+		}
+	}
+
 	// Clean up Vulkan resources
+	// Pending compiles may still reference the render passes and the pipeline cache
+	pipelineCompiler.destroy();
+	if (!captureFile.empty()) {
+		// Pending captures still copy from the swap chain images
+		frameCapture.destroy();
+		const vks::FrameCapture::Statistics captureStatistics = frameCapture.statistics();
+		std::cout << captureStatistics.written << " frames captured to " << captureFile << " (" << captureStatistics.stalls << " stalls, "
+			<< captureStatistics.captureTime << " ms on the render thread, " << captureStatistics.writeTime << " ms writing)\n";
+	}
 	swapChain.cleanup();
 	if (descriptorPool != VK_NULL_HANDLE)
 	{
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 	}
 	destroyCommandBuffers();
+	destroyOverlayPass();
 	if (renderPass != VK_NULL_HANDLE)
 	{
 		vkDestroyRenderPass(device, renderPass, nullptr);
@@ -888,10 +1344,8 @@ VulkanExampleBase::~VulkanExampleBase()
 		vkDestroyFramebuffer(device, frameBuffers[i], nullptr);
 	}
 
-	for (auto& shaderModule : shaderModules)
-	{
-		vkDestroyShaderModule(device, shaderModule, nullptr);
-	}
+	descriptorAllocator.destroy();
+	shaderCache.destroy();
 	vkDestroyImageView(device, depthStencil.view, nullptr);
 	vkDestroyImage(device, depthStencil.image, nullptr);
 	vkFreeMemory(device, depthStencil.mem, nullptr);
@@ -910,6 +1364,8 @@ VulkanExampleBase::~VulkanExampleBase()
 		UIOverlay.freeResources();
 	}
 
+	gpuProfiler.destroy();
+
 	delete vulkanDevice;
 
 	if (settings.validation)
@@ -933,29 +1389,34 @@ VulkanExampleBase::~VulkanExampleBase()
 	if (dfb)
 		dfb->Release(dfb);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	xdg_toplevel_destroy(xdg_toplevel);
-	xdg_surface_destroy(xdg_surface);
-	wl_surface_destroy(surface);
-	if (keyboard)
-		wl_keyboard_destroy(keyboard);
-	if (pointer)
-		wl_pointer_destroy(pointer);
-	if (seat)
-		wl_seat_destroy(seat);
-	xdg_wm_base_destroy(shell);
-	wl_compositor_destroy(compositor);
-	wl_registry_destroy(registry);
-	wl_display_disconnect(display);
+	if (!settings.headlessOffscreen) {
+		xdg_toplevel_destroy(xdg_toplevel);
+		xdg_surface_destroy(xdg_surface);
+		wl_surface_destroy(surface);
+		if (keyboard)
+			wl_keyboard_destroy(keyboard);
+		if (pointer)
+			wl_pointer_destroy(pointer);
+		if (seat)
+			wl_seat_destroy(seat);
+		xdg_wm_base_destroy(shell);
+		wl_compositor_destroy(compositor);
+		wl_registry_destroy(registry);
+		wl_display_disconnect(display);
+	}
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// todo : android cleanup (if required)
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	xcb_destroy_window(connection, window);
-	xcb_disconnect(connection);
+	if (!settings.headlessOffscreen) {
+		xcb_destroy_window(connection, window);
+		xcb_disconnect(connection);
+	}
 #endif
 }
 
 bool VulkanExampleBase::initVulkan()
 {
+	VKS_PROFILE_SCOPE("initVulkan");
 	VkResult err;
 
 	// Vulkan instance
@@ -1044,6 +1505,17 @@ bool VulkanExampleBase::initVulkan()
 	}
 	device = vulkanDevice->logicalDevice;
 
+	// Module identifiers can only be queried if the example enabled the extension and its feature
+	bool shaderModuleIdentifiers = false;
+	if (std::find_if(enabledDeviceExtensions.begin(), enabledDeviceExtensions.end(), [](const char *extension) { return strcmp(extension, VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME) == 0; }) != enabledDeviceExtensions.end()) {
+		for (VkBaseOutStructure *next = (VkBaseOutStructure*)deviceCreatepNextChain; next; next = next->pNext) {
+			if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT) {
+				shaderModuleIdentifiers = ((VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT*)next)->shaderModuleIdentifier == VK_TRUE;
+			}
+		}
+	}
+	shaderCache.create(device, shaderModuleIdentifiers);
+
 	// Get a graphics queue from the device
 	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
 
@@ -1116,6 +1588,9 @@ void VulkanExampleBase::setupDPIAwareness()
 HWND VulkanExampleBase::setupWindow(HINSTANCE hinstance, WNDPROC wndproc)
 {
 	this->windowInstance = hinstance;
+	if (settings.headlessOffscreen) {
+		return nullptr;
+	}
 
 	WNDCLASSEX wndClass;
 
@@ -1876,10 +2351,7 @@ void VulkanExampleBase::displayLinkOutputCb()
 {
 #if defined(VK_EXAMPLE_XCODE_GENERATED)
 	if (benchmark.active) {
-		benchmark.run([=] { render(); }, vulkanDevice->properties);
-		if (benchmark.filename != "") {
-			benchmark.saveResults();
-		}
+		runBenchmark();
 		quit = true;	// SRS - quit NSApp rendering loop when benchmarking complete
 		return;
 	}
@@ -2417,6 +2889,9 @@ static const struct xdg_toplevel_listener xdg_toplevel_listener = {
 
 struct xdg_surface *VulkanExampleBase::setupWindow()
 {
+	if (settings.headlessOffscreen) {
+		return nullptr;
+	}
 	surface = wl_compositor_create_surface(compositor);
 	xdg_surface = xdg_wm_base_get_xdg_surface(shell, surface);
 
@@ -2443,6 +2918,10 @@ xcb_window_t VulkanExampleBase::setupWindow()
 {
 	uint32_t value_mask, value_list[32];
 
+	if (settings.headlessOffscreen) {
+		return 0;
+	}
+
 	window = xcb_generate_id(connection);
 
 	value_mask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
@@ -2830,6 +3309,7 @@ void VulkanExampleBase::getEnabledExtensions() {}
 
 void VulkanExampleBase::windowResize()
 {
+	VKS_PROFILE_SCOPE("windowResize");
 	if (!prepared)
 	{
 		return;
@@ -2844,6 +3324,10 @@ void VulkanExampleBase::windowResize()
 	width = destWidth;
 	height = destHeight;
 	setupSwapChain();
+	if (!captureFile.empty()) {
+		frameCapture.destroy();
+		frameCapture.create(vulkanDevice, width, height, swapChain.colorFormat, swapChain.imageUsage, static_cast<uint32_t>(swapChain.imageCount));
+	}
 
 	// Recreate the frame buffers
 	vkDestroyImageView(device, depthStencil.view, nullptr);
@@ -2860,6 +3344,10 @@ void VulkanExampleBase::windowResize()
 			UIOverlay.resize(width, height);
 		}
 	}
+	if (overlayPass.renderPass != VK_NULL_HANDLE) {
+		destroyOverlayFrameBuffers();
+		setupOverlayFrameBuffers();
+	}
 
 	// Command buffers need to be recreated as they may store
 	// references to the recreated frame buffer
@@ -2923,6 +3411,10 @@ void VulkanExampleBase::windowResized() {}
 
 void VulkanExampleBase::initSwapchain()
 {
+	if (settings.headlessOffscreen) {
+		swapChain.initOffscreen(queue, vulkanDevice->queueFamilyIndices.graphics);
+		return;
+	}
 #if defined(_WIN32)
 	swapChain.initSurface(windowInstance, window);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
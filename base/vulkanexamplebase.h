@@ -71,7 +71,16 @@
 
 #include "VulkanInitializers.hpp"
 #include "camera.hpp"
+#include "camerapath.hpp"
 #include "benchmark.hpp"
+#include "VulkanProfiler.h"
+#include "VulkanShaderCache.h"
+#include "VulkanPipelineCompiler.h"
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanFrameCapture.h"
+#include "cpuprofiler.hpp"
+#include "jobsystem.hpp"
+#include "taskgraph.hpp"
 
 class VulkanExampleBase
 {
@@ -84,6 +93,13 @@ private:
 	void handleMouseMove(int32_t x, int32_t y);
 	void nextFrame();
 	void updateOverlay();
+	void createOverlayPass();
+	void setupOverlayFrameBuffers();
+	void destroyOverlayFrameBuffers();
+	void destroyOverlayPass();
+	VkSemaphore submitOverlayPass(VkSemaphore waitSemaphore);
+	void runBenchmark();
+	void benchmarkFrame();
 	void createPipelineCache();
 	void createCommandPool();
 	void createSynchronizationPrimitives();
@@ -92,6 +108,33 @@ private:
 	void createCommandBuffers();
 	void destroyCommandBuffers();
 	std::string shaderDir = "glsl";
+	// File the CPU profiler scopes are written to on exit (Chrome trace JSON), empty if not requested
+	std::string cpuTraceFile;
+	// Time since the last UI overlay update in seconds and the mouse position at that update, used to cap the overlay update rate
+	float overlayUpdateTimer = 0.0f;
+	glm::vec2 overlayMousePos = glm::vec2(0.0f);
+	// Render pass drawing the UI overlay on top of the example's output, with a command buffer, fence and semaphore per swap chain image
+	struct {
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		std::vector<VkFramebuffer> frameBuffers;
+		std::vector<VkCommandBuffer> commandBuffers;
+		std::vector<VkFence> fences;
+		// Overlay geometry slot drawn by the last pass of each swap chain image
+		std::vector<uint32_t> drawnSlots;
+		// Waited on by the presentation of each swap chain image, a single semaphore could be signaled again by the next frame in flight before its present has waited on it
+		std::vector<VkSemaphore> complete;
+	} overlayPass;
+	// Camera path played back in benchmark mode, or recorded in interactive mode and written to cameraPathFile on exit
+	vks::CameraPath cameraPath;
+	std::string cameraPathFile;
+	bool recordCameraPath = false;
+	uint32_t cameraPathFrame = 0;
+	// Fixed frame time in ms used for animations in benchmark mode, 0 uses the frame time measured by the benchmark
+	float benchmarkTimestep = 0.0f;
+	// Every presented frame is captured to captureFile with the frame number appended when set via command line
+	vks::FrameCapture frameCapture;
+	std::string captureFile;
+	uint32_t captureFrame = 0;
 protected:
 	// Returns the path to the root of the glsl or hlsl shader directory.
 	std::string getShadersPath() const;
@@ -140,7 +183,7 @@ protected:
 	uint32_t currentBuffer = 0;
 	// Descriptor set pool
 	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
-	// List of shader modules created (stored for cleanup)
+	// List of distinct shader modules created by loadShader, owned by the shader cache
 	std::vector<VkShaderModule> shaderModules;
 	// Pipeline cache object
 	VkPipelineCache pipelineCache;
@@ -169,6 +212,19 @@ public:
 	float frameTimer = 1.0f;
 
 	vks::Benchmark benchmark;
+	/** @brief Shader modules loaded with loadShader, files with the same name or SPIR-V share a module */
+	vks::ShaderCache shaderCache;
+	/** @brief Compiles pipelines in the background using the pipeline cache, threads are only started with the first submission */
+	vks::PipelineCompiler pipelineCompiler;
+	/** @brief Descriptor layouts and sets from pools that grow on demand, with one transient pool chain per command buffer that the example resets once the GPU is done with it */
+	vks::DescriptorAllocator descriptorAllocator;
+	/** @brief GPU timings of named scopes, examples opt in by recording scopes into their command buffers (one slot per command buffer) */
+	vks::GPUProfiler gpuProfiler;
+
+	/** @brief Job system that executes the frame graph, worker threads are only started by launchFrameGraph() or by the example calling create() */
+	vks::JobSystem jobSystem;
+	/** @brief Optional task graph for the CPU work of a frame, examples opt in by adding tasks and calling launchFrameGraph() from their render function */
+	vks::TaskGraph frameGraph;
 
 	/** @brief Encapsulated physical and logical vulkan device */
 	vks::VulkanDevice *vulkanDevice;
@@ -183,6 +239,12 @@ public:
 		bool vsync = false;
 		/** @brief Enable UI overlay */
 		bool overlay = true;
+		/** @brief Draw the UI overlay in its own render pass when the frame is submitted, so overlay updates only rebuild the example's command buffers if a widget changed a value (drawUI then does nothing) */
+		bool overlayPass = true;
+		/** @brief Minimum time in seconds between two UI overlay updates while there is no mouse input, 0 updates the overlay every frame */
+		float overlayUpdateInterval = 1.0f / 30.0f;
+		/** @brief Render into offscreen images instead of a swapchain without creating a window, implies benchmark mode */
+		bool headlessOffscreen = false;
 	} settings;
 
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
@@ -385,10 +447,23 @@ public:
 
 	/** Prepare the next frame for workload submission by acquiring the next swap chain image */
 	void prepareFrame();
+	/** @brief Acquires the next swap chain image and signals the given semaphore, used by examples that keep several frames in flight with their own semaphores */
+	void prepareFrame(VkSemaphore presentCompleteSemaphore);
 	/** @brief Presents the current image to the swap chain */
 	void submitFrame();
+	/**
+	* Presents the current image to the swap chain once the given semaphore has been signaled
+	* @param waitIdle If false, returns without waiting for the queue to become idle, the example then needs to synchronize with fences
+	*/
+	void submitFrame(VkSemaphore renderCompleteSemaphore, bool waitIdle);
 	/** @brief (Virtual) Default image acquire + submission and command buffer submission function */
 	virtual void renderFrame();
+	/**
+	* Starts the frame graph tasks for the next frame on the job system and returns immediately
+	* Called after the command buffers of the current frame have been submitted, the tasks then run while the GPU renders and presents the frame
+	* Tasks must not write to memory the GPU is reading, the render function calls frameGraph.wait() before using their results
+	*/
+	void launchFrameGraph();
 
 	/** @brief (Virtual) Called when the UI overlay is updating, can be used to add custom elements to the overlay */
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay);
@@ -417,7 +492,7 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)									\
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
 	vulkanExample->setupWindow(hInstance, WndProc);													\
-	vulkanExample->prepare();																		\
+	{ VKS_PROFILE_SCOPE("prepare"); vulkanExample->prepare(); }									\
 	vulkanExample->renderLoop();																	\
 	delete(vulkanExample);																			\
 	return 0;																						\
@@ -449,7 +524,7 @@ int main(const int argc, const char *argv[])													    \
 	for (size_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };  				\
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
-	vulkanExample->prepare();																		\
+	{ VKS_PROFILE_SCOPE("prepare"); vulkanExample->prepare(); }									\
 	vulkanExample->renderLoop();																	\
 	delete(vulkanExample);																			\
 	return 0;																						\
@@ -470,7 +545,7 @@ int main(const int argc, const char *argv[])													    \
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
 	vulkanExample->setupWindow();					 												\
-	vulkanExample->prepare();																		\
+	{ VKS_PROFILE_SCOPE("prepare"); vulkanExample->prepare(); }									\
 	vulkanExample->renderLoop();																	\
 	delete(vulkanExample);																			\
 	return 0;																						\
@@ -484,7 +559,7 @@ int main(const int argc, const char *argv[])													    \
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
 	vulkanExample->setupWindow();					 												\
-	vulkanExample->prepare();																		\
+	{ VKS_PROFILE_SCOPE("prepare"); vulkanExample->prepare(); }									\
 	vulkanExample->renderLoop();																	\
 	delete(vulkanExample);																			\
 	return 0;																						\
@@ -505,7 +580,7 @@ int main(const int argc, const char *argv[])													    \
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
 	vulkanExample->setupWindow();					 												\
-	vulkanExample->prepare();																		\
+	{ VKS_PROFILE_SCOPE("prepare"); vulkanExample->prepare(); }									\
 	vulkanExample->renderLoop();																	\
 	delete(vulkanExample);																			\
 	return 0;																						\
@@ -522,7 +597,7 @@ int main(const int argc, const char *argv[])														\
 		vulkanExample = new VulkanExample();														\
 		vulkanExample->initVulkan();																\
 		vulkanExample->setupWindow(nullptr);														\
-		vulkanExample->prepare();																	\
+		{ VKS_PROFILE_SCOPE("prepare"); vulkanExample->prepare(); }								\
 		vulkanExample->renderLoop();																\
 		delete(vulkanExample);																		\
 	}																								\
@@ -1,8 +1,19 @@
 # Benchmark all examples
-import subprocess
-import sys
+# Runs a set of examples in benchmark mode (optionally repeated and on a selected device or Vulkan driver)
+# and compares the results against a baseline from a previous run with significance tests
+#
+# Examples:
+#   python benchmark-all.py                                      Run all examples once, results are written to ./benchmark
+#   python benchmark-all.py --examples triangle,ssao --repeats 5 --output ./current
+#   python benchmark-all.py --repeats 5 --baseline ./benchmark --output ./current
+#   python benchmark-all.py --icd /usr/share/vulkan/icd.d/lvp_icd.x86_64.json     Run on a software implementation (lavapipe)
+import argparse
+import json
+import math
 import os
 import platform
+import subprocess
+import sys
 
 EXAMPLES = [
 	"bloom",
@@ -83,24 +94,238 @@ EXAMPLES = [
 	"vulkanscene"
 ]
 
-CURR_INDEX = 0
+# Metrics compared against the baseline, lower values are better for all of them
+METRICS = [
+	("avg", "avg frame time (ms)"),
+	("p99", "p99 frame time (ms)"),
+	("startup", "startup (ms)")
+]
+
+def parseArguments():
+	parser = argparse.ArgumentParser(description="Run examples in benchmark mode and compare the results against a baseline")
+	parser.add_argument("--examples", type=str, help="comma separated list of examples to run (default: all)")
+	parser.add_argument("--exclude", type=str, help="comma separated list of examples to skip")
+	parser.add_argument("--repeats", type=int, default=1, help="number of runs per example")
+	parser.add_argument("--runtime", type=int, help="benchmark duration per run in seconds")
+	parser.add_argument("--warmup", type=int, help="maximum warmup time per run in seconds")
+	parser.add_argument("--gpu", type=int, help="index of the Vulkan device to run on (see --listgpus of any example)")
+	parser.add_argument("--icd", type=str, help="Vulkan driver (ICD) manifest to use, e.g. lavapipe's lvp_icd json for a software implementation")
+	parser.add_argument("--bindir", type=str, default=".", help="directory containing the example binaries")
+	parser.add_argument("--output", type=str, default="./benchmark", help="directory the results are written to")
+	parser.add_argument("--baseline", type=str, help="output directory of a previous run to compare against")
+	parser.add_argument("--alpha", type=float, default=0.05, help="significance level for the comparison")
+	parser.add_argument("--threshold", type=float, default=2.0, help="minimum change in percent for a significant difference to be reported")
+	parser.add_argument("--windowed", action="store_true", help="don't run the examples in fullscreen")
+	parser.add_argument("--fail-on-regression", action="store_true", help="exit with a non-zero code if a regression has been found")
+	parser.add_argument("--args", type=str, default="", help="additional arguments passed to every example")
+	return parser.parse_args()
+
+def selectExamples(args):
+	examples = EXAMPLES
+	if args.examples:
+		examples = [e.strip() for e in args.examples.split(",") if e.strip()]
+		unknown = [e for e in examples if e not in EXAMPLES]
+		if unknown:
+			sys.exit("Unknown examples: %s" % ", ".join(unknown))
+	if args.exclude:
+		excluded = [e.strip() for e in args.exclude.split(",")]
+		examples = [e for e in examples if e not in excluded]
+	return examples
+
+def runExample(args, example, resultFile):
+	executable = os.path.join(args.bindir, example + (".exe" if platform.system() == "Windows" else ""))
+	command = [executable, "-b", "-bt", "-bf", resultFile]
+	if not args.windowed:
+		command.append("-fullscreen")
+	if args.runtime is not None:
+		command += ["-br", str(args.runtime)]
+	if args.warmup is not None:
+		command += ["-bw", str(args.warmup)]
+	if args.gpu is not None:
+		command += ["-g", str(args.gpu)]
+	command += args.args.split()
+	env = os.environ.copy()
+	if args.icd:
+		# The loader reads VK_DRIVER_FILES since 1.3.207, older loaders VK_ICD_FILENAMES
+		env["VK_DRIVER_FILES"] = args.icd
+		env["VK_ICD_FILENAMES"] = args.icd
+	try:
+		return subprocess.call(command, env=env)
+	except OSError as e:
+		print("Could not run %s: %s" % (executable, e))
+		return -1
+
+def loadRun(resultFile):
+	with open(resultFile) as file:
+		result = json.load(file)
+	return {
+		"device": result["device"],
+		"driverversion": result["driverversion"],
+		"resolution": result["resolution"],
+		"fps": result["fps"],
+		"avg": result["frametime"]["avg"],
+		"p50": result["frametime"]["p50"],
+		"p99": result["frametime"]["p99"],
+		"p99.9": result["frametime"]["p99.9"],
+		"stddev": result["frametime"]["stddev"],
+		"startup": result.get("startup", 0.0),
+		"frametimes": result.get("frametimes", [])
+	}
+
+# Statistics
+
+def mean(values):
+	return sum(values) / len(values)
+
+def variance(values):
+	m = mean(values)
+	return sum((v - m) ** 2 for v in values) / (len(values) - 1)
+
+# Regularized incomplete beta function I_x(a, b), evaluated with a continued fraction (modified Lentz)
+def incompleteBeta(x, a, b):
+	if x <= 0.0:
+		return 0.0
+	if x >= 1.0:
+		return 1.0
+	if x > (a + 1.0) / (a + b + 2.0):
+		return 1.0 - incompleteBeta(1.0 - x, b, a)
+	front = math.exp(math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b) + a * math.log(x) + b * math.log(1.0 - x)) / a
+	tiny = 1e-300
+	f = 1.0
+	c = 1.0
+	d = 0.0
+	for i in range(400):
+		m = i // 2
+		if i == 0:
+			numerator = 1.0
+		elif i % 2 == 0:
+			numerator = (m * (b - m) * x) / ((a + 2.0 * m - 1.0) * (a + 2.0 * m))
+		else:
+			numerator = -((a + m) * (a + b + m) * x) / ((a + 2.0 * m) * (a + 2.0 * m + 1.0))
+		d = 1.0 + numerator * d
+		d = tiny if abs(d) < tiny else d
+		d = 1.0 / d
+		c = 1.0 + numerator / c
+		c = tiny if abs(c) < tiny else c
+		f *= c * d
+		if abs(1.0 - c * d) < 1e-12:
+			break
+	return front * (f - 1.0)
+
+# Two sided p-value of Welch's t-test for samples with unequal variances
+def welchTest(a, b):
+	va = variance(a) / len(a)
+	vb = variance(b) / len(b)
+	if va + vb == 0.0:
+		return 1.0 if mean(a) == mean(b) else 0.0
+	t = (mean(a) - mean(b)) / math.sqrt(va + vb)
+	df = (va + vb) ** 2 / ((va ** 2) / (len(a) - 1) + (vb ** 2) / (len(b) - 1))
+	return incompleteBeta(df / (df + t * t), df / 2.0, 0.5)
+
+# Two sided p-value of the Mann-Whitney U test (normal approximation), used for frame times of single runs
+def mannWhitneyTest(a, b):
+	values = sorted([(v, 0) for v in a] + [(v, 1) for v in b])
+	rankSum = 0.0
+	i = 0
+	while i < len(values):
+		j = i
+		while j + 1 < len(values) and values[j + 1][0] == values[i][0]:
+			j += 1
+		# Tied values get the average of their ranks
+		rank = (i + j) / 2.0 + 1.0
+		rankSum += rank * sum(1 for k in range(i, j + 1) if values[k][1] == 0)
+		i = j + 1
+	n1 = len(a)
+	n2 = len(b)
+	u = rankSum - n1 * (n1 + 1) / 2.0
+	sigma = math.sqrt(n1 * n2 * (n1 + n2 + 1) / 12.0)
+	if sigma == 0.0:
+		return 1.0
+	z = (u - n1 * n2 / 2.0) / sigma
+	return math.erfc(abs(z) / math.sqrt(2.0))
+
+# Compares one metric of an example, returns (baseline, current, change in percent, p-value or None)
+def compareMetric(metric, baselineRuns, currentRuns):
+	baselineValues = [run[metric] for run in baselineRuns]
+	currentValues = [run[metric] for run in currentRuns]
+	baselineMean = mean(baselineValues)
+	currentMean = mean(currentValues)
+	change = (currentMean - baselineMean) / baselineMean * 100.0 if baselineMean != 0.0 else 0.0
+	p = None
+	if len(baselineValues) >= 2 and len(currentValues) >= 2:
+		p = welchTest(baselineValues, currentValues)
+	elif metric == "avg" and baselineRuns[0]["frametimes"] and currentRuns[0]["frametimes"]:
+		p = mannWhitneyTest(baselineRuns[0]["frametimes"], currentRuns[0]["frametimes"])
+	return (baselineMean, currentMean, change, p)
+
+def compare(args, results, baseline):
+	rows = []
+	for example in sorted(results.keys()):
+		if example not in baseline or not results[example] or not baseline[example]:
+			continue
+		for metric, label in METRICS:
+			baselineMean, currentMean, change, p = compareMetric(metric, baseline[example], results[example])
+			verdict = "unchanged"
+			if p is not None and p < args.alpha and abs(change) >= args.threshold:
+				verdict = "REGRESSION" if change > 0.0 else "improvement"
+			elif p is None:
+				verdict = "not tested"
+			rows.append((example, label, baselineMean, currentMean, change, p, verdict))
+	return rows
+
+def formatTable(rows):
+	header = ("example", "metric", "baseline", "current", "change", "p", "result")
+	lines = [header]
+	for example, label, baselineMean, currentMean, change, p, verdict in rows:
+		lines.append((example, label, "%.3f" % baselineMean, "%.3f" % currentMean, "%+.1f%%" % change, "-" if p is None else "%.4f" % p, verdict))
+	widths = [max(len(line[i]) for line in lines) for i in range(len(header))]
+	return "\n".join("  ".join(column.ljust(widths[i]) for i, column in enumerate(line)).rstrip() for line in lines)
 
-ARGS = "-fullscreen -b"
+def main():
+	args = parseArguments()
+	examples = selectExamples(args)
+	os.makedirs(args.output, exist_ok=True)
 
-print("Benchmarking all examples...")
+	print("Benchmarking %d examples (%d runs each)..." % (len(examples), args.repeats))
+	results = {}
+	failed = []
+	for index, example in enumerate(examples):
+		results[example] = []
+		for repeat in range(args.repeats):
+			print("---- (%d/%d) Running %s in benchmark mode (run %d/%d) ----" % (index + 1, len(examples), example, repeat + 1, args.repeats))
+			resultFile = os.path.join(args.output, "%s.%d.json" % (example, repeat))
+			resultCode = runExample(args, example, resultFile)
+			if resultCode == 0 and os.path.isfile(resultFile):
+				results[example].append(loadRun(resultFile))
+				print("Results written to %s" % resultFile)
+			else:
+				print("Error, result code = %d" % resultCode)
+				failed.append(example)
+	with open(os.path.join(args.output, "results.json"), "w") as file:
+		json.dump(results, file)
 
-os.makedirs("./benchmark", exist_ok=True)
+	summary = []
+	for example in examples:
+		if results[example]:
+			summary.append("%s: %.3f ms avg, %.3f ms p99, %.1f ms startup (%s)" % (example, mean([r["avg"] for r in results[example]]), mean([r["p99"] for r in results[example]]), mean([r["startup"] for r in results[example]]), results[example][0]["device"]))
+	regressions = []
+	if args.baseline:
+		with open(os.path.join(args.baseline, "results.json")) as file:
+			baseline = json.load(file)
+		rows = compare(args, results, baseline)
+		regressions = [row for row in rows if row[6] == "REGRESSION"]
+		summary += ["", "Comparison against %s (alpha = %.3f, threshold = %.1f%%)" % (args.baseline, args.alpha, args.threshold), formatTable(rows)]
+		summary.append("%d regressions, %d improvements" % (len(regressions), len([row for row in rows if row[6] == "improvement"])))
+	if failed:
+		summary.append("Failed runs: %s" % ", ".join(sorted(set(failed))))
+	summary = "\n".join(summary)
+	print("Benchmark run finished")
+	print(summary)
+	with open(os.path.join(args.output, "summary.txt"), "w") as file:
+		file.write(summary + "\n")
 
-for example in EXAMPLES:
-	print("---- (%d/%d) Running %s in benchmark mode ----" % (CURR_INDEX+1, len(EXAMPLES), example))
-	if platform.system() == 'Linux' or platform.system() == 'Darwin':
-		RESULT_CODE = subprocess.call("./%s %s -bf ./benchmark/%s.csv 5" % (example, ARGS, example), shell=True)
-	else:
-		RESULT_CODE = subprocess.call("%s %s -bf ./benchmark/%s.csv 5" % (example, ARGS, example))
-	if RESULT_CODE == 0:
-		print("Results written to ./benchmark/%s.csv" % example)
-	else:
-		print("Error, result code = %d" % RESULT_CODE)
-	CURR_INDEX += 1
+	if args.fail_on_regression and regressions:
+		sys.exit(1)
 
-print("Benchmark run finished")
+if __name__ == "__main__":
+	main()
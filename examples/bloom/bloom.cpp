@@ -345,6 +345,9 @@ public:
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			// Each command buffer records its GPU timings into its own profiler slot
+			gpuProfiler.beginFrame(drawCmdBuffers[i], i);
+
 			if (bloom) {
 				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
 				clearValues[1].depthStencil = { 1.0f, 0 };
@@ -367,6 +370,7 @@ public:
 					First render pass: Render glow parts of the model (separate mesh) to an offscreen frame buffer
 				*/
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], i, "Glow");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
@@ -375,6 +379,7 @@ public:
 				models.ufoGlow.draw(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i], i);
 
 				/*
 					Second render pass: Vertical blur
@@ -385,6 +390,7 @@ public:
 
 				renderPassBeginInfo.framebuffer = offscreenPass.framebuffers[1].framebuffer;
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], i, "Vertical blur");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurVert, 0, NULL);
@@ -392,6 +398,7 @@ public:
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i], i);
 			}
 
 			/*
@@ -425,6 +432,7 @@ public:
 				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
 				// Skybox
+				gpuProfiler.beginScope(drawCmdBuffers[i], i, "Scene");
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.skyBox, 0, NULL);
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skyBox);
 				models.skyBox.draw(drawCmdBuffers[i]);
@@ -433,12 +441,15 @@ public:
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phongPass);
 				models.ufo.draw(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i], i);
 
 				if (bloom)
 				{
+					gpuProfiler.beginScope(drawCmdBuffers[i], i, "Horizontal blur");
 					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurHorz, 0, NULL);
 					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurHorz);
 					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+					gpuProfiler.endScope(drawCmdBuffers[i], i);
 				}
 
 				drawUI(drawCmdBuffers[i]);
@@ -453,6 +464,7 @@ public:
 
 	void loadAssets()
 	{
+		VKS_PROFILE_FUNCTION();
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
 		models.ufo.loadFromFile(getAssetPath() + "models/retroufo.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		models.ufoGlow.loadFromFile(getAssetPath() + "models/retroufo_glow.gltf", vulkanDevice, queue, glTFLoadingFlags);
@@ -541,6 +553,7 @@ public:
 
 	void preparePipelines()
 	{
+		VKS_PROFILE_FUNCTION();
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
 		VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
@@ -1,6 +1,8 @@
 /*
 * Vulkan Example - Minimal headless compute example
 *
+* Processes a data set in batches, with several batches in flight so uploading, computing and reading back different batches overlap
+*
 * Copyright (C) 2017-2022 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -22,7 +24,9 @@
 #include <assert.h>
 #include <vector>
 #include <iostream>
+#include <fstream>
 #include <algorithm>
+#include <chrono>
 
 #if defined(VK_USE_PLATFORM_MACOS_MVK)
 #define VK_ENABLE_BETA_EXTENSIONS
@@ -38,6 +42,8 @@ android_app* androidapp;
 #define DEBUG (!NDEBUG)
 
 #define BUFFER_ELEMENTS 32
+// Elements processed per dispatch unless set via command line, limited by maxComputeWorkGroupCount
+#define DEFAULT_BATCH_ELEMENTS 65536
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 #define LOG(...) ((void)__android_log_print(ANDROID_LOG_INFO, "vulkanExample", __VA_ARGS__))
@@ -61,6 +67,22 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugMessageCallback(
 
 CommandLineParser commandLineParser;
 
+// CPU reference of the compute shader, unsigned overflow wraps the same way
+uint32_t fibonacci(uint32_t n)
+{
+	if (n <= 1) {
+		return n;
+	}
+	uint32_t curr = 1;
+	uint32_t prev = 1;
+	for (uint32_t i = 2; i < n; ++i) {
+		uint32_t temp = curr;
+		curr += prev;
+		prev = temp;
+	}
+	return curr;
+}
+
 class VulkanExample
 {
 public:
@@ -71,14 +93,43 @@ public:
 	VkPipelineCache pipelineCache;
 	VkQueue queue;
 	VkCommandPool commandPool;
-	VkCommandBuffer commandBuffer;
-	VkFence fence;
 	VkDescriptorPool descriptorPool;
 	VkDescriptorSetLayout descriptorSetLayout;
-	VkDescriptorSet descriptorSet;
 	VkPipelineLayout pipelineLayout;
 	VkPipeline pipeline;
 	VkShaderModule shaderModule;
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+
+	// Resources of a batch in flight, consecutive batches use different slots so uploading, computing and reading back overlap
+	struct Batch {
+		VkBuffer uploadBuffer, downloadBuffer, deviceBuffer;
+		VkDeviceMemory uploadMemory, downloadMemory, deviceMemory;
+		void* uploadMapped = nullptr;
+		void* downloadMapped = nullptr;
+		VkDescriptorSet descriptorSet;
+		VkCommandBuffer commandBuffer;
+		VkFence fence;
+		// Range of the dataset processed by the batch, a count of 0 marks the slot as unused
+		size_t first = 0;
+		uint32_t count = 0;
+	};
+	std::vector<Batch> batches;
+	uint32_t batchSize = DEFAULT_BATCH_ELEMENTS;
+
+	std::vector<uint32_t> computeInput;
+	std::vector<uint32_t> computeOutput;
+	bool verificationFailed = false;
+
+	bool timestampsSupported = false;
+	float timestampPeriod = 1.0f;
+	uint64_t timestampMask = UINT64_MAX;
+	struct {
+		double upload = 0.0;
+		double compute = 0.0;
+		double download = 0.0;
+		uint64_t firstStart = UINT64_MAX;
+		uint64_t lastEnd = 0;
+	} gpuTimings;
 
 	VkDebugReportCallbackEXT debugReportCallback{};
 
@@ -295,72 +346,73 @@ public:
 		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
 
 		/*
-			Prepare storage buffers
+			Prepare the dataset
 		*/
-		std::vector<uint32_t> computeInput(BUFFER_ELEMENTS);
-		std::vector<uint32_t> computeOutput(BUFFER_ELEMENTS);
-
-		// Fill input data
-		uint32_t n = 0;
-		std::generate(computeInput.begin(), computeInput.end(), [&n] { return n++; });
-
-		const VkDeviceSize bufferSize = BUFFER_ELEMENTS * sizeof(uint32_t);
+		if (commandLineParser.isSet("input")) {
+			const std::string inputFile = commandLineParser.getValueAsString("input", "");
+			std::ifstream is(inputFile, std::ios::binary | std::ios::ate);
+			if (!is.is_open()) {
+				vks::tools::exitFatal("Could not open input file \"" + inputFile + "\"", -1);
+			}
+			const size_t fileSize = static_cast<size_t>(is.tellg());
+			if (fileSize % sizeof(uint32_t) != 0) {
+				LOG("Input file size is not a multiple of 4 bytes, trailing bytes are ignored\n");
+			}
+			computeInput.resize(fileSize / sizeof(uint32_t));
+			is.seekg(0, std::ios::beg);
+			is.read(reinterpret_cast<char*>(computeInput.data()), computeInput.size() * sizeof(uint32_t));
+			LOG("Read %zu elements from %s\n", computeInput.size(), inputFile.c_str());
+		}
+		else {
+			// Values repeat, as the shader's run time grows with each value
+			computeInput.resize(std::max(commandLineParser.getValueAsInt("elements", BUFFER_ELEMENTS), 0));
+			for (size_t i = 0; i < computeInput.size(); i++) {
+				computeInput[i] = static_cast<uint32_t>(i % BUFFER_ELEMENTS);
+			}
+		}
+		computeOutput.resize(computeInput.size());
+		if (computeInput.empty()) {
+			vks::tools::exitFatal("No elements to process", -1);
+		}
 
-		VkBuffer deviceBuffer, hostBuffer;
-		VkDeviceMemory deviceMemory, hostMemory;
-
-		// Copy input data to VRAM using a staging buffer
-		{
-			createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-				&hostBuffer,
-				&hostMemory,
-				bufferSize,
-				computeInput.data());
-
-			// Flush writes to host visible buffer
-			void* mapped;
-			vkMapMemory(device, hostMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
-			VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
-			mappedRange.memory = hostMemory;
-			mappedRange.offset = 0;
-			mappedRange.size = VK_WHOLE_SIZE;
-			vkFlushMappedMemoryRanges(device, 1, &mappedRange);
-			vkUnmapMemory(device, hostMemory);
+		// The shader runs one invocation per work group, so a batch can't have more elements than work groups can be dispatched
+		batchSize = std::max(commandLineParser.getValueAsInt("batchsize", DEFAULT_BATCH_ELEMENTS), 1);
+		batchSize = std::min(batchSize, deviceProperties.limits.maxComputeWorkGroupCount[0]);
+		batchSize = std::min(batchSize, static_cast<uint32_t>(computeInput.size()));
+		batches.resize(std::max(commandLineParser.getValueAsInt("inflight", 2), 1));
 
+		/*
+			Prepare per batch resources
+		*/
+		const VkDeviceSize bufferSize = batchSize * sizeof(uint32_t);
+		for (auto& batch : batches) {
+			// Separate staging buffers for upload and download, so the next batch can be written while this one is still being read back
+			createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &batch.uploadBuffer, &batch.uploadMemory, bufferSize);
+			createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &batch.downloadBuffer, &batch.downloadMemory, bufferSize);
 			createBuffer(
 				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				&deviceBuffer,
-				&deviceMemory,
+				&batch.deviceBuffer,
+				&batch.deviceMemory,
 				bufferSize);
+			// Staging buffers stay mapped for the lifetime of the example
+			VK_CHECK_RESULT(vkMapMemory(device, batch.uploadMemory, 0, VK_WHOLE_SIZE, 0, &batch.uploadMapped));
+			VK_CHECK_RESULT(vkMapMemory(device, batch.downloadMemory, 0, VK_WHOLE_SIZE, 0, &batch.downloadMapped));
+		}
 
-			// Copy to staging buffer
-			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
-			VkCommandBuffer copyCmd;
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &copyCmd));
-			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-			VK_CHECK_RESULT(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
-
-			VkBufferCopy copyRegion = {};
-			copyRegion.size = bufferSize;
-			vkCmdCopyBuffer(copyCmd, hostBuffer, deviceBuffer, 1, &copyRegion);
-			VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
-
-			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
-			submitInfo.commandBufferCount = 1;
-			submitInfo.pCommandBuffers = &copyCmd;
-			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-			VkFence fence;
-			VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-
-			// Submit to the queue
-			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
-			VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
-
-			vkDestroyFence(device, fence, nullptr);
-			vkFreeCommandBuffers(device, commandPool, 1, &copyCmd);
+		// GPU timestamps are taken before and after each step of a batch, if the queue supports them
+		timestampsSupported = (queueFamilyProperties[queueFamilyIndex].timestampValidBits > 0) && (deviceProperties.limits.timestampPeriod > 0.0f);
+		timestampPeriod = deviceProperties.limits.timestampPeriod;
+		timestampMask = (queueFamilyProperties[queueFamilyIndex].timestampValidBits >= 64) ? UINT64_MAX : ((1ULL << queueFamilyProperties[queueFamilyIndex].timestampValidBits) - 1);
+		if (timestampsSupported) {
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = static_cast<uint32_t>(batches.size()) * 4;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+		}
+		else {
+			LOG("Timestamps are not supported by the compute queue, only the wall clock time is reported\n");
 		}
 
 		/*
@@ -368,11 +420,11 @@ public:
 		*/
 		{
 			std::vector<VkDescriptorPoolSize> poolSizes = {
-				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(batches.size())),
 			};
 
 			VkDescriptorPoolCreateInfo descriptorPoolInfo =
-				vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 1);
+				vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), static_cast<uint32_t>(batches.size()));
 			VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
 			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
@@ -386,15 +438,17 @@ public:
 				vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
 			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 
-			VkDescriptorSetAllocateInfo allocInfo =
-				vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+			for (auto& batch : batches) {
+				VkDescriptorSetAllocateInfo allocInfo =
+					vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &batch.descriptorSet));
 
-			VkDescriptorBufferInfo bufferDescriptor = { deviceBuffer, 0, VK_WHOLE_SIZE };
-			std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
-				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &bufferDescriptor),
-			};
-			vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
+				VkDescriptorBufferInfo bufferDescriptor = { batch.deviceBuffer, 0, VK_WHOLE_SIZE };
+				std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
+					vks::initializers::writeDescriptorSet(batch.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &bufferDescriptor),
+				};
+				vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
+			}
 
 			VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 			pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
@@ -403,10 +457,11 @@ public:
 			// Create pipeline
 			VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
 
-			// Pass SSBO size via specialization constant
+			// Pass SSBO size via specialization constant, smaller batches dispatch fewer work groups
 			struct SpecializationData {
-				uint32_t BUFFER_ELEMENT_COUNT = BUFFER_ELEMENTS;
+				uint32_t BUFFER_ELEMENT_COUNT;
 			} specializationData;
+			specializationData.BUFFER_ELEMENT_COUNT = batchSize;
 			VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
 			VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(SpecializationData), &specializationData);
 
@@ -432,132 +487,213 @@ public:
 			computePipelineCreateInfo.stage = shaderStage;
 			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
 
-			// Create a command buffer for compute operations
-			VkCommandBufferAllocateInfo cmdBufAllocateInfo =
-				vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
-
-			// Fence for compute CB sync
-			VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-			VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
+			// One command buffer and fence per batch in flight
+			for (auto& batch : batches) {
+				VkCommandBufferAllocateInfo cmdBufAllocateInfo =
+					vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &batch.commandBuffer));
+				VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+				VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &batch.fence));
+			}
 		}
 
 		/*
-			Command buffer creation (for compute work submission)
+			Process the dataset in batches
 		*/
 		{
-			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
-
-			// Barrier to ensure that input buffer transfer is finished before compute shader reads from it
-			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
-			bufferBarrier.buffer = deviceBuffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				VK_PIPELINE_STAGE_HOST_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				1, &bufferBarrier,
-				0, nullptr);
-
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, 0);
-
-			vkCmdDispatch(commandBuffer, BUFFER_ELEMENTS, 1, 1);
-
-			// Barrier to ensure that shader writes are finished before buffer is read back from GPU
-			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			bufferBarrier.buffer = deviceBuffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				1, &bufferBarrier,
-				0, nullptr);
-
-			// Read back to host visible buffer
-			VkBufferCopy copyRegion = {};
-			copyRegion.size = bufferSize;
-			vkCmdCopyBuffer(commandBuffer, deviceBuffer, hostBuffer, 1, &copyRegion);
-
-			// Barrier to ensure that buffer copy is finished before host reading from it
-			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
-			bufferBarrier.buffer = hostBuffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_HOST_BIT,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				1, &bufferBarrier,
-				0, nullptr);
-
-			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
-
-			// Submit compute work
-			vkResetFences(device, 1, &fence);
-			const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
-			computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
-			computeSubmitInfo.commandBufferCount = 1;
-			computeSubmitInfo.pCommandBuffers = &commandBuffer;
-			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &computeSubmitInfo, fence));
-			VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
-
-			// Make device writes visible to the host
-			void *mapped;
-			vkMapMemory(device, hostMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
-			VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
-			mappedRange.memory = hostMemory;
-			mappedRange.offset = 0;
-			mappedRange.size = VK_WHOLE_SIZE;
-			vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
-
-			// Copy to output
-			memcpy(computeOutput.data(), mapped, bufferSize);
-			vkUnmapMemory(device, hostMemory);
+			const uint32_t batchCount = static_cast<uint32_t>((computeInput.size() + batchSize - 1) / batchSize);
+			LOG("Processing %zu elements in %u batches of up to %u elements, %zu batches in flight\n", computeInput.size(), batchCount, batchSize, batches.size());
+			const auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < batchCount; i++) {
+				const uint32_t slot = i % static_cast<uint32_t>(batches.size());
+				Batch& batch = batches[slot];
+				// The slot's previous batch has to be finished before its buffers can be reused, its results are read back first
+				if (batch.count > 0) {
+					finishBatch(batch, slot);
+				}
+				batch.first = static_cast<size_t>(i) * batchSize;
+				batch.count = std::min(batchSize, static_cast<uint32_t>(computeInput.size() - batch.first));
+				submitBatch(batch, slot);
+			}
+			// Read back the batches still in flight in submission order
+			for (uint32_t i = (batchCount > batches.size()) ? batchCount - static_cast<uint32_t>(batches.size()) : 0; i < batchCount; i++) {
+				const uint32_t slot = i % static_cast<uint32_t>(batches.size());
+				finishBatch(batches[slot], slot);
+			}
+			const double wallTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+			// Throughput report
+			const double elementCount = static_cast<double>(computeInput.size());
+			LOG("Wall clock: %.3f ms, %.0f elements/s\n", wallTime, elementCount / (wallTime / 1000.0));
+			if (timestampsSupported) {
+				const double gpuSpan = (gpuTimings.lastEnd - gpuTimings.firstStart) * timestampPeriod / 1000000.0;
+				LOG("GPU busy span: %.3f ms, %.0f elements/s\n", gpuSpan, elementCount / (gpuSpan / 1000.0));
+				LOG("GPU time summed over batches: upload %.3f ms, compute %.3f ms (%.0f elements/s), download %.3f ms\n",
+					gpuTimings.upload, gpuTimings.compute, elementCount / (gpuTimings.compute / 1000.0), gpuTimings.download);
+			}
 		}
 
 		vkQueueWaitIdle(queue);
 
-		// Output buffer contents
+		if (commandLineParser.isSet("output")) {
+			const std::string outputFile = commandLineParser.getValueAsString("output", "");
+			std::ofstream os(outputFile, std::ios::binary);
+			os.write(reinterpret_cast<const char*>(computeOutput.data()), computeOutput.size() * sizeof(uint32_t));
+			if (!os.good()) {
+				vks::tools::exitFatal("Could not write output file \"" + outputFile + "\"", -1);
+			}
+			LOG("Wrote %zu elements to %s\n", computeOutput.size(), outputFile.c_str());
+		}
+
+		if (commandLineParser.isSet("verify")) {
+			size_t mismatches = 0;
+			for (size_t i = 0; i < computeInput.size(); i++) {
+				if (computeOutput[i] != fibonacci(computeInput[i])) {
+					mismatches++;
+				}
+			}
+			LOG("Verification %s: %zu of %zu elements differ from the CPU reference\n", (mismatches == 0) ? "passed" : "failed", mismatches, computeInput.size());
+			verificationFailed = (mismatches > 0);
+		}
+
+		// Output buffer contents (only the start of large datasets)
+		const size_t printCount = std::min<size_t>(computeInput.size(), BUFFER_ELEMENTS);
 		LOG("Compute input:\n");
-		for (auto v : computeInput) {
-			LOG("%d \t", v);
+		for (size_t i = 0; i < printCount; i++) {
+			LOG("%d \t", computeInput[i]);
 		}
 		std::cout << std::endl;
 
 		LOG("Compute output:\n");
-		for (auto v : computeOutput) {
-			LOG("%d \t", v);
+		for (size_t i = 0; i < printCount; i++) {
+			LOG("%d \t", computeOutput[i]);
 		}
 		std::cout << std::endl;
+	}
+
+	// Uploads the batch's input, and records and submits the copy to the device, the dispatch and the copy back
+	void submitBatch(Batch& batch, uint32_t slot)
+	{
+		const VkDeviceSize size = batch.count * sizeof(uint32_t);
+		memcpy(batch.uploadMapped, &computeInput[batch.first], size);
+		VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
+		mappedRange.memory = batch.uploadMemory;
+		mappedRange.offset = 0;
+		mappedRange.size = VK_WHOLE_SIZE;
+		VK_CHECK_RESULT(vkFlushMappedMemoryRanges(device, 1, &mappedRange));
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(batch.commandBuffer, &cmdBufInfo));
+		const uint32_t query = slot * 4;
+		if (timestampsSupported) {
+			vkCmdResetQueryPool(batch.commandBuffer, queryPool, query, 4);
+			vkCmdWriteTimestamp(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, query);
+		}
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = size;
+		vkCmdCopyBuffer(batch.commandBuffer, batch.uploadBuffer, batch.deviceBuffer, 1, &copyRegion);
+		if (timestampsSupported) {
+			vkCmdWriteTimestamp(batch.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, query + 1);
+		}
 
-		// Clean up
-		vkDestroyBuffer(device, deviceBuffer, nullptr);
-		vkFreeMemory(device, deviceMemory, nullptr);
-		vkDestroyBuffer(device, hostBuffer, nullptr);
-		vkFreeMemory(device, hostMemory, nullptr);
+		// Barrier to ensure that input buffer transfer is finished before compute shader reads from it
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.buffer = batch.deviceBuffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+		vkCmdPipelineBarrier(
+			batch.commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_FLAGS_NONE,
+			0, nullptr,
+			1, &bufferBarrier,
+			0, nullptr);
+
+		vkCmdBindPipeline(batch.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(batch.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &batch.descriptorSet, 0, 0);
+
+		vkCmdDispatch(batch.commandBuffer, batch.count, 1, 1);
+		if (timestampsSupported) {
+			vkCmdWriteTimestamp(batch.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, query + 2);
+		}
+
+		// Barrier to ensure that shader writes are finished before buffer is read back from GPU
+		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		vkCmdPipelineBarrier(
+			batch.commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_FLAGS_NONE,
+			0, nullptr,
+			1, &bufferBarrier,
+			0, nullptr);
+
+		// Read back to host visible buffer
+		vkCmdCopyBuffer(batch.commandBuffer, batch.deviceBuffer, batch.downloadBuffer, 1, &copyRegion);
+
+		// Barrier to ensure that buffer copy is finished before host reading from it
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.buffer = batch.downloadBuffer;
+
+		vkCmdPipelineBarrier(
+			batch.commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT,
+			VK_FLAGS_NONE,
+			0, nullptr,
+			1, &bufferBarrier,
+			0, nullptr);
+		if (timestampsSupported) {
+			vkCmdWriteTimestamp(batch.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, query + 3);
+		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(batch.commandBuffer));
+
+		// Submit without waiting, the fence is only waited on once the slot is needed again
+		VK_CHECK_RESULT(vkResetFences(device, 1, &batch.fence));
+		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
+		computeSubmitInfo.commandBufferCount = 1;
+		computeSubmitInfo.pCommandBuffers = &batch.commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &computeSubmitInfo, batch.fence));
+	}
+
+	// Waits for the batch, copies its results to the output and adds its GPU timings
+	void finishBatch(Batch& batch, uint32_t slot)
+	{
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX));
+
+		// Make device writes visible to the host
+		VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
+		mappedRange.memory = batch.downloadMemory;
+		mappedRange.offset = 0;
+		mappedRange.size = VK_WHOLE_SIZE;
+		VK_CHECK_RESULT(vkInvalidateMappedMemoryRanges(device, 1, &mappedRange));
+		memcpy(&computeOutput[batch.first], batch.downloadMapped, batch.count * sizeof(uint32_t));
+
+		if (timestampsSupported) {
+			uint64_t timestamps[4];
+			VK_CHECK_RESULT(vkGetQueryPoolResults(device, queryPool, slot * 4, 4, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT));
+			for (auto& timestamp : timestamps) {
+				timestamp &= timestampMask;
+			}
+			const double toMs = timestampPeriod / 1000000.0;
+			gpuTimings.upload += (timestamps[1] - timestamps[0]) * toMs;
+			gpuTimings.compute += (timestamps[2] - timestamps[1]) * toMs;
+			gpuTimings.download += (timestamps[3] - timestamps[2]) * toMs;
+			gpuTimings.firstStart = std::min(gpuTimings.firstStart, timestamps[0]);
+			gpuTimings.lastEnd = std::max(gpuTimings.lastEnd, timestamps[3]);
+		}
+		batch.count = 0;
 	}
 
 	~VulkanExample()
@@ -567,7 +703,18 @@ public:
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 		vkDestroyPipeline(device, pipeline, nullptr);
 		vkDestroyPipelineCache(device, pipelineCache, nullptr);
-		vkDestroyFence(device, fence, nullptr);
+		for (auto& batch : batches) {
+			vkDestroyBuffer(device, batch.uploadBuffer, nullptr);
+			vkFreeMemory(device, batch.uploadMemory, nullptr);
+			vkDestroyBuffer(device, batch.downloadBuffer, nullptr);
+			vkFreeMemory(device, batch.downloadMemory, nullptr);
+			vkDestroyBuffer(device, batch.deviceBuffer, nullptr);
+			vkFreeMemory(device, batch.deviceMemory, nullptr);
+			vkDestroyFence(device, batch.fence, nullptr);
+		}
+		if (queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, queryPool, nullptr);
+		}
 		vkDestroyCommandPool(device, commandPool, nullptr);
 		vkDestroyShaderModule(device, shaderModule, nullptr);
 		vkDestroyDevice(device, nullptr);
@@ -608,6 +755,12 @@ void android_main(android_app* state) {
 int main(int argc, char* argv[]) {
 	commandLineParser.add("help", { "--help" }, 0, "Show help");
 	commandLineParser.add("shaders", { "-s", "--shaders" }, 1, "Select shader type to use (glsl or hlsl)");
+	commandLineParser.add("input", { "-i", "--input" }, 1, "Read the elements to process from a file of 32 bit unsigned integers");
+	commandLineParser.add("output", { "-o", "--output" }, 1, "Write the results to a file of 32 bit unsigned integers");
+	commandLineParser.add("elements", { "-n", "--elements" }, 1, "Number of generated elements to process if no input file is given");
+	commandLineParser.add("batchsize", { "-bs", "--batchsize" }, 1, "Maximum number of elements per dispatch");
+	commandLineParser.add("inflight", { "-if", "--inflight" }, 1, "Number of batches in flight (default 2)");
+	commandLineParser.add("verify", { "--verify" }, 0, "Compare the results against a CPU reference");
 	commandLineParser.parse(argc, argv);
 	if (commandLineParser.isSet("help")) {
 		commandLineParser.printHelp();
@@ -615,9 +768,13 @@ int main(int argc, char* argv[]) {
 		return 0;
 	}
 	VulkanExample *vulkanExample = new VulkanExample();
-	std::cout << "Finished. Press enter to terminate...";
-	std::cin.get();
+	const int result = vulkanExample->verificationFailed ? 1 : 0;
+	// Runs on datasets are usually scripted, so only wait for confirmation when run without any dataset arguments
+	if (!commandLineParser.isSet("input") && !commandLineParser.isSet("output") && !commandLineParser.isSet("elements")) {
+		std::cout << "Finished. Press enter to terminate...";
+		std::cin.get();
+	}
 	delete(vulkanExample);
-	return 0;
+	return result;
 }
 #endif
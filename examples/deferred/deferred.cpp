@@ -409,6 +409,10 @@ public:
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(offScreenCmdBuffer, &cmdBufInfo));
 
+		// GPU timings of the offscreen command buffer go to profiler slot 0, the draw command buffers use the following slots
+		gpuProfiler.beginFrame(offScreenCmdBuffer, 0);
+		gpuProfiler.beginScope(offScreenCmdBuffer, 0, "G-Buffer");
+
 		vkCmdBeginRenderPass(offScreenCmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 		VkViewport viewport = vks::initializers::viewport((float)offScreenFrameBuf.width, (float)offScreenFrameBuf.height, 0.0f, 1.0f);
@@ -430,11 +434,14 @@ public:
 
 		vkCmdEndRenderPass(offScreenCmdBuffer);
 
+		gpuProfiler.endScope(offScreenCmdBuffer, 0);
+
 		VK_CHECK_RESULT(vkEndCommandBuffer(offScreenCmdBuffer));
 	}
 
 	void loadAssets()
 	{
+		VKS_PROFILE_FUNCTION();
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
 		models.model.loadFromFile(getAssetPath() + "models/armor/armor.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		models.floor.loadFromFile(getAssetPath() + "models/deferred_floor.gltf", vulkanDevice, queue, glTFLoadingFlags);
@@ -467,6 +474,8 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			gpuProfiler.beginFrame(drawCmdBuffers[i], i + 1);
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -480,7 +489,9 @@ public:
    			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
 			// Final composition as full screen quad
 			// Note: Also used for debug display if debugDisplayTarget > 0
+			gpuProfiler.beginScope(drawCmdBuffers[i], i + 1, "Composition");
 			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+			gpuProfiler.endScope(drawCmdBuffers[i], i + 1);
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -592,6 +603,7 @@ public:
 
 	void preparePipelines()
 	{
+		VKS_PROFILE_FUNCTION();
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
 		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
@@ -8,15 +8,16 @@
 * Summary:
 * Demonstrates the use of dynamic uniform buffers.
 *
-* Instead of using one uniform buffer per-object, this example allocates one big uniform buffer
-* with respect to the alignment reported by the device via minUniformBufferOffsetAlignment that
-* contains all matrices for the objects in the scene.
+* Instead of using one uniform buffer per-object, this example writes all matrices for the objects
+* in the scene into one big uniform buffer per frame using a linear frame allocator, which aligns
+* each allocation to the minUniformBufferOffsetAlignment reported by the device.
 *
 * The used descriptor type VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC then allows to set a dynamic
 * offset used to pass data from the single uniform buffer to the connected shader binding point.
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanFrameAllocator.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -28,30 +29,6 @@ struct Vertex {
 	float color[3];
 };
 
-// Wrapper functions for aligned memory allocation
-// There is currently no standard for this in C++ that works across all platforms and vendors, so we abstract this
-void* alignedAlloc(size_t size, size_t alignment)
-{
-	void *data = nullptr;
-#if defined(_MSC_VER) || defined(__MINGW32__)
-	data = _aligned_malloc(size, alignment);
-#else
-	int res = posix_memalign(&data, alignment, size);
-	if (res != 0)
-		data = nullptr;
-#endif
-	return data;
-}
-
-void alignedFree(void* data)
-{
-#if	defined(_MSC_VER) || defined(__MINGW32__)
-	_aligned_free(data);
-#else
-	free(data);
-#endif
-}
-
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -67,7 +44,6 @@ public:
 
 	struct {
 		vks::Buffer view;
-		vks::Buffer dynamic;
 	} uniformBuffers;
 
 	struct {
@@ -79,21 +55,18 @@ public:
 	glm::vec3 rotations[OBJECT_INSTANCES];
 	glm::vec3 rotationSpeeds[OBJECT_INSTANCES];
 
-	// One big uniform buffer that contains all matrices
-	// Note that we need to manually allocate the data to cope for GPU-specific uniform buffer offset alignments
-	struct UboDataDynamic {
-		glm::mat4 *model = nullptr;
-	} uboDataDynamic;
+	// One big uniform buffer per frame that contains all matrices
+	// The frame allocator takes care of the GPU-specific uniform buffer offset alignments
+	vks::FrameAllocator frameAllocator;
+	// Objects are written in the same order every frame, so their offsets are the same for all frames
+	std::array<uint32_t, OBJECT_INSTANCES> dynamicOffsets;
 
 	VkPipeline pipeline;
 	VkPipelineLayout pipelineLayout;
-	VkDescriptorSet descriptorSet;
+	// One descriptor set per command buffer, as each one reads from the buffer of its own frame
+	std::vector<VkDescriptorSet> descriptorSets;
 	VkDescriptorSetLayout descriptorSetLayout;
 
-	float animationTimer = 0.0f;
-
-	size_t dynamicAlignment;
-
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Dynamic uniform buffers";
@@ -105,10 +78,6 @@ public:
 
 	~VulkanExample()
 	{
-		if (uboDataDynamic.model) {
-			alignedFree(uboDataDynamic.model);
-		}
-
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
 		vkDestroyPipeline(device, pipeline, nullptr);
@@ -120,7 +89,7 @@ public:
 		indexBuffer.destroy();
 
 		uniformBuffers.view.destroy();
-		uniformBuffers.dynamic.destroy();
+		frameAllocator.destroy();
 	}
 
 	void buildCommandBuffers()
@@ -164,9 +133,8 @@ public:
 			for (uint32_t j = 0; j < OBJECT_INSTANCES; j++)
 			{
 				// One dynamic offset per dynamic descriptor to offset into the ubo containing all model matrices
-				uint32_t dynamicOffset = j * static_cast<uint32_t>(dynamicAlignment);
 				// Bind the descriptor set for rendering a mesh using the dynamic offset
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &dynamicOffset);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 1, &dynamicOffsets[j]);
 
 				vkCmdDrawIndexed(drawCmdBuffers[i], indexCount, 1, 0, 0, 0);
 			}
@@ -183,6 +151,9 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		// Write the matrices into the frame of the command buffer that's about to be submitted
+		updateDynamicUniformBuffer();
+
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
@@ -251,24 +222,6 @@ public:
 		vertices.inputState.pVertexAttributeDescriptions = vertices.attributeDescriptions.data();
 	}
 
-	void setupDescriptorPool()
-	{
-		// Example uses one ubo and one image sampler
-		std::vector<VkDescriptorPoolSize> poolSizes =
-		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1)
-		};
-
-		VkDescriptorPoolCreateInfo descriptorPoolInfo =
-			vks::initializers::descriptorPoolCreateInfo(
-				static_cast<uint32_t>(poolSizes.size()),
-				poolSizes.data(),
-				2);
-
-		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
-	}
-
 	void setupDescriptorSetLayout()
 	{
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings =
@@ -292,24 +245,24 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
-	void setupDescriptorSet()
+	void setupDescriptorSets()
 	{
-		VkDescriptorSetAllocateInfo allocInfo =
-			vks::initializers::descriptorSetAllocateInfo(
-				descriptorPool,
-				&descriptorSetLayout,
-				1);
-
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
-
-		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-			// Binding 0 : Projection/View matrix uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.view.descriptor),
-			// Binding 1 : Instance matrix as dynamic uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, &uniformBuffers.dynamic.descriptor),
-		};
-
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+		// The sets are allocated from the base class' descriptor allocator, so there's no need to size a pool for the number of frames
+		descriptorSets.resize(drawCmdBuffers.size());
+		for (uint32_t i = 0; i < descriptorSets.size(); i++) {
+			descriptorSets[i] = descriptorAllocator.allocate(descriptorSetLayout);
+
+			// Each draw reads one matrix starting at its dynamic offset
+			VkDescriptorBufferInfo dynamicDescriptor = frameAllocator.descriptor(i, sizeof(glm::mat4));
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				// Binding 0 : Projection/View matrix uniform buffer
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.view.descriptor),
+				// Binding 1 : Instance matrix as dynamic uniform buffer
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, &dynamicDescriptor),
+			};
+
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+		}
 	}
 
 	void preparePipelines()
@@ -390,23 +343,12 @@ public:
 	// Prepare and initialize uniform buffer containing shader uniforms
 	void prepareUniformBuffers()
 	{
-		// Allocate data for the dynamic uniform buffer object
-		// We allocate this manually as the alignment of the offset differs between GPUs
-
-		// Calculate required alignment based on minimum device offset alignment
-		size_t minUboAlignment = vulkanDevice->properties.limits.minUniformBufferOffsetAlignment;
-		dynamicAlignment = sizeof(glm::mat4);
-		if (minUboAlignment > 0) {
-			dynamicAlignment = (dynamicAlignment + minUboAlignment - 1) & ~(minUboAlignment - 1);
-		}
+		// Create one buffer per frame for the per-object matrices
+		// Each matrix starts at a multiple of the device's offset alignment, which differs between GPUs
+		frameAllocator.create(vulkanDevice, static_cast<uint32_t>(drawCmdBuffers.size()), OBJECT_INSTANCES * vks::FrameAllocator::alignedSize(vulkanDevice, sizeof(glm::mat4)));
 
-		size_t bufferSize = OBJECT_INSTANCES * dynamicAlignment;
-
-		uboDataDynamic.model = (glm::mat4*)alignedAlloc(bufferSize, dynamicAlignment);
-		assert(uboDataDynamic.model);
-
-		std::cout << "minUniformBufferOffsetAlignment = " << minUboAlignment << std::endl;
-		std::cout << "dynamicAlignment = " << dynamicAlignment << std::endl;
+		std::cout << "minUniformBufferOffsetAlignment = " << vulkanDevice->properties.limits.minUniformBufferOffsetAlignment << std::endl;
+		std::cout << "dynamicAlignment = " << frameAllocator.alignment() << std::endl;
 
 		// Vertex shader uniform buffer block
 
@@ -417,19 +359,8 @@ public:
 			&uniformBuffers.view,
 			sizeof(uboVS)));
 
-		// Uniform buffer object with per-object matrices
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-			&uniformBuffers.dynamic,
-			bufferSize));
-
-		// Override descriptor range to [base, base + dynamicAlignment]
-		uniformBuffers.dynamic.descriptor.range = dynamicAlignment;
-
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.view.map());
-		VK_CHECK_RESULT(uniformBuffers.dynamic.map());
 
 		// Prepare per-object matrices with offsets and random rotations
 		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
@@ -440,7 +371,12 @@ public:
 		}
 
 		updateUniformBuffers();
-		updateDynamicUniformBuffer(true);
+		// Fill the buffers of all frames, which also yields the dynamic offsets used by the command buffers
+		for (uint32_t i = 0; i < drawCmdBuffers.size(); i++) {
+			currentBuffer = i;
+			updateDynamicUniformBuffer(false);
+		}
+		currentBuffer = 0;
 	}
 
 	void updateUniformBuffers()
@@ -452,13 +388,10 @@ public:
 		memcpy(uniformBuffers.view.mapped, &uboVS, sizeof(uboVS));
 	}
 
-	void updateDynamicUniformBuffer(bool force = false)
+	void updateDynamicUniformBuffer(bool animate = true)
 	{
-		// Update at max. 60 fps
-		animationTimer += frameTimer;
-		if ((animationTimer <= 1.0f / 60.0f) && (!force)) {
-			return;
-		}
+		// All previous allocations of this frame's buffer are released, the GPU is done with it once the frame's command buffer can be submitted again
+		frameAllocator.beginFrame(currentBuffer);
 
 		// Dynamic ubo with per-object model matrices indexed by offsets in the command buffer
 		uint32_t dim = static_cast<uint32_t>(pow(OBJECT_INSTANCES, (1.0f / 3.0f)));
@@ -472,30 +405,23 @@ public:
 				{
 					uint32_t index = x * dim * dim + y * dim + z;
 
-					// Aligned offset
-					glm::mat4* modelMat = (glm::mat4*)(((uint64_t)uboDataDynamic.model + (index * dynamicAlignment)));
-
 					// Update rotations
-					rotations[index] += animationTimer * rotationSpeeds[index];
+					if (animate && !paused) {
+						rotations[index] += frameTimer * rotationSpeeds[index];
+					}
 
 					// Update matrices
 					glm::vec3 pos = glm::vec3(-((dim * offset.x) / 2.0f) + offset.x / 2.0f + x * offset.x, -((dim * offset.y) / 2.0f) + offset.y / 2.0f + y * offset.y, -((dim * offset.z) / 2.0f) + offset.z / 2.0f + z * offset.z);
-					*modelMat = glm::translate(glm::mat4(1.0f), pos);
-					*modelMat = glm::rotate(*modelMat, rotations[index].x, glm::vec3(1.0f, 1.0f, 0.0f));
-					*modelMat = glm::rotate(*modelMat, rotations[index].y, glm::vec3(0.0f, 1.0f, 0.0f));
-					*modelMat = glm::rotate(*modelMat, rotations[index].z, glm::vec3(0.0f, 0.0f, 1.0f));
+					glm::mat4 modelMat = glm::translate(glm::mat4(1.0f), pos);
+					modelMat = glm::rotate(modelMat, rotations[index].x, glm::vec3(1.0f, 1.0f, 0.0f));
+					modelMat = glm::rotate(modelMat, rotations[index].y, glm::vec3(0.0f, 1.0f, 0.0f));
+					modelMat = glm::rotate(modelMat, rotations[index].z, glm::vec3(0.0f, 0.0f, 1.0f));
+
+					// Writing the matrix is a bump of the frame allocator's offset, the buffer is host coherent so no flush is required
+					dynamicOffsets[index] = frameAllocator.push(modelMat).offset;
 				}
 			}
 		}
-
-		animationTimer = 0.0f;
-
-		memcpy(uniformBuffers.dynamic.mapped, uboDataDynamic.model, uniformBuffers.dynamic.size);
-		// Flush to make changes visible to the host
-		VkMappedMemoryRange memoryRange = vks::initializers::mappedMemoryRange();
-		memoryRange.memory = uniformBuffers.dynamic.memory;
-		memoryRange.size = uniformBuffers.dynamic.size;
-		vkFlushMappedMemoryRanges(device, 1, &memoryRange);
 	}
 
 	void prepare()
@@ -506,8 +432,7 @@ public:
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
-		setupDescriptorPool();
-		setupDescriptorSet();
+		setupDescriptorSets();
 		buildCommandBuffers();
 		prepared = true;
 	}
@@ -517,8 +442,6 @@ public:
 		if (!prepared)
 			return;
 		draw();
-		if (!paused)
-			updateDynamicUniformBuffer();
 	}
 
 	virtual void viewChanged()
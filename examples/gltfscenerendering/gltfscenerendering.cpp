@@ -34,9 +34,7 @@ VulkanglTFScene::~VulkanglTFScene()
 		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
 		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
 	}
-	for (Material material : materials) {
-		vkDestroyPipeline(vulkanDevice->logicalDevice, material.pipeline, nullptr);
-	}
+	// Material pipelines are owned by the pipeline variant cache of the example
 }
 
 /*
@@ -48,10 +46,11 @@ VulkanglTFScene::~VulkanglTFScene()
 void VulkanglTFScene::loadImages(tinygltf::Model& input)
 {
 	// POI: The textures for the glTF file used in this sample are stored as external ktx files, so we can directly load them from disk without the need for conversion
+	// Only the mip tail of each image is uploaded here, so the scene can be rendered right away while the finer levels are streamed in
 	images.resize(input.images.size());
 	for (size_t i = 0; i < input.images.size(); i++) {
 		tinygltf::Image& glTFImage = input.images[i];
-		images[i].texture.loadFromFile(path + "/" + glTFImage.uri, VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, copyQueue);
+		images[i].texture.loadFromFile(path + "/" + glTFImage.uri, VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, copyQueue, textureStreamer);
 	}
 }
 
@@ -296,6 +295,9 @@ VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 
 VulkanExample::~VulkanExample()
 {
+	// The streamer needs to be stopped before the textures it's loading data for are destroyed
+	textureStreamer.destroy();
+	pipelineVariants.destroy();
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.matrices, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.textures, nullptr);
@@ -365,6 +367,8 @@ void VulkanExample::loadglTFFile(std::string filename)
 	// Pass some Vulkan resources required for setup and rendering to the glTF model loading class
 	glTFScene.vulkanDevice = vulkanDevice;
 	glTFScene.copyQueue    = queue;
+	textureStreamer.create(vulkanDevice, queue);
+	glTFScene.textureStreamer = &textureStreamer;
 
 	size_t pos = filename.find_last_of('/');
 	glTFScene.path = filename.substr(0, pos);
@@ -521,6 +525,14 @@ void VulkanExample::setupDescriptors()
 	for (auto& material : glTFScene.materials) {
 		const VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.textures, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &material.descriptorSet));
+	}
+	updateMaterialDescriptors();
+}
+
+// POI: The material descriptors need to be updated whenever streamed textures get new samplers (with a lower min lod)
+void VulkanExample::updateMaterialDescriptors()
+{
+	for (auto& material : glTFScene.materials) {
 		VkDescriptorImageInfo colorMap = glTFScene.getTextureDescriptor(material.baseColorTextureIndex);
 		VkDescriptorImageInfo normalMap = glTFScene.getTextureDescriptor(material.normalTextureIndex);
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
@@ -571,7 +583,9 @@ void VulkanExample::preparePipelines()
 	shaderStages[0] = loadShader(getShadersPath() + "gltfscenerendering/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 	shaderStages[1] = loadShader(getShadersPath() + "gltfscenerendering/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
-	// POI: Instead if using a few fixed pipelines, we create one pipeline for each material using the properties of that material
+	// POI: Instead if using a few fixed pipelines, we request a pipeline for each material using the properties of that material
+	// The variant cache only creates a pipeline for each distinct permutation, materials with the same properties share it
+	pipelineVariants.create(device, pipelineCache);
 	for (auto &material : glTFScene.materials) {
 
 		struct MaterialSpecializationData {
@@ -580,7 +594,8 @@ void VulkanExample::preparePipelines()
 		} materialSpecializationData;
 
 		materialSpecializationData.alphaMask = material.alphaMode == "MASK";
-		materialSpecializationData.alphaMaskCutoff = material.alphaCutOff;
+		// The cutoff is only used for masked materials, so it's not allowed to split other materials into separate variants
+		materialSpecializationData.alphaMaskCutoff = materialSpecializationData.alphaMask ? material.alphaCutOff : 0.0f;
 
 		// POI: Constant fragment shader material parameters will be set using specialization constants
 		std::vector<VkSpecializationMapEntry> specializationMapEntries = {
@@ -593,7 +608,7 @@ void VulkanExample::preparePipelines()
 		// For double sided materials, culling will be disabled
 		rasterizationStateCI.cullMode = material.doubleSided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &material.pipeline));
+		material.pipeline = pipelineVariants.get(pipelineCI);
 	}
 }
 
@@ -629,6 +644,12 @@ void VulkanExample::prepare()
 
 void VulkanExample::render()
 {
+	// POI: Upload the mip levels that have been streamed in since the last frame
+	// The queue is idle at this point (the base class waits on it after each frame), so samplers can safely be replaced
+	if (textureStreamer.update()) {
+		updateMaterialDescriptors();
+		buildCommandBuffers();
+	}
 	renderFrame();
 	if (camera.updated) {
 		updateUniformBuffers();
@@ -642,6 +663,19 @@ void VulkanExample::viewChanged()
 
 void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 {
+	if (overlay->header("Texture streaming")) {
+		vks::TextureStreamer::Statistics stats = textureStreamer.getStatistics();
+		overlay->text("Levels pending: %d", stats.levelsPending);
+		overlay->text("Levels uploaded: %d", stats.levelsUploaded);
+		overlay->text("Uploaded: %.1f MB", (float)stats.bytesUploaded / (1024.0f * 1024.0f));
+	}
+	if (overlay->header("Pipeline variants")) {
+		vks::PipelineVariantCache::Statistics stats = pipelineVariants.statistics();
+		overlay->text("Materials: %d", (int32_t)glTFScene.materials.size());
+		overlay->text("Pipelines: %d", (int32_t)pipelineVariants.size());
+		overlay->text("Hits: %d, misses: %d", stats.hits, stats.misses);
+		overlay->text("Creation: %.2f ms", stats.creationTime);
+	}
 	if (overlay->header("Visibility")) {
 
 		if (overlay->button("All")) {
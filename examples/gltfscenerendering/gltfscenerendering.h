@@ -23,6 +23,8 @@
 #include "tiny_gltf.h"
 
 #include "vulkanexamplebase.h"
+#include "VulkanTextureStreaming.h"
+#include "VulkanPipelineVariantCache.h"
 
 #define ENABLE_VALIDATION false
 
@@ -34,6 +36,8 @@ public:
 	// The class requires some Vulkan objects so it can create it's own resources
 	vks::VulkanDevice* vulkanDevice;
 	VkQueue copyQueue;
+	// Finer mip levels of the scene's images are streamed in after loading
+	vks::TextureStreamer* textureStreamer;
 
 	// The vertex layout for the samples' model
 	struct Vertex {
@@ -102,8 +106,9 @@ public:
 
 	// Contains the texture for a single glTF image
 	// Images may be reused by texture objects and are as such separated
+	// Only the smallest mip levels are loaded up front, the rest is streamed in while rendering
 	struct Image {
-		vks::Texture2D texture;
+		vks::StreamingTexture2D texture;
 	};
 
 	// A glTF texture stores a reference to the image and a sampler
@@ -136,6 +141,8 @@ class VulkanExample : public VulkanExampleBase
 {
 public:
 	VulkanglTFScene glTFScene;
+	vks::TextureStreamer textureStreamer;
+	vks::PipelineVariantCache pipelineVariants;
 
 	struct ShaderData {
 		vks::Buffer buffer;
@@ -162,6 +169,7 @@ public:
 	void loadglTFFile(std::string filename);
 	void loadAssets();
 	void setupDescriptors();
+	void updateMaterialDescriptors();
 	void preparePipelines();
 	void prepareUniformBuffers();
 	void updateUniformBuffers();
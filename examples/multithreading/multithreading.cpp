@@ -15,6 +15,9 @@
 
 #define ENABLE_VALIDATION false
 
+// Number of frames that can be worked on at the same time, the CPU records a frame while the GPU executes the previous one
+#define MAX_CONCURRENT_FRAMES 2
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -31,6 +34,18 @@ public:
 		glm::mat4 view;
 	} matrices;
 
+	// Snapshot of the application state taken when the frame graph is launched
+	// The tasks run while the main thread already handles input for the next frame, so they must not read the camera directly
+	struct {
+		glm::mat4 projection;
+		glm::mat4 view;
+		float frameTimer;
+		bool paused;
+	} frameInput;
+
+	// Frame graph task names and CPU times of the last frame
+	std::vector<vks::TaskGraph::TaskInfo> frameGraphStats;
+
 	struct {
 		VkPipeline phong;
 		VkPipeline starsphere;
@@ -38,57 +53,122 @@ public:
 
 	VkPipelineLayout pipelineLayout;
 
-	VkCommandBuffer primaryCommandBuffer;
-
 	// Secondary scene command buffers used to store backdrop and user interface
 	struct SecondaryCommandBuffers {
 		VkCommandBuffer background;
 		VkCommandBuffer ui;
-	} secondaryCommandBuffers;
+	};
+
+	// Resources owned by one of the frames in flight
+	// They are only reused once the fence has signaled that the GPU is done with that frame
+	struct FrameResources {
+		// Pool for the command buffers recorded by the main thread, reset as a whole at the start of the frame
+		VkCommandPool commandPool;
+		VkCommandBuffer primaryCommandBuffer;
+		SecondaryCommandBuffers secondaryCommandBuffers;
+		VkFence fence;
+		VkSemaphore presentComplete;
+		VkSemaphore renderComplete;
+	};
+	std::array<FrameResources, MAX_CONCURRENT_FRAMES> frames;
+	uint32_t frameIndex = 0;
 
-	// Number of animated objects to be renderer
-	// by using threads and secondary command buffers
-	uint32_t numObjectsPerThread;
+	// Number of animated objects to be rendered
+	// by using threads and secondary command buffers, can be set with --objects
+	uint32_t objectCount = 512;
 
 	// Multi threaded stuff
 	// Max. number of concurrent threads
 	uint32_t numThreads;
 
 	// Use push constants to update shader
-	// parameters on a per-thread base
+	// parameters on a per-object base
 	struct ThreadPushConstantBlock {
 		glm::mat4 mvp;
 		glm::vec3 color;
 	};
 
-	struct ObjectData {
-		glm::mat4 model;
-		glm::vec3 pos;
-		glm::vec3 rotation;
-		float rotationDir;
-		float rotationSpeed;
-		float scale;
-		float deltaT;
-		float stateT = 0;
-		bool visible = true;
-	};
+	// Per object information (position, rotation, etc.) stored as a structure of arrays
+	// Animation and culling walk over the arrays linearly, so many objects are processed per cache line and SIMD register
+	struct ObjectStore {
+		std::vector<float> posX, posY, posZ;
+		// Bounding sphere radius used for culling
+		std::vector<float> radius;
+		std::vector<float> rotationY;
+		std::vector<float> rotationDir;
+		std::vector<float> rotationSpeed;
+		std::vector<float> scale;
+		std::vector<float> deltaT;
+		std::vector<glm::vec3> color;
+
+		void resize(size_t count)
+		{
+			posX.resize(count);
+			posY.resize(count);
+			posZ.resize(count);
+			radius.resize(count);
+			rotationY.resize(count);
+			rotationDir.resize(count);
+			rotationSpeed.resize(count);
+			scale.resize(count);
+			deltaT.resize(count);
+			color.resize(count);
+		}
+	} objects;
 
+	// Objects are split into one contiguous range per thread
+	// Each thread records a single secondary command buffer per frame that draws all visible objects of its range
 	struct ThreadData {
-		VkCommandPool commandPool;
-		// One command buffer per render object
-		std::vector<VkCommandBuffer> commandBuffer;
-		// One push constant block per render object
+		uint32_t firstObject;
+		uint32_t objectCount;
+		// One command pool per frame in flight, the pool is reset as a whole by the thread before it records that frame
+		std::array<VkCommandPool, MAX_CONCURRENT_FRAMES> commandPools;
+		std::array<VkCommandBuffer, MAX_CONCURRENT_FRAMES> commandBuffers;
+		// Indices of the objects that passed culling, and their push constant blocks
+		std::vector<uint32_t> visibleObjects;
 		std::vector<ThreadPushConstantBlock> pushConstBlock;
-		// Per object information (position, rotation, etc.)
-		std::vector<ObjectData> objectData;
+		uint32_t visibleCount = 0;
 	};
 	std::vector<ThreadData> threadData;
+	// Number of objects that passed culling in the last frame
+	uint32_t visibleObjectCount = 0;
 
-	vks::ThreadPool threadPool;
+	// Results of the job system micro benchmark
+	struct {
+		bool available = false;
+		double jobSystemThroughput, threadPoolThroughput;
+		double jobSystemLatency, threadPoolLatency;
+	} jobBenchmark;
+
+	// Results of the batch culling benchmark, one entry per instruction set supported by the CPU
+	struct CullBenchmarkResult {
+		vks::Frustum::InstructionSet instructionSet;
+		// Time for culling all bounds in ms
+		double spheres, spheresHinted, aabbs, aabbsMask;
+		bool matchesReference;
+	};
+	std::vector<CullBenchmarkResult> cullBenchmark;
 
-	// Fence to wait for all command buffers to finish before
-	// presenting to the swap chain
-	VkFence renderFence = {};
+	// CPU times of the last frame in ms
+	struct {
+		// Recording of the primary and all secondary command buffers
+		double recording = 0.0;
+		// Waiting for the GPU to finish the frame in flight that's reused
+		double fenceWait = 0.0;
+		// Time between the start of two frames
+		double frame = 0.0;
+	} frameTimes;
+	std::chrono::high_resolution_clock::time_point lastFrameStart;
+
+	// Sweep over thread and object counts that reports recording and frame times
+	struct {
+		bool requested = false;
+		std::vector<uint32_t> threadCounts;
+		std::vector<uint32_t> objectCounts = { 512, 8192, 131072 };
+		uint32_t warmupFrames = 16;
+		uint32_t frames = 128;
+		std::string results;
+	} recordingSweep;
 
 	// View frustum for culling invisible objects
 	vks::Frustum frustum;
@@ -111,9 +191,22 @@ public:
 #else
 		std::cout << "numThreads = " << numThreads << std::endl;
 #endif
-		threadPool.setThreadCount(numThreads);
-		numObjectsPerThread = 512 / numThreads;
+		// Secondary command buffers and the frame graph tasks are run by the jobs of the job system from the base class
+		jobSystem.create(numThreads);
 		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
+		commandLineParser.add("jobbenchmark", { "--jobbenchmark" }, 0, "Compare job throughput and latency of the job system and the thread pool at startup");
+		commandLineParser.add("recordingsweep", { "--recordingsweep" }, 0, "Measure command buffer recording and frame times for different thread and object counts at startup");
+		commandLineParser.add("cullbenchmark", { "--cullbenchmark" }, 0, "Cull one million bounding spheres and boxes with the scalar and SIMD paths at startup");
+		commandLineParser.add("objects", { "--objects" }, 1, "Number of objects to render (default 512)");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("objects")) {
+			objectCount = std::max(commandLineParser.getValueAsInt("objects", objectCount), 1);
+		}
+		recordingSweep.requested = commandLineParser.isSet("recordingsweep");
+		for (uint32_t threadCount = 1; threadCount < numThreads; threadCount *= 2) {
+			recordingSweep.threadCounts.push_back(threadCount);
+		}
+		recordingSweep.threadCounts.push_back(numThreads);
 	}
 
 	~VulkanExample()
@@ -125,12 +218,14 @@ public:
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
-		for (auto& thread : threadData) {
-			vkFreeCommandBuffers(device, thread.commandPool, thread.commandBuffer.size(), thread.commandBuffer.data());
-			vkDestroyCommandPool(device, thread.commandPool, nullptr);
-		}
+		destroyThreadData();
 
-		vkDestroyFence(device, renderFence, nullptr);
+		for (auto& frame : frames) {
+			vkDestroyCommandPool(device, frame.commandPool, nullptr);
+			vkDestroyFence(device, frame.fence, nullptr);
+			vkDestroySemaphore(device, frame.presentComplete, nullptr);
+			vkDestroySemaphore(device, frame.renderComplete, nullptr);
+		}
 	}
 
 	float rnd(float range)
@@ -139,88 +234,130 @@ public:
 		return rndDist(rndEngine);
 	}
 
-	// Create all threads and initialize shader push constants
-	void prepareMultiThreadedRenderer()
+	// Create the command buffers and synchronization primitives for each frame in flight
+	void prepareFrameResources()
 	{
 		// Since this demo updates the command buffers on each frame
 		// we don't use the per-framebuffer command buffers from the
-		// base class, and create a single primary command buffer instead
-		VkCommandBufferAllocateInfo cmdBufAllocateInfo =
-			vks::initializers::commandBufferAllocateInfo(
-				cmdPool,
-				VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-				1);
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &primaryCommandBuffer));
-
-		// Create additional secondary CBs for background and ui
-		cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers.background));
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers.ui));
+		// base class, and create a primary command buffer per frame in flight instead
+		for (auto& frame : frames) {
+			// Command buffers are re-recorded every frame, so the pool is transient and reset as a whole
+			VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+			cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
+			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &frame.commandPool));
 
-		threadData.resize(numThreads);
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo =
+				vks::initializers::commandBufferAllocateInfo(
+					frame.commandPool,
+					VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+					1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &frame.primaryCommandBuffer));
+
+			// Create additional secondary CBs for background and ui
+			cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &frame.secondaryCommandBuffers.background));
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &frame.secondaryCommandBuffers.ui));
+
+			// Created signaled, so the first wait for each frame returns immediately
+			VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+			VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &frame.fence));
+
+			// The semaphores of the base class can't be shared by frames in flight
+			VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.presentComplete));
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.renderComplete));
+		}
+	}
 
-		float maxX = std::floor(std::sqrt(numThreads * numObjectsPerThread));
-		uint32_t posX = 0;
-		uint32_t posZ = 0;
+	// Places the objects at random positions, the area they are spread over grows with the number of objects
+	void prepareObjects()
+	{
+		objects.resize(objectCount);
+		const float spread = 35.0f * std::max(1.0f, std::sqrt(objectCount / 512.0f));
+		for (uint32_t i = 0; i < objectCount; i++) {
+			float theta = 2.0f * float(M_PI) * rnd(1.0f);
+			float phi = acos(1.0f - 2.0f * rnd(1.0f));
+			objects.posX[i] = sin(phi) * cos(theta) * spread;
+			objects.posY[i] = 0.0f;
+			objects.posZ[i] = cos(phi) * spread;
+
+			objects.rotationY[i] = rnd(360.0f);
+			objects.deltaT[i] = rnd(1.0f);
+			objects.rotationDir[i] = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
+			objects.rotationSpeed[i] = (2.0f + rnd(4.0f)) * objects.rotationDir[i];
+			objects.scale[i] = 0.75f + rnd(0.5f);
+			// Simple sphere check based on the radius of the mesh
+			objects.radius[i] = models.ufo.dimensions.radius * 0.5f * objects.scale[i];
+
+			objects.color[i] = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
+		}
+	}
+
+	// Create the per-thread command pools and split the objects among the threads
+	void prepareThreadData()
+	{
+		threadData.resize(numThreads);
 
 		for (uint32_t i = 0; i < numThreads; i++) {
 			ThreadData *thread = &threadData[i];
 
-			// Create one command pool for each thread
-			VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
-			cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
-			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &thread->commandPool));
-
-			// One secondary command buffer per object that is updated by this thread
-			thread->commandBuffer.resize(numObjectsPerThread);
-			// Generate secondary command buffers for each thread
-			VkCommandBufferAllocateInfo secondaryCmdBufAllocateInfo =
-				vks::initializers::commandBufferAllocateInfo(
-					thread->commandPool,
-					VK_COMMAND_BUFFER_LEVEL_SECONDARY,
-					thread->commandBuffer.size());
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &secondaryCmdBufAllocateInfo, thread->commandBuffer.data()));
-
-			thread->pushConstBlock.resize(numObjectsPerThread);
-			thread->objectData.resize(numObjectsPerThread);
-
-			for (uint32_t j = 0; j < numObjectsPerThread; j++) {
-				float theta = 2.0f * float(M_PI) * rnd(1.0f);
-				float phi = acos(1.0f - 2.0f * rnd(1.0f));
-				thread->objectData[j].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * 35.0f;
-
-				thread->objectData[j].rotation = glm::vec3(0.0f, rnd(360.0f), 0.0f);
-				thread->objectData[j].deltaT = rnd(1.0f);
-				thread->objectData[j].rotationDir = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
-				thread->objectData[j].rotationSpeed = (2.0f + rnd(4.0f)) * thread->objectData[j].rotationDir;
-				thread->objectData[j].scale = 0.75f + rnd(0.5f);
-
-				thread->pushConstBlock[j].color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
+			thread->firstObject = (uint32_t)((uint64_t)objectCount * i / numThreads);
+			thread->objectCount = (uint32_t)((uint64_t)objectCount * (i + 1) / numThreads) - thread->firstObject;
+			thread->visibleObjects.resize(thread->objectCount);
+			thread->pushConstBlock.resize(thread->objectCount);
+			thread->visibleCount = 0;
+
+			for (uint32_t f = 0; f < MAX_CONCURRENT_FRAMES; f++) {
+				// Create one command pool for each thread and frame in flight
+				// Command pools must only be used by one thread at a time, and resetting the whole pool is cheaper than resetting each command buffer
+				VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+				cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
+				cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+				VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &thread->commandPools[f]));
+
+				VkCommandBufferAllocateInfo secondaryCmdBufAllocateInfo =
+					vks::initializers::commandBufferAllocateInfo(
+						thread->commandPools[f],
+						VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+						1);
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &secondaryCmdBufAllocateInfo, &thread->commandBuffers[f]));
 			}
 		}
+	}
 
+	void destroyThreadData()
+	{
+		for (auto& thread : threadData) {
+			for (uint32_t f = 0; f < MAX_CONCURRENT_FRAMES; f++) {
+				vkFreeCommandBuffers(device, thread.commandPools[f], 1, &thread.commandBuffers[f]);
+				vkDestroyCommandPool(device, thread.commandPools[f], nullptr);
+			}
+		}
+		threadData.clear();
 	}
 
 	// Builds the secondary command buffer for each thread
-	void threadRenderCode(uint32_t threadIndex, uint32_t cmdBufferIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
+	// Pipeline and buffers are bound once, every visible object only adds its push constants and a draw
+	void threadRenderCode(uint32_t threadIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
 	{
+		VKS_PROFILE_FUNCTION();
 		ThreadData *thread = &threadData[threadIndex];
-		ObjectData *objectData = &thread->objectData[cmdBufferIndex];
 
-		// Check visibility against view frustum using a simple sphere check based on the radius of the mesh
-		objectData->visible = frustum.checkSphere(objectData->pos, models.ufo.dimensions.radius * 0.5f);
+		// The GPU has finished this frame, so the command buffers of the thread's pool can be reset at once
+		VK_CHECK_RESULT(vkResetCommandPool(device, thread->commandPools[frameIndex], 0));
 
-		if (!objectData->visible)
+		// Animation, culling and matrices have been computed by the frame graph
+		if (thread->visibleCount == 0)
 		{
 			return;
 		}
 
 		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
-		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 		commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
 
-		VkCommandBuffer cmdBuffer = thread->commandBuffer[cmdBufferIndex];
+		VkCommandBuffer cmdBuffer = thread->commandBuffers[frameIndex];
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &commandBufferBeginInfo));
 
@@ -232,46 +369,32 @@ public:
 
 		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phong);
 
-		// Update
-		if (!paused) {
-			objectData->rotation.y += 2.5f * objectData->rotationSpeed * frameTimer;
-			if (objectData->rotation.y > 360.0f) {
-				objectData->rotation.y -= 360.0f;
-			}
-			objectData->deltaT += 0.15f * frameTimer;
-			if (objectData->deltaT > 1.0f)
-				objectData->deltaT -= 1.0f;
-			objectData->pos.y = sin(glm::radians(objectData->deltaT * 360.0f)) * 2.5f;
-		}
-
-		objectData->model = glm::translate(glm::mat4(1.0f), objectData->pos);
-		objectData->model = glm::rotate(objectData->model, -sinf(glm::radians(objectData->deltaT * 360.0f)) * 0.25f, glm::vec3(objectData->rotationDir, 0.0f, 0.0f));
-		objectData->model = glm::rotate(objectData->model, glm::radians(objectData->rotation.y), glm::vec3(0.0f, objectData->rotationDir, 0.0f));
-		objectData->model = glm::rotate(objectData->model, glm::radians(objectData->deltaT * 360.0f), glm::vec3(0.0f, objectData->rotationDir, 0.0f));
-		objectData->model = glm::scale(objectData->model, glm::vec3(objectData->scale));
-
-		thread->pushConstBlock[cmdBufferIndex].mvp = matrices.projection * matrices.view * objectData->model;
-
-		// Update shader push constant block
-		// Contains model view matrix
-		vkCmdPushConstants(
-			cmdBuffer,
-			pipelineLayout,
-			VK_SHADER_STAGE_VERTEX_BIT,
-			0,
-			sizeof(ThreadPushConstantBlock),
-			&thread->pushConstBlock[cmdBufferIndex]);
-
 		VkDeviceSize offsets[1] = { 0 };
 		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &models.ufo.vertices.buffer, offsets);
 		vkCmdBindIndexBuffer(cmdBuffer, models.ufo.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(cmdBuffer, models.ufo.indices.count, 1, 0, 0, 0);
+
+		for (uint32_t i = 0; i < thread->visibleCount; i++)
+		{
+			// Update shader push constant block
+			// Contains model view matrix
+			vkCmdPushConstants(
+				cmdBuffer,
+				pipelineLayout,
+				VK_SHADER_STAGE_VERTEX_BIT,
+				0,
+				sizeof(ThreadPushConstantBlock),
+				&thread->pushConstBlock[i]);
+
+			vkCmdDrawIndexed(cmdBuffer, models.ufo.indices.count, 1, 0, 0, 0);
+		}
 
 		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 	}
 
 	void updateSecondaryCommandBuffers(VkCommandBufferInheritanceInfo inheritanceInfo)
 	{
+		SecondaryCommandBuffers &secondaryCommandBuffers = frames[frameIndex].secondaryCommandBuffers;
+
 		// Secondary command buffer for the sky sphere
 		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
 		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
@@ -331,6 +454,14 @@ public:
 	// lat submitted to the queue for rendering
 	void updateCommandBuffers(VkFramebuffer frameBuffer)
 	{
+		VKS_PROFILE_FUNCTION();
+		FrameResources &frame = frames[frameIndex];
+		VkCommandBuffer primaryCommandBuffer = frame.primaryCommandBuffer;
+		SecondaryCommandBuffers &secondaryCommandBuffers = frame.secondaryCommandBuffers;
+
+		// The GPU has finished this frame, so all command buffers of the main thread can be reset at once
+		VK_CHECK_RESULT(vkResetCommandPool(device, frame.commandPool, 0));
+
 		// Contains the list of secondary command buffers to be submitted
 		std::vector<VkCommandBuffer> commandBuffers;
 
@@ -371,26 +502,21 @@ public:
 			commandBuffers.push_back(secondaryCommandBuffers.background);
 		}
 
-		// Add a job to the thread's queue for each object to be rendered
-		for (uint32_t t = 0; t < numThreads; t++)
-		{
-			for (uint32_t i = 0; i < numObjectsPerThread; i++)
+		// One job per thread data block, as each block's command pool must only be used by one thread at a time
+		// Workers that run out of blocks steal the remaining ones from busy workers
+		jobSystem.parallel_for(0, numThreads, 1, [&](uint32_t first, uint32_t last) {
+			for (uint32_t t = first; t < last; t++)
 			{
-				threadPool.threads[t]->addJob([=] { threadRenderCode(t, i, inheritanceInfo); });
+				threadRenderCode(t, inheritanceInfo);
 			}
-		}
-
-		threadPool.wait();
+		});
 
-		// Only submit if object is within the current view frustum
+		// Only submit threads that have objects within the current view frustum
 		for (uint32_t t = 0; t < numThreads; t++)
 		{
-			for (uint32_t i = 0; i < numObjectsPerThread; i++)
+			if (threadData[t].visibleCount > 0)
 			{
-				if (threadData[t].objectData[i].visible)
-				{
-					commandBuffers.push_back(threadData[t].commandBuffer[i]);
-				}
+				commandBuffers.push_back(threadData[t].commandBuffers[frameIndex]);
 			}
 		}
 
@@ -407,8 +533,247 @@ public:
 		VK_CHECK_RESULT(vkEndCommandBuffer(primaryCommandBuffer));
 	}
 
+	// Animates a range of objects
+	void animateObjects(uint32_t first, uint32_t last)
+	{
+		VKS_PROFILE_FUNCTION();
+		if (frameInput.paused) {
+			return;
+		}
+		const float frameTimer = frameInput.frameTimer;
+		float *rotationY = objects.rotationY.data();
+		float *deltaT = objects.deltaT.data();
+		float *posY = objects.posY.data();
+		const float *rotationSpeed = objects.rotationSpeed.data();
+		// Simple loops over the arrays, the compiler can vectorize everything but the sine
+		for (uint32_t i = first; i < last; i++) {
+			rotationY[i] += 2.5f * rotationSpeed[i] * frameTimer;
+			rotationY[i] = (rotationY[i] > 360.0f) ? rotationY[i] - 360.0f : rotationY[i];
+			deltaT[i] += 0.15f * frameTimer;
+			deltaT[i] = (deltaT[i] > 1.0f) ? deltaT[i] - 1.0f : deltaT[i];
+		}
+		for (uint32_t i = first; i < last; i++) {
+			posY[i] = sinf(glm::radians(deltaT[i] * 360.0f)) * 2.5f;
+		}
+	}
+
+	// Culls the objects of a thread data block in SIMD batches and builds the push constant blocks of the visible ones
+	// Model matrices are only calculated for objects that passed culling
+	void cullObjects(ThreadData *thread)
+	{
+		VKS_PROFILE_FUNCTION();
+		const uint32_t first = thread->firstObject;
+		thread->visibleCount = frustum.cullSpheres(&objects.posX[first], &objects.posY[first], &objects.posZ[first], &objects.radius[first], thread->objectCount, thread->visibleObjects.data(), first);
+
+		const glm::mat4 viewProjection = matrices.projection * matrices.view;
+		for (uint32_t i = 0; i < thread->visibleCount; i++)
+		{
+			const uint32_t index = thread->visibleObjects[i];
+			const float rotationDir = objects.rotationDir[index];
+			const float deltaT = objects.deltaT[index];
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(objects.posX[index], objects.posY[index], objects.posZ[index]));
+			model = glm::rotate(model, -sinf(glm::radians(deltaT * 360.0f)) * 0.25f, glm::vec3(rotationDir, 0.0f, 0.0f));
+			model = glm::rotate(model, glm::radians(objects.rotationY[index]), glm::vec3(0.0f, rotationDir, 0.0f));
+			model = glm::rotate(model, glm::radians(deltaT * 360.0f), glm::vec3(0.0f, rotationDir, 0.0f));
+			model = glm::scale(model, glm::vec3(objects.scale[index]));
+			thread->pushConstBlock[i].mvp = viewProjection * model;
+			thread->pushConstBlock[i].color = objects.color[index];
+		}
+	}
+
+	// The CPU work that doesn't touch Vulkan objects runs in the frame graph:
+	// Updating the view and animating the objects are independent, culling depends on both
+	// The graph for the next frame is launched right after submitting the current frame, so it overlaps with the GPU work
+	void prepareFrameGraph()
+	{
+		vks::TaskGraph::Resource view = frameGraph.addResource("view");
+		vks::TaskGraph::Resource objectState = frameGraph.addResource("objects");
+		vks::TaskGraph::Resource drawData = frameGraph.addResource("draw data");
+
+		frameGraph.addTask("View", [this]() {
+			matrices.projection = frameInput.projection;
+			matrices.view = frameInput.view;
+			frustum.update(matrices.projection * matrices.view);
+		}, {}, { view });
+
+		frameGraph.addTask("Animate", [this]() {
+			jobSystem.parallel_for(0, objectCount, 4096, [this](uint32_t first, uint32_t last) {
+				animateObjects(first, last);
+			});
+		}, {}, { objectState });
+
+		frameGraph.addTask("Cull", [this]() {
+			jobSystem.parallel_for(0, numThreads, 1, [this](uint32_t first, uint32_t last) {
+				for (uint32_t t = first; t < last; t++) {
+					cullObjects(&threadData[t]);
+				}
+			});
+		}, { view, objectState }, { drawData });
+	}
+
+	void startFrameGraph()
+	{
+		frameInput.projection = camera.matrices.perspective;
+		frameInput.view = camera.matrices.view;
+		frameInput.frameTimer = frameTimer;
+		frameInput.paused = paused;
+		VulkanExampleBase::launchFrameGraph();
+	}
+
+	// Compares the job system against the simple thread pool
+	// Throughput: Many small jobs spread over all threads, latency: round trip time of a single job that's waited for
+	void runJobBenchmark()
+	{
+		const uint32_t jobCount = 100000;
+		const uint32_t latencyRuns = 1000;
+		std::atomic<uint32_t> result(0);
+		auto work = [&result]() {
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < 64; i++) {
+				value = value * 31 + i;
+			}
+			result.fetch_add(value, std::memory_order_relaxed);
+		};
+		auto elapsed = [](std::chrono::high_resolution_clock::time_point start) {
+			return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+		};
+
+		// The benchmark shares the job system with the frame graph
+		frameGraph.wait();
+
+		vks::ThreadPool threadPool;
+		threadPool.setThreadCount(numThreads);
+
+		// Throughput
+		auto tStart = std::chrono::high_resolution_clock::now();
+		vks::JobCounter counter;
+		for (uint32_t i = 0; i < jobCount; i++) {
+			jobSystem.run(work, &counter);
+		}
+		jobSystem.wait(counter);
+		jobBenchmark.jobSystemThroughput = jobCount / (elapsed(tStart) / 1000000.0);
+
+		tStart = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < jobCount; i++) {
+			threadPool.threads[i % numThreads]->addJob(work);
+		}
+		threadPool.wait();
+		jobBenchmark.threadPoolThroughput = jobCount / (elapsed(tStart) / 1000000.0);
+
+		// Latency
+		tStart = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < latencyRuns; i++) {
+			jobSystem.run(work, &counter);
+			jobSystem.wait(counter);
+		}
+		jobBenchmark.jobSystemLatency = elapsed(tStart) / latencyRuns;
+
+		tStart = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < latencyRuns; i++) {
+			threadPool.threads[0]->addJob(work);
+			threadPool.threads[0]->wait();
+		}
+		jobBenchmark.threadPoolLatency = elapsed(tStart) / latencyRuns;
+
+		jobBenchmark.available = true;
+		std::cout << "Job benchmark (" << numThreads << " threads, " << jobCount << " jobs)" << std::endl;
+		std::cout << "  Job system:  " << jobBenchmark.jobSystemThroughput / 1000000.0 << " M jobs/s, " << jobBenchmark.jobSystemLatency << " us latency" << std::endl;
+		std::cout << "  Thread pool: " << jobBenchmark.threadPoolThroughput / 1000000.0 << " M jobs/s, " << jobBenchmark.threadPoolLatency << " us latency" << std::endl;
+	}
+
+	// Culls one million bounding spheres and boxes with every instruction set supported by the CPU
+	// The scalar path is the reference, all SIMD paths have to produce the same visible sets
+	void runCullBenchmark()
+	{
+		const uint32_t boundsCount = 1000000;
+		const uint32_t iterations = 8;
+		auto elapsed = [](std::chrono::high_resolution_clock::time_point start) {
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		};
+
+		// Bounds are spread in a cube around the origin, only the part inside the current view frustum is visible
+		std::default_random_engine rndGen(0);
+		std::uniform_real_distribution<float> rndPosition(-128.0f, 128.0f);
+		std::uniform_real_distribution<float> rndSize(0.1f, 2.0f);
+		std::vector<float> x(boundsCount), y(boundsCount), z(boundsCount), radius(boundsCount);
+		std::vector<float> extentX(boundsCount), extentY(boundsCount), extentZ(boundsCount);
+		for (uint32_t i = 0; i < boundsCount; i++) {
+			x[i] = rndPosition(rndGen);
+			y[i] = rndPosition(rndGen);
+			z[i] = rndPosition(rndGen);
+			radius[i] = rndSize(rndGen);
+			extentX[i] = rndSize(rndGen);
+			extentY[i] = rndSize(rndGen);
+			extentZ[i] = rndSize(rndGen);
+		}
+		const vks::AABBBounds boxes = { x.data(), y.data(), z.data(), extentX.data(), extentY.data(), extentZ.data() };
+
+		vks::Frustum cullFrustum;
+		cullFrustum.update(camera.matrices.perspective * camera.matrices.view);
+
+		std::vector<uint32_t> visibleIndices(boundsCount), referenceIndices(boundsCount);
+		std::vector<uint32_t> visibleMask((boundsCount + 31) / 32), referenceMask((boundsCount + 31) / 32);
+		std::vector<uint8_t> planeHints((boundsCount + vks::Frustum::hintBlockSize - 1) / vks::Frustum::hintBlockSize);
+
+		cullFrustum.instructionSet = vks::Frustum::InstructionSet::Scalar;
+		const uint32_t referenceCount = cullFrustum.cullSpheres(x.data(), y.data(), z.data(), radius.data(), boundsCount, referenceIndices.data());
+		cullFrustum.cullAABBsMask(boxes, boundsCount, referenceMask.data());
+
+		cullBenchmark.clear();
+		const vks::Frustum::InstructionSet instructionSets[] = { vks::Frustum::InstructionSet::Scalar, vks::Frustum::InstructionSet::SSE, vks::Frustum::InstructionSet::AVX, vks::Frustum::InstructionSet::NEON };
+		for (auto instructionSet : instructionSets) {
+			if (!vks::Frustum::instructionSetSupported(instructionSet)) {
+				continue;
+			}
+			cullFrustum.instructionSet = instructionSet;
+			CullBenchmarkResult result{};
+			result.instructionSet = instructionSet;
+			result.matchesReference = true;
+			uint32_t visibleCount = 0;
+
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < iterations; i++) {
+				visibleCount = cullFrustum.cullSpheres(x.data(), y.data(), z.data(), radius.data(), boundsCount, visibleIndices.data());
+			}
+			result.spheres = elapsed(tStart) / iterations;
+			result.matchesReference &= (visibleCount == referenceCount) && std::equal(referenceIndices.begin(), referenceIndices.begin() + referenceCount, visibleIndices.begin());
+
+			// The first iteration fills the hints, the following ones profit from them as the bounds don't move
+			std::fill(planeHints.begin(), planeHints.end(), 0);
+			cullFrustum.cullSpheres(x.data(), y.data(), z.data(), radius.data(), boundsCount, visibleIndices.data(), 0, planeHints.data());
+			tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < iterations; i++) {
+				visibleCount = cullFrustum.cullSpheres(x.data(), y.data(), z.data(), radius.data(), boundsCount, visibleIndices.data(), 0, planeHints.data());
+			}
+			result.spheresHinted = elapsed(tStart) / iterations;
+			result.matchesReference &= (visibleCount == referenceCount) && std::equal(referenceIndices.begin(), referenceIndices.begin() + referenceCount, visibleIndices.begin());
+
+			tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < iterations; i++) {
+				cullFrustum.cullAABBs(boxes, boundsCount, visibleIndices.data());
+			}
+			result.aabbs = elapsed(tStart) / iterations;
+
+			tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < iterations; i++) {
+				cullFrustum.cullAABBsMask(boxes, boundsCount, visibleMask.data());
+			}
+			result.aabbsMask = elapsed(tStart) / iterations;
+			result.matchesReference &= (visibleMask == referenceMask);
+
+			cullBenchmark.push_back(result);
+		}
+
+		std::cout << "Cull benchmark (" << boundsCount << " bounds, " << referenceCount << " visible spheres)" << std::endl;
+		for (auto &result : cullBenchmark) {
+			std::cout << "  " << vks::Frustum::instructionSetName(result.instructionSet) << ": spheres " << result.spheres << " ms (" << result.spheresHinted << " ms with plane hints), "
+				<< "boxes " << result.aabbs << " ms (" << result.aabbsMask << " ms bitmask)" << (result.matchesReference ? "" : ", MISMATCH against scalar reference") << std::endl;
+		}
+	}
+
 	void loadAssets()
 	{
+		VKS_PROFILE_FUNCTION();
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
 		models.ufo.loadFromFile(getAssetPath() + "models/retroufo_red_lowpoly.gltf",vulkanDevice, queue,glTFLoadingFlags);
 		models.starSphere.loadFromFile(getAssetPath() + "models/sphere.gltf", vulkanDevice, queue, glTFLoadingFlags);
@@ -435,6 +800,7 @@ public:
 
 	void preparePipelines()
 	{
+		VKS_PROFILE_FUNCTION();
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
 		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
@@ -471,46 +837,139 @@ public:
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.starsphere));
 	}
 
-	void updateMatrices()
-	{
-		matrices.projection = camera.matrices.perspective;
-		matrices.view = camera.matrices.view;
-		frustum.update(matrices.projection * matrices.view);
-	}
-
 	void draw()
 	{
-		// Wait for fence to signal that all command buffers are ready
+		auto tFrameStart = std::chrono::high_resolution_clock::now();
+		frameTimes.frame = std::chrono::duration<double, std::milli>(tFrameStart - lastFrameStart).count();
+		lastFrameStart = tFrameStart;
+
+		// Object animation and culling for this frame ran in the frame graph while the GPU was busy with the last frame
+		frameGraph.wait();
+		frameGraphStats.resize(frameGraph.taskCount());
+		for (uint32_t i = 0; i < frameGraph.taskCount(); i++) {
+			frameGraphStats[i] = frameGraph.taskInfo(i);
+		}
+		visibleObjectCount = 0;
+		for (auto& thread : threadData) {
+			visibleObjectCount += thread.visibleCount;
+		}
+
+		// Wait until the GPU has finished the frame that last used this frame's resources
+		// With more than one frame in flight, the previous frame may still be executing while this one is recorded
+		FrameResources &frame = frames[frameIndex];
+		auto tStart = std::chrono::high_resolution_clock::now();
 		VkResult fenceRes;
 		do {
-			fenceRes = vkWaitForFences(device, 1, &renderFence, VK_TRUE, 100000000);
+			fenceRes = vkWaitForFences(device, 1, &frame.fence, VK_TRUE, 100000000);
 		} while (fenceRes == VK_TIMEOUT);
 		VK_CHECK_RESULT(fenceRes);
-		vkResetFences(device, 1, &renderFence);
+		frameTimes.fenceWait = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		vkResetFences(device, 1, &frame.fence);
 
-		VulkanExampleBase::prepareFrame();
+		VulkanExampleBase::prepareFrame(frame.presentComplete);
 
+		tStart = std::chrono::high_resolution_clock::now();
 		updateCommandBuffers(frameBuffers[currentBuffer]);
+		frameTimes.recording = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		VkSubmitInfo frameSubmitInfo = vks::initializers::submitInfo();
+		frameSubmitInfo.pWaitDstStageMask = &waitStageMask;
+		frameSubmitInfo.waitSemaphoreCount = 1;
+		frameSubmitInfo.pWaitSemaphores = &frame.presentComplete;
+		frameSubmitInfo.signalSemaphoreCount = 1;
+		frameSubmitInfo.pSignalSemaphores = &frame.renderComplete;
+		frameSubmitInfo.commandBufferCount = 1;
+		frameSubmitInfo.pCommandBuffers = &frame.primaryCommandBuffer;
 
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &primaryCommandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &frameSubmitInfo, frame.fence));
 
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, renderFence));
+		// Start the CPU work for the next frame before presenting
+		startFrameGraph();
 
-		VulkanExampleBase::submitFrame();
+		// Don't wait for the queue to become idle, the fences keep the frames in flight apart
+		VulkanExampleBase::submitFrame(frame.renderComplete, false);
+
+		frameIndex = (frameIndex + 1) % MAX_CONCURRENT_FRAMES;
+	}
+
+	// Waits until the GPU has finished all frames in flight
+	void waitForFrames()
+	{
+		for (auto& frame : frames) {
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+		}
+	}
+
+	// Renders a number of frames for each combination of thread and object count and reports the average CPU recording time and frame time
+	// Both the job system's workers and the thread data blocks are set to the thread count of a step
+	// Uses the same seed for every run so that all combinations animate the same objects
+	void runRecordingSweep()
+	{
+		const uint32_t defaultThreadCount = numThreads;
+		const uint32_t defaultObjectCount = objectCount;
+		std::stringstream results;
+		results << std::fixed << std::setprecision(3);
+		results << "threads,objects,recording (ms),frame (ms),fence wait (ms)" << "\n";
+		for (uint32_t threadCount : recordingSweep.threadCounts) {
+			for (uint32_t sweepObjectCount : recordingSweep.objectCounts) {
+				frameGraph.wait();
+				waitForFrames();
+				destroyThreadData();
+				// The job system is recreated with the thread count of this step, so it limits the workers recording and culling and not only the number of thread data blocks
+				jobSystem.destroy();
+				jobSystem.create(threadCount);
+				numThreads = threadCount;
+				objectCount = sweepObjectCount;
+				rndEngine.seed(0);
+				prepareObjects();
+				prepareThreadData();
+				double recording = 0.0, frame = 0.0, fenceWait = 0.0;
+				for (uint32_t i = 0; i < recordingSweep.warmupFrames + recordingSweep.frames; i++) {
+					draw();
+					if (i >= recordingSweep.warmupFrames) {
+						recording += frameTimes.recording;
+						frame += frameTimes.frame;
+						fenceWait += frameTimes.fenceWait;
+					}
+				}
+				const double frameCount = (double)recordingSweep.frames;
+				results << threadCount << "," << objectCount << "," << recording / frameCount << "," << frame / frameCount << "," << fenceWait / frameCount << "\n";
+			}
+		}
+		recordingSweep.results = results.str();
+		std::cout << "Recording sweep (" << MAX_CONCURRENT_FRAMES << " frames in flight)" << "\n" << recordingSweep.results;
+
+		// Restore the default configuration
+		frameGraph.wait();
+		waitForFrames();
+		destroyThreadData();
+		jobSystem.destroy();
+		jobSystem.create(defaultThreadCount);
+		numThreads = defaultThreadCount;
+		objectCount = defaultObjectCount;
+		prepareObjects();
+		prepareThreadData();
 	}
 
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
-		// Create a fence for synchronization
-		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-		vkCreateFence(device, &fenceCreateInfo, nullptr, &renderFence);
 		loadAssets();
 		setupPipelineLayout();
 		preparePipelines();
-		prepareMultiThreadedRenderer();
-		updateMatrices();
+		prepareFrameResources();
+		prepareObjects();
+		prepareThreadData();
+		if (commandLineParser.isSet("jobbenchmark")) {
+			runJobBenchmark();
+		}
+		if (commandLineParser.isSet("cullbenchmark")) {
+			runCullBenchmark();
+		}
+		prepareFrameGraph();
+		startFrameGraph();
+		lastFrameStart = std::chrono::high_resolution_clock::now();
 		prepared = true;
 	}
 
@@ -518,26 +977,55 @@ public:
 	{
 		if (!prepared)
 			return;
-		draw();
-		if (camera.updated)
-		{
-			updateMatrices();
+		if (recordingSweep.requested) {
+			recordingSweep.requested = false;
+			runRecordingSweep();
 		}
-	}
-
-	virtual void viewChanged()
-	{
-		updateMatrices();
+		draw();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Statistics")) {
 			overlay->text("Active threads: %d", numThreads);
+			overlay->text("Objects: %d (%d visible)", objectCount, visibleObjectCount);
+			overlay->text("Recording: %.3f ms", frameTimes.recording);
+			overlay->text("Fence wait: %.3f ms", frameTimes.fenceWait);
+		}
+		if (overlay->header("Frame graph")) {
+			for (auto &task : frameGraphStats) {
+				overlay->text("%s: %.3f ms", task.name.c_str(), task.duration);
+			}
 		}
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Stars", &displayStarSphere);
 		}
+		if (overlay->header("Recording sweep")) {
+			if (overlay->button("Run sweep")) {
+				// Runs at the start of the next frame, outside of the UI update
+				recordingSweep.requested = true;
+			}
+			if (!recordingSweep.results.empty()) {
+				overlay->text("%s", recordingSweep.results.c_str());
+			}
+		}
+		if (overlay->header("Job system benchmark")) {
+			if (overlay->button("Run")) {
+				runJobBenchmark();
+			}
+			if (jobBenchmark.available) {
+				overlay->text("Job system: %.2f M jobs/s, %.1f us", jobBenchmark.jobSystemThroughput / 1000000.0, jobBenchmark.jobSystemLatency);
+				overlay->text("Thread pool: %.2f M jobs/s, %.1f us", jobBenchmark.threadPoolThroughput / 1000000.0, jobBenchmark.threadPoolLatency);
+			}
+		}
+		if (overlay->header("Cull benchmark")) {
+			if (overlay->button("Cull 1M bounds")) {
+				runCullBenchmark();
+			}
+			for (auto &result : cullBenchmark) {
+				overlay->text("%s: %.2f ms spheres, %.2f ms boxes%s", vks::Frustum::instructionSetName(result.instructionSet), result.spheres, result.aabbs, result.matchesReference ? "" : " (mismatch)");
+			}
+		}
 
 	}
 };
@@ -8,9 +8,23 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "jobsystem.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define PARTICLE_SIMD_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define PARTICLE_SIMD_NEON
+#include <arm_neon.h>
+#endif
 
 #define ENABLE_VALIDATION false
+// Initial number of particles, can be overridden at compile time and changed at runtime via the UI
+#ifndef PARTICLE_COUNT
 #define PARTICLE_COUNT 512
+#endif
+// Number of particles that are updated as one job
+#define PARTICLE_CHUNK_SIZE 16384
 #define PARTICLE_SIZE 10.0f
 
 #define FLAME_RADIUS 8.0f
@@ -18,16 +32,58 @@
 #define PARTICLE_TYPE_FLAME 0
 #define PARTICLE_TYPE_SMOKE 1
 
-struct Particle {
+// Particle attributes read by the vertex shader
+struct ParticleVertex {
 	glm::vec4 pos;
 	glm::vec4 color;
 	float alpha;
 	float size;
 	float rotation;
 	uint32_t type;
-	// Attributes not used in shader
-	glm::vec4 vel;
-	float rotationSpeed;
+};
+
+// Small and fast xorshift random number generator
+// Every chunk of particles has its own generator, so chunks can be updated in parallel and results don't depend on the thread count
+struct XorShiftRNG {
+	uint32_t state;
+	void seed(uint32_t value)
+	{
+		// Xorshift gets stuck at zero
+		state = value ? value : 0x9E3779B9;
+	}
+	uint32_t next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+	// Returns a random value in [0..range)
+	float operator()(float range)
+	{
+		return (float)(next() >> 8) * (1.0f / 16777216.0f) * range;
+	}
+};
+
+// Simulation state of all particles stored as a structure of arrays, so the update can process several particles at once
+// All color channels of a particle have the same value, so only one is stored
+struct ParticleStore {
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> velX, velY, velZ;
+	std::vector<float> color;
+	std::vector<float> alpha;
+	std::vector<float> size;
+	std::vector<float> rotation;
+	std::vector<float> rotationSpeed;
+	std::vector<uint32_t> type;
+
+	void resize(size_t count)
+	{
+		for (auto attribute : { &posX, &posY, &posZ, &velX, &velY, &velZ, &color, &alpha, &size, &rotation, &rotationSpeed }) {
+			attribute->resize(count);
+		}
+		type.resize(count);
+	}
 };
 
 class VulkanExample : public VulkanExampleBase
@@ -93,9 +149,15 @@ public:
 		VkDescriptorSet environment;
 	} descriptorSets;
 
-	std::vector<Particle> particleBuffer;
+	ParticleStore particleStore;
+	uint32_t particleCount = PARTICLE_COUNT;
+	int32_t particleCountIndex = 0;
+	const std::vector<uint32_t> particleCounts = { PARTICLE_COUNT, PARTICLE_COUNT * 64, PARTICLE_COUNT * 512, PARTICLE_COUNT * 2048, PARTICLE_COUNT * 8192 };
+	std::vector<XorShiftRNG> chunkRNGs;
+	uint32_t rngSeed;
 
-	std::default_random_engine rndEngine;
+	// CPU time spent on the particle update in ms, smoothed over several frames
+	float particleUpdateTime = 0.0f;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -105,7 +167,9 @@ public:
 		camera.setRotation(glm::vec3(-15.0f, 45.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 1.0f, 256.0f);
 		timerSpeed *= 8.0f;
-		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
+		rngSeed = benchmark.active ? 0 : (uint32_t)time(nullptr);
+		// Particle chunks are updated by the jobs of the job system from the base class
+		jobSystem.create();
 	}
 
 	~VulkanExample()
@@ -124,9 +188,7 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		vkUnmapMemory(device, particles.memory);
-		vkDestroyBuffer(device, particles.buffer, nullptr);
-		vkFreeMemory(device, particles.memory, nullptr);
+		destroyParticles();
 
 		uniformBuffers.environment.destroy();
 		uniformBuffers.fire.destroy();
@@ -185,7 +247,7 @@ public:
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.particles, 0, nullptr);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.particles);
 			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &particles.buffer, offsets);
-			vkCmdDraw(drawCmdBuffers[i], PARTICLE_COUNT, 1, 0, 0);
+			vkCmdDraw(drawCmdBuffers[i], particleCount, 1, 0, 0);
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -195,114 +257,252 @@ public:
 		}
 	}
 
-	float rnd(float range)
+	void initParticle(uint32_t index, XorShiftRNG &rnd)
 	{
-		std::uniform_real_distribution<float> rndDist(0.0f, range);
-		return rndDist(rndEngine);
-	}
-
-	void initParticle(Particle *particle, glm::vec3 emitterPos)
-	{
-		particle->vel = glm::vec4(0.0f, minVel.y + rnd(maxVel.y - minVel.y), 0.0f, 0.0f);
-		particle->alpha = rnd(0.75f);
-		particle->size = 1.0f + rnd(0.5f);
-		particle->color = glm::vec4(1.0f);
-		particle->type = PARTICLE_TYPE_FLAME;
-		particle->rotation = rnd(2.0f * float(M_PI));
-		particle->rotationSpeed = rnd(2.0f) - rnd(2.0f);
+		ParticleStore &p = particleStore;
+		p.velX[index] = 0.0f;
+		p.velY[index] = minVel.y + rnd(maxVel.y - minVel.y);
+		p.velZ[index] = 0.0f;
+		p.alpha[index] = rnd(0.75f);
+		p.size[index] = 1.0f + rnd(0.5f);
+		p.color[index] = 1.0f;
+		p.type[index] = PARTICLE_TYPE_FLAME;
+		p.rotation[index] = rnd(2.0f * float(M_PI));
+		p.rotationSpeed[index] = rnd(2.0f) - rnd(2.0f);
 
 		// Get random sphere point
 		float theta = rnd(2.0f * float(M_PI));
 		float phi = rnd(float(M_PI)) - float(M_PI) / 2.0f;
 		float r = rnd(FLAME_RADIUS);
 
-		particle->pos.x = r * cos(theta) * cos(phi);
-		particle->pos.y = r * sin(phi);
-		particle->pos.z = r * sin(theta) * cos(phi);
-
-		particle->pos += glm::vec4(emitterPos, 0.0f);
+		p.posX[index] = r * cos(theta) * cos(phi) + emitterPos.x;
+		p.posY[index] = r * sin(phi) + emitterPos.y;
+		p.posZ[index] = r * sin(theta) * cos(phi) + emitterPos.z;
 	}
 
-	void transitionParticle(Particle *particle)
+	void transitionParticle(uint32_t index, XorShiftRNG &rnd)
 	{
-		switch (particle->type)
+		ParticleStore &p = particleStore;
+		switch (p.type[index])
 		{
 		case PARTICLE_TYPE_FLAME:
 			// Flame particles have a chance of turning into smoke
 			if (rnd(1.0f) < 0.05f)
 			{
-				particle->alpha = 0.0f;
-				particle->color = glm::vec4(0.25f + rnd(0.25f));
-				particle->pos.x *= 0.5f;
-				particle->pos.z *= 0.5f;
-				particle->vel = glm::vec4(rnd(1.0f) - rnd(1.0f), (minVel.y * 2) + rnd(maxVel.y - minVel.y), rnd(1.0f) - rnd(1.0f), 0.0f);
-				particle->size = 1.0f + rnd(0.5f);
-				particle->rotationSpeed = rnd(1.0f) - rnd(1.0f);
-				particle->type = PARTICLE_TYPE_SMOKE;
+				p.alpha[index] = 0.0f;
+				p.color[index] = 0.25f + rnd(0.25f);
+				p.posX[index] *= 0.5f;
+				p.posZ[index] *= 0.5f;
+				p.velX[index] = rnd(1.0f) - rnd(1.0f);
+				p.velY[index] = (minVel.y * 2) + rnd(maxVel.y - minVel.y);
+				p.velZ[index] = rnd(1.0f) - rnd(1.0f);
+				p.size[index] = 1.0f + rnd(0.5f);
+				p.rotationSpeed[index] = rnd(1.0f) - rnd(1.0f);
+				p.type[index] = PARTICLE_TYPE_SMOKE;
 			}
 			else
 			{
-				initParticle(particle, emitterPos);
+				initParticle(index, rnd);
 			}
 			break;
 		case PARTICLE_TYPE_SMOKE:
 			// Respawn at end of life
-			initParticle(particle, emitterPos);
+			initParticle(index, rnd);
 			break;
 		}
 	}
 
 	void prepareParticles()
 	{
-		particleBuffer.resize(PARTICLE_COUNT);
-		for (auto& particle : particleBuffer)
+		particleStore.resize(particleCount);
+
+		const uint32_t chunkCount = (particleCount + PARTICLE_CHUNK_SIZE - 1) / PARTICLE_CHUNK_SIZE;
+		chunkRNGs.resize(chunkCount);
+		for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+			chunkRNGs[chunk].seed(rngSeed + chunk * 0x9E3779B9);
+		}
+
+		for (uint32_t i = 0; i < particleCount; i++)
 		{
-			initParticle(&particle, emitterPos);
-			particle.alpha = 1.0f - (abs(particle.pos.y) / (FLAME_RADIUS * 2.0f));
+			initParticle(i, chunkRNGs[i / PARTICLE_CHUNK_SIZE]);
+			particleStore.alpha[i] = 1.0f - (fabs(particleStore.posY[i]) / (FLAME_RADIUS * 2.0f));
 		}
 
-		particles.size = particleBuffer.size() * sizeof(Particle);
+		particles.size = particleCount * sizeof(ParticleVertex);
 
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			particles.size,
 			&particles.buffer,
-			&particles.memory,
-			particleBuffer.data()));
+			&particles.memory));
 
 		// Map the memory and store the pointer for reuse
 		VK_CHECK_RESULT(vkMapMemory(device, particles.memory, 0, particles.size, 0, &particles.mappedMemory));
+
+		writeParticleVertices(0, particleCount);
 	}
 
-	void updateParticles()
+	void destroyParticles()
+	{
+		vkUnmapMemory(device, particles.memory);
+		vkDestroyBuffer(device, particles.buffer, nullptr);
+		vkFreeMemory(device, particles.memory, nullptr);
+	}
+
+	// Scalar update of a single particle, returns true if the particle has reached the end of its current state
+	bool updateParticle(uint32_t i, float frameTime, float particleTimer)
 	{
-		float particleTimer = frameTimer * 0.45f;
-		for (auto& particle : particleBuffer)
+		ParticleStore &p = particleStore;
+		switch (p.type[i])
 		{
-			switch (particle.type)
-			{
-			case PARTICLE_TYPE_FLAME:
-				particle.pos.y -= particle.vel.y * particleTimer * 3.5f;
-				particle.alpha += particleTimer * 2.5f;
-				particle.size -= particleTimer * 0.5f;
-				break;
-			case PARTICLE_TYPE_SMOKE:
-				particle.pos -= particle.vel * frameTimer * 1.0f;
-				particle.alpha += particleTimer * 1.25f;
-				particle.size += particleTimer * 0.125f;
-				particle.color -= particleTimer * 0.05f;
-				break;
+		case PARTICLE_TYPE_FLAME:
+			p.posY[i] -= p.velY[i] * particleTimer * 3.5f;
+			p.alpha[i] += particleTimer * 2.5f;
+			p.size[i] -= particleTimer * 0.5f;
+			break;
+		case PARTICLE_TYPE_SMOKE:
+			p.posX[i] -= p.velX[i] * frameTime;
+			p.posY[i] -= p.velY[i] * frameTime;
+			p.posZ[i] -= p.velZ[i] * frameTime;
+			p.alpha[i] += particleTimer * 1.25f;
+			p.size[i] += particleTimer * 0.125f;
+			p.color[i] -= particleTimer * 0.05f;
+			break;
+		}
+		p.rotation[i] += particleTimer * p.rotationSpeed[i];
+		return p.alpha[i] > 2.0f;
+	}
+
+	// Update the particles in [first..last), four at a time if SIMD is available
+	// Flame and smoke particles are updated with the same instructions, the per-type rates are selected with a mask
+	void updateParticleRange(uint32_t first, uint32_t last, XorShiftRNG &rnd, float frameTime)
+	{
+		ParticleStore &p = particleStore;
+		const float particleTimer = frameTime * 0.45f;
+		uint32_t i = first;
+#if defined(PARTICLE_SIMD_SSE)
+		auto select = [](const __m128 &mask, const __m128 &a, const __m128 &b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); };
+		const __m128i flameType = _mm_set1_epi32(PARTICLE_TYPE_FLAME);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 rateXZ = _mm_set1_ps(frameTime);
+		const __m128 flameRateY = _mm_set1_ps(particleTimer * 3.5f);
+		const __m128 flameAlpha = _mm_set1_ps(particleTimer * 2.5f);
+		const __m128 smokeAlpha = _mm_set1_ps(particleTimer * 1.25f);
+		const __m128 flameSize = _mm_set1_ps(-particleTimer * 0.5f);
+		const __m128 smokeSize = _mm_set1_ps(particleTimer * 0.125f);
+		const __m128 smokeColor = _mm_set1_ps(particleTimer * 0.05f);
+		const __m128 rotationRate = _mm_set1_ps(particleTimer);
+		const __m128 maxAlpha = _mm_set1_ps(2.0f);
+		for (; i + 4 <= last; i += 4) {
+			const __m128 flame = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&p.type[i])), flameType));
+			const __m128 moveXZ = select(flame, zero, rateXZ);
+			const __m128 moveY = select(flame, flameRateY, rateXZ);
+			_mm_storeu_ps(&p.posX[i], _mm_sub_ps(_mm_loadu_ps(&p.posX[i]), _mm_mul_ps(_mm_loadu_ps(&p.velX[i]), moveXZ)));
+			_mm_storeu_ps(&p.posY[i], _mm_sub_ps(_mm_loadu_ps(&p.posY[i]), _mm_mul_ps(_mm_loadu_ps(&p.velY[i]), moveY)));
+			_mm_storeu_ps(&p.posZ[i], _mm_sub_ps(_mm_loadu_ps(&p.posZ[i]), _mm_mul_ps(_mm_loadu_ps(&p.velZ[i]), moveXZ)));
+			const __m128 alpha = _mm_add_ps(_mm_loadu_ps(&p.alpha[i]), select(flame, flameAlpha, smokeAlpha));
+			_mm_storeu_ps(&p.alpha[i], alpha);
+			_mm_storeu_ps(&p.size[i], _mm_add_ps(_mm_loadu_ps(&p.size[i]), select(flame, flameSize, smokeSize)));
+			_mm_storeu_ps(&p.color[i], _mm_sub_ps(_mm_loadu_ps(&p.color[i]), select(flame, zero, smokeColor)));
+			_mm_storeu_ps(&p.rotation[i], _mm_add_ps(_mm_loadu_ps(&p.rotation[i]), _mm_mul_ps(_mm_loadu_ps(&p.rotationSpeed[i]), rotationRate)));
+			// Transition particle state
+			const int expired = _mm_movemask_ps(_mm_cmpgt_ps(alpha, maxAlpha));
+			if (expired) {
+				for (uint32_t lane = 0; lane < 4; lane++) {
+					if (expired & (1 << lane)) {
+						transitionParticle(i + lane, rnd);
+					}
+				}
 			}
-			particle.rotation += particleTimer * particle.rotationSpeed;
+		}
+#elif defined(PARTICLE_SIMD_NEON)
+		const uint32x4_t flameType = vdupq_n_u32(PARTICLE_TYPE_FLAME);
+		const float32x4_t zero = vdupq_n_f32(0.0f);
+		const float32x4_t rateXZ = vdupq_n_f32(frameTime);
+		const float32x4_t flameRateY = vdupq_n_f32(particleTimer * 3.5f);
+		const float32x4_t flameAlpha = vdupq_n_f32(particleTimer * 2.5f);
+		const float32x4_t smokeAlpha = vdupq_n_f32(particleTimer * 1.25f);
+		const float32x4_t flameSize = vdupq_n_f32(-particleTimer * 0.5f);
+		const float32x4_t smokeSize = vdupq_n_f32(particleTimer * 0.125f);
+		const float32x4_t smokeColor = vdupq_n_f32(particleTimer * 0.05f);
+		const float32x4_t maxAlpha = vdupq_n_f32(2.0f);
+		for (; i + 4 <= last; i += 4) {
+			const uint32x4_t flame = vceqq_u32(vld1q_u32(&p.type[i]), flameType);
+			const float32x4_t moveXZ = vbslq_f32(flame, zero, rateXZ);
+			const float32x4_t moveY = vbslq_f32(flame, flameRateY, rateXZ);
+			vst1q_f32(&p.posX[i], vmlsq_f32(vld1q_f32(&p.posX[i]), vld1q_f32(&p.velX[i]), moveXZ));
+			vst1q_f32(&p.posY[i], vmlsq_f32(vld1q_f32(&p.posY[i]), vld1q_f32(&p.velY[i]), moveY));
+			vst1q_f32(&p.posZ[i], vmlsq_f32(vld1q_f32(&p.posZ[i]), vld1q_f32(&p.velZ[i]), moveXZ));
+			const float32x4_t alpha = vaddq_f32(vld1q_f32(&p.alpha[i]), vbslq_f32(flame, flameAlpha, smokeAlpha));
+			vst1q_f32(&p.alpha[i], alpha);
+			vst1q_f32(&p.size[i], vaddq_f32(vld1q_f32(&p.size[i]), vbslq_f32(flame, flameSize, smokeSize)));
+			vst1q_f32(&p.color[i], vsubq_f32(vld1q_f32(&p.color[i]), vbslq_f32(flame, zero, smokeColor)));
+			vst1q_f32(&p.rotation[i], vmlaq_n_f32(vld1q_f32(&p.rotation[i]), vld1q_f32(&p.rotationSpeed[i]), particleTimer));
 			// Transition particle state
-			if (particle.alpha > 2.0f)
-			{
-				transitionParticle(&particle);
+			uint32_t expired[4];
+			vst1q_u32(expired, vcgtq_f32(alpha, maxAlpha));
+			for (uint32_t lane = 0; lane < 4; lane++) {
+				if (expired[lane]) {
+					transitionParticle(i + lane, rnd);
+				}
+			}
+		}
+#endif
+		// Remaining particles (or all of them without SIMD)
+		for (; i < last; i++) {
+			if (updateParticle(i, frameTime, particleTimer)) {
+				transitionParticle(i, rnd);
 			}
 		}
-		size_t size = particleBuffer.size() * sizeof(Particle);
-		memcpy(particles.mappedMemory, particleBuffer.data(), size);
+	}
+
+	// Write the shader attributes of the particles in [first..last) directly into the mapped vertex buffer
+	void writeParticleVertices(uint32_t first, uint32_t last)
+	{
+		const ParticleStore &p = particleStore;
+		ParticleVertex *vertices = static_cast<ParticleVertex*>(particles.mappedMemory);
+		for (uint32_t i = first; i < last; i++) {
+			// Build the vertex locally, so the (possibly write-combined) buffer memory is written sequentially
+			ParticleVertex vertex;
+			vertex.pos = glm::vec4(p.posX[i], p.posY[i], p.posZ[i], 1.0f);
+			vertex.color = glm::vec4(p.color[i]);
+			vertex.alpha = p.alpha[i];
+			vertex.size = p.size[i];
+			vertex.rotation = p.rotation[i];
+			vertex.type = p.type[i];
+			vertices[i] = vertex;
+		}
+	}
+
+	void updateParticles()
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		const uint32_t chunkCount = static_cast<uint32_t>(chunkRNGs.size());
+		const float frameTime = frameTimer;
+		auto updateChunk = [this, frameTime](uint32_t chunk) {
+			const uint32_t first = chunk * PARTICLE_CHUNK_SIZE;
+			const uint32_t last = std::min(first + PARTICLE_CHUNK_SIZE, particleCount);
+			updateParticleRange(first, last, chunkRNGs[chunk], frameTime);
+			writeParticleVertices(first, last);
+		};
+
+		if (chunkCount == 1) {
+			// Not worth distributing
+			updateChunk(0);
+		} else {
+			// One job per chunk, idle workers steal chunks from busy ones
+			jobSystem.parallel_for(0, chunkCount, 1, [&](uint32_t first, uint32_t last) {
+				for (uint32_t chunk = first; chunk < last; chunk++) {
+					updateChunk(chunk);
+				}
+			});
+		}
+
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		const float tDiff = std::chrono::duration<float, std::milli>(tEnd - tStart).count();
+		particleUpdateTime = (particleUpdateTime == 0.0f) ? tDiff : particleUpdateTime * 0.95f + tDiff * 0.05f;
 	}
 
 	void loadAssets()
@@ -446,15 +646,15 @@ public:
 		{
 			// Vertex input state
 			VkVertexInputBindingDescription vertexInputBinding =
-				vks::initializers::vertexInputBindingDescription(0, sizeof(Particle), VK_VERTEX_INPUT_RATE_VERTEX);
+				vks::initializers::vertexInputBindingDescription(0, sizeof(ParticleVertex), VK_VERTEX_INPUT_RATE_VERTEX);
 
 			std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
-				vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT,	offsetof(Particle, pos)),	// Location 0: Position
-				vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32A32_SFLOAT,	offsetof(Particle, color)),	// Location 1: Color
-				vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32_SFLOAT, offsetof(Particle, alpha)),			// Location 2: Alpha
-				vks::initializers::vertexInputAttributeDescription(0, 3, VK_FORMAT_R32_SFLOAT, offsetof(Particle, size)),			// Location 3: Size
-				vks::initializers::vertexInputAttributeDescription(0, 4, VK_FORMAT_R32_SFLOAT, offsetof(Particle, rotation)),		// Location 4: Rotation
-				vks::initializers::vertexInputAttributeDescription(0, 5, VK_FORMAT_R32_SINT, offsetof(Particle, type)),				// Location 5: Particle type
+				vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT,	offsetof(ParticleVertex, pos)),	// Location 0: Position
+				vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32A32_SFLOAT,	offsetof(ParticleVertex, color)),	// Location 1: Color
+				vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32_SFLOAT, offsetof(ParticleVertex, alpha)),			// Location 2: Alpha
+				vks::initializers::vertexInputAttributeDescription(0, 3, VK_FORMAT_R32_SFLOAT, offsetof(ParticleVertex, size)),			// Location 3: Size
+				vks::initializers::vertexInputAttributeDescription(0, 4, VK_FORMAT_R32_SFLOAT, offsetof(ParticleVertex, rotation)),		// Location 4: Rotation
+				vks::initializers::vertexInputAttributeDescription(0, 5, VK_FORMAT_R32_SINT, offsetof(ParticleVertex, type)),				// Location 5: Particle type
 			};
 
 			VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
@@ -594,6 +794,28 @@ public:
 	{
 		updateUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			std::vector<std::string> particleCountNames;
+			for (auto count : particleCounts) {
+				particleCountNames.push_back(std::to_string(count));
+			}
+			if (overlay->comboBox("Particle count", &particleCountIndex, particleCountNames)) {
+				vkDeviceWaitIdle(device);
+				destroyParticles();
+				particleCount = particleCounts[particleCountIndex];
+				prepareParticles();
+				// The draw command buffers reference the old particle buffer and count
+				buildCommandBuffers();
+			}
+		}
+		if (overlay->header("Statistics")) {
+			overlay->text("Particles: %d", particleCount);
+			overlay->text("CPU update: %.3f ms/frame", particleUpdateTime);
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
@@ -35,6 +35,13 @@ public:
 		VkPipeline toon;
 	} pipelines;
 
+	// The toon and wireframe variants are compiled in the background, phong is used in their place until all of them are ready
+	struct {
+		std::shared_future<VkPipeline> wireframe;
+		std::shared_future<VkPipeline> toon;
+		bool pending = false;
+	} compiledPipelines;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Pipeline state objects";
@@ -49,6 +56,9 @@ public:
 	{
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
+		// Variants still being compiled reference the pipeline layout and the phong base pipeline
+		pipelineCompiler.wait();
+		applyCompiledPipelines();
 		vkDestroyPipeline(device, pipelines.phong, nullptr);
 		if (enabledFeatures.fillModeNonSolid)
 		{
@@ -253,7 +263,10 @@ public:
 		// Phong shading pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "pipelines/phong.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "pipelines/phong.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		// Phong is created right away, as it's the base for the other pipelines and is rendered in their place until they're ready
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phong));
+		pipelines.toon = pipelines.phong;
+		pipelines.wireframe = pipelines.phong;
 
 		// All pipelines created after the base pipeline will be derivatives
 		pipelineCI.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
@@ -266,7 +279,8 @@ public:
 		// Toon shading pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "pipelines/toon.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "pipelines/toon.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.toon));
+		// The compiler copies the create info, so the state above can be changed for the next pipeline right away
+		compiledPipelines.toon = pipelineCompiler.compile("toon", pipelineCI);
 
 		// Pipeline for wire frame rendering
 		// Non solid rendering is not a mandatory Vulkan feature
@@ -275,8 +289,26 @@ public:
 			rasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
 			shaderStages[0] = loadShader(getShadersPath() + "pipelines/wireframe.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 			shaderStages[1] = loadShader(getShadersPath() + "pipelines/wireframe.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
+			compiledPipelines.wireframe = pipelineCompiler.compile("wireframe", pipelineCI);
+		}
+		compiledPipelines.pending = true;
+	}
+
+	// Replaces the fallback with the compiled variants once all of them are ready, returns true if they have been replaced
+	bool applyCompiledPipelines()
+	{
+		if (!compiledPipelines.pending) {
+			return false;
 		}
+		if (!vks::PipelineCompiler::ready(compiledPipelines.toon) || (compiledPipelines.wireframe.valid() && !vks::PipelineCompiler::ready(compiledPipelines.wireframe))) {
+			return false;
+		}
+		pipelines.toon = compiledPipelines.toon.get();
+		if (compiledPipelines.wireframe.valid()) {
+			pipelines.wireframe = compiledPipelines.wireframe.get();
+		}
+		compiledPipelines.pending = false;
+		return true;
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -330,6 +362,10 @@ public:
 	{
 		if (!prepared)
 			return;
+		if (applyCompiledPipelines()) {
+			pipelineCompiler.printReport();
+			buildCommandBuffers();
+		}
 		draw();
 		if (camera.updated) {
 			updateUniformBuffers();
@@ -344,6 +380,18 @@ public:
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
+		if (overlay->header("Pipeline compilation")) {
+			if (compiledPipelines.pending) {
+				overlay->text("Compiling variants...");
+			}
+			else {
+				const vks::PipelineCompiler::Statistics statistics = pipelineCompiler.statistics();
+				overlay->text("Wall clock: %.2f ms", statistics.wallTime);
+				for (auto &timing : statistics.timings) {
+					overlay->text("%s: %.2f ms", timing.name.c_str(), timing.compileTime);
+				}
+			}
+		}
 		if (!enabledFeatures.fillModeNonSolid) {
 			if (overlay->header("Info")) {
 				overlay->text("Non solid fill modes not supported!");
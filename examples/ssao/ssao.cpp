@@ -485,6 +485,7 @@ public:
 
 	void loadAssets()
 	{
+		VKS_PROFILE_FUNCTION();
 		vkglTF::descriptorBindingFlags  = vkglTF::DescriptorBindingFlags::ImageBaseColor;
 		const uint32_t gltfLoadingFlags = vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::PreTransformVertices;
 		scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, gltfLoadingFlags);
@@ -498,6 +499,9 @@ public:
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			// Each command buffer records its GPU timings into its own profiler slot
+			gpuProfiler.beginFrame(drawCmdBuffers[i], i);
+
 			/*
 				Offscreen SSAO generation
 			*/
@@ -521,6 +525,7 @@ public:
 					First pass: Fill G-Buffer components (positions+depth, normals, albedo) using MRT
 				*/
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], i, "G-Buffer");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				VkViewport viewport = vks::initializers::viewport((float)frameBuffers.offscreen.width, (float)frameBuffers.offscreen.height, 0.0f, 1.0f);
@@ -535,6 +540,7 @@ public:
 				scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayouts.gBuffer);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i], i);
 
 				/*
 					Second pass: SSAO generation
@@ -550,6 +556,7 @@ public:
 				renderPassBeginInfo.clearValueCount = 2;
 				renderPassBeginInfo.pClearValues = clearValues.data();
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], i, "SSAO");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				viewport = vks::initializers::viewport((float)frameBuffers.ssao.width, (float)frameBuffers.ssao.height, 0.0f, 1.0f);
@@ -562,6 +569,7 @@ public:
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i], i);
 
 				/*
 					Third pass: SSAO blur
@@ -572,6 +580,7 @@ public:
 				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssaoBlur.width;
 				renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssaoBlur.height;
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], i, "SSAO blur");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				viewport = vks::initializers::viewport((float)frameBuffers.ssaoBlur.width, (float)frameBuffers.ssaoBlur.height, 0.0f, 1.0f);
@@ -584,6 +593,7 @@ public:
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i], i);
 			}
 
 			/*
@@ -617,8 +627,10 @@ public:
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composition, 0, 1, &descriptorSets.composition, 0, NULL);
 
 				// Final composition pass
+				gpuProfiler.beginScope(drawCmdBuffers[i], i, "Composition");
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				gpuProfiler.endScope(drawCmdBuffers[i], i);
 
 				drawUI(drawCmdBuffers[i]);
 
@@ -747,6 +759,7 @@ public:
 
 	void preparePipelines()
 	{
+		VKS_PROFILE_FUNCTION();
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
 		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
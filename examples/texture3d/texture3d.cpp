@@ -8,6 +8,26 @@
 
 #include "vulkanexamplebase.h"
 
+#include <atomic>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NOISE_SIMD_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+// The AVX2 kernel is compiled for AVX2 regardless of the target flags and only used if the CPU supports it
+#if defined(__GNUC__) || defined(__clang__)
+#define NOISE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define NOISE_TARGET_AVX2
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define NOISE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
 
@@ -55,6 +75,10 @@ public:
 			permutations[i] = permutations[256 + i] = plookup[i];
 		}
 	}
+	const uint32_t* data() const
+	{
+		return permutations;
+	}
 	T noise(T x, T y, T z)
 	{
 		// Find unit cube that contains point
@@ -125,6 +149,312 @@ public:
 	}
 };
 
+// Evaluates the fractal noise above for whole rows of voxels that share their y and z coordinates
+// The SIMD paths process 8 (AVX2) or 4 (NEON) voxels at once, the per-row parts of the noise are only calculated once per octave
+class FractalNoiseRowKernel
+{
+public:
+	enum class InstructionSet { Scalar, AVX2, NEON };
+	InstructionSet instructionSet;
+
+	FractalNoiseRowKernel(const PerlinNoise<float> &perlinNoise, const FractalNoise<float> &fractalNoise, bool useSimd)
+		: permutations(perlinNoise.data()), fractalNoise(fractalNoise)
+	{
+		instructionSet = useSimd ? bestInstructionSet() : InstructionSet::Scalar;
+	}
+
+	static InstructionSet bestInstructionSet()
+	{
+#if defined(NOISE_SIMD_AVX2)
+		if (avx2Supported()) {
+			return InstructionSet::AVX2;
+		}
+#elif defined(NOISE_SIMD_NEON)
+		return InstructionSet::NEON;
+#endif
+		return InstructionSet::Scalar;
+	}
+
+	static const char* name(InstructionSet instructionSet)
+	{
+		switch (instructionSet) {
+		case InstructionSet::AVX2: return "AVX2";
+		case InstructionSet::NEON: return "NEON";
+		default: return "scalar";
+		}
+	}
+
+	// Writes count voxels of a row, the noise x coordinate of voxel i is i * xScale
+	void row(uint32_t count, float xScale, float y, float z, uint8_t* dst)
+	{
+		switch (instructionSet) {
+#if defined(NOISE_SIMD_AVX2)
+		case InstructionSet::AVX2:
+			rowAVX2(count, xScale, y, z, dst);
+			break;
+#endif
+#if defined(NOISE_SIMD_NEON)
+		case InstructionSet::NEON:
+			rowNEON(count, xScale, y, z, dst);
+			break;
+#endif
+		default:
+			for (uint32_t x = 0; x < count; x++) {
+				float n = fractalNoise.noise((float)x * xScale, y, z);
+				n = n - floor(n);
+				dst[x] = static_cast<uint8_t>(floor(n * 255));
+			}
+		}
+	}
+
+private:
+	const uint32_t* permutations;
+	FractalNoise<float> fractalNoise;
+	// Must match FractalNoise
+	const uint32_t octaves = 6;
+	const float persistence = 0.5f;
+
+	// Scalar parts of a noise lookup that are shared by all voxels of a row
+	struct RowCoordinate {
+		int32_t cell;
+		float frac;
+		float fade;
+	};
+	static RowCoordinate rowCoordinate(float v)
+	{
+		RowCoordinate c;
+		c.cell = (int32_t)floor(v) & 255;
+		c.frac = v - floor(v);
+		c.fade = c.frac * c.frac * c.frac * (c.frac * (c.frac * 6.0f - 15.0f) + 10.0f);
+		return c;
+	}
+
+#if defined(NOISE_SIMD_AVX2)
+	static bool avx2Supported()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) {
+			return false;
+		}
+		__cpuid(info, 1);
+		// The OS has to save the AVX registers on context switches
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		if (!osxsave || ((_xgetbv(0) & 0x6) != 0x6)) {
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	NOISE_TARGET_AVX2 static __m256 fade8(__m256 t)
+	{
+		__m256 r = _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f));
+		r = _mm256_add_ps(_mm256_mul_ps(t, r), _mm256_set1_ps(10.0f));
+		return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), r);
+	}
+
+	NOISE_TARGET_AVX2 static __m256 lerp8(__m256 t, __m256 a, __m256 b)
+	{
+		return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+	}
+
+	NOISE_TARGET_AVX2 static __m256 grad8(__m256i hash, __m256 x, __m256 y, __m256 z)
+	{
+		const __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+		// u = h < 8 ? x : y
+		const __m256i lt8 = _mm256_cmpgt_epi32(_mm256_set1_epi32(8), h);
+		const __m256 u = _mm256_blendv_ps(y, x, _mm256_castsi256_ps(lt8));
+		// v = h < 4 ? y : h == 12 || h == 14 ? x : z
+		const __m256i lt4 = _mm256_cmpgt_epi32(_mm256_set1_epi32(4), h);
+		const __m256i is12or14 = _mm256_or_si256(_mm256_cmpeq_epi32(h, _mm256_set1_epi32(12)), _mm256_cmpeq_epi32(h, _mm256_set1_epi32(14)));
+		__m256 v = _mm256_blendv_ps(z, x, _mm256_castsi256_ps(is12or14));
+		v = _mm256_blendv_ps(v, y, _mm256_castsi256_ps(lt4));
+		// Bit 0 negates u, bit 1 negates v
+		const __m256 uSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(1)), 31));
+		const __m256 vSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30));
+		return _mm256_add_ps(_mm256_xor_ps(u, uSign), _mm256_xor_ps(v, vSign));
+	}
+
+	NOISE_TARGET_AVX2 __m256 perlinNoise8(__m256 x, const RowCoordinate &cy, const RowCoordinate &cz)
+	{
+		const int* perm = reinterpret_cast<const int*>(permutations);
+		const __m256 floorX = _mm256_floor_ps(x);
+		const __m256i X = _mm256_and_si256(_mm256_cvtps_epi32(floorX), _mm256_set1_epi32(255));
+		const __m256 fx = _mm256_sub_ps(x, floorX);
+		const __m256 u = fade8(fx);
+		const __m256i one = _mm256_set1_epi32(1);
+		const __m256i Y = _mm256_set1_epi32(cy.cell);
+		const __m256i Z = _mm256_set1_epi32(cz.cell);
+
+		// Hash coordinates of the 8 cube corners
+		const __m256i A = _mm256_add_epi32(_mm256_i32gather_epi32(perm, X, 4), Y);
+		const __m256i AA = _mm256_add_epi32(_mm256_i32gather_epi32(perm, A, 4), Z);
+		const __m256i AB = _mm256_add_epi32(_mm256_i32gather_epi32(perm, _mm256_add_epi32(A, one), 4), Z);
+		const __m256i B = _mm256_add_epi32(_mm256_i32gather_epi32(perm, _mm256_add_epi32(X, one), 4), Y);
+		const __m256i BA = _mm256_add_epi32(_mm256_i32gather_epi32(perm, B, 4), Z);
+		const __m256i BB = _mm256_add_epi32(_mm256_i32gather_epi32(perm, _mm256_add_epi32(B, one), 4), Z);
+
+		const __m256 fx1 = _mm256_sub_ps(fx, _mm256_set1_ps(1.0f));
+		const __m256 fy = _mm256_set1_ps(cy.frac);
+		const __m256 fy1 = _mm256_set1_ps(cy.frac - 1.0f);
+		const __m256 fz = _mm256_set1_ps(cz.frac);
+		const __m256 fz1 = _mm256_set1_ps(cz.frac - 1.0f);
+		const __m256 v = _mm256_set1_ps(cy.fade);
+		const __m256 w = _mm256_set1_ps(cz.fade);
+
+		// And add blended results for 8 corners of the cube
+		return lerp8(w,
+			lerp8(v,
+				lerp8(u, grad8(_mm256_i32gather_epi32(perm, AA, 4), fx, fy, fz), grad8(_mm256_i32gather_epi32(perm, BA, 4), fx1, fy, fz)),
+				lerp8(u, grad8(_mm256_i32gather_epi32(perm, AB, 4), fx, fy1, fz), grad8(_mm256_i32gather_epi32(perm, BB, 4), fx1, fy1, fz))),
+			lerp8(v,
+				lerp8(u, grad8(_mm256_i32gather_epi32(perm, _mm256_add_epi32(AA, one), 4), fx, fy, fz1), grad8(_mm256_i32gather_epi32(perm, _mm256_add_epi32(BA, one), 4), fx1, fy, fz1)),
+				lerp8(u, grad8(_mm256_i32gather_epi32(perm, _mm256_add_epi32(AB, one), 4), fx, fy1, fz1), grad8(_mm256_i32gather_epi32(perm, _mm256_add_epi32(BB, one), 4), fx1, fy1, fz1))));
+	}
+
+	NOISE_TARGET_AVX2 void rowAVX2(uint32_t count, float xScale, float y, float z, uint8_t* dst)
+	{
+		const __m256 laneOffsets = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+		for (uint32_t x = 0; x < count; x += 8) {
+			const __m256 px = _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps((float)x), laneOffsets), _mm256_set1_ps(xScale));
+			__m256 sum = _mm256_setzero_ps();
+			float frequency = 1.0f;
+			float amplitude = 1.0f;
+			float max = 0.0f;
+			for (uint32_t i = 0; i < octaves; i++) {
+				const RowCoordinate cy = rowCoordinate(y * frequency);
+				const RowCoordinate cz = rowCoordinate(z * frequency);
+				const __m256 n = perlinNoise8(_mm256_mul_ps(px, _mm256_set1_ps(frequency)), cy, cz);
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(n, _mm256_set1_ps(amplitude)));
+				max += amplitude;
+				amplitude *= persistence;
+				frequency *= 2.0f;
+			}
+			// Map to [0..1] and keep the fractional part like the scalar path
+			__m256 n = _mm256_div_ps(_mm256_add_ps(_mm256_div_ps(sum, _mm256_set1_ps(max)), _mm256_set1_ps(1.0f)), _mm256_set1_ps(2.0f));
+			n = _mm256_sub_ps(n, _mm256_floor_ps(n));
+			alignas(32) int32_t values[8];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(values), _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(n, _mm256_set1_ps(255.0f)))));
+			const uint32_t lanes = std::min(count - x, 8u);
+			for (uint32_t lane = 0; lane < lanes; lane++) {
+				dst[x + lane] = static_cast<uint8_t>(values[lane]);
+			}
+		}
+	}
+#endif
+
+#if defined(NOISE_SIMD_NEON)
+	static float32x4_t fade4(float32x4_t t)
+	{
+		float32x4_t r = vsubq_f32(vmulq_n_f32(t, 6.0f), vdupq_n_f32(15.0f));
+		r = vaddq_f32(vmulq_f32(t, r), vdupq_n_f32(10.0f));
+		return vmulq_f32(vmulq_f32(vmulq_f32(t, t), t), r);
+	}
+
+	static float32x4_t lerp4(float32x4_t t, float32x4_t a, float32x4_t b)
+	{
+		return vaddq_f32(a, vmulq_f32(t, vsubq_f32(b, a)));
+	}
+
+	// NEON has no gather instruction, so table lookups are done per lane
+	uint32x4_t gather4(uint32x4_t index)
+	{
+		uint32_t i[4];
+		vst1q_u32(i, index);
+		const uint32_t v[4] = { permutations[i[0]], permutations[i[1]], permutations[i[2]], permutations[i[3]] };
+		return vld1q_u32(v);
+	}
+
+	static float32x4_t grad4(uint32x4_t hash, float32x4_t x, float32x4_t y, float32x4_t z)
+	{
+		const uint32x4_t h = vandq_u32(hash, vdupq_n_u32(15));
+		// u = h < 8 ? x : y
+		const float32x4_t u = vbslq_f32(vcltq_u32(h, vdupq_n_u32(8)), x, y);
+		// v = h < 4 ? y : h == 12 || h == 14 ? x : z
+		const uint32x4_t is12or14 = vorrq_u32(vceqq_u32(h, vdupq_n_u32(12)), vceqq_u32(h, vdupq_n_u32(14)));
+		float32x4_t v = vbslq_f32(is12or14, x, z);
+		v = vbslq_f32(vcltq_u32(h, vdupq_n_u32(4)), y, v);
+		// Bit 0 negates u, bit 1 negates v
+		const uint32x4_t uSign = vshlq_n_u32(vandq_u32(h, vdupq_n_u32(1)), 31);
+		const uint32x4_t vSign = vshlq_n_u32(vandq_u32(h, vdupq_n_u32(2)), 30);
+		return vaddq_f32(vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(u), uSign)), vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(v), vSign)));
+	}
+
+	float32x4_t perlinNoise4(float32x4_t x, const RowCoordinate &cy, const RowCoordinate &cz)
+	{
+		const float32x4_t floorX = vrndmq_f32(x);
+		const uint32x4_t X = vandq_u32(vreinterpretq_u32_s32(vcvtq_s32_f32(floorX)), vdupq_n_u32(255));
+		const float32x4_t fx = vsubq_f32(x, floorX);
+		const float32x4_t u = fade4(fx);
+		const uint32x4_t one = vdupq_n_u32(1);
+		const uint32x4_t Y = vdupq_n_u32(cy.cell);
+		const uint32x4_t Z = vdupq_n_u32(cz.cell);
+
+		// Hash coordinates of the 8 cube corners
+		const uint32x4_t A = vaddq_u32(gather4(X), Y);
+		const uint32x4_t AA = vaddq_u32(gather4(A), Z);
+		const uint32x4_t AB = vaddq_u32(gather4(vaddq_u32(A, one)), Z);
+		const uint32x4_t B = vaddq_u32(gather4(vaddq_u32(X, one)), Y);
+		const uint32x4_t BA = vaddq_u32(gather4(B), Z);
+		const uint32x4_t BB = vaddq_u32(gather4(vaddq_u32(B, one)), Z);
+
+		const float32x4_t fx1 = vsubq_f32(fx, vdupq_n_f32(1.0f));
+		const float32x4_t fy = vdupq_n_f32(cy.frac);
+		const float32x4_t fy1 = vdupq_n_f32(cy.frac - 1.0f);
+		const float32x4_t fz = vdupq_n_f32(cz.frac);
+		const float32x4_t fz1 = vdupq_n_f32(cz.frac - 1.0f);
+		const float32x4_t v = vdupq_n_f32(cy.fade);
+		const float32x4_t w = vdupq_n_f32(cz.fade);
+
+		// And add blended results for 8 corners of the cube
+		return lerp4(w,
+			lerp4(v,
+				lerp4(u, grad4(gather4(AA), fx, fy, fz), grad4(gather4(BA), fx1, fy, fz)),
+				lerp4(u, grad4(gather4(AB), fx, fy1, fz), grad4(gather4(BB), fx1, fy1, fz))),
+			lerp4(v,
+				lerp4(u, grad4(gather4(vaddq_u32(AA, one)), fx, fy, fz1), grad4(gather4(vaddq_u32(BA, one)), fx1, fy, fz1)),
+				lerp4(u, grad4(gather4(vaddq_u32(AB, one)), fx, fy1, fz1), grad4(gather4(vaddq_u32(BB, one)), fx1, fy1, fz1))));
+	}
+
+	void rowNEON(uint32_t count, float xScale, float y, float z, uint8_t* dst)
+	{
+		const float laneOffsetValues[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+		const float32x4_t laneOffsets = vld1q_f32(laneOffsetValues);
+		for (uint32_t x = 0; x < count; x += 4) {
+			const float32x4_t px = vmulq_n_f32(vaddq_f32(vdupq_n_f32((float)x), laneOffsets), xScale);
+			float32x4_t sum = vdupq_n_f32(0.0f);
+			float frequency = 1.0f;
+			float amplitude = 1.0f;
+			float max = 0.0f;
+			for (uint32_t i = 0; i < octaves; i++) {
+				const RowCoordinate cy = rowCoordinate(y * frequency);
+				const RowCoordinate cz = rowCoordinate(z * frequency);
+				const float32x4_t n = perlinNoise4(vmulq_n_f32(px, frequency), cy, cz);
+				sum = vaddq_f32(sum, vmulq_n_f32(n, amplitude));
+				max += amplitude;
+				amplitude *= persistence;
+				frequency *= 2.0f;
+			}
+			// Map to [0..1] and keep the fractional part like the scalar path
+			float32x4_t n = vmulq_n_f32(vaddq_f32(vmulq_n_f32(sum, 1.0f / max), vdupq_n_f32(1.0f)), 0.5f);
+			n = vsubq_f32(n, vrndmq_f32(n));
+			int32_t values[4];
+			vst1q_s32(values, vcvtq_s32_f32(vrndmq_f32(vmulq_n_f32(n, 255.0f))));
+			const uint32_t lanes = std::min(count - x, 4u);
+			for (uint32_t lane = 0; lane < lanes; lane++) {
+				dst[x + lane] = static_cast<uint8_t>(values[lane]);
+			}
+		}
+	}
+#endif
+};
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -168,6 +498,45 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	// Noise generation settings and statistics
+	enum GenerationMode { GenerationCPUScalar = 0, GenerationCPUSIMD = 1, GenerationGPU = 2 };
+	int32_t generationMode = GenerationCPUSIMD;
+	int32_t volumeSizeIndex = 0;
+	const std::vector<uint32_t> volumeSizes = { 128, 256, 512 };
+	// Rows of a single slice that are generated by one worker at a time
+	const uint32_t tileRows = 16;
+	struct {
+		// Not set for GPU generation on queues without timestamp support
+		bool timed = false;
+		double ms = 0.0;
+		double voxelsPerSecond = 0.0;
+	} generationStats;
+
+	// Persistently mapped staging buffer, the CPU paths write the noise directly into it
+	vks::Buffer stagingBuffer;
+
+	// Resources for generating the noise with a compute shader, created on first use
+	struct {
+		vks::Buffer voxels;
+		vks::Buffer permutations;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		// Only created if the graphics queue supports timestamps
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		uint64_t timestampMask = 0;
+	} compute;
+
+	// Matches the push constant block of the noise compute shader
+	struct ComputePushConstants {
+		// xyz = volume size, w = invocations per row of the dispatch
+		uint32_t extent[4];
+		float noiseScale;
+		uint32_t octaves;
+		float persistence;
+	};
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "3D textures";
@@ -193,6 +562,16 @@ public:
 		vertexBuffer.destroy();
 		indexBuffer.destroy();
 		uniformBufferVS.destroy();
+		stagingBuffer.destroy();
+
+		if (compute.pipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, compute.pipeline, nullptr);
+			vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
+			vkDestroyQueryPool(device, compute.queryPool, nullptr);
+		}
+		compute.voxels.destroy();
+		compute.permutations.destroy();
 	}
 
 	// Prepare all Vulkan resources for the 3D texture (including descriptors)
@@ -284,83 +663,197 @@ public:
 		texture.descriptor.imageView = texture.view;
 		texture.descriptor.sampler = texture.sampler;
 
+		prepareNoiseBuffers();
 		updateNoiseTexture();
 	}
 
-	// Generate randomized noise and upload it to the 3D texture using staging
-	void updateNoiseTexture()
+	// (Re)create the buffers that hold the noise for the current texture dimensions
+	void prepareNoiseBuffers()
 	{
-		const uint32_t texMemSize = texture.width * texture.height * texture.depth;
+		const VkDeviceSize texMemSize = texture.width * texture.height * texture.depth;
 
-		uint8_t *data = new uint8_t[texMemSize];
-		memset(data, 0, texMemSize);
+		// The staging buffer stays mapped, so the CPU paths can write the noise without an intermediate copy
+		stagingBuffer.destroy();
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			texMemSize));
+		VK_CHECK_RESULT(stagingBuffer.map());
+
+		if (compute.pipeline != VK_NULL_HANDLE) {
+			compute.voxels.destroy();
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&compute.voxels,
+				texMemSize));
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.voxels.descriptor);
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		}
+	}
 
-		// Generate perlin based noise
-		std::cout << "Generating " << texture.width << " x " << texture.height << " x " << texture.depth << " noise texture..." << std::endl;
+	// Create the compute pipeline used to generate the noise on the GPU
+	// This is only done once the compute path is selected for the first time
+	void prepareCompute()
+	{
+		// Binding 0 : Voxel output, four voxels are packed into one uint
+		// Binding 1 : Permutation table of the perlin noise
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1)
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &compute.descriptorSetLayout));
 
-		auto tStart = std::chrono::high_resolution_clock::now();
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ComputePushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&compute.descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
 
-		PerlinNoise<float> perlinNoise;
-		FractalNoise<float> fractalNoise(perlinNoise);
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "texture3d/noise.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
 
-		const float noiseScale = static_cast<float>(rand() % 10) + 4.0f;
+		// Host visible, as the permutation table changes with every new texture
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&compute.permutations,
+			512 * sizeof(uint32_t)));
+		VK_CHECK_RESULT(compute.permutations.map());
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &compute.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSet));
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.permutations.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+
+		// Timestamps around the dispatch measure the pure generation time, if the queue supports them
+		const uint32_t timestampValidBits = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits;
+		if ((timestampValidBits > 0) && (vulkanDevice->properties.limits.timestampPeriod > 0.0f)) {
+			compute.timestampMask = (timestampValidBits >= 64) ? UINT64_MAX : ((1ULL << timestampValidBits) - 1);
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &compute.queryPool));
+		}
+		else {
+			std::cout << "Timestamps are not supported by the graphics queue, the GPU generation time is not reported" << std::endl;
+		}
 
-#pragma omp parallel for
-		for (int32_t z = 0; z < texture.depth; z++)
-		{
-			for (int32_t y = 0; y < texture.height; y++)
-			{
-				for (int32_t x = 0; x < texture.width; x++)
-				{
-					float nx = (float)x / (float)texture.width;
-					float ny = (float)y / (float)texture.height;
-					float nz = (float)z / (float)texture.depth;
-#define FRACTAL
-#ifdef FRACTAL
-					float n = fractalNoise.noise(nx * noiseScale, ny * noiseScale, nz * noiseScale);
-#else
-					float n = 20.0 * perlinNoise.noise(nx, ny, nz);
-#endif
-					n = n - floor(n);
+		// Creates the voxel buffer and binds it to the descriptor set
+		prepareNoiseBuffers();
+	}
 
-					data[x + y * texture.width + z * texture.width * texture.height] = static_cast<uint8_t>(floor(n * 255));
+	// Generate the noise on the CPU into the mapped staging buffer
+	// The volume is split into tiles of a few rows of a single slice that are picked up by all hardware threads
+	void generateNoiseCPU(const PerlinNoise<float> &perlinNoise, const FractalNoise<float> &fractalNoise, float noiseScale, bool useSimd)
+	{
+		uint8_t *data = static_cast<uint8_t*>(stagingBuffer.mapped);
+		const uint32_t tilesPerSlice = (texture.height + tileRows - 1) / tileRows;
+		const uint32_t tileCount = tilesPerSlice * texture.depth;
+		std::atomic<uint32_t> nextTile(0);
+
+		auto worker = [&]() {
+			FractalNoiseRowKernel kernel(perlinNoise, fractalNoise, useSimd);
+			const float xScale = noiseScale / (float)texture.width;
+			for (uint32_t tile = nextTile++; tile < tileCount; tile = nextTile++) {
+				const uint32_t z = tile / tilesPerSlice;
+				const uint32_t yStart = (tile % tilesPerSlice) * tileRows;
+				const uint32_t yEnd = std::min(yStart + tileRows, texture.height);
+				const float nz = (float)z / (float)texture.depth * noiseScale;
+				for (uint32_t y = yStart; y < yEnd; y++) {
+					const float ny = (float)y / (float)texture.height * noiseScale;
+					kernel.row(texture.width, xScale, ny, nz, data + y * texture.width + z * texture.width * texture.height);
 				}
 			}
+		};
+
+		const uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+		std::vector<std::thread> threads;
+		for (uint32_t i = 1; i < threadCount; i++) {
+			threads.push_back(std::thread(worker));
+		}
+		worker();
+		for (auto& thread : threads) {
+			thread.join();
 		}
+	}
 
-		auto tEnd = std::chrono::high_resolution_clock::now();
-		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+	// Generate randomized noise and upload it to the 3D texture
+	void updateNoiseTexture()
+	{
+		const uint64_t voxelCount = (uint64_t)texture.width * texture.height * texture.depth;
 
-		std::cout << "Done in " << tDiff << "ms" << std::endl;
+		PerlinNoise<float> perlinNoise;
+		FractalNoise<float> fractalNoise(perlinNoise);
 
-		// Create a host-visible staging buffer that contains the raw image data
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
+		const float noiseScale = static_cast<float>(rand() % 10) + 4.0f;
 
-		// Buffer object
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = texMemSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &stagingBuffer));
+		const bool gpu = (generationMode == GenerationGPU);
+		if (gpu && (compute.pipeline == VK_NULL_HANDLE)) {
+			prepareCompute();
+		}
 
-		// Allocate host visible memory for data upload
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs = {};
-		vkGetBufferMemoryRequirements(device, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0));
+		// Generate perlin based noise
+		const char* generator = gpu ? "GPU" : (generationMode == GenerationCPUSIMD) ? FractalNoiseRowKernel::name(FractalNoiseRowKernel::bestInstructionSet()) : "scalar";
+		std::cout << "Generating " << texture.width << " x " << texture.height << " x " << texture.depth << " noise texture (" << generator << ")..." << std::endl;
 
-		// Copy texture data into staging buffer
-		uint8_t *mapped;
-		VK_CHECK_RESULT(vkMapMemory(device, stagingMemory, 0, memReqs.size, 0, (void **)&mapped));
-		memcpy(mapped, data, texMemSize);
-		vkUnmapMemory(device, stagingMemory);
+		auto tStart = std::chrono::high_resolution_clock::now();
+		if (!gpu) {
+			generateNoiseCPU(perlinNoise, fractalNoise, noiseScale, generationMode == GenerationCPUSIMD);
+		}
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		generationStats.ms = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		generationStats.timed = !gpu;
 
 		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
+		if (gpu) {
+			memcpy(compute.permutations.mapped, perlinNoise.data(), 512 * sizeof(uint32_t));
+
+			// Each invocation writes four voxels
+			// Large volumes need more work groups than maxComputeWorkGroupCount[0] allows (e.g. 524288 at 512^3), so they are spread over rows of a 2D dispatch
+			const uint32_t groupCount = static_cast<uint32_t>((voxelCount / 4 + 63) / 64);
+			const uint32_t groupCountX = std::min(groupCount, vulkanDevice->properties.limits.maxComputeWorkGroupCount[0]);
+			const uint32_t groupCountY = (groupCount + groupCountX - 1) / groupCountX;
+
+			ComputePushConstants pushConstants = {};
+			pushConstants.extent[0] = texture.width;
+			pushConstants.extent[1] = texture.height;
+			pushConstants.extent[2] = texture.depth;
+			pushConstants.extent[3] = groupCountX * 64;
+			pushConstants.noiseScale = noiseScale;
+			pushConstants.octaves = 6;
+			pushConstants.persistence = 0.5f;
+
+			if (compute.queryPool != VK_NULL_HANDLE) {
+				vkCmdResetQueryPool(copyCmd, compute.queryPool, 0, 2);
+			}
+			vkCmdBindPipeline(copyCmd, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
+			vkCmdBindDescriptorSets(copyCmd, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, nullptr);
+			vkCmdPushConstants(copyCmd, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pushConstants);
+			if (compute.queryPool != VK_NULL_HANDLE) {
+				vkCmdWriteTimestamp(copyCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, compute.queryPool, 0);
+			}
+			vkCmdDispatch(copyCmd, groupCountX, groupCountY, 1);
+			if (compute.queryPool != VK_NULL_HANDLE) {
+				vkCmdWriteTimestamp(copyCmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, compute.queryPool, 1);
+			}
+
+			// Make the shader writes visible to the copy
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = compute.voxels.buffer;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		}
+
 		// The sub resource range describes the regions of the image we will be transitioned
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -391,7 +884,7 @@ public:
 
 		vkCmdCopyBufferToImage(
 			copyCmd,
-			stagingBuffer,
+			gpu ? compute.voxels.buffer : stagingBuffer.buffer,
 			texture.image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1,
@@ -408,10 +901,35 @@ public:
 
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
-		// Clean up staging resources
-		delete[] data;
-		vkFreeMemory(device, stagingMemory, nullptr);
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
+		if (gpu && (compute.queryPool != VK_NULL_HANDLE)) {
+			uint64_t timestamps[2] = {};
+			VK_CHECK_RESULT(vkGetQueryPoolResults(device, compute.queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+			// Only the valid bits are written, the difference is taken modulo their range in case the counter wrapped
+			const uint64_t ticks = ((timestamps[1] & compute.timestampMask) - (timestamps[0] & compute.timestampMask)) & compute.timestampMask;
+			generationStats.ms = (double)ticks * (double)vulkanDevice->properties.limits.timestampPeriod / 1000000.0;
+			generationStats.timed = true;
+		}
+		if (generationStats.timed) {
+			generationStats.voxelsPerSecond = (generationStats.ms > 0.0) ? (double)voxelCount / (generationStats.ms / 1000.0) : 0.0;
+			std::cout << "Done in " << generationStats.ms << "ms (" << generationStats.voxelsPerSecond / 1000000.0 << " Mvoxels/s)" << std::endl;
+		}
+		else {
+			generationStats.ms = 0.0;
+			generationStats.voxelsPerSecond = 0.0;
+			std::cout << "Done" << std::endl;
+		}
+	}
+
+	// Recreate the texture with a new size, e.g. after selecting a different volume size in the UI
+	void resizeNoiseTexture(uint32_t size)
+	{
+		vkDeviceWaitIdle(device);
+		destroyTextureImage(texture);
+		prepareNoiseTexture(size, size, size);
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texture.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		// Updating the descriptor set invalidates the command buffers it's bound in
+		buildCommandBuffers();
 	}
 
 	// Free all Vulkan resources used a texture object
@@ -566,18 +1084,19 @@ public:
 
 	void setupDescriptorPool()
 	{
-		// Example uses one ubo and one image sampler
+		// Example uses one ubo and one image sampler, the compute noise generation uses two storage buffers
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				static_cast<uint32_t>(poolSizes.size()),
 				poolSizes.data(),
-				2);
+				3);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -749,10 +1268,11 @@ public:
 		generateQuad();
 		setupVertexDescriptions();
 		prepareUniformBuffers();
-		prepareNoiseTexture(128, 128, 128);
+		// The pool is also used by the compute noise generation
+		setupDescriptorPool();
+		prepareNoiseTexture(volumeSizes[volumeSizeIndex], volumeSizes[volumeSizeIndex], volumeSizes[volumeSizeIndex]);
 		setupDescriptorSetLayout();
 		preparePipelines();
-		setupDescriptorPool();
 		setupDescriptorSet();
 		buildCommandBuffers();
 		prepared = true;
@@ -771,10 +1291,33 @@ public:
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
+			const std::string simdName = std::string("CPU SIMD (") + FractalNoiseRowKernel::name(FractalNoiseRowKernel::bestInstructionSet()) + ")";
+			if (overlay->comboBox("Generation", &generationMode, { "CPU scalar", simdName, "GPU compute" })) {
+				updateNoiseTexture();
+			}
+			// Only offer volume sizes supported by the device
+			std::vector<std::string> sizeNames;
+			for (auto size : volumeSizes) {
+				if (size <= vulkanDevice->properties.limits.maxImageDimension3D) {
+					sizeNames.push_back(std::to_string(size) + "^3");
+				}
+			}
+			if (overlay->comboBox("Volume size", &volumeSizeIndex, sizeNames)) {
+				resizeNoiseTexture(volumeSizes[volumeSizeIndex]);
+			}
 			if (overlay->button("Generate new texture")) {
 				updateNoiseTexture();
 			}
 		}
+		if (overlay->header("Statistics")) {
+			if (generationStats.timed) {
+				overlay->text("Generation: %.2f ms", generationStats.ms);
+				overlay->text("Throughput: %.1f Mvoxels/s", generationStats.voxelsPerSecond / 1000000.0);
+			}
+			else {
+				overlay->text("Generation: no GPU timestamps");
+			}
+		}
 	}
 };
 
@@ -12,6 +12,54 @@
 
 #include "texturesparseresidency.h"
 
+/*
+	Physical page pool
+	Single device memory allocation split into fixed size slots that are handed out to resident pages
+ */
+
+void PhysicalPagePool::create(VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize pageSize, VkDeviceSize budget)
+{
+	this->device = device;
+	this->pageSize = pageSize;
+	capacity = static_cast<uint32_t>(budget / pageSize);
+	assert(capacity > 0);
+
+	VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
+	allocInfo.allocationSize = capacity * pageSize;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+	VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &memory));
+
+	// Hand out low slots first
+	freeSlots.resize(capacity);
+	for (uint32_t i = 0; i < capacity; i++) {
+		freeSlots[i] = capacity - i - 1;
+	}
+}
+
+bool PhysicalPagePool::acquire(uint32_t &slot)
+{
+	if (freeSlots.empty()) {
+		return false;
+	}
+	slot = freeSlots.back();
+	freeSlots.pop_back();
+	return true;
+}
+
+void PhysicalPagePool::release(uint32_t slot)
+{
+	freeSlots.push_back(slot);
+}
+
+void PhysicalPagePool::destroy()
+{
+	if (memory != VK_NULL_HANDLE) {
+		vkFreeMemory(device, memory, nullptr);
+		memory = VK_NULL_HANDLE;
+	}
+	freeSlots.clear();
+}
+
 /*
 	Virtual texture page 
 	Contains all functions and objects for a single page of a virtual texture
@@ -28,20 +76,18 @@ bool VirtualTexturePage::resident()
 	return (imageMemoryBind.memory != VK_NULL_HANDLE);
 }
 
-// Allocate Vulkan memory for the virtual page
-bool VirtualTexturePage::allocate(VkDevice device, uint32_t memoryTypeIndex)
+// Back the virtual page with a slot from the physical page pool
+bool VirtualTexturePage::allocate(PhysicalPagePool &pool)
 {
 	if (imageMemoryBind.memory != VK_NULL_HANDLE)
 	{
 		return false;
 	};
 
-	imageMemoryBind = {};
-
-	VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
-	allocInfo.allocationSize = size;
-	allocInfo.memoryTypeIndex = memoryTypeIndex;
-	VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &imageMemoryBind.memory));
+	if (!pool.acquire(slot))
+	{
+		return false;
+	}
 
 	VkImageSubresource subResource{};
 	subResource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -49,20 +95,25 @@ bool VirtualTexturePage::allocate(VkDevice device, uint32_t memoryTypeIndex)
 	subResource.arrayLayer = layer;
 
 	// Sparse image memory binding
+	imageMemoryBind = {};
 	imageMemoryBind.subresource = subResource;
 	imageMemoryBind.extent = extent;
 	imageMemoryBind.offset = offset;
+	imageMemoryBind.memory = pool.memory;
+	imageMemoryBind.memoryOffset = slot * pool.pageSize;
+	del = false;
 	return true;
 }
 
-// Release Vulkan memory allocated for this page
-bool VirtualTexturePage::release(VkDevice device)
+// Return the physical page backing this page to the pool
+bool VirtualTexturePage::release(PhysicalPagePool &pool)
 {
-	del= false;
+	del = false;
 	if (imageMemoryBind.memory != VK_NULL_HANDLE)
 	{
-		vkFreeMemory(device, imageMemoryBind.memory, nullptr);
+		pool.release(slot);
 		imageMemoryBind.memory = VK_NULL_HANDLE;
+		imageMemoryBind.memoryOffset = 0;
 		return true;
 	}
 	return false;
@@ -82,6 +133,8 @@ VirtualTexturePage* VirtualTexture::addPage(VkOffset3D offset, VkExtent3D extent
 	newPage.mipLevel = mipLevel;
 	newPage.layer = layer;
 	newPage.index = static_cast<uint32_t>(pages.size());
+	newPage.slot = 0;
+	newPage.lastUsedFrame = 0;
 	newPage.imageMemoryBind = {};
 	newPage.imageMemoryBind.offset = offset;
 	newPage.imageMemoryBind.extent = extent;
@@ -91,24 +144,22 @@ VirtualTexturePage* VirtualTexture::addPage(VkOffset3D offset, VkExtent3D extent
 }
 
 // Call before sparse binding to update memory bind list etc.
-void VirtualTexture::updateSparseBindInfo(std::vector<VirtualTexturePage> &bindingChangedPages, bool del)
+// Pages flagged with del are unbound, all other pages are bound to their current memory, so page-ins and evictions go into a single batch
+void VirtualTexture::updateSparseBindInfo(const std::vector<VirtualTexturePage> &bindingChangedPages, bool bindMipTail)
 {
 	// Update list of memory-backed sparse image memory binds
-	//sparseImageMemoryBinds.resize(pages.size());
 	sparseImageMemoryBinds.clear();
-	for (auto page : bindingChangedPages)
+	for (auto &page : bindingChangedPages)
 	{
 		sparseImageMemoryBinds.push_back(page.imageMemoryBind);
-		if (del)
+		if (page.del)
 		{
-			sparseImageMemoryBinds[sparseImageMemoryBinds.size() - 1].memory = VK_NULL_HANDLE;
+			sparseImageMemoryBinds.back().memory = VK_NULL_HANDLE;
+			sparseImageMemoryBinds.back().memoryOffset = 0;
 		}
 	}
 	// Update sparse bind info
 	bindSparseInfo = vks::initializers::bindSparseInfo();
-	// todo: Semaphore for queue submission
-	// bindSparseInfo.signalSemaphoreCount = 1;
-	// bindSparseInfo.pSignalSemaphores = &bindSparseSemaphore;
 
 	// Image memory binds
 	imageMemoryBindInfo = {};
@@ -122,17 +173,19 @@ void VirtualTexture::updateSparseBindInfo(std::vector<VirtualTexturePage> &bindi
 	opaqueMemoryBindInfo.image = image;
 	opaqueMemoryBindInfo.bindCount = static_cast<uint32_t>(opaqueMemoryBinds.size());
 	opaqueMemoryBindInfo.pBinds = opaqueMemoryBinds.data();
-	bindSparseInfo.imageOpaqueBindCount = (opaqueMemoryBindInfo.bindCount > 0) ? 1 : 0;
+	// The mip tail is always resident, so it only needs to be bound once
+	bindSparseInfo.imageOpaqueBindCount = (bindMipTail && (opaqueMemoryBindInfo.bindCount > 0)) ? 1 : 0;
 	bindSparseInfo.pImageOpaqueBinds = &opaqueMemoryBindInfo;
 }
 
 // Release all Vulkan resources
 void VirtualTexture::destroy()
 {
-	for (auto page : pages)
+	for (auto &page : pages)
 	{
-		page.release(device);
+		page.release(pagePool);
 	}
+	pagePool.destroy();
 	for (auto bind : opaqueMemoryBinds)
 	{
 		vkFreeMemory(device, bind.memory, nullptr);
@@ -161,6 +214,8 @@ VulkanExample::~VulkanExample()
 	// Clean up used Vulkan resources
 	// Note : Inherited destructor cleans up resources stored in base class
 	destroyTextureImage(texture);
+	streaming.stagingBuffer.destroy();
+	feedbackBuffer.destroy();
 	vkDestroySemaphore(device, bindSparseSemaphore, nullptr);
 	vkDestroyPipeline(device, pipeline, nullptr);
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
@@ -178,6 +233,14 @@ void VulkanExample::getEnabledFeatures()
 	else {
 		std::cout << "Sparse binding not supported" << std::endl;
 	}
+	// The fragment shader writes page requests to the feedback buffer
+	if (deviceFeatures.fragmentStoresAndAtomics) {
+		enabledFeatures.fragmentStoresAndAtomics = VK_TRUE;
+	}
+	// Required for clamping sparse fetches to coarser mip levels in the fragment shader
+	if (deviceFeatures.shaderResourceMinLod) {
+		enabledFeatures.shaderResourceMinLod = VK_TRUE;
+	}
 }
 
 glm::uvec3 VulkanExample::alignedDivision(const VkExtent3D& extent, const VkExtent3D& granularity)
@@ -347,6 +410,12 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 			// Aligned sizes by image granularity
 			VkExtent3D imageGranularity = sparseMemoryReq.formatProperties.imageGranularity;
 			glm::uvec3 sparseBindCounts = alignedDivision(extent, imageGranularity);
+
+			// Page table entry used by the fragment shader to calculate the feedback index of a texel
+			if ((layer == 0) && (mipLevel < 16))
+			{
+				uboVS.pageTable[mipLevel] = glm::uvec4(static_cast<uint32_t>(texture.pages.size()), sparseBindCounts.x, sparseBindCounts.y, 0);
+			}
 			glm::uvec3 lastBlockExtent;
 			lastBlockExtent.x = (extent.width % imageGranularity.width) ? extent.width % imageGranularity.width : imageGranularity.width;
 			lastBlockExtent.y = (extent.height % imageGranularity.height) ? extent.height % imageGranularity.height : imageGranularity.height;
@@ -404,9 +473,16 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 		}
 	} // end layers and mips
 
+	uboVS.mipTailStart = std::min(texture.mipTailStart, 16u);
+	uboVS.pageGranularity = glm::uvec2(sparseMemoryReq.formatProperties.imageGranularity.width, sparseMemoryReq.formatProperties.imageGranularity.height);
+
+	// All resident pages share a fixed memory budget
+	texture.pagePool.create(device, texture.memoryTypeIndex, sparseImageMemoryReqs.alignment, std::max(streaming.memoryBudget, sparseImageMemoryReqs.alignment));
+
 	std::cout << "Texture info:" << std::endl;
 	std::cout << "\tDim: " << texture.width << " x " << texture.height << std::endl;
 	std::cout << "\tVirtual pages: " << texture.pages.size() << std::endl;
+	std::cout << "\tPhysical pages: " << texture.pagePool.capacity << std::endl;
 
 	// Check if format has one mip tail for all layers
 	if ((sparseMemoryReq.formatProperties.flags & VK_SPARSE_IMAGE_FORMAT_SINGLE_MIPTAIL_BIT) && (sparseMemoryReq.imageMipTailFirstLod < texture.mipLevels))
@@ -432,13 +508,9 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
 	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &bindSparseSemaphore));
 
-	// Prepare bind sparse info for reuse in queue submission
-	texture.updateSparseBindInfo(texture.pages);
-
-	// Bind to queue
-	// todo: in draw?
+	// Bind the mip tail, all other pages are made resident on demand
+	texture.updateSparseBindInfo({}, true);
 	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, VK_NULL_HANDLE);
-	//todo: use sparse bind semaphore
 	vkQueueWaitIdle(queue);
 
 	// Create sampler
@@ -525,6 +597,16 @@ void VulkanExample::buildCommandBuffers()
 
 		vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+		// Make the page requests written by the fragment shader visible to the host
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = feedbackBuffer.buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
 }
@@ -546,11 +628,12 @@ void VulkanExample::loadAssets()
 
 void VulkanExample::setupDescriptorPool()
 {
-	// Example uses one ubo and one image sampler
+	// Example uses one ubo, one image sampler and one storage buffer for the feedback
 	std::vector<VkDescriptorPoolSize> poolSizes =
 	{
 		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1)
 	};
 
 	VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -566,16 +649,21 @@ void VulkanExample::setupDescriptorSetLayout()
 {
 	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings =
 	{
-		// Binding 0 : Vertex shader uniform buffer
+		// Binding 0 : Vertex and fragment shader uniform buffer
 		vks::initializers::descriptorSetLayoutBinding(
 			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-			VK_SHADER_STAGE_VERTEX_BIT,
+			VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
 			0),
 		// Binding 1 : Fragment shader image sampler
 		vks::initializers::descriptorSetLayoutBinding(
 			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 			VK_SHADER_STAGE_FRAGMENT_BIT,
-			1)
+			1),
+		// Binding 2 : Fragment shader page feedback buffer
+		vks::initializers::descriptorSetLayoutBinding(
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_SHADER_STAGE_FRAGMENT_BIT,
+			2)
 	};
 
 	VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -616,7 +704,13 @@ void VulkanExample::setupDescriptorSet()
 			descriptorSet,
 			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 			1,
-			&texture.descriptor)
+			&texture.descriptor),
+		// Binding 2 : Fragment shader page feedback buffer
+		vks::initializers::writeDescriptorSet(
+			descriptorSet,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			2,
+			&feedbackBuffer.descriptor)
 	};
 
 	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
@@ -666,6 +760,30 @@ void VulkanExample::prepareUniformBuffers()
 	updateUniformBuffers();
 }
 
+// Prepare the buffer the fragment shader writes page requests to
+void VulkanExample::prepareFeedbackBuffer()
+{
+	// Host visible, as the requests are read back and cleared on the host after each frame
+	const VkDeviceSize bufferSize = std::max(texture.pages.size(), (size_t)1) * sizeof(uint32_t);
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&feedbackBuffer,
+		bufferSize));
+	VK_CHECK_RESULT(feedbackBuffer.map());
+	memset(feedbackBuffer.mapped, 0, bufferSize);
+
+	// Staging buffer and command buffer for uploading the content of newly resident pages
+	const VkExtent3D granularity = texture.sparseImageMemoryRequirements.formatProperties.imageGranularity;
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&streaming.stagingBuffer,
+		streaming.maxPageInsPerFrame * 4 * granularity.width * granularity.height));
+	VK_CHECK_RESULT(streaming.stagingBuffer.map());
+	streaming.uploadCmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+}
+
 void VulkanExample::updateUniformBuffers()
 {
 	uboVS.projection = camera.matrices.perspective;
@@ -684,10 +802,17 @@ void VulkanExample::prepare()
 	if (!vulkanDevice->features.sparseResidencyImage2D) {
 		vks::tools::exitFatal("Device does not support sparse residency for 2D images!", VK_ERROR_FEATURE_NOT_PRESENT);
 	}
+	// Page requests are written to the feedback buffer by the fragment shader
+	if (!vulkanDevice->features.fragmentStoresAndAtomics) {
+		vks::tools::exitFatal("Device does not support stores in fragment shaders!", VK_ERROR_FEATURE_NOT_PRESENT);
+	}
 	loadAssets();
-	prepareUniformBuffers();
 	// Create a virtual texture with max. possible dimension (does not take up any VRAM yet)
 	prepareSparseTexture(4096, 4096, 1, VK_FORMAT_R8G8B8A8_UNORM);
+	// The mip tail is always resident and used as the fallback for pages that haven't been streamed in yet
+	fillMipTail();
+	prepareUniformBuffers();
+	prepareFeedbackBuffer();
 	setupDescriptorSetLayout();
 	preparePipelines();
 	setupDescriptorPool();
@@ -701,6 +826,8 @@ void VulkanExample::render()
 	if (!prepared)
 		return;
 	draw();
+	// submitFrame waits for the queue to become idle, so the feedback of the frame that has just been rendered can be read
+	processFeedback();
 	if (camera.updated) {
 		updateUniformBuffers();
 	}
@@ -733,94 +860,9 @@ void VulkanExample::randomPattern(uint8_t* buffer, uint32_t width, uint32_t heig
 	}
 }
 
-void VulkanExample::uploadContent(VirtualTexturePage page, VkImage image)
-{
-	// Generate some random image data and upload as a buffer
-	const size_t bufferSize = 4 * page.extent.width * page.extent.height;
-
-	vks::Buffer imageBuffer;
-	VK_CHECK_RESULT(vulkanDevice->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&imageBuffer,
-		bufferSize));
-	imageBuffer.map();
-
-	uint8_t* data = (uint8_t*)imageBuffer.mapped;
-	randomPattern(data, page.extent.height, page.extent.width);
-
-	VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-	VkBufferImageCopy region{};
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.layerCount = 1;
-	region.imageSubresource.mipLevel = page.mipLevel;
-	region.imageOffset = page.offset;
-	region.imageExtent = page.extent;
-	vkCmdCopyBufferToImage(copyCmd, imageBuffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-	vulkanDevice->flushCommandBuffer(copyCmd, queue);
-
-	imageBuffer.destroy();
-}
-
-void VulkanExample::fillRandomPages()
-{
-	vkDeviceWaitIdle(device);
-
-	std::default_random_engine rndEngine(std::random_device{}());
-	std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
-
-	std::vector<VirtualTexturePage> updatedPages;
-	std::vector<VirtualTexturePage> bindingChangedPages;
-	for (auto& page : texture.pages) {
-		if (rndDist(rndEngine) < 0.5f) {
-			continue;
-		}
-		if (page.allocate(device, texture.memoryTypeIndex))
-		{
-			bindingChangedPages.push_back(page);
-		}
-		updatedPages.push_back(page);
-	}
-
-	// Update sparse queue binding
-	texture.updateSparseBindInfo(bindingChangedPages);
-	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-	VkFence fence;
-	VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, fence);
-	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-	vkDestroyFence(device, fence, nullptr);
-
-	for (auto &page: updatedPages) {
-		uploadContent(page, texture.image);
-	}
-}
-
 void VulkanExample::fillMipTail()
 {
-	// Clean up previous mip tail memory allocation
-	if (texture.mipTailimageMemoryBind.memory != VK_NULL_HANDLE) {
-		vkFreeMemory(device, texture.mipTailimageMemoryBind.memory, nullptr);
-	}
-
-	//@todo: WIP
-	VkDeviceSize imageMipTailSize = texture.sparseImageMemoryRequirements.imageMipTailSize;
-	VkDeviceSize imageMipTailOffset = texture.sparseImageMemoryRequirements.imageMipTailOffset;
-	// Stride between memory bindings for each mip level if not single mip tail (VK_SPARSE_IMAGE_FORMAT_SINGLE_MIPTAIL_BIT not set)
-	VkDeviceSize imageMipTailStride = texture.sparseImageMemoryRequirements.imageMipTailStride;
-
-	VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
-	allocInfo.allocationSize = imageMipTailSize;
-	allocInfo.memoryTypeIndex = texture.memoryTypeIndex;
-	VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &texture.mipTailimageMemoryBind.memory));
-
-	uint32_t mipLevel = texture.sparseImageMemoryRequirements.imageMipTailFirstLod;
-	uint32_t width = std::max(texture.width >> texture.sparseImageMemoryRequirements.imageMipTailFirstLod, 1u);
-	uint32_t height = std::max(texture.height >> texture.sparseImageMemoryRequirements.imageMipTailFirstLod, 1u);
-	uint32_t depth = 1;
-
+	// The mip tail memory is bound in prepareSparseTexture, so this only needs to fill it
 	for (uint32_t i = texture.mipTailStart; i < texture.mipLevels; i++) {
 
 		const uint32_t width = std::max(texture.width >> i, 1u);
@@ -838,9 +880,6 @@ void VulkanExample::fillMipTail()
 		imageBuffer.map();
 
 		// Fill buffer with random colors
-		std::random_device rd;
-		std::mt19937 rndEngine(rd());
-		std::uniform_int_distribution<uint32_t> rndDist(0, 255);
 		uint8_t* data = (uint8_t*)imageBuffer.mapped;
 		randomPattern(data, width, height);
 
@@ -860,41 +899,169 @@ void VulkanExample::fillMipTail()
 	}
 }
 
-void VulkanExample::flushRandomPages()
+// Read back the pages requested by the last frame and stream in missing pages, evicting the least recently used ones if the page pool is full
+void VulkanExample::processFeedback()
 {
-	vkDeviceWaitIdle(device);
+	if (!streaming.enabled) {
+		return;
+	}
 
-	std::default_random_engine rndEngine(std::random_device{}());
-	std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
+	streaming.frameIndex++;
+	uint32_t* requested = (uint32_t*)feedbackBuffer.mapped;
+	statistics.frameRequests = 0;
+	statistics.frameMisses = 0;
 
-	std::vector<VirtualTexturePage> updatedPages;
-	std::vector<VirtualTexturePage> bindingChangedPages;
-	for (auto& page : texture.pages)
-	{
-		if (rndDist(rndEngine) < 0.5f) {
+	// Aggregate the per texel requests into a list of missing pages
+	// The coarser pages covering a requested page are requested too, as they're used as the fallback while the finer page isn't resident
+	std::vector<VirtualTexturePage*> missingPages;
+	for (size_t i = 0; i < texture.pages.size(); i++) {
+		if (requested[i] == 0) {
 			continue;
 		}
-		if (page.imageMemoryBind.memory != VK_NULL_HANDLE){
-			page.del = true;
-			bindingChangedPages.push_back(page);
+		requested[i] = 0;
+		VirtualTexturePage* page = &texture.pages[i];
+		uint32_t pageX = page->offset.x / uboVS.pageGranularity.x;
+		uint32_t pageY = page->offset.y / uboVS.pageGranularity.y;
+		for (uint32_t mipLevel = page->mipLevel; mipLevel < uboVS.mipTailStart; mipLevel++) {
+			const glm::uvec4 &levelPages = uboVS.pageTable[mipLevel];
+			VirtualTexturePage* levelPage = &texture.pages[levelPages.x + std::min(pageY, levelPages.z - 1) * levelPages.y + std::min(pageX, levelPages.y - 1)];
+			if (levelPage->lastUsedFrame == streaming.frameIndex) {
+				// This page and all coarser ones have already been requested this frame
+				break;
+			}
+			levelPage->lastUsedFrame = streaming.frameIndex;
+			statistics.frameRequests++;
+			if (!levelPage->resident()) {
+				statistics.frameMisses++;
+				missingPages.push_back(levelPage);
+			}
+			pageX /= 2;
+			pageY /= 2;
+		}
+	}
+	statistics.requests += statistics.frameRequests;
+	statistics.misses += statistics.frameMisses;
+
+	if (missingPages.empty()) {
+		return;
+	}
+
+	// Coarsest pages first, they cover the most screen space per byte
+	std::sort(missingPages.begin(), missingPages.end(), [](const VirtualTexturePage* a, const VirtualTexturePage* b) { return a->mipLevel > b->mipLevel; });
+	if (missingPages.size() > streaming.maxPageInsPerFrame) {
+		missingPages.resize(streaming.maxPageInsPerFrame);
+	}
+
+	// Eviction candidates are resident pages that haven't been requested this frame, least recently used first
+	std::vector<VirtualTexturePage*> evictionCandidates;
+	if (missingPages.size() > texture.pagePool.freeSlots.size()) {
+		for (auto &page : texture.pages) {
+			if (page.resident() && (page.lastUsedFrame != streaming.frameIndex)) {
+				evictionCandidates.push_back(&page);
+			}
+		}
+		std::sort(evictionCandidates.begin(), evictionCandidates.end(), [](const VirtualTexturePage* a, const VirtualTexturePage* b) { return a->lastUsedFrame < b->lastUsedFrame; });
+	}
+
+	std::vector<VirtualTexturePage*> pageIns;
+	std::vector<VirtualTexturePage*> evictions;
+	size_t freeSlots = texture.pagePool.freeSlots.size();
+	for (auto page : missingPages) {
+		if (freeSlots == 0) {
+			if (evictions.size() == evictionCandidates.size()) {
+				// Working set exceeds the memory budget
+				break;
+			}
+			evictions.push_back(evictionCandidates[evictions.size()]);
+			freeSlots++;
+		}
+		pageIns.push_back(page);
+		freeSlots--;
+	}
+
+	updatePages(pageIns, evictions);
+}
+
+// Unbinds the evicted pages and binds the paged in pages with a single sparse binding update, then uploads the content of the paged in pages
+void VulkanExample::updatePages(std::vector<VirtualTexturePage*> &pageIns, std::vector<VirtualTexturePage*> &evictions)
+{
+	if (pageIns.empty() && evictions.empty()) {
+		return;
+	}
+
+	// Evicted pages return their slots to the pool before the paged in pages acquire them
+	std::vector<VirtualTexturePage> bindingChangedPages;
+	for (auto page : evictions) {
+		page->del = true;
+		bindingChangedPages.push_back(*page);
+		page->release(texture.pagePool);
+	}
+	for (auto page : pageIns) {
+		if (page->allocate(texture.pagePool)) {
+			bindingChangedPages.push_back(*page);
 		}
 	}
+	statistics.evictions += static_cast<uint32_t>(evictions.size());
+	statistics.pageIns += static_cast<uint32_t>(pageIns.size());
 
 	// Update sparse queue binding
-	texture.updateSparseBindInfo(bindingChangedPages, true);
-	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-	VkFence fence;
-	VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, fence);
-	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-	vkDestroyFence(device, fence, nullptr);
-	for (auto& page : texture.pages)
-	{
-		if (page.del)
-		{
-			page.release(device);
+	texture.updateSparseBindInfo(bindingChangedPages);
+	if (!pageIns.empty()) {
+		texture.bindSparseInfo.signalSemaphoreCount = 1;
+		texture.bindSparseInfo.pSignalSemaphores = &bindSparseSemaphore;
+	}
+	VK_CHECK_RESULT(vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, VK_NULL_HANDLE));
+
+	if (pageIns.empty()) {
+		return;
+	}
+
+	// Generate some random image data for each new page and upload it once the pages have been bound
+	// The upload command buffer can be reused, as the queue is idle again by the time the next feedback is processed
+	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+	VK_CHECK_RESULT(vkBeginCommandBuffer(streaming.uploadCmdBuffer, &cmdBufInfo));
+	vks::tools::setImageLayout(streaming.uploadCmdBuffer, texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	std::vector<VkBufferImageCopy> regions;
+	VkDeviceSize bufferOffset = 0;
+	for (auto page : pageIns) {
+		randomPattern((uint8_t*)streaming.stagingBuffer.mapped + bufferOffset, page->extent.width, page->extent.height);
+		VkBufferImageCopy region{};
+		region.bufferOffset = bufferOffset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.layerCount = 1;
+		region.imageSubresource.mipLevel = page->mipLevel;
+		region.imageSubresource.baseArrayLayer = page->layer;
+		region.imageOffset = page->offset;
+		region.imageExtent = page->extent;
+		regions.push_back(region);
+		bufferOffset += 4 * page->extent.width * page->extent.height;
+	}
+	vkCmdCopyBufferToImage(streaming.uploadCmdBuffer, streaming.stagingBuffer.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+	vks::tools::setImageLayout(streaming.uploadCmdBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	VK_CHECK_RESULT(vkEndCommandBuffer(streaming.uploadCmdBuffer));
+
+	VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	VkSubmitInfo uploadSubmitInfo = vks::initializers::submitInfo();
+	uploadSubmitInfo.waitSemaphoreCount = 1;
+	uploadSubmitInfo.pWaitSemaphores = &bindSparseSemaphore;
+	uploadSubmitInfo.pWaitDstStageMask = &waitStageMask;
+	uploadSubmitInfo.commandBufferCount = 1;
+	uploadSubmitInfo.pCommandBuffers = &streaming.uploadCmdBuffer;
+	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &uploadSubmitInfo, VK_NULL_HANDLE));
+}
+
+void VulkanExample::evictAllPages()
+{
+	vkQueueWaitIdle(queue);
+	std::vector<VirtualTexturePage*> pageIns;
+	std::vector<VirtualTexturePage*> evictions;
+	for (auto &page : texture.pages) {
+		if (page.resident()) {
+			evictions.push_back(&page);
 		}
 	}
+	updatePages(pageIns, evictions);
+	vkQueueWaitIdle(queue);
 }
 
 void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
@@ -903,21 +1070,25 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 		if (overlay->sliderFloat("LOD bias", &uboVS.lodBias, -(float)texture.mipLevels, (float)texture.mipLevels)) {
 			updateUniformBuffers();
 		}
-		if (overlay->button("Fill random pages")) {
-			fillRandomPages();
-		}
-		if (overlay->button("Flush random pages")) {
-			flushRandomPages();
+		overlay->checkBox("Feedback streaming", &streaming.enabled);
+		if (overlay->button("Evict all pages")) {
+			evictAllPages();
 		}
 		if (overlay->button("Fill mip tail")) {
 			fillMipTail();
 		}
 	}
 	if (overlay->header("Statistics")) {
-		uint32_t respages = 0;
-		std::for_each(texture.pages.begin(), texture.pages.end(), [&respages](VirtualTexturePage page) { respages += (page.resident()) ? 1 : 0; });
+		uint32_t respages = texture.pagePool.capacity - static_cast<uint32_t>(texture.pagePool.freeSlots.size());
 		overlay->text("Resident pages: %d of %d", respages, static_cast<uint32_t>(texture.pages.size()));
+		overlay->text("Page pool: %d of %d", respages, texture.pagePool.capacity);
 		overlay->text("Mip tail starts at: %d", texture.mipTailStart);
+		overlay->text("Page-ins: %d", statistics.pageIns);
+		overlay->text("Evictions: %d", statistics.evictions);
+		overlay->text("Requested pages: %d", statistics.frameRequests);
+		overlay->text("Miss rate: %.2f %% (frame %.2f %%)",
+			statistics.requests > 0 ? 100.0f * statistics.misses / statistics.requests : 0.0f,
+			statistics.frameRequests > 0 ? 100.0f * statistics.frameMisses / statistics.frameRequests : 0.0f);
 	}
 
 }
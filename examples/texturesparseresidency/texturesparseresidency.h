@@ -15,6 +15,22 @@
 
 #define ENABLE_VALIDATION false
 
+// Fixed size pool of device memory that backs the resident pages of a virtual texture
+// Pages are bound to fixed size slots of a single allocation, so paging in and out never allocates memory
+struct PhysicalPagePool
+{
+	VkDevice device;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize pageSize;
+	uint32_t capacity;
+	std::vector<uint32_t> freeSlots;
+
+	void create(VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize pageSize, VkDeviceSize budget);
+	bool acquire(uint32_t &slot);
+	void release(uint32_t slot);
+	void destroy();
+};
+
 // Virtual texture page as a part of the partially resident texture
 // Contains memory bindings, offsets and status information
 struct VirtualTexturePage
@@ -26,12 +42,14 @@ struct VirtualTexturePage
 	uint32_t mipLevel;													// Mip level that this page belongs to
 	uint32_t layer;														// Array layer that this page belongs to
 	uint32_t index;
-    bool del;
+	uint32_t slot;														// Slot of the physical page pool backing this page
+	uint32_t lastUsedFrame;												// Last frame this page has been requested by the feedback buffer
+	bool del;															// Page is unbound with the next sparse binding update
 
 	VirtualTexturePage();
 	bool resident();
-	bool allocate(VkDevice device, uint32_t memoryTypeIndex);
-	bool release(VkDevice device);
+	bool allocate(PhysicalPagePool &pool);
+	bool release(PhysicalPagePool &pool);
 };
 
 // Virtual texture object containing all pages
@@ -46,6 +64,7 @@ struct VirtualTexture
 	VkSparseImageMemoryBindInfo imageMemoryBindInfo;					// Sparse image memory bind info
 	VkSparseImageOpaqueMemoryBindInfo opaqueMemoryBindInfo;				// Sparse image opaque memory bind info (mip tail)
 	uint32_t mipTailStart;												// First mip level in mip tail
+	PhysicalPagePool pagePool;											// Memory backing all resident pages
 	VkSparseImageMemoryRequirements sparseImageMemoryRequirements;		// @todo: Comment
 	uint32_t memoryTypeIndex;											// @todo: Comment
 
@@ -58,7 +77,7 @@ struct VirtualTexture
 	} mipTailInfo;
 
 	VirtualTexturePage *addPage(VkOffset3D offset, VkExtent3D extent, const VkDeviceSize size, const uint32_t mipLevel, uint32_t layer);
-	void updateSparseBindInfo(std::vector<VirtualTexturePage> &bindingChangedPages, bool del = false);
+	void updateSparseBindInfo(const std::vector<VirtualTexturePage> &bindingChangedPages, bool bindMipTail = false);
 	// @todo: replace with dtor?
 	void destroy();
 };
@@ -86,15 +105,44 @@ public:
 		glm::mat4 model;
 		glm::vec4 viewPos;
 		float lodBias = 0.0f;
+		uint32_t mipTailStart;
+		glm::uvec2 pageGranularity;
+		// Per mip level: x = index of the level's first page, y = pages per row, z = page rows
+		glm::uvec4 pageTable[16];
 	} uboVS;
 	vks::Buffer uniformBufferVS;
 
+	// Written by the fragment shader, contains one flag per virtual page that has been sampled in the last frame
+	vks::Buffer feedbackBuffer;
+
+	// Feedback driven page streaming
+	struct Streaming {
+		bool enabled = true;
+		// Maximum device memory used for resident pages
+		VkDeviceSize memoryBudget = 32 * 1024 * 1024;
+		// Maximum number of pages made resident in a single frame
+		uint32_t maxPageInsPerFrame = 64;
+		uint32_t frameIndex = 0;
+		vks::Buffer stagingBuffer;
+		VkCommandBuffer uploadCmdBuffer = VK_NULL_HANDLE;
+	} streaming;
+
+	struct StreamingStatistics {
+		uint32_t pageIns = 0;
+		uint32_t evictions = 0;
+		// Pages requested by the feedback buffer and how many of these weren't resident
+		uint64_t requests = 0;
+		uint64_t misses = 0;
+		uint32_t frameRequests = 0;
+		uint32_t frameMisses = 0;
+	} statistics;
+
 	VkPipeline pipeline;
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
-	//todo: comment
+	// Signaled by the sparse binding update, page uploads wait on it
 	VkSemaphore bindSparseSemaphore = VK_NULL_HANDLE;
 
 	VulkanExample();
@@ -113,13 +161,14 @@ public:
 	void setupDescriptorSet();
 	void preparePipelines();
 	void prepareUniformBuffers();
+	void prepareFeedbackBuffer();
 	void updateUniformBuffers();
 	void prepare();
 	virtual void render();
 	virtual void viewChanged();
-	void uploadContent(VirtualTexturePage page, VkImage image);
-	void fillRandomPages();
+	void processFeedback();
+	void updatePages(std::vector<VirtualTexturePage*> &pageIns, std::vector<VirtualTexturePage*> &evictions);
+	void evictAllPages();
 	void fillMipTail();
-	void flushRandomPages();
 	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay);
 };
@@ -3,8 +3,26 @@
 #extension GL_ARB_sparse_texture2 : enable
 #extension GL_ARB_sparse_texture_clamp : enable
 
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	vec4 viewPos;
+	float lodBias;
+	uint mipTailStart;
+	uvec2 pageGranularity;
+	// Per mip level: x = index of the level's first page, y = pages per row, z = page rows
+	uvec4 pageTable[16];
+} ubo;
+
 layout (binding = 1) uniform sampler2D samplerColor;
 
+// One entry per virtual page, set to 1 if the page has been requested by any fragment in this frame
+layout (binding = 2) buffer Feedback 
+{
+	uint requested[];
+} feedback;
+
 layout (location = 0) in vec2 inUV;
 layout (location = 1) in float inLodBias;
 
@@ -12,20 +30,30 @@ layout (location = 0) out vec4 outFragColor;
 
 void main() 
 {
+	// Record the page this fragment samples from in the feedback buffer
+	// The sampler uses nearest mip filtering, so the sampled level is the rounded LOD
+	float lod = max(textureQueryLod(samplerColor, inUV).y + inLodBias, 0.0);
+	uint mipLevel = uint(lod + 0.5);
+	if (mipLevel < ubo.mipTailStart)
+	{
+		uvec4 levelPages = ubo.pageTable[mipLevel];
+		uvec2 texel = uvec2(clamp(inUV, 0.0, 1.0) * vec2(textureSize(samplerColor, int(mipLevel))));
+		uvec2 page = min(texel / ubo.pageGranularity, levelPages.yz - 1);
+		feedback.requested[levelPages.x + page.y * levelPages.y + page.x] = 1;
+	}
+
 	vec4 color = vec4(0.0);
 
 	// Get residency code for current texel
 	int residencyCode = sparseTextureARB(samplerColor, inUV, color, inLodBias);
 
-	// Fetch sparse until we get a valid texel
-	/*
-	float minLod = 1.0;
-	while (!sparseTexelsResidentARB(residencyCode)) 
+	// Fall back to coarser mip levels until we get a valid texel (the mip tail is always resident)
+	float minLod = float(mipLevel) + 1.0;
+	while (!sparseTexelsResidentARB(residencyCode) && (minLod <= float(ubo.mipTailStart))) 
 	{
 		residencyCode = sparseTextureClampARB(samplerColor, inUV, minLod, color);
-		minLod += 1.0f;
+		minLod += 1.0;
 	}
-	*/
 
 	// Check if texel is resident
 	bool texelResident = sparseTexelsResidentARB(residencyCode);
@@ -36,4 +64,4 @@ void main()
 	}
 
 	outFragColor = color;
-}
\ No newline at end of file
+}
@@ -1,8 +1,25 @@
 // Copyright 2020 Google LLC
 
+struct UBO
+{
+	float4x4 projection;
+	float4x4 model;
+	float4 viewPos;
+	float lodBias;
+	uint mipTailStart;
+	uint2 pageGranularity;
+	// Per mip level: x = index of the level's first page, y = pages per row, z = page rows
+	uint4 pageTable[16];
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
 Texture2D textureColor : register(t1);
 SamplerState samplerColor : register(s1);
 
+// One entry per virtual page, set to 1 if the page has been requested by any fragment in this frame
+RWStructuredBuffer<uint> feedback : register(u2);
+
 struct VSOutput
 {
 [[vk::location(0)]] float2 UV : TEXCOORD0;
@@ -14,16 +31,30 @@ struct VSOutput
 
 float4 main(VSOutput input) : SV_TARGET
 {
+	// Record the page this fragment samples from in the feedback buffer
+	// The sampler uses nearest mip filtering, so the sampled level is the rounded LOD
+	float lod = max(textureColor.CalculateLevelOfDetailUnclamped(samplerColor, input.UV) + input.LodBias, 0.0);
+	uint mipLevel = uint(lod + 0.5);
+	if (mipLevel < ubo.mipTailStart)
+	{
+		uint4 levelPages = ubo.pageTable[mipLevel];
+		uint levelWidth, levelHeight, levelCount;
+		textureColor.GetDimensions(mipLevel, levelWidth, levelHeight, levelCount);
+		uint2 texel = uint2(clamp(input.UV, 0.0, 1.0) * float2(levelWidth, levelHeight));
+		uint2 page = min(texel / ubo.pageGranularity, levelPages.yz - 1);
+		feedback[levelPages.x + page.y * levelPages.y + page.x] = 1;
+	}
+
 	float4 color = float4(0.0, 0.0, 0.0, 0.0);
 
-	// Fetch sparse until we get a valid texel
+	// Fetch sparse until we get a valid texel, falling back to coarser mip levels (the mip tail is always resident)
 	uint status;
-	float minLod = input.LodBias;
+	float minLod = float(mipLevel);
 	do
 	{
 		color = textureColor.SampleLevel(samplerColor, input.UV, minLod, 0, status);
 		minLod += 1.0f;
-	} while(!CheckAccessFullyMapped(status));
+	} while(!CheckAccessFullyMapped(status) && (minLod <= float(ubo.mipTailStart) + 1.0));
 
 	float3 N = normalize(input.Normal);
 